@@ -102,6 +102,13 @@ static pdip_t isys_pdip;
 #define ISYS_SH_PROMPT "ISYS_PDIP> "
 
 
+// ----------------------------------------------------------------------------
+// Name   : isys_prompt
+// Usage  : Precompiled regular expression to synchronize on the shell prompt
+// ----------------------------------------------------------------------------
+static pdip_pattern_t isys_prompt;
+
+
 // ----------------------------------------------------------------------------
 // Name   : isys_display...
 // Usage  : Buffer into which the shell prints its outputs
@@ -139,7 +146,7 @@ struct timeval  to;
   {
     // Refresh the timeout
     to = isys_timeout;
-    rc = pdip_recv(isys_pdip, "^" ISYS_SH_PROMPT "$", &isys_display, &isys_display_sz, &isys_data_sz, &to);
+    rc = pdip_recv_pattern(isys_pdip, isys_prompt, &isys_display, &isys_display_sz, &isys_data_sz, &to);
     switch(rc)
     {
       case PDIP_RECV_FOUND:
@@ -248,7 +255,7 @@ struct timeval  to;
     // Refresh the timeout
     to = isys_timeout;
 
-    rc = pdip_recv(isys_pdip, "^" ISYS_SH_PROMPT "$", &isys_display, &isys_display_sz, &isys_data_sz, &to);
+    rc = pdip_recv_pattern(isys_pdip, isys_prompt, &isys_display, &isys_display_sz, &isys_data_sz, &to);
     switch(rc)
     {
       case PDIP_RECV_FOUND:
@@ -509,6 +516,18 @@ char           *env;
     return -1;
   }
 
+  // Compile the regular expression of the prompt once for all
+  // (the pattern survives fork() as it is not linked to any PDIP object)
+  if (!isys_prompt)
+  {
+    isys_prompt = pdip_pattern_new("^" ISYS_SH_PROMPT "$");
+    if (!isys_prompt)
+    {
+      ISYS_ERR("pdip_pattern_new(): '%m' (%d)\n", errno);
+      return -1;
+    }
+  }
+
   // Configure the PDIP object (By default, the process attached to it
   // can run on any processor)
   (void)pdip_cfg_init(&cfg);
@@ -611,6 +630,12 @@ int status;
   // Delete the PDIP object
   (void)pdip_delete(isys_pdip, &status);
 
+  if (isys_prompt)
+  {
+    (void)pdip_pattern_delete(isys_prompt);
+    isys_prompt = (pdip_pattern_t)0;
+  }
+
 } // isys_lib_exit
 
 
@@ -43,6 +43,9 @@
 #include <stdio.h>
 #include <signal.h>
 #include <sys/time.h>
+#include <time.h>
+#include <sys/uio.h>
+#include <stdint.h>
 
 
 
@@ -67,6 +70,26 @@ extern int pdip_configure(
 		    );
 
 
+// ----------------------------------------------------------------------------
+// Name   : pdip_configure_pty_pool
+// Usage  : Number of pre-opened PTY kept ready for pdip_exec() by a background
+//          thread (0 to deactivate the pool, default)
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_configure_pty_pool(
+                                   unsigned int sz
+                                  );
+
+// Values of 'sig_hdl_internal'
+#define PDIP_SIG_HDL_EXTERNAL  0  // The user calls pdip_signal_handler() from
+                                  // its handler of SIGCHLD
+#define PDIP_SIG_HDL_INTERNAL  1  // PDIP installs its handler of SIGCHLD
+#define PDIP_SIG_HDL_PIDFD     2  // No signal handler: the controlled processes
+                                  // are supervised through process file
+                                  // descriptors (cf. pdip_pidfd())
+
+
 // ----------------------------------------------------------------------------
 // Name   : pdip_signal_handler
 // Usage  : Signal handler
@@ -86,6 +109,63 @@ extern int pdip_signal_handler(
 
 
 
+// ----------------------------------------------------------------------------
+// Name   : pdip_rec_hdr_t
+// Usage  : Header of a session recorded by a PDIP object (cf. pdip_cfg_t).
+//          It is followed by events. As a recording file is opened in append
+//          mode, it may contain several sessions. The integers are stored in
+//          the byte order of the host
+// ----------------------------------------------------------------------------
+#define PDIP_REC_MAGIC    "PDIPREC"   // Including the terminating NUL
+#define PDIP_REC_VERSION  1
+
+typedef struct
+{
+  char     magic[8];   // PDIP_REC_MAGIC
+  uint32_t version;    // PDIP_REC_VERSION
+  uint32_t reserved;
+  uint64_t start;      // Start of the session (CLOCK_REALTIME in nanoseconds)
+} pdip_rec_hdr_t;
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_rec_event_t
+// Usage  : Event of a recorded session, followed by 'len' bytes of data
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  uint8_t  type;
+#define PDIP_REC_PAD     0   // Not an event: zeros left at the end of a mapped
+                             // recording by a crash (PDIP_FLAG_RECORD_MMAP).
+                             // A following session begins at the next page
+                             // boundary
+#define PDIP_REC_EXEC    1   // Process launched: pid (int32_t) and the NUL
+                             // terminated parameters of the program
+#define PDIP_REC_SEND    2   // Data sent to the process
+#define PDIP_REC_RECV    3   // Data received from the process
+#define PDIP_REC_SIGNAL  4   // Signal sent to the process (int32_t)
+#define PDIP_REC_EXIT    5   // Termination status of the process (int32_t)
+  uint8_t  reserved[3];
+  uint32_t len;        // Length of the data following the event
+  uint64_t ts;         // Time since the start of the session (nanoseconds)
+} pdip_rec_event_t;
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_output_cb_t
+// Usage  : Callback invoked with the data as soon as they are read from the
+//          controlled process (cf. pdip_cfg_t)
+// ----------------------------------------------------------------------------
+typedef void (*pdip_output_cb_t)(
+                                 pdip_t      ctx,
+                                 const char *data,
+                                 size_t      len,
+                                 void       *user
+                                );
+
+
+
 // ----------------------------------------------------------------------------
 // Name   : pdip_cfg_t
 // Usage  : Configuration of a PDIP object
@@ -117,14 +197,88 @@ typedef struct
                                          // Otherwise, the data is returned when
                                          // the regular expression is found (default)
 
+#define PDIP_FLAG_NO_REGEX_CACHE   0x04  // If set, pdip_recv() compiles the regular
+                                         // expression at each call.
+                                         // Otherwise, the compiled regular
+                                         // expressions are kept in a cache (default)
+
+#define PDIP_FLAG_OUTPUT_LINES     0x08  // If set, on_output is passed complete
+                                         // lines (one line per call).
+                                         // Otherwise, it is passed the data
+                                         // as they are read (default)
+
+#define PDIP_FLAG_RECORD_MMAP      0x10  // If set, the session is recorded
+                                         // through a mapping of the file.
+                                         // Otherwise, it is written through
+                                         // a buffer (default)
+
+#define PDIP_FLAG_FILTER_CTRL      0x20  // If set, the control characters
+                                         // and the escape sequences are
+                                         // ignored by the pattern matching
+                                         // (the returned data keep them).
+                                         // Otherwise, the data are matched
+                                         // as they are received (default)
+
   unsigned char *cpu;  // Array of bits describing the CPU affinity of the controlled process
                        // Allocated/freed with pdip_cpu_alloc()/pdip_cpu_free()
                        // By default, the affinity is inherited from the main program
 
   size_t buf_resize_increment;   // Amount of space in bytes to add to the reception
                                  // buffer each time additional space is needed
+                                 // (minimum size of the buffers with the
+                                 // geometric growth)
                                  // Default is 1 KB
 
+  unsigned int buf_growth;       // Growth policy of the reception buffers
+#define PDIP_BUF_GROWTH_GEOMETRIC  0     // The size is multiplied by buf_growth_factor (default)
+#define PDIP_BUF_GROWTH_LINEAR     1     // The size is increased by buf_resize_increment
+
+  unsigned int buf_growth_factor; // Multiplier of the geometric growth
+                                  // Default is 2
+
+  size_t buf_max_sz;             // Maximum size in bytes of a reception buffer
+                                 // (i.e. maximum amount of received data not
+                                 // matching the regular expression)
+                                 // Default is 0 (no limit)
+
+  unsigned int buf_overflow;     // Behaviour when the received data kept by
+                                 // the object would exceed buf_max_sz
+#define PDIP_BUF_OVERFLOW_ERROR    0     // PDIP_RECV_ERROR with errno set to ENOSPC (default)
+#define PDIP_BUF_OVERFLOW_FAIL     1     // PDIP_RECV_OVERFLOW
+#define PDIP_BUF_OVERFLOW_DISCARD  2     // The oldest data are discarded
+#define PDIP_BUF_OVERFLOW_SPILL    3     // The oldest data are appended to a
+                                         // temporary file (cf. pdip_spill_fd())
+
+  size_t buf_lookback;           // Amount of data kept when the oldest data
+                                 // are discarded or spilled
+                                 // Default is 0 (half of buf_max_sz)
+
+  unsigned int regex_cache_sz;   // Maximum number of compiled regular expressions
+                                 // kept in the cache of pdip_recv()
+                                 // Default is 8
+
+  pdip_output_cb_t on_output;    // Called with the data as soon as they are read
+                                 // from the controlled process. The pattern
+                                 // matching goes on with the same data
+                                 // Default is NULL (no callback)
+  void *on_output_user;          // Parameter passed to on_output
+
+  unsigned int spawn;            // Creation of the controlled process
+#define PDIP_SPAWN_FORK   0      // fork() (default)
+#define PDIP_SPAWN_VFORK  1      // clone(CLONE_VM|CLONE_VFORK): the memory of the
+                                 // main program is shared with the child until
+                                 // it executes the program (no copy of the page
+                                 // tables)
+
+  const char *record;            // File into which the session is recorded
+                                 // (events appended at the end)
+                                 // Default is NULL (no recording)
+
+  unsigned int screen_rows;      // Size of the virtual screen on which the
+  unsigned int screen_cols;      // output is rendered (cf. pdip_recv_screen())
+                                 // and of the window of the PTY
+                                 // Default is 0 (no virtual screen)
+
 } pdip_cfg_t;
 
 
@@ -253,6 +407,27 @@ extern int pdip_delete(
 extern int pdip_fd(pdip_t ctx);
 
 
+// ----------------------------------------------------------------------------
+// Name   : pdip_pidfd
+// Usage  : Return the process file descriptor of the controlled process
+//          (PDIP_SIG_HDL_PIDFD mode). It becomes readable when the process
+//          dies
+// Return : File descriptor, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_pidfd(pdip_t ctx);
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_spill_fd
+// Usage  : Return the file descriptor of the temporary file into which the
+//          oldest received data are appended (PDIP_BUF_OVERFLOW_SPILL)
+// Return : File descriptor, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_spill_fd(pdip_t ctx);
+
+
 // ----------------------------------------------------------------------------
 // Name   : pdip_status
 // Usage  : Return the status of the dead controlled program
@@ -278,6 +453,35 @@ extern int pdip_set_debug_level(
 			 );
 
 
+// ----------------------------------------------------------------------------
+// Name   : pdip_configure_log
+// Usage  : Set the output mode of the debug messages. In the asynchronous
+//          modes, the messages are stored into a lock-free ring of 'ring_sz'
+//          bytes per thread (0 for the default size) and printed by a
+//          background thread or by pdip_log_flush()
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_configure_log(
+                              int    mode,
+                              size_t ring_sz
+                             );
+
+// Values of 'mode'
+#define PDIP_LOG_SYNC      0  // Messages printed by the calling thread (default)
+#define PDIP_LOG_ASYNC     1  // Messages printed by a background thread
+#define PDIP_LOG_DEFERRED  2  // Messages printed upon pdip_log_flush()
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_log_flush
+// Usage  : Print the debug messages stored in the rings of the threads
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_log_flush(void);
+
+
 
 // ----------------------------------------------------------------------------
 // Name   : pdip_exec
@@ -319,6 +523,271 @@ extern int pdip_recv(
                               // . Regular expression still not found but
                               // data arrived and PDIP_FLAG_RECV_ON_THE_FLOW
                               // is set
+#define PDIP_RECV_OVERFLOW  3 // The received data exceed buf_max_sz
+                              // (PDIP_BUF_OVERFLOW_FAIL), they are available
+                              // through pdip_flush()
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pattern_t
+// Usage  : Precompiled regular expression
+// ----------------------------------------------------------------------------
+typedef void *pdip_pattern_t;
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pattern_new
+// Usage  : Compile a regular expression once for multiple calls to
+//          pdip_recv_pattern(). The resulting object is read-only and can be
+//          shared between threads and PDIP objects
+// Return : Pattern, if OK
+//          0, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern pdip_pattern_t pdip_pattern_new(
+                                       const char *regular_expr
+                                      );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pattern_delete
+// Usage  : Free a pattern allocated by pdip_pattern_new()
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_pattern_delete(
+                               pdip_pattern_t pattern
+                              );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pattern_match
+// Usage  : Look for the first match of a precompiled regular expression in
+//          a NUL terminated string. If not NULL, 'start' and 'end' are set
+//          with the offsets of the beginning and the end of the match
+// Return : 0, if found
+//          1, if not found
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_pattern_match(
+                              pdip_pattern_t  pattern,
+                              const char     *str,
+                              size_t         *start,
+                              size_t         *end
+                             );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_pattern
+// Usage  : Same as pdip_recv() with a precompiled regular expression
+// Return : PDIP_RECV_FOUND
+//          PDIP_RECV_TIMEOUT
+//          PDIP_RECV_DATA
+//          PDIP_RECV_ERROR (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_recv_pattern(
+                             pdip_t           ctx,
+                             pdip_pattern_t   pattern,
+                             char           **display,
+                             size_t          *display_sz,
+                             size_t          *data_sz,
+                             struct timeval  *timeout
+                            );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_until
+// Usage  : Same as pdip_recv_pattern() with an absolute deadline on
+//          CLOCK_MONOTONIC instead of a timeout (NULL to wait indefinitely).
+//          The steps of a dialogue can share the same deadline
+// Return : PDIP_RECV_FOUND
+//          PDIP_RECV_TIMEOUT
+//          PDIP_RECV_DATA
+//          PDIP_RECV_ERROR (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_recv_until(
+                           pdip_t                  ctx,
+                           pdip_pattern_t          pattern,
+                           char                  **display,
+                           size_t                 *display_sz,
+                           size_t                 *data_sz,
+                           const struct timespec  *deadline
+                          );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_any
+// Usage  : Same as pdip_recv_pattern() with several precompiled regular
+//          expressions looked for in one pass. Upon PDIP_RECV_FOUND, 'index'
+//          is set with the index in 'patterns' of the earliest match and
+//          'offset' with the offset of the beginning of the match in the
+//          returned data (both may be NULL)
+// Return : PDIP_RECV_FOUND
+//          PDIP_RECV_TIMEOUT
+//          PDIP_RECV_DATA
+//          PDIP_RECV_ERROR (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_recv_any(
+                         pdip_t           ctx,
+                         pdip_pattern_t   patterns[],
+                         unsigned int     nb,
+                         unsigned int    *index,
+                         size_t          *offset,
+                         char           **display,
+                         size_t          *display_sz,
+                         size_t          *data_sz,
+                         struct timeval  *timeout
+                        );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_view
+// Usage  : Same as pdip_recv_pattern() ('pattern' may be NULL) without copy
+//          of the received data into a user buffer: 'data' points into the
+//          internal buffers of the object. The data (not NUL terminated)
+//          stay valid until the call to pdip_release()
+// Return : PDIP_RECV_FOUND
+//          PDIP_RECV_TIMEOUT
+//          PDIP_RECV_DATA
+//          PDIP_RECV_ERROR (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_recv_view(
+                          pdip_t           ctx,
+                          pdip_pattern_t   pattern,
+                          const char     **data,
+                          size_t          *data_sz,
+                          struct timeval  *timeout
+                         );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_screen
+// Usage  : Receive data from the controlled process until a pattern matches
+//          one of the rows of the virtual screen modified since the last
+//          search ('row' and 'col' are set with the position of the match)
+// Return : PDIP_RECV_FOUND, PDIP_RECV_TIMEOUT or PDIP_RECV_ERROR (errno
+//          is set)
+// ----------------------------------------------------------------------------
+extern int pdip_recv_screen(
+                            pdip_t           ctx,
+                            pdip_pattern_t   pattern,
+                            unsigned int    *row,
+                            unsigned int    *col,
+                            struct timeval  *timeout
+                           );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_screen_all
+// Usage  : Same as pdip_recv_screen() but the whole virtual screen is
+//          searched first
+// Return : PDIP_RECV_FOUND, PDIP_RECV_TIMEOUT or PDIP_RECV_ERROR (errno
+//          is set)
+// ----------------------------------------------------------------------------
+extern int pdip_recv_screen_all(
+                                pdip_t           ctx,
+                                pdip_pattern_t   pattern,
+                                unsigned int    *row,
+                                unsigned int    *col,
+                                struct timeval  *timeout
+                               );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_screen_get
+// Usage  : Get the content of the virtual screen (one line per row without
+//          the trailing blanks)
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_screen_get(
+                           pdip_t    ctx,
+                           char    **display,
+                           size_t   *display_sz,
+                           size_t   *data_sz
+                          );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_release
+// Usage  : Release the data returned by pdip_recv_view()
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_release(
+                        pdip_t ctx
+                       );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_regex_cache_stats
+// Usage  : Get the hit and miss counters of the cache of compiled regular
+//          expressions used by pdip_recv()
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_regex_cache_stats(
+                                  pdip_t         ctx,
+                                  unsigned long *hits,
+                                  unsigned long *misses
+                                 );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_alloc_stats
+// Usage  : Get the number of allocations of reception buffers made for an
+//          object and the current size of its outstanding data buffer
+//          (subset of pdip_stats())
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_alloc_stats(
+                            pdip_t         ctx,
+                            unsigned long *allocs,
+                            size_t        *buf_sz
+                           );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_stats_t
+// Usage  : Performance counters of an object or of the library (cf.
+//          pdip_stats())
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  unsigned long long read_bytes;     // Bytes read from the controlled process
+  unsigned long      read_calls;     // Calls to read()
+  unsigned long long write_bytes;    // Bytes written to the controlled process
+  unsigned long      write_calls;    // Calls to writev()
+  unsigned long      match_calls;    // Searches of a pattern in the received data
+  unsigned long long match_ns;       // Time spent in the searches (nanoseconds)
+  unsigned long      allocs;         // Allocations of reception buffers
+  unsigned long      strdups;        // Duplicated strings (parameters of the
+                                     // programs, regular expressions compiled
+                                     // by the reception services)
+  size_t             buf_peak_sz;    // Peak size of the outstanding data buffer
+  size_t             buf_sz;         // Current size of the outstanding data
+                                     // buffer
+  unsigned long      recv_timeouts;  // Receptions ended by a timeout
+  unsigned long      replies;        // Patterns found after a pdip_send()
+  unsigned long long reply_ns;       // Total time between the last pdip_send()
+                                     // and the pattern found (nanoseconds)
+  unsigned long long reply_max_ns;   // Maximum of this time (nanoseconds)
+  unsigned long long overflow_bytes; // Received bytes discarded or spilled
+                                     // (cf. buf_overflow)
+} pdip_stats_t;
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_stats
+// Usage  : Get the performance counters of an object or, if 'ctx' is NULL,
+//          of the library (all the objects, including the deleted ones)
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_stats(
+                      pdip_t        ctx,
+                      pdip_stats_t *stats
+                     );
 
 
 // ----------------------------------------------------------------------------
@@ -334,6 +803,32 @@ extern int pdip_send(
 	      ) __attribute ((format (printf, 2, 3)));
 
 
+// ----------------------------------------------------------------------------
+// Name   : pdip_send_raw
+// Usage  : Send a buffer as is to the controlled process
+// Return : Amount of sent data, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_send_raw(
+                         pdip_t      ctx,
+                         const void *buf,
+                         size_t      len
+                        );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_sendv
+// Usage  : Send the data of 'iovcnt' buffers as is to the controlled process
+// Return : Amount of sent data, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_sendv(
+                      pdip_t              ctx,
+                      const struct iovec *iov,
+                      int                 iovcnt
+                     );
+
+
 // ----------------------------------------------------------------------------
 // Name   : pdip_flush
 // Usage  : Flush the outstanding data
@@ -361,6 +856,127 @@ extern int pdip_sig(
 
 
 
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_t
+// Usage  : Event loop driving several PDIP objects from one thread
+// ----------------------------------------------------------------------------
+typedef void *pdip_loop_t;
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_cb_t
+// Usage  : Callbacks of an object registered in an event loop (NULL if not
+//          used). The data passed to the callbacks belong to the object: they
+//          are valid until the callback returns
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  // Data received while no pattern is awaited
+  // If NULL, the data are kept until a pattern is awaited
+  void (*on_data)(pdip_loop_t loop, pdip_t ctx, const char *data, size_t data_sz, void *user);
+
+  // The awaited pattern matched: data up to the end of the match
+  void (*on_match)(pdip_loop_t loop, pdip_t ctx, const char *data, size_t data_sz, void *user);
+
+  // The awaited pattern has not been found before the timeout
+  void (*on_timeout)(pdip_loop_t loop, pdip_t ctx, void *user);
+
+  // Reception error ('err' is the errno value): the pattern is no longer
+  // awaited
+  void (*on_error)(pdip_loop_t loop, pdip_t ctx, int err, void *user);
+
+  // The controlled process is dead (the object is no longer in the loop)
+  void (*on_death)(pdip_loop_t loop, pdip_t ctx, int status, void *user);
+} pdip_loop_cb_t;
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_new
+// Usage  : Allocate an event loop
+// Return : Event loop, if OK
+//          0, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern pdip_loop_t pdip_loop_new(void);
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_delete
+// Usage  : Deallocate an event loop (the objects are removed from it)
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_loop_delete(pdip_loop_t loop);
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_add
+// Usage  : Register an object in an event loop
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_loop_add(
+                         pdip_loop_t           loop,
+                         pdip_t                ctx,
+                         const pdip_loop_cb_t *cb,
+                         void                 *user
+                        );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_remove
+// Usage  : Unregister an object from an event loop
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_loop_remove(
+                            pdip_loop_t  loop,
+                            pdip_t       ctx
+                           );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_expect
+// Usage  : Await a pattern on an object registered in an event loop
+//          (NULL pattern to cancel). If 'timeout' is NULL, it is awaited
+//          indefinitely
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_loop_expect(
+                            pdip_loop_t      loop,
+                            pdip_t           ctx,
+                            pdip_pattern_t   pattern,
+                            struct timeval  *timeout
+                           );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_run
+// Usage  : Dispatch the events of the objects registered in an event loop.
+//          If 'timeout' is NULL, the function runs until the loop is empty
+//          or stopped
+// Return : One of the following PDIP_LOOP_xxx values
+// ----------------------------------------------------------------------------
+#define PDIP_LOOP_ERROR   -1 // Error, errno is set
+#define PDIP_LOOP_EMPTY    0 // No more objects in the loop
+#define PDIP_LOOP_STOPPED  1 // pdip_loop_stop() called
+#define PDIP_LOOP_TIMEOUT  2 // Timeout
+extern int pdip_loop_run(
+                         pdip_loop_t      loop,
+                         struct timeval  *timeout
+                        );
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_stop
+// Usage  : Make pdip_loop_run() return (typically called from a callback)
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+extern int pdip_loop_stop(pdip_loop_t loop);
+
+
+
 // ----------------------------------------------------------------------------
 // Name   : pdip_lib_initialize
 // Usage  : Library initialization when needed in a child process
@@ -0,0 +1,118 @@
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// File        : pdip_ctrl.h
+// Description : Search of the bytes removed by PDIP_FLAG_FILTER_CTRL (shared
+//               by the library and the benchmark of the kernels)
+// License     :
+//
+//  Copyright (C) 2007-2018 Rachid Koucha <rachid dot koucha at gmail dot com>
+//
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+
+
+#ifndef PDIP_CTRL_H
+#define PDIP_CTRL_H
+
+
+#include <stddef.h>
+
+#if defined(__SSE2__) && !defined(PDIP_NO_SIMD)
+#include <emmintrin.h>
+#endif // __SSE2__ && !PDIP_NO_SIMD
+
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : PDIP_CTRL
+// Usage  : Bytes removed by PDIP_FLAG_FILTER_CTRL: the control characters
+//          except the tabulation and the newline, and DEL
+// ----------------------------------------------------------------------------
+#define PDIP_CTRL(c) ((((unsigned char)(c) < ' ') && ('\t' != (c)) && ('\n' != (c))) || (0x7F == (unsigned char)(c)))
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_ctrl_span_scalar
+// Usage  : Number of bytes at the beginning of a buffer which are not
+//          removed by PDIP_FLAG_FILTER_CTRL (byte by byte)
+// Return : Offset of the first byte to remove or 'len' if none
+// ----------------------------------------------------------------------------
+static inline size_t pdip_ctrl_span_scalar(
+                                           const char *str,
+                                           size_t      len
+                                          )
+{
+size_t i;
+
+  for (i = 0; i < len; i ++)
+  {
+    if (PDIP_CTRL(str[i]))
+    {
+      break;
+    }
+  } // End for
+
+  return i;
+} // pdip_ctrl_span_scalar
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_ctrl_span
+// Usage  : Same as pdip_ctrl_span_scalar() but 16 bytes at a time with SSE2
+//          (the tail is processed byte by byte). The build option
+//          PDIP_NO_SIMD keeps the scalar loop
+// Return : Offset of the first byte to remove or 'len' if none
+// ----------------------------------------------------------------------------
+static inline size_t pdip_ctrl_span(
+                                    const char *str,
+                                    size_t      len
+                                   )
+{
+#if defined(__SSE2__) && !defined(PDIP_NO_SIMD)
+size_t   i;
+__m128i  v, ctrl, keep;
+int      mask;
+const __m128i us  = _mm_set1_epi8(0x1F);
+const __m128i tab = _mm_set1_epi8('\t');
+const __m128i nl  = _mm_set1_epi8('\n');
+const __m128i del = _mm_set1_epi8(0x7F);
+
+  for (i = 0; (i + 16) <= len; i += 16)
+  {
+    v = _mm_loadu_si128((const __m128i *)(const void *)(str + i));
+
+    // Unsigned v <= 0x1F, i.e. min(v, 0x1F) == v
+    ctrl = _mm_cmpeq_epi8(_mm_min_epu8(v, us), v);
+    keep = _mm_or_si128(_mm_cmpeq_epi8(v, tab), _mm_cmpeq_epi8(v, nl));
+    ctrl = _mm_or_si128(_mm_andnot_si128(keep, ctrl), _mm_cmpeq_epi8(v, del));
+
+    mask = _mm_movemask_epi8(ctrl);
+    if (mask)
+    {
+      return i + (size_t)__builtin_ctz((unsigned int)mask);
+    }
+  } // End for
+
+  return i + pdip_ctrl_span_scalar(str + i, len - i);
+#else
+  return pdip_ctrl_span_scalar(str, len);
+#endif // __SSE2__ && !PDIP_NO_SIMD
+} // pdip_ctrl_span
+
+
+
+#endif // PDIP_CTRL_H
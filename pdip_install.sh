@@ -271,7 +271,7 @@ then
 
   # Delete various common objects
   find . -type f -name a.out -exec rm -f {} \; -print
-  rm -f pdip libpdip.so
+  rm -f pdip libpdip.so*
   rm -f test/check_all test/check_pdip test/check_isys test/check_rsys test/tisys test/tpdip test/man_exe_1 test/man_exe_2 test/man_exe_3
   rm -f isys/libisys.so rsys/librsys.so
 
@@ -427,7 +427,7 @@ then
   cp FindPdip.cmake ${TMPDIR}/${INST_DIR}/lib/cmake
   cp pdip.pc ${TMPDIR}/${INST_DIR}/lib/pkgconfig
   cp pdip ${TMPDIR}/${INST_DIR}/bin
-  cp libpdip.so ${TMPDIR}/${INST_DIR}/lib
+  cp -P libpdip.so* ${TMPDIR}/${INST_DIR}/lib
   cp pdip.h ${TMPDIR}/${INST_DIR}/include
   cp pdip_en.1.gz ${TMPDIR}/${INST_DIR}/share/man/man1/pdip.1.gz
   cp pdip_fr.1.gz ${TMPDIR}/${INST_DIR}/share/man/fr/man1/pdip.1.gz
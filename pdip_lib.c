@@ -58,10 +58,19 @@
 #include <ctype.h>
 #include <stdarg.h>
 #include <sched.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <time.h>
 
 #include "pdip.h"
 #include "pdip_p.h"
 #include "pdip_util.h"
+#include "pdip_ctrl.h"
 
 #include "plat_types.h"
 
@@ -72,8 +81,14 @@
 Notes:
 
   . The global mutex pdip_mtx is used to manage the list of objects
-    as it is accessed by the user (pdip_new, pdip_delete) and
-    the signal handler to look for the object concerned by the SIGCHLD
+    as it is accessed by the user (pdip_new, pdip_delete) and the table
+    of the controlled processes (pdip_pid_tab)
+
+  . The signal handler looks for the object concerned by the SIGCHLD in
+    pdip_pid_tab without lock. It signals its activity through
+    pdip_sig_active: an object or a table which is no longer reachable from
+    pdip_pid_tab is freed only when no signal handler is running
+    (pdip_pid_quiesce())
 
      So, to access the list of objects :
 
@@ -100,6 +115,11 @@ Notes:
 
        PDIP_UNMASK_SIG(); // Reactivate signal handler
 
+  . In PDIP_SIG_HDL_PIDFD mode, there is no signal handler. The death of a
+    controlled process is detected through its process file descriptor
+    (pidfd) or by pdip_status(). PDIP_MASK_SIG()/PDIP_UNMASK_SIG() do not
+    make any system call
+
 
   . Concerning, the read/send data fields, if multiple threads access the
     same object, the mutual exclusion must be managed by the application
@@ -148,922 +168,4381 @@ static pthread_mutex_t pdip_mtx;
 // ----------------------------------------------------------------------------
 static sigset_t pdip_sigset;
 
-#define PDIP_MASK_SIG()  pthread_sigmask(SIG_BLOCK, &pdip_sigset, 0)
-#define PDIP_UNMASK_SIG()  pthread_sigmask(SIG_UNBLOCK, &pdip_sigset, 0)
 
+// ----------------------------------------------------------------------------
+// Name   : pdip_sig_pidfd
+// Usage  : Set in PDIP_SIG_HDL_PIDFD mode: the objects are never updated
+//          asynchronously and the signals do not need to be masked
+// ----------------------------------------------------------------------------
+static int pdip_sig_pidfd;
+
+#define PDIP_MASK_SIG()  do { if (!pdip_sig_pidfd) (void)pthread_sigmask(SIG_BLOCK, &pdip_sigset, 0); } while(0)
+#define PDIP_UNMASK_SIG()  do { if (!pdip_sig_pidfd) (void)pthread_sigmask(SIG_UNBLOCK, &pdip_sigset, 0); } while(0)
 
 
 // ----------------------------------------------------------------------------
-// Name   : ctx_list
-// Usage  : List of PDIP objects
+// Name   : PDIP_STATE_GET/PDIP_STATE_SET
+// Usage  : Atomic accesses to the state of an object as it is updated by the
+//          signal handler, the sending and the receiving threads
 // ----------------------------------------------------------------------------
-static pdip_ctx_t *pdip_ctx_list;
+#define PDIP_STATE_GET(ctxp)     __atomic_load_n(&((ctxp)->state), __ATOMIC_ACQUIRE)
+#define PDIP_STATE_SET(ctxp, s)  __atomic_store_n(&((ctxp)->state), (s), __ATOMIC_RELEASE)
 
 
+// ----------------------------------------------------------------------------
+// Name   : pdip_state_move
+// Usage  : Atomically change the state of an object from 'from' to 'to'
+// Return : 1, if the state changed
+//          0, if the state was not 'from'
+// ----------------------------------------------------------------------------
+static int pdip_state_move(
+                           pdip_ctx_t   *ctxp,
+                           sig_atomic_t  from,
+                           sig_atomic_t  to
+                          )
+{
+sig_atomic_t expected = from;
+
+  return __atomic_compare_exchange_n(&(ctxp->state), &expected, to, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+} // pdip_state_move
+
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_saved_action
-// Usage  : Original signal disposition
+// Name   : PDIP_OBJ_LOCK/PDIP_OBJ_UNLOCK
+// Usage  : Lock/unlock the mutex 'mtx' of an object (nothing if the object
+//          is NULL as the locked service reports the error)
 // ----------------------------------------------------------------------------
-struct sigaction pdip_saved_action;
+#define PDIP_OBJ_LOCK(ctx, mtx)   do { if (ctx) (void)pthread_mutex_lock(&(((pdip_ctx_t *)(ctx))->mtx)); } while(0)
+#define PDIP_OBJ_UNLOCK(ctx, mtx) do { if (ctx) (void)pthread_mutex_unlock(&(((pdip_ctx_t *)(ctx))->mtx)); } while(0)
 
 
 
-//----------------------------------------------------------------------------
-// Name        : pdip_write
-// Description : Write out data
-// Return      : len, if OK
-//               -1, if error (errno is set)
-//----------------------------------------------------------------------------
-static int pdip_write(
-                      pdip_ctx_t *ctxp,
-                      const char *buf,
-                      size_t      len
-                     )
-{
-int          rc;
-unsigned int l;
-int          state;
-int          err_sav;
+// ----------------------------------------------------------------------------
+// Name   : ctx_list
+// Usage  : List of PDIP objects
+// ----------------------------------------------------------------------------
+static pdip_ctx_t *pdip_ctx_list;
 
-  l = 0;
-  do
-  {
-one_more_time:
 
-    rc = write(ctxp->pty_master, buf + l, len - l);
+// ----------------------------------------------------------------------------
+// Name   : pdip_stats_deleted
+// Usage  : Performance counters of the deleted objects (cf. pdip_stats())
+// ----------------------------------------------------------------------------
+static pdip_stats_t pdip_stats_deleted;
 
-    if (rc < 0)
-    {
-      if (EINTR == errno)
-      {
-        goto one_more_time;
-      }
 
-      err_sav = errno;
+// ----------------------------------------------------------------------------
+// Name   : pdip_pid_tab
+// Usage  : Table of the controlled processes indexed by their pid to find
+//          the object concerned by a SIGCHLD in constant time
+// ----------------------------------------------------------------------------
+static pdip_pid_tab_t *pdip_pid_tab;
 
-      PDIP_MASK_SIG();
-      state = ctxp->state;
-      PDIP_UNMASK_SIG();
 
-      // The controlled program may be dead
-      if (state != PDIP_STATE_ALIVE)
-      {
-        PDIP_ERR(ctxp, "Controlled program '%s' (%"PRIPID") is dead\n", ctxp->av[0], ctxp->pid);
+// ----------------------------------------------------------------------------
+// Name   : pdip_sig_active
+// Usage  : Number of signal handlers looking into the table of the
+//          controlled processes
+// ----------------------------------------------------------------------------
+static int pdip_sig_active;
 
-        errno = err_sav;
 
-        // Report an error or the amount of data written until now ?
-        if (l)
-	{
-          return (int)l;
-        }
-        else
-	{
-          return -1;
-	}
-      }
+// ----------------------------------------------------------------------------
+// Name   : pdip_pty_pool
+// Usage  : Pool of pre-opened PTY drawn by pdip_exec() and refilled by a
+//          background thread (cf. pdip_configure_pty_pool()). The fields are
+//          protected by a dedicated mutex (locked after the global mutex)
+// ----------------------------------------------------------------------------
+static pthread_mutex_t pdip_pty_pool_mtx;
+static pdip_pty_t     *pdip_pty_pool;
+static unsigned int    pdip_pty_pool_sz;       // Requested number of PTY
+static unsigned int    pdip_pty_pool_nb;       // Number of ready PTY
+static pthread_cond_t  pdip_pty_pool_cond;     // Signaled when a PTY is drawn
+static pthread_t       pdip_pty_pool_tid;
+static int             pdip_pty_pool_running;  // Set while the thread runs
+static int             pdip_pty_pool_stop;     // Set to stop the thread
 
-      PDIP_ERR(ctxp, "write(%"PRISIZE"): '%m' (%d)\n", len - 1, errno);
-      errno = err_sav;
-      return -1;
-    }
 
-    assert((l + (size_t)rc) <= len);
-    l += (size_t)rc;
-  } while (l != len);
+// ----------------------------------------------------------------------------
+// Name   : pdip_log_xxx
+// Usage  : Rings of the debug messages of the threads in the asynchronous
+//          modes (cf. pdip_configure_log()). The list of rings and the
+//          drain are protected by a dedicated mutex (locked after the mutex
+//          of the pool of PTY)
+// ----------------------------------------------------------------------------
+#define PDIP_LOG_RING_SZ      (64 * 1024)   // Default size of a ring
+#define PDIP_LOG_RING_SZ_MIN  4096
+#define PDIP_LOG_MSG_MAX      1024          // Maximum length of a message
+#define PDIP_LOG_PERIOD_MS    10            // Period of the drain thread
+
+static pthread_mutex_t         pdip_log_mtx;
+static int                     pdip_log_mode;          // PDIP_LOG_xxx
+static size_t                  pdip_log_ring_sz = PDIP_LOG_RING_SZ;
+static pdip_log_ring_t        *pdip_log_rings;
+static __thread pdip_log_ring_t *pdip_log_self;         // Ring of the thread
+static pthread_key_t           pdip_log_key;           // Marks the ring dead
+static int                     pdip_log_key_done;
+static pthread_cond_t          pdip_log_cond;          // Wakes up the thread
+static pthread_t               pdip_log_tid;
+static int                     pdip_log_running;       // Set while the thread runs
+static int                     pdip_log_stop;          // Set to stop the thread
+
+// A thread running pdip_signal_handler() can not allocate its ring: its
+// messages are dropped until it gets one outside of the handler
+static __thread int            pdip_log_in_sig;
+static unsigned long           pdip_log_sig_drops;
+static unsigned long           pdip_log_sig_drops_reported;
 
-  return (int)len;
 
-} // pdip_write
+// ----------------------------------------------------------------------------
+// Name   : pdip_pidfd_open
+// Usage  : Get a process file descriptor (close on exec) for a child process
+// Return : File descriptor, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_pidfd_open(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+  return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+  (void)pid;
+  errno = ENOSYS;
+  return -1;
+#endif // SYS_pidfd_open
+} // pdip_pidfd_open
 
 
-//----------------------------------------------------------------------------
-// Name        : pdip_read
-// Description : Read input data
-// Return      : Number of read bytes if OK
-//               -1, if error
-//----------------------------------------------------------------------------
-static int pdip_read(
-                      pdip_ctx_t   *ctxp,
-                      char         *buf,
-                      size_t        l
-                    )
+// ----------------------------------------------------------------------------
+// Name   : pdip_pidfd_check
+// Usage  : In PDIP_SIG_HDL_PIDFD mode, update the state of the object if the
+//          process file descriptor reports the death of the controlled
+//          process. This replaces the signal handler on the error paths
+//          which need an up to date state
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_pidfd_check(pdip_ctx_t *ctxp)
 {
-int rc;
-int err_sav;
-int state;
+struct pollfd pfd;
 
-  do
+  if ((ctxp->pidfd < 0) || (PDIP_STATE_ALIVE != PDIP_STATE_GET(ctxp)))
   {
-    rc = read(ctxp->pty_master, buf, l);
-    if (-1 == rc)
-    {
-      if (EINTR == errno)
-      {
-        continue;
-      }
+    return;
+  }
 
-      err_sav = errno;
+  // The sending and the receiving threads may check concurrently
+  pfd.fd      = ctxp->pidfd;
+  pfd.events  = POLLIN;
+  pfd.revents = 0;
+  if ((poll(&pfd, 1, 0) > 0) && pdip_state_move(ctxp, PDIP_STATE_ALIVE, PDIP_STATE_ZOMBIE))
+  {
+    PDIP_DBG(ctxp, 1, "Process %"PRIPID" is dead (pidfd)\n", ctxp->pid);
+  }
+} // pdip_pidfd_check
 
-      PDIP_MASK_SIG();
-      state = ctxp->state;
-      PDIP_UNMASK_SIG();
 
-      // The controlled program may be dead (but experimentations show that we may get the error
-      // here before the signal handler updates the state of the object!)
-      if (state != PDIP_STATE_ALIVE)
-      {
-        PDIP_DBG(ctxp, 1, "Controlled program '%s' (%"PRIPID") is dead\n", ctxp->av[0], ctxp->pid);
-      }
 
-      PDIP_DBG(ctxp, 1, "read(fd:%d, l:%"PRISIZE"): '%m' (%d), state=%d\n", ctxp->pty_master, l, errno, state);
-      errno = err_sav;
-      return -1;
-    } // End if read error
-  } while (rc < 0);
 
-  return rc;
-} // pdip_read
+// ----------------------------------------------------------------------------
+// Name   : pdip_saved_action
+// Usage  : Original signal disposition
+// ----------------------------------------------------------------------------
+struct sigaction pdip_saved_action;
 
 
 
 // ----------------------------------------------------------------------------
-// Name   : PDIP_RESIZE_INCREMENT
-// Usage  : Allocation increment for the receiving buffers
-//          (must be bigger than 1 !)
+// Name   : PDIP_SEND_CHUNK
+// Usage  : Maximum amount of data passed to one writev() on the PTY. The
+//          line discipline of the PTY can not buffer more than 4 KB: the big
+//          payloads are pushed chunk by chunk as the controlled program
+//          consumes them
 // ----------------------------------------------------------------------------
-#define PDIP_RESIZE_INCREMENT  1024
+#define PDIP_SEND_CHUNK  4096
 
 
+// ----------------------------------------------------------------------------
+// Name   : PDIP_SEND_IOV_NB
+// Usage  : Maximum number of buffers passed to one writev() on the PTY
+// ----------------------------------------------------------------------------
+#define PDIP_SEND_IOV_NB  64
 
-//----------------------------------------------------------------------------
-// Name        : pdip_read_until_timeout
-// Description : Read input data until a timeout occurs (if requested
-//               by the user)
-// Return      : 0, if OK
-//               -1, if error (data may have been read !)
-//----------------------------------------------------------------------------
-static int pdip_read_until_timeout(
-                                   pdip_ctx_t      *ctxp,
-                                   char           **display,
-                                   size_t          *display_sz,
-                                   size_t          *data_sz,
-                                   struct timeval  *to
-                                  )
-{
-int             rc;
-fd_set          fdset;
-int             err_sav = 0;
-size_t          len;
 
- PDIP_DBG(ctxp, 1, "Reading data from %"PRIPID", timeout %p (%lu s, %lu us)\n", ctxp->pid, to, (to ? to->tv_sec : 0), (to ? to->tv_usec : 0));
+// ----------------------------------------------------------------------------
+// Name   : PDIP_REC_BUF_SZ
+// Usage  : Size of the buffer of the recorders
+// ----------------------------------------------------------------------------
+#define PDIP_REC_BUF_SZ  (64 * 1024)
 
-do_it_again:
 
-  FD_ZERO(&fdset);
-  FD_SET(ctxp->pty_master, &fdset);
-  rc = select(ctxp->pty_master + 1, &fdset, 0, 0, to);
-  switch(rc)
-  {
-    case -1:
-    {
-      err_sav = errno;
-      if (EINTR == errno)
-      {
-        goto do_it_again;
-      }
+// ----------------------------------------------------------------------------
+// Name   : PDIP_REC_MAP_SZ
+// Usage  : Size of the window of the file mapped by the recorders
+//          (PDIP_FLAG_RECORD_MMAP)
+// ----------------------------------------------------------------------------
+#define PDIP_REC_MAP_SZ  (1024 * 1024)
 
-      PDIP_ERR(ctxp, "select(): '%m' (%d), data_sz=%"PRISIZE"\n", errno, *data_sz);
-      rc = -1;
-      goto end;
-    }
-    break;
 
-    case 0: // Timeout
-    {
-      PDIP_DBG(ctxp, 5, "Timeout (data_sz=%"PRISIZE")\n", *data_sz);
+// ----------------------------------------------------------------------------
+// Name   : pdip_rec_map
+// Usage  : Map the window of the recording file beginning at 'map_off'
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_rec_map(pdip_rec_t *rec)
+{
+void *p;
 
-      rc = 0;
-      goto end;
-    }
-    break;
+  // The file is extended to the end of the window
+  if (0 != ftruncate(rec->fd, rec->map_off + (off_t)(rec->buf_sz)))
+  {
+    return -1;
+  }
 
-    default: // There are data
-    {
-      assert(FD_ISSET(ctxp->pty_master, &fdset));
+  p = mmap(0, rec->buf_sz, PROT_READ | PROT_WRITE, MAP_SHARED, rec->fd, rec->map_off);
+  if (MAP_FAILED == p)
+  {
+    rec->buf = (char *)0;
+    return -1;
+  }
 
-      // If there is not enough space in the buffer, enlarge it
-      if ((*display_sz - *data_sz) < ctxp->buf_resize_increment)
-      {
-        *display_sz += ctxp->buf_resize_increment;
-        *display = (char *)realloc(*display, *display_sz);
-        if (!(*display))
-        {
-          // Errno is set
-          err_sav = errno;
-          *display_sz = *data_sz = 0;
-          return -1;
-        }
-      } // End if not enough space in the buffer
+  rec->buf = (char *)p;
 
-      // Read the data, keep one slot for terminating NUL
-      len = (*display_sz) - (*data_sz) - 1;
-      rc = pdip_read(ctxp, *display + *data_sz, len);
-      err_sav = errno;
-      PDIP_DBG(ctxp, 3, "Read %d bytes from process %"PRIPID" in buffer %p at offset %"PRISIZE"\n", rc, ctxp->pid, *display, *data_sz);
-      if (rc >= 0)
-      {
-        // If rc == 0 : No more data to read (i.e. An error occured while reading
-        // or the controlled process is dead)
+  return 0;
+} // pdip_rec_map
 
-        (*data_sz) += rc;
 
-        // NUL terminate the string
-        (*display)[*data_sz] = '\0';
+// ----------------------------------------------------------------------------
+// Name   : pdip_rec_flush
+// Usage  : Write out the buffer of a recorder or move its mapped window
+//          forward
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_rec_flush(pdip_rec_t *rec)
+{
+ssize_t rc;
+size_t  l;
+off_t   end;
 
-        rc = 0;
-      }
-      else // Error
-      {
-        // NUL terminate the string (data read until now)
-        (*display)[*data_sz] = '\0';
+  if (rec->map)
+  {
+    // The new window begins at the page of the end of the data
+    end = rec->map_off + (off_t)(rec->buf_len);
+    (void)munmap(rec->buf, rec->buf_sz);
+    rec->map_off = end & ~((off_t)sysconf(_SC_PAGESIZE) - 1);
+    rec->buf_len = (size_t)(end - rec->map_off);
 
-        PDIP_DBG(ctxp, 1, "Error '%m' (%d), data_sz=%"PRISIZE"\n", errno, *data_sz);
+    return pdip_rec_map(rec);
+  }
 
-        // errno is set
-        rc = -1;
+  l = 0;
+  while (l < rec->buf_len)
+  {
+    rc = write(rec->fd, rec->buf + l, rec->buf_len - l);
+    if (rc < 0)
+    {
+      if (EINTR == errno)
+      {
+        continue;
       }
-    } // break;
-  } // End switch
 
-end:
+      return -1;
+    }
 
-  errno = err_sav;
+    l += (size_t)rc;
+  } // End while
 
-  return rc;
+  rec->buf_len = 0;
 
-} // pdip_read_until_timeout
+  return 0;
+} // pdip_rec_flush
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_flush_internal
-// Usage  : Flush the outstanding data
+// Name   : pdip_rec_copy
+// Usage  : Append data to the recording
 // Return : 0, if OK
-//          -1, if error
+//          -1, if error (errno is set)
 // ----------------------------------------------------------------------------
-static int pdip_flush_internal(
- 	                       pdip_ctx_t  *ctxp,
-                               char       **display,
-                               size_t      *display_sz,
-                               size_t      *data_sz
-                              )
+static int pdip_rec_copy(
+                         pdip_rec_t *rec,
+                         const void *data,
+                         size_t      len
+                        )
 {
-  if (ctxp->outstanding_data)
+size_t l;
+
+  while (len)
   {
-    if (*display_sz)
+    if (rec->buf_len == rec->buf_sz)
     {
-      assert(display && *display);
-      (void)free(*display);
+      if (0 != pdip_rec_flush(rec))
+      {
+        return -1;
+      }
     }
 
-    // The outstanding data is NUL terminated
-    assert('\0' == *(ctxp->outstanding_data + ctxp->outstanding_data_offset));
-    *display = ctxp->outstanding_data;
-    *data_sz = ctxp->outstanding_data_offset;
-    *display_sz = ctxp->outstanding_data_sz;
+    l = rec->buf_sz - rec->buf_len;
+    if (l > len)
+    {
+      l = len;
+    }
 
-    ctxp->outstanding_data        = (char *)0;
-    ctxp->outstanding_data_offset = 0;
-    ctxp->outstanding_data_sz     = 0;
-  }
-  else // No outstanding data
-  {
-    assert(0 == ctxp->outstanding_data_offset);
-    assert(0 == ctxp->outstanding_data_sz);
-    *data_sz = 0;
-  } // End if outstanding data
+    memcpy(rec->buf + rec->buf_len, data, l);
+    rec->buf_len += l;
+    data = (const char *)data + l;
+    len -= l;
+  } // End while
 
   return 0;
-} // pdip_flush_internal
-
-
+} // pdip_rec_copy
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_flush_outstanding
-// Usage  : Flush the outstanding data except the last line if it is not
-//          complete as the following unread yet data may complete the line and
-//          make the regex match
-// Return : 0, if at least one line flushed
-//          1, no line to flush
-//          -1, if error
+// Name   : pdip_rec_close_unlocked
+// Usage  : Stop the recording of the session of an object. Called with the
+//          lock of the recorder held
+// Return : None
 // ----------------------------------------------------------------------------
-static int pdip_flush_outstanding(
- 	                          pdip_ctx_t  *ctxp,
-                                  char       **display,
-                                  size_t      *display_sz,
-                                  size_t      *data_sz
-                                 )
+static void pdip_rec_close_unlocked(pdip_ctx_t *ctxp)
 {
-size_t  len;
- char   *p, *p1, *pEnd;
-
-  assert(ctxp->outstanding_data);
-
-  // If there are no outstanding data
-  if (!(ctxp->outstanding_data_offset))
-  {
-    return 1;
-  }
-
-  pEnd = ctxp->outstanding_data + ctxp->outstanding_data_offset;
-  assert('\0' == *pEnd);
-
-  // Look for the end of the last complete line
-  p = pEnd - 1;
-  while ((p != ctxp->outstanding_data) && (*p != '\n'))
-  {
-    p --;
-  } // End while
+pdip_rec_t *rec = ctxp->rec;
 
-  // If there is not a complete line
-  if ('\n' != *p)
+  if (!rec)
   {
-    return 1;
+    return;
   }
 
-  // Go after the '\n'
-  p ++;
-
-  // Amount of data to return (including the terminating NUL)
-  len = (p - ctxp->outstanding_data) + 1;
+  // The other threads check the recorder before locking it
+  __atomic_store_n(&(ctxp->rec), (pdip_rec_t *)0, __ATOMIC_RELAXED);
 
-  // If at least one byte (not including terminating NUL) can be returned
-  PDIP_DBG(ctxp, 5, "len=%"PRISIZE" + 1\n", len - 1);
-
-  // If there are remaining data behind the last line
-  if (p != pEnd)
+  if (rec->map)
   {
-    p1 = strdup(p);
-    if (!p1)
+    // The file is truncated at the end of the data
+    if (rec->buf)
     {
-      // errno is set
-      return -1;
+      (void)munmap(rec->buf, rec->buf_sz);
+      (void)ftruncate(rec->fd, rec->map_off + (off_t)(rec->buf_len));
     }
   }
   else
   {
-    // To avoid compiler complaints
-    p1 = (char *)0;
+    (void)pdip_rec_flush(rec);
+    free(rec->buf);
   }
 
-  // Return the beginning of the outstanding data
-  *display = ctxp->outstanding_data;
-  *display_sz = ctxp->outstanding_data_sz; // The physical size of the buffer
-  *data_sz = p - ctxp->outstanding_data; // The size of the complete lines
-
-  // NUL terminate the data
-  *p = '\0';
-
-  if (p != pEnd)
-  {
-    // Make the outstanding data refer to the duplicated end of original buffer
-    // (i.e. the remaining data behind the last complete line)
-    ctxp->outstanding_data_sz = (pEnd - p) + 1;
-    ctxp->outstanding_data = p1;
-    ctxp->outstanding_data_offset = ctxp->outstanding_data_sz - 1;
-    assert(strlen(p1) == ctxp->outstanding_data_offset);
-  }
-  else
-  {
-    ctxp->outstanding_data_sz = ctxp->outstanding_data_offset = 0;
-    ctxp->outstanding_data = (char *)0;
-  }
+  (void)close(rec->fd);
+  free(rec->path);
+  free(rec);
+} // pdip_rec_close_unlocked
 
-  return 0;
-} // pdip_flush_outstanding
 
+// ----------------------------------------------------------------------------
+// Name   : pdip_rec_close
+// Usage  : Stop the recording of the session of an object: the sending and
+//          the receiving threads may be recording
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_rec_close(pdip_ctx_t *ctxp)
+{
+  (void)pthread_mutex_lock(&(ctxp->rec_mtx));
+  pdip_rec_close_unlocked(ctxp);
+  (void)pthread_mutex_unlock(&(ctxp->rec_mtx));
+} // pdip_rec_close
 
 
-//----------------------------------------------------------------------------
-// Name        : pdip_append_to_outstanding
-// Description : Put data in outstanding space
-// Return      : 0, if OK
-//              -1, if error
-//----------------------------------------------------------------------------
-static int pdip_append_to_outstanding(
-                                      pdip_ctx_t  *ctxp,
-                                      char       **display,
-                                      size_t      *display_sz,
-                                      size_t      *data_sz
-		   		     )
+// ----------------------------------------------------------------------------
+// Name   : pdip_rec_trim
+// Usage  : A mapped recording interrupted by a crash is not truncated at the
+//          end of its data: it ends with the zeros of its last window
+//          (PDIP_REC_PAD). They are removed before appending a new session.
+//          As a crash leaves a file whose size is a multiple of the page size
+//          and whose last byte is 0, the sessions are only walked through in
+//          this case. The file is left untouched if the zeros are not found
+//          at the boundary of an event
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_rec_trim(int fd)
 {
-int err_sav;
-
-  PDIP_DBG(ctxp, 5, "Appending %"PRISIZE" bytes to outstanding data (%p) at offset %"PRISIZE"\n", *data_sz, ctxp->outstanding_data, ctxp->outstanding_data_offset);
+struct stat       st;
+long              pg;
+char              c;
+ssize_t           rc;
+void             *p;
+const char       *buf;
+size_t            sz, off, end;
+pdip_rec_event_t  ev;
+
+  if (0 != fstat(fd, &st))
+  {
+    return -1;
+  }
 
-  if (!(*data_sz))
+  pg = sysconf(_SC_PAGESIZE);
+  if (!(st.st_size) || (st.st_size % pg))
   {
     return 0;
   }
 
-  // There is always a terminating NUL not counted by data_sz
-  assert(*display_sz > *data_sz);
-  pdip_assert('\0' == (*display)[*data_sz], "*display_sz=%"PRISIZE", *data_sz=%"PRISIZE"\n", *display_sz, *data_sz);
+  rc = pread(fd, &c, 1, st.st_size - 1);
+  if (rc < 0)
+  {
+    return -1;
+  }
 
-  //printf("outstanding_data_sz=%"PRISIZE", outstanding_data_offset=%"PRISIZE", *display_sz=%"PRISIZE", *data_sz=%"PRISIZE"\n", ctxp->outstanding_data_sz, ctxp->outstanding_data_offset, *display_sz, *data_sz);
+  if ((1 != rc) || c)
+  {
+    return 0;
+  }
 
-  // If there are already outstanding data
-  if (ctxp->outstanding_data)
+  sz = (size_t)(st.st_size);
+  p = mmap(0, sz, PROT_READ, MAP_SHARED, fd, 0);
+  if (MAP_FAILED == p)
   {
-    assert(ctxp->outstanding_data_sz > 0);
-    pdip_assert('\0' == ctxp->outstanding_data[ctxp->outstanding_data_offset], "outstanding_data_sz=%"PRISIZE", outstanding_data_offset=%"PRISIZE", *display_sz=%"PRISIZE", *data_sz=%"PRISIZE"\n", ctxp->outstanding_data_sz, ctxp->outstanding_data_offset, *display_sz, *data_sz);
-    assert(ctxp->outstanding_data_offset <= ctxp->outstanding_data_sz);
+    return -1;
+  }
+  buf = (const char *)p;
 
-    if (*data_sz > (ctxp->outstanding_data_sz - (ctxp->outstanding_data_offset + 1)))
+  off = 0;
+  while ((sz - off) >= sizeof(ev))
+  {
+    // Header of a session
+    if (!memcmp(buf + off, PDIP_REC_MAGIC, sizeof(PDIP_REC_MAGIC)))
     {
-      // Terminating NUL is already in ctxp->outstanding_data_sz
-      ctxp->outstanding_data = (char *)realloc(ctxp->outstanding_data, ctxp->outstanding_data_sz + *data_sz);
-      if (!(ctxp->outstanding_data))
+      if ((sz - off) < sizeof(pdip_rec_hdr_t))
       {
-        // Errno is set
-        err_sav = errno;
-        PDIP_ERR(ctxp, "realloc(%"PRISIZE"): '%m' (%d)\n", ctxp->outstanding_data_sz + *data_sz, errno);
-        ctxp->outstanding_data_sz = 0;
-        ctxp->outstanding_data_offset = 0;
-        errno = err_sav;
-        return -1;
+        break;
       }
 
-      ctxp->outstanding_data_sz += *data_sz;
-    } // End if enough space
-
-    // Include terminating NUL in the copy
-    memcpy(ctxp->outstanding_data + ctxp->outstanding_data_offset, *display, *data_sz + 1);
-    ctxp->outstanding_data_offset += *data_sz;
-  }
-  else
-  {
-    assert(0 == ctxp->outstanding_data_sz);
-    assert(0 == ctxp->outstanding_data_offset);
+      off += sizeof(pdip_rec_hdr_t);
+      continue;
+    }
 
-    // Add terminating NUL
-    ctxp->outstanding_data = *display;
-    ctxp->outstanding_data_sz = *display_sz;
-    ctxp->outstanding_data_offset = *data_sz;
-    assert('\0' == ctxp->outstanding_data[ctxp->outstanding_data_offset]);
-  }
+    memcpy(&ev, buf + off, sizeof(ev));
 
-  // Reset the user data
-  *display = (char *)0;
-  *display_sz = 0;
-  *data_sz = 0;
+    if (PDIP_REC_PAD == ev.type)
+    {
+      // Zeros up to the end of the file or to the next session
+      for (end = off; (end < sz) && !(buf[end]); end ++)
+      {
+      } // End for
 
-  return 0;
-} // pdip_append_to_outstanding
+      if (end == sz)
+      {
+        rc = ftruncate(fd, (off_t)off);
+        break;
+      }
 
+      if ((end % (size_t)pg) || ((sz - end) < sizeof(pdip_rec_hdr_t)) ||
+          memcmp(buf + end, PDIP_REC_MAGIC, sizeof(PDIP_REC_MAGIC)))
+      {
+        break;
+      }
 
-//----------------------------------------------------------------------------
-// Name        : pdip_look_for_regex
-// Description : Handle the synchronization string
-// Note        : NUL chars are removed
-//
-// Return      : 0, if synchro string found
-//               1, if synchro string not found
-//              -1, if error
-//----------------------------------------------------------------------------
-static int pdip_look_for_regex(
-                               pdip_ctx_t    *ctxp,
-                               const char    *regular_expr,
-                               regex_t       *regex,
-                               char         **display,
-                               size_t        *display_sz,
-                               size_t        *data_sz
-                              )
-{
-int        rc;
-regmatch_t result;
+      off = end;
+      continue;
+    }
 
-  if (*data_sz)
-  {
-    // Append the incoming data to the outstanding one
-    // If the last line in the outstanding was incomplete, the incoming data may
-    // complete it
-    rc = pdip_append_to_outstanding(ctxp, display, display_sz, data_sz);
-    if (rc != 0)
+    // Not a recording or truncated event
+    if (ev.len > (sz - off - sizeof(ev)))
     {
-      // Errno is set
-      return -1;
+      break;
     }
-  } // End if incoming data to add to the outstanding ones
 
-  // If there are outstanding data
-  if (ctxp->outstanding_data_offset > 0)
-  {
-    PDIP_DUMP(ctxp, 2, "Looking for a match of <%s> in (%p):\n", ctxp->outstanding_data, ctxp->outstanding_data_offset, regular_expr, ctxp->outstanding_data);
+    off += sizeof(ev) + ev.len;
+  } // End while
 
-    // Look for the regular expression in the outstanding data
-    rc = regexec(regex, ctxp->outstanding_data, 1, &result, 0);
-    if (0 == rc)
-    {
-    char   *p;
-    size_t  l;
+  (void)munmap(p, sz);
 
-      // The relative 'rm_eo' field indicates the end offset of the match
-      // If 'rm_eo' == 0, this means that we are matching a beginning or end
-      // of line
-      // regoff_t type of result.rm_eo is sometimes "int" and sometimes
-      // "long int". Hence, the cast to "long int"
-      PDIP_DBG(ctxp, 2, "Pattern matching SUCCEEDED at offset %ld in outstanding data !\n", (long int)(result.rm_eo));
+  return (rc < 0 ? -1 : 0);
+} // pdip_rec_trim
 
-      if (0 == result.rm_eo)
-      {
-	// Here, we are sure that there is at least one
-        // byte (ctxp->outstanding_data_offset > 0)
-        if ('\n' == ctxp->outstanding_data[0])
-	{
-          // Skip the new line
-          PDIP_DBG(ctxp, 2, "Match at offset 0 ==> Skipping end of line !\n");
-          result.rm_eo = 1;
-	}
-      } // End if match beginning/end of line
 
-      // The data up to the end offset of the matching pattern must be
-      // returned to the user
-      // The remainning data stays in the outstanding
-      *display = ctxp->outstanding_data;
-      *display_sz = ctxp->outstanding_data_sz;
-      // The outstanding data is NUL terminated
-      assert('\0' == ctxp->outstanding_data[ctxp->outstanding_data_offset]);
-      *data_sz = result.rm_eo;
-
-      p = ctxp->outstanding_data + *data_sz;
-
-      // Size of the remaining data
-      l = ctxp->outstanding_data_offset - result.rm_eo;
-      pdip_assert(strlen(p) == l, "l=%"PRISIZE", strlen(p)=%"PRISIZE"\n", l, strlen(p));
-
-      // Reset the outstanding data space
-      ctxp->outstanding_data_offset = 0;
-      ctxp->outstanding_data = (char *)0;
-      ctxp->outstanding_data_sz = 0;
-
-      // Append the remaining data in the outstanding space
-      // When the outstanding data is empty, the following function merely makes
-      // the user data becoming the outstanding data without copy. So, we need
-      // to duplicate this space here as we need the beginning of a dynamic memory buffer
-      // (otherwise the call to "free()" to delete the content of the outstanding data
-      // would crash
-      if (l)
-      {
-      size_t  l1;
-
-        p = strdup(p);
-        if (rc < 0)
-        {
-          // Errno is set
-          *display = (char *)0;
-          *data_sz = 0;
-          return -1;
-        }
-        l1 = l + 1;
-        rc = pdip_append_to_outstanding(ctxp, &p, &l1, &l);
-        if (rc < 0)
-        {
-          // Errno is set
-          *display = (char *)0;
-          *data_sz = 0;
-          return -1;
-        }
+// ----------------------------------------------------------------------------
+// Name   : pdip_rec_open
+// Usage  : Start the recording of the session of an object
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_rec_open(
+                         pdip_ctx_t *ctxp,
+                         const char *path
+                        )
+{
+pdip_rec_t      *rec;
+pdip_rec_hdr_t   hdr;
+struct timespec  ts;
+struct stat      st;
+int              err_sav;
+
+  rec = (pdip_rec_t *)calloc(1, sizeof(pdip_rec_t));
+  if (!rec)
+  {
+    return -1;
+  }
+  rec->fd = -1;
+  rec->map = (ctxp->flags & PDIP_FLAG_RECORD_MMAP ? 1 : 0);
+  ctxp->rec = rec;
 
-        assert(0 == l);
-        assert(0 == l1);
-      } // End if remaining outstanding data
+  rec->path = strdup(path);
+  if (!(rec->path))
+  {
+    goto error;
+  }
 
-      // There is at least one slot for the terminating NUL in the outstanding space;
-      (*display)[result.rm_eo] = '\0';
+  // The end of the file is read to remove the zeros left by a crash (and a
+  // mapping needs a read access)
+  rec->fd = open(path, O_RDWR | (rec->map ? 0 : O_APPEND) | O_CREAT | O_CLOEXEC, 0644);
+  if (rec->fd < 0)
+  {
+    err_sav = errno;
+    PDIP_ERR(ctxp, "open(%s): '%m' (%d)\n", path, errno);
+    errno = err_sav;
+    goto error;
+  }
 
-      PDIP_DUMP(ctxp, 2, "Remaining outstanding data (%"PRISIZE" bytes):\n", ctxp->outstanding_data, ctxp->outstanding_data_offset, ctxp->outstanding_data_offset);
+  if (0 != pdip_rec_trim(rec->fd))
+  {
+    err_sav = errno;
+    PDIP_ERR(ctxp, "Trimming of '%s': '%m' (%d)\n", path, errno);
+    errno = err_sav;
+    goto error;
+  }
 
-      return 0;
-    }
-    else // Regex not found
+  if (rec->map)
+  {
+    // The first window begins at the page of the end of the file
+    if (0 != fstat(rec->fd, &st))
     {
-      PDIP_DBG(ctxp, 2, "Pattern matching FAILED!\n");
-
-      // The data is kept in the outstanding space
+      goto error;
+    }
 
-    } // End if regex found
+    rec->buf_sz  = PDIP_REC_MAP_SZ;
+    rec->map_off = st.st_size & ~((off_t)sysconf(_SC_PAGESIZE) - 1);
+    rec->buf_len = (size_t)(st.st_size - rec->map_off);
+    if (0 != pdip_rec_map(rec))
+    {
+      err_sav = errno;
+      PDIP_ERR(ctxp, "mmap(%s): '%m' (%d)\n", path, errno);
+      errno = err_sav;
+      goto error;
+    }
   }
   else
   {
-    PDIP_DBG(ctxp, 2, "No outstanding data to look for a match of <%s>\n", regular_expr);
-  } // End if outstanding data
+    rec->buf_sz = PDIP_REC_BUF_SZ;
+    rec->buf = (char *)malloc(rec->buf_sz);
+    if (!(rec->buf))
+    {
+      goto error;
+    }
+  }
 
-  return 1;
-} // pdip_look_for_regex
+  (void)clock_gettime(CLOCK_MONOTONIC, &(rec->start));
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, PDIP_REC_MAGIC, sizeof(hdr.magic));
+  hdr.version = PDIP_REC_VERSION;
+  (void)clock_gettime(CLOCK_REALTIME, &ts);
+  hdr.start = ((uint64_t)(ts.tv_sec) * 1000000000) + (uint64_t)(ts.tv_nsec);
 
+  return pdip_rec_copy(rec, &hdr, sizeof(hdr));
 
+error:
+
+  err_sav = errno;
+  pdip_rec_close(ctxp);
+  errno = err_sav;
 
+  return -1;
+} // pdip_rec_open
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_recv
-// Usage  : Receive data from the controlled process
-//          If the timeout is NULL and the regular expression is not found,
-//          the function blocks indefinitely
-// Return : PDIP_RECV_FOUND
-//          PDIP_RECV_TIMEOUT
-//          PDIP_RECV_DATA
-//          PDIP_RECV_ERROR (errno is set)
+// Name   : pdip_rec_begin
+// Usage  : Append the descriptor of an event followed by 'len' bytes of data
+// Return : 0, if OK
+//          -1, if error (errno is set)
 // ----------------------------------------------------------------------------
-int pdip_recv(
-              pdip_t          *ctx,
-	      const char      *regular_expr,
-              char           **display,
-              size_t          *display_sz,
-              size_t          *data_sz,      // OUT: strlen() of the received data (i.e. Terminating NUL not counted)
-              struct timeval  *timeout
-             )
+static int pdip_rec_begin(
+                          pdip_rec_t   *rec,
+                          unsigned int  type,
+                          size_t        len
+                         )
 {
-int            rc;
-pdip_ctx_t    *ctxp;
-int            err_sav = 0;
+pdip_rec_event_t  ev;
+struct timespec   ts;
 
-  if (!data_sz)
-  {
-    errno = EINVAL;
-    return PDIP_RECV_ERROR;
-  }
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
 
-  // No data for the moment
-  *data_sz = 0;
+  memset(&ev, 0, sizeof(ev));
+  ev.type = (uint8_t)type;
+  ev.len  = (uint32_t)len;
+  ev.ts   = ((uint64_t)(ts.tv_sec - rec->start.tv_sec) * 1000000000) + (uint64_t)(ts.tv_nsec) - (uint64_t)(rec->start.tv_nsec);
 
-  if (!display || !display_sz || !ctx)
-  {
-    errno = EINVAL;
-    return PDIP_RECV_ERROR;
-  }
+  return pdip_rec_copy(rec, &ev, sizeof(ev));
+} // pdip_rec_begin
 
-  // Some coherency checks
-  if ((*display_sz && !(*display)) ||
-      (!(*display_sz) && *display))
-  {
-    errno = EINVAL;
-    return PDIP_RECV_ERROR;
-  }
 
-  ctxp = (pdip_ctx_t *)ctx;
+// ----------------------------------------------------------------------------
+// Name   : pdip_rec_error
+// Usage  : Stop the recording upon error. Called with the lock of the
+//          recorder held
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_rec_error(pdip_ctx_t *ctxp)
+{
+  PDIP_ERR(ctxp, "Recording into '%s' stopped: '%m' (%d)\n", ctxp->rec->path, errno);
+  pdip_rec_close_unlocked(ctxp);
+} // pdip_rec_error
 
-  // The process may be dead but there may be outstanding data
-  // in internal buffers or PTY. Hence we don't check ALIVE state
-  // but the validity of the file descriptor on the master side
-  // The file descriptor on the master side is equal to -1
-  // only if the object is not linked to any process (i.e. pdip_exec()
-  // not called or process is dead)
-  // No need for mutual exclusion with the signal handler as the
-  // user is supposed to make one call at a time on a given object
-  // (eventually making mutual exclusion on its side if multiple threads
-  // access the same object)
-  if (ctxp->pty_master < 0)
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_rec_eventv
+// Usage  : Record an event with the first 'len' bytes of 'iovcnt' buffers.
+//          The sending and the receiving threads record under the lock of
+//          the recorder which may have been stopped in the meantime
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_rec_eventv(
+                            pdip_ctx_t         *ctxp,
+                            unsigned int        type,
+                            const struct iovec *iov,
+                            int                 iovcnt,
+                            size_t              len
+                           )
+{
+size_t l;
+int    i;
+
+  (void)pthread_mutex_lock(&(ctxp->rec_mtx));
+
+  if (!(ctxp->rec))
   {
-    errno = EPERM;
-    return PDIP_RECV_ERROR;
+    goto end;
   }
 
-  rc = PDIP_RECV_ERROR;
+  if (0 != pdip_rec_begin(ctxp->rec, type, len))
+  {
+    pdip_rec_error(ctxp);
+    goto end;
+  }
 
-  // If a regular expression is not passed for synchronization
-  if (!regular_expr)
+  for (i = 0; len && (i < iovcnt); i ++)
   {
-    // Flush the outstanding data
-    rc = pdip_flush_internal(ctxp, display, display_sz, data_sz);
-    if (rc < 0)
+    l = (iov[i].iov_len < len ? iov[i].iov_len : len);
+    if (0 != pdip_rec_copy(ctxp->rec, iov[i].iov_base, l))
     {
-      // Errno is set
-      err_sav = errno;
-      rc = PDIP_RECV_ERROR;
-      goto end_no_regex;
+      pdip_rec_error(ctxp);
+      goto end;
     }
+    len -= l;
+  } // End for
 
-    // If outstanding data have been flushed ==> Return them to the user
-    if (*data_sz)
+end:
+
+  (void)pthread_mutex_unlock(&(ctxp->rec_mtx));
+} // pdip_rec_eventv
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_rec_exec
+// Usage  : Record the launching of the controlled program
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_rec_exec(
+                          pdip_ctx_t *ctxp,
+                          pid_t       pid
+                         )
+{
+int32_t  rec_pid = pid;
+size_t   len;
+int      i;
+
+  len = sizeof(rec_pid);
+  for (i = 0; i < ctxp->ac; i ++)
+  {
+    len += strlen(ctxp->av[i]) + 1;
+  } // End for
+
+  (void)pthread_mutex_lock(&(ctxp->rec_mtx));
+
+  if (!(ctxp->rec))
+  {
+    goto end;
+  }
+
+  if (0 != pdip_rec_begin(ctxp->rec, PDIP_REC_EXEC, len))
+  {
+    goto error;
+  }
+
+  if (0 != pdip_rec_copy(ctxp->rec, &rec_pid, sizeof(rec_pid)))
+  {
+    goto error;
+  }
+
+  for (i = 0; i < ctxp->ac; i ++)
+  {
+    if (0 != pdip_rec_copy(ctxp->rec, ctxp->av[i], strlen(ctxp->av[i]) + 1))
     {
-      PDIP_DBG(ctxp, 4, "Returning %"PRISIZE" outstanding data bytes\n", *data_sz);
-      rc = PDIP_RECV_DATA;
-      goto end_no_regex;
+      goto error;
     }
+  } // End for
 
-    // If a timeout is passed
-    if (timeout)
-    {
-      // Get new data if any
-      rc = pdip_read_until_timeout(ctxp, display, display_sz, data_sz, timeout);
-      err_sav = errno;
+  goto end;
 
-      switch(rc)
-      {
-        case 0: // No error
-        {
-          // If data have been read
-          if (*data_sz > 0)
-	  {
-            rc = PDIP_RECV_DATA;
-	  }
-          else // No data
-	  {
-            rc = PDIP_RECV_TIMEOUT;
-	  }
-        }
-        break;
+error:
 
-        case -1: // Error
-        {
-          // Data may have been read (data_sz >= 0)
-          // If we received data, return OK!
-          if (*data_sz)
-	  {
-            rc = PDIP_RECV_DATA;
-	  }
-          else
-	  {
-            err_sav = errno;
-            rc = PDIP_RECV_ERROR;
-	  }
-        }
-        break;
+  pdip_rec_error(ctxp);
 
-        default: // Bug !?!
-        {
-          assert(0);
-          err_sav = errno;
-          rc = PDIP_RECV_ERROR;
-        }
-      } // End switch
-    }
-    else // No timeout
-    {
-      // If there is not enough space in the buffer, enlarge it
-      if (*display_sz < ctxp->buf_resize_increment)
-      {
-        *display_sz += ctxp->buf_resize_increment;
-        *display = (char *)realloc(*display, *display_sz);
-        if (!(*display))
-        {
-          *display_sz = *data_sz = 0;
-          // Errno is set
-          err_sav = errno;
-          rc = PDIP_RECV_ERROR;
-          goto end_no_regex;
-        }
-      } // End if not enough space in the buffer
+end:
 
-      // Blocking data reception (let 1 slot for terminating NUL)
-      rc = pdip_read(ctxp, *display, *display_sz - 1);
-      if (rc > 0)
-      {
-        (*display)[rc] = '\0';
-        *data_sz = rc;
-        rc = PDIP_RECV_DATA;
-      }
-      else // Error
-      {
-        assert(0 != rc);
+  (void)pthread_mutex_unlock(&(ctxp->rec_mtx));
+} // pdip_rec_exec
 
-        err_sav = errno;
-        rc = PDIP_RECV_ERROR;
-      }
-    } // End if timeout
 
-end_no_regex:
+// ----------------------------------------------------------------------------
+// Name   : PDIP_REC_EVENT
+// Usage  : Record an event made of 'len' bytes of data if the session of the
+//          object is recorded
+// ----------------------------------------------------------------------------
+#define PDIP_REC_EVENT(ctxp, type, data, len) do {                      \
+    if (__atomic_load_n(&((ctxp)->rec), __ATOMIC_RELAXED))              \
+    {                                                                   \
+    struct iovec rec_iov;                                               \
+      rec_iov.iov_base = (void *)(data);                                \
+      rec_iov.iov_len  = (len);                                         \
+      pdip_rec_eventv((ctxp), (type), &rec_iov, 1, rec_iov.iov_len);    \
+    }                                                                   \
+  } while (0)
 
-    PDIP_DBG(ctxp, 5, "Return code: %d\n", rc);
 
-    errno = err_sav;
+// ----------------------------------------------------------------------------
+// Name   : pdip_now
+// Usage  : Current time on CLOCK_MONOTONIC
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_now(struct timespec *ts)
+{
+  (void)clock_gettime(CLOCK_MONOTONIC, ts);
+} // pdip_now
 
-    return rc;
-  }
-  else // A regular expression has been passed
-  {
-  regex_t regex;
-  char    regex_err[256];
 
-    memset(&regex, 0, sizeof(regex));
+// ----------------------------------------------------------------------------
+// Name   : pdip_ns
+// Usage  : Get the current date on CLOCK_MONOTONIC in nanoseconds
+// Return : The date
+// ----------------------------------------------------------------------------
+static uint64_t pdip_ns(void)
+{
+struct timespec ts;
 
-    // Compile the regular expression
-    //
-    // . After compilation, the compiler returns the number of parenthesized
-    //   subexpressions in regex.re_nsub
-    //
-    PDIP_DBG(ctxp, 3, "Compiling <%s>\n", regular_expr);
-    rc = regcomp(&regex, regular_expr, REG_EXTENDED|REG_NEWLINE);
-    //rc = regcomp(&regex, regular_expr, REG_EXTENDED);
-    if (0 != rc)
-    {
-      (void)regerror(rc, &regex, regex_err, sizeof(regex_err));
-      PDIP_ERR(ctxp, "Bad regular expression <%s>: %s\n", regular_expr, regex_err);
-      err_sav = EINVAL;
-      rc = PDIP_RECV_ERROR;
-      goto end_regex;
-    }
+  pdip_now(&ts);
 
-    PDIP_DBG(ctxp, 5, "Number of sub expressions in regex (%s): %"PRISIZE"\n", regular_expr, regex.re_nsub);
+  return ((uint64_t)(ts.tv_sec) * 1000000000) + (uint64_t)(ts.tv_nsec);
+} // pdip_ns
 
-    // First of all, look for a match in the outstanding data if any
-    rc = pdip_look_for_regex(ctxp, regular_expr, &regex, display, display_sz, data_sz);
 
-    // If pattern matching succeeded
-    if (0 == rc)
-    {
-      rc = PDIP_RECV_FOUND;
-      goto end_regex;
-    } // End if pattern matching succeeded
+// ----------------------------------------------------------------------------
+// Name   : pdip_stats_reply
+// Usage  : Account for the time between the last pdip_send() and the
+//          pattern found
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_stats_reply(pdip_ctx_t *ctxp)
+{
+uint64_t d;
+uint64_t send_ns;
 
-    if (timeout)
-    {
+  // The date is set by the sending thread
+  send_ns = __atomic_exchange_n(&(ctxp->send_ns), 0, __ATOMIC_RELAXED);
+  if (!send_ns)
+  {
+    return;
+  }
 
-read_again:
+  d = pdip_ns() - send_ns;
 
-      rc = pdip_read_until_timeout(ctxp, display, display_sz, data_sz, timeout);
-      err_sav = errno;
+  ctxp->stats.replies ++;
+  ctxp->stats.reply_ns += d;
+  if (d > ctxp->stats.reply_max_ns)
+  {
+    ctxp->stats.reply_max_ns = d;
+  }
+} // pdip_stats_reply
 
-      switch(rc)
-      {
-        case 0: // No error
-        {
-          // If data have been read
-          if (*data_sz > 0)
-	  {
-            // Look for the regular expression
-            rc = pdip_look_for_regex(ctxp, regular_expr, &regex, display, display_sz, data_sz);
-            switch(rc)
-            {
-              case 0 : // Regular expression found
-              {
-                // The read data located after the pattern matching is stored in the
-                // outstanding data of the context.
-                rc = PDIP_RECV_FOUND;
-                goto end_regex;
-              }
-              break;
-              case 1 : // Regular expression not found
-              {
-                // If timeout not elapsed
-                // Linux select() updates the timeout parameter with the remaining time
-                if (timeout->tv_sec || timeout->tv_usec)
-	        {
-                  // Reiterate the read with the remaining timeout only if flag
-                  // RECV_ON_THE_FLOW is not set
-                  if (ctxp->flags & PDIP_FLAG_RECV_ON_THE_FLOW)
-		  {
-                    PDIP_DBG(ctxp, 7, "Flag RECV_ON_THE_FLOW is set ==> Trying an intermediate return of outstanding data\n");
 
-                    // The user wants to receive intermediate data
-                    // ==> Return the data read until now except the last line if it is not complete
-                    //     as the following data may complete the line and make the regex match
-                    rc = pdip_flush_outstanding(ctxp, display, display_sz, data_sz);
-                    switch(rc)
-		    {
-   		      case 0: // Outstanding data to return
-		      {
-                        rc = PDIP_RECV_DATA;
-                        goto end_regex;
-		      }
-                      break;
+// ----------------------------------------------------------------------------
+// Name   : pdip_log_thread_exit
+// Usage  : Destructor of the thread specific key: the ring of the exiting
+//          thread is freed by the next drain once it is empty
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_log_thread_exit(void *p)
+{
+pdip_log_ring_t *ring = (pdip_log_ring_t *)p;
 
-		      case 1: // Not enough outstanding data (at least not a complete line to return)
-		      {
-                        // Loop again to read more data as the timeout is not elapsed
-                        goto read_again;
-		      }
-                      break;
+  pdip_log_self = (pdip_log_ring_t *)0;
 
-	  	      default : // Error
-		      {
-                        err_sav = errno;
-                        rc = PDIP_RECV_ERROR;
-                        goto end_regex;
-		      }
-                      break;
-		    } // End switch
+  __atomic_store_n(&(ring->dead), 1, __ATOMIC_RELEASE);
+} // pdip_log_thread_exit
 
-		  }
-                  else // No reception on the flow
-		  {
-                    // Reiterate the read
-                    goto read_again;
-		  }
-	        }
-                else // Timeout elapsed
-	        {
-                  // This is a scarce (impossible) case where we received data
-                  // and the timeout dropped to 0. I did not succeed to reproduce
-                  // this in unitary tests
 
-                  // Return outstanding data only if RECV_ON_THE_FLOW is set
-                  if ((ctxp->flags & PDIP_FLAG_RECV_ON_THE_FLOW) && (ctxp->outstanding_data_offset))
-		  {
+// ----------------------------------------------------------------------------
+// Name   : pdip_log_ring
+// Usage  : Get the ring of the calling thread (allocated upon the first call)
+// Return : Address of the ring, if OK
+//          NULL, if error
+// ----------------------------------------------------------------------------
+static pdip_log_ring_t *pdip_log_ring(void)
+{
+pdip_log_ring_t *ring;
+
+  if (pdip_log_self)
+  {
+    return pdip_log_self;
+  }
+
+  ring = (pdip_log_ring_t *)calloc(1, sizeof(pdip_log_ring_t));
+  if (!ring)
+  {
+    return (pdip_log_ring_t *)0;
+  }
+
+  ring->sz = __atomic_load_n(&pdip_log_ring_sz, __ATOMIC_RELAXED);
+  ring->buf = (char *)malloc(ring->sz);
+  if (!(ring->buf))
+  {
+    free(ring);
+    return (pdip_log_ring_t *)0;
+  }
+
+  pthread_mutex_lock(&pdip_log_mtx);
+  ring->next = pdip_log_rings;
+  pdip_log_rings = ring;
+  pthread_mutex_unlock(&pdip_log_mtx);
+
+  pdip_log_self = ring;
+  (void)pthread_setspecific(pdip_log_key, ring);
+
+  return ring;
+} // pdip_log_ring
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_log_put
+// Usage  : Store a debug message in the ring of the calling thread. The
+//          message is dropped if the ring is full. The dump is truncated to
+//          keep the record smaller than half of the ring
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_log_put(
+                         pdip_log_ring_t *ring,
+                         int              level,
+                         FILE            *out,
+                         const char      *func,
+                         int              line,
+                         const char      *msg,
+                         size_t           msg_len,
+                         const char      *dump,
+                         size_t           dump_sz
+                        )
+{
+pdip_log_rec_t *rec;
+size_t          dump_len;
+size_t          max;
+size_t          len;
+size_t          off;
+size_t          skip;
+uint64_t        h, t;
+
+  // A signal handler interrupted the thread while it was writing a record
+  if (ring->busy)
+  {
+    __atomic_fetch_add(&(ring->drops), 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  ring->busy = 1;
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+  max = (ring->sz / 2) - 8;
+  dump_len = dump_sz;
+  if ((sizeof(pdip_log_rec_t) + msg_len + dump_len) > max)
+  {
+    dump_len = max - sizeof(pdip_log_rec_t) - msg_len;
+  }
+
+  len = (sizeof(pdip_log_rec_t) + msg_len + dump_len + 7) & ~((size_t)7);
+
+  h = ring->head;
+  t = __atomic_load_n(&(ring->tail), __ATOMIC_ACQUIRE);
+
+  // A record is contiguous: if it does not fit at the end of the ring, the
+  // end is skipped
+  off = (size_t)(h & (ring->sz - 1));
+  skip = ((ring->sz - off) < len ? ring->sz - off : 0);
+
+  if ((h + skip + len - t) > ring->sz)
+  {
+    __atomic_fetch_add(&(ring->drops), 1, __ATOMIC_RELAXED);
+    goto end;
+  }
+
+  if (skip)
+  {
+    *((uint32_t *)(ring->buf + off)) = 0;
+    h += skip;
+    off = 0;
+  }
+
+  rec = (pdip_log_rec_t *)(ring->buf + off);
+  rec->len       = (uint32_t)len;
+  rec->level     = level;
+  rec->line      = line;
+  rec->msg_len   = (uint32_t)msg_len;
+  rec->ts        = pdip_ns();
+  rec->out       = out;
+  rec->func      = func;
+  rec->dump_addr = dump;
+  rec->dump_len  = dump_len;
+  rec->dump_sz   = dump_sz;
+  memcpy(rec + 1, msg, msg_len);
+  if (dump_len)
+  {
+    memcpy((char *)(rec + 1) + msg_len, dump, dump_len);
+  }
+
+  // Publish the record
+  __atomic_store_n(&(ring->head), h + len, __ATOMIC_RELEASE);
+
+end:
+
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+  ring->busy = 0;
+} // pdip_log_put
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_log_peek
+// Usage  : Get the oldest record of a ring written before the beginning of
+//          the current drain. Called with pdip_log_mtx locked
+// Return : Address of the record, if any
+//          NULL, otherwise
+// ----------------------------------------------------------------------------
+static pdip_log_rec_t *pdip_log_peek(pdip_log_ring_t *ring)
+{
+size_t off;
+
+  if (ring->tail == ring->mark)
+  {
+    return (pdip_log_rec_t *)0;
+  }
+
+  off = (size_t)(ring->tail & (ring->sz - 1));
+
+  // Padding up to the end of the ring
+  if (0 == *((uint32_t *)(ring->buf + off)))
+  {
+    __atomic_store_n(&(ring->tail), ring->tail + (ring->sz - off), __ATOMIC_RELEASE);
+    if (ring->tail == ring->mark)
+    {
+      return (pdip_log_rec_t *)0;
+    }
+
+    off = 0;
+  }
+
+  return (pdip_log_rec_t *)(ring->buf + off);
+} // pdip_log_peek
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_log_print
+// Usage  : Print a record in the same format as the synchronous mode
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_log_print(
+                           const pdip_log_rec_t *rec,
+                           pid_t                 pid
+                          )
+{
+const char *msg = (const char *)(rec + 1);
+
+  flockfile(rec->out);
+
+  fprintf(rec->out, "%sPDIP(%d-%d) - %s#%d: %.*s",
+          (rec->dump_addr ? "\n" : ""), pid, rec->level,
+          rec->func, rec->line, (int)(rec->msg_len), msg);
+
+  if (rec->dump_addr)
+  {
+    pdip_dump_file(rec->out, msg + rec->msg_len, rec->dump_len, rec->dump_addr);
+
+    if (rec->dump_len != rec->dump_sz)
+    {
+      fprintf(rec->out, "... %zu bytes not dumped\n", rec->dump_sz - rec->dump_len);
+    }
+  }
+
+  funlockfile(rec->out);
+} // pdip_log_print
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_log_drain
+// Usage  : Print the records of all the rings in chronological order. Called
+//          with pdip_log_mtx locked
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_log_drain(void)
+{
+pdip_log_ring_t  *ring;
+pdip_log_ring_t  *best;
+pdip_log_ring_t **pring;
+pdip_log_rec_t   *rec;
+pdip_log_rec_t   *best_rec;
+unsigned long     drops;
+pid_t             pid;
+
+  pid = getpid();
+
+  // The records written during the drain are left for the next one to
+  // make sure that it ends
+  for (ring = pdip_log_rings; ring; ring = ring->next)
+  {
+    ring->mark = __atomic_load_n(&(ring->head), __ATOMIC_ACQUIRE);
+  } // End for
+
+  // Merge the rings on the dates of the records
+  for (;;)
+  {
+    best = (pdip_log_ring_t *)0;
+    best_rec = (pdip_log_rec_t *)0;
+    for (ring = pdip_log_rings; ring; ring = ring->next)
+    {
+      rec = pdip_log_peek(ring);
+      if (rec && (!best_rec || (rec->ts < best_rec->ts)))
+      {
+        best = ring;
+        best_rec = rec;
+      }
+    } // End for
+
+    if (!best)
+    {
+      break;
+    }
+
+    pdip_log_print(best_rec, pid);
+
+    __atomic_store_n(&(best->tail), best->tail + best_rec->len, __ATOMIC_RELEASE);
+  } // End for
+
+  // Report the lost messages and free the rings of the exited threads
+  drops = __atomic_load_n(&pdip_log_sig_drops, __ATOMIC_RELAXED);
+  if (drops != pdip_log_sig_drops_reported)
+  {
+    fprintf(stderr, "PDIP(%d) - %lu debug messages lost (signal handler of a thread without ring)\n",
+            pid, drops - pdip_log_sig_drops_reported);
+    pdip_log_sig_drops_reported = drops;
+  }
+
+  pring = &pdip_log_rings;
+  while ((ring = *pring))
+  {
+    drops = __atomic_load_n(&(ring->drops), __ATOMIC_RELAXED);
+    if (drops != ring->drops_reported)
+    {
+      fprintf(stderr, "PDIP(%d) - %lu debug messages lost (ring of %zu bytes)\n",
+              pid, drops - ring->drops_reported, ring->sz);
+      ring->drops_reported = drops;
+    }
+
+    if (__atomic_load_n(&(ring->dead), __ATOMIC_ACQUIRE) &&
+        (ring->tail == __atomic_load_n(&(ring->head), __ATOMIC_ACQUIRE)))
+    {
+      *pring = ring->next;
+      free(ring->buf);
+      free(ring);
+      continue;
+    }
+
+    pring = &(ring->next);
+  } // End while
+} // pdip_log_drain
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_log_thread
+// Usage  : Background thread draining periodically the rings in
+//          PDIP_LOG_ASYNC mode
+// Return : NULL
+// ----------------------------------------------------------------------------
+static void *pdip_log_thread(
+                             void *arg
+                            )
+{
+struct timespec ts;
+
+  (void)arg;
+
+  pthread_mutex_lock(&pdip_log_mtx);
+
+  while (!pdip_log_stop)
+  {
+    pdip_log_drain();
+
+    pdip_now(&ts);
+    ts.tv_nsec += PDIP_LOG_PERIOD_MS * 1000000;
+    if (ts.tv_nsec >= 1000000000)
+    {
+      ts.tv_sec += 1;
+      ts.tv_nsec -= 1000000000;
+    }
+
+    (void)pthread_cond_timedwait(&pdip_log_cond, &pdip_log_mtx, &ts);
+  } // End while
+
+  pdip_log_drain();
+
+  pthread_mutex_unlock(&pdip_log_mtx);
+
+  return NULL;
+} // pdip_log_thread
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_log
+// Usage  : Output of PDIP_DBG() and PDIP_DUMP(). The message is formatted by
+//          the caller (the arguments may not exist anymore afterwards) but
+//          it is printed later in the asynchronous modes
+// Return : None
+// ----------------------------------------------------------------------------
+void pdip_log(
+              int          level,
+              FILE        *out,
+              const char  *func,
+              int          line,
+              const char  *dump,
+              size_t       dump_len,
+              const char  *format,
+              ...
+             )
+{
+va_list          ap;
+char             msg[PDIP_LOG_MSG_MAX];
+int              len;
+pdip_log_ring_t *ring;
+int              err_sav;
+
+  // The debug messages do not alter errno
+  err_sav = errno;
+
+  if (PDIP_LOG_SYNC != __atomic_load_n(&pdip_log_mode, __ATOMIC_RELAXED))
+  {
+    // Neither malloc() nor the mutex of the rings are async-signal-safe
+    if (!pdip_log_self && pdip_log_in_sig)
+    {
+      __atomic_fetch_add(&pdip_log_sig_drops, 1, __ATOMIC_RELAXED);
+      errno = err_sav;
+      return;
+    }
+
+    va_start(ap, format);
+    len = vsnprintf(msg, sizeof(msg), format, ap);
+    va_end(ap);
+    if (len < 0)
+    {
+      len = 0;
+    }
+    else if ((size_t)len >= sizeof(msg))
+    {
+      len = sizeof(msg) - 1;
+    }
+
+    ring = pdip_log_ring();
+    if (ring)
+    {
+      pdip_log_put(ring, level, out, func, line, msg, (size_t)len, dump, dump_len);
+      errno = err_sav;
+      return;
+    }
+
+    // No memory for the ring: the message is printed synchronously
+    flockfile(out);
+    fprintf(out, "%sPDIP(%d-%d) - %s#%d: %s", (dump ? "\n" : ""), getpid(), level, func, line, msg);
+  }
+  else
+  {
+    flockfile(out);
+    fprintf(out, "%sPDIP(%d-%d) - %s#%d: ", (dump ? "\n" : ""), getpid(), level, func, line);
+    va_start(ap, format);
+    vfprintf(out, format, ap);
+    va_end(ap);
+  }
+
+  if (dump)
+  {
+    pdip_dump_file(out, dump, dump_len, dump);
+  }
+
+  funlockfile(out);
+
+  errno = err_sav;
+} // pdip_log
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_watch
+// Usage  : Set the events watched on the master side of the PTY of an object
+//          registered in a loop: the room to write is only watched while
+//          sent data are queued
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_loop_watch(pdip_loop_entry_t *e)
+{
+struct epoll_event ev;
+
+  ev.events   = EPOLLIN | (e->out_len ? EPOLLOUT : 0);
+  ev.data.ptr = e;
+
+  return epoll_ctl(e->loop->epfd, EPOLL_CTL_MOD, e->ctxp->pty_master, &ev);
+} // pdip_loop_watch
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_queue
+// Usage  : Queue the data of 'iovcnt' buffers, from the offset 'off' in the
+//          buffer 'i', on an object registered in a loop whose PTY is full.
+//          Called with the sending lock of the object held
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_loop_queue(
+                           pdip_loop_entry_t  *e,
+                           const struct iovec *iov,
+                           int                 iovcnt,
+                           int                 i,
+                           size_t              off
+                          )
+{
+size_t  len, sz, l;
+char   *p;
+int     j;
+int     err_sav;
+int     was_empty = (e->out_len ? 0 : 1);
+
+  len = 0;
+  for (j = i; j < iovcnt; j ++)
+  {
+    len += iov[j].iov_len;
+  } // End for
+  len -= off;
+
+  // The data already written out are dropped before enlarging the buffer
+  if ((e->out_len + len) > e->out_sz)
+  {
+    memmove(e->out, e->out + e->out_off, e->out_len - e->out_off);
+    e->out_len -= e->out_off;
+    e->out_off = 0;
+  }
+
+  if ((e->out_len + len) > e->out_sz)
+  {
+    sz = (e->out_sz ? e->out_sz : PDIP_SEND_CHUNK);
+    while (sz < (e->out_len + len))
+    {
+      sz *= 2;
+    } // End while
+
+    p = (char *)realloc(e->out, sz);
+    if (!p)
+    {
+      err_sav = errno;
+      PDIP_ERR(e->ctxp, "realloc(%"PRISIZE"): '%m' (%d)\n", sz, errno);
+      errno = err_sav;
+      return -1;
+    }
+
+    e->out = p;
+    e->out_sz = sz;
+  }
+
+  for (j = i; j < iovcnt; j ++, off = 0)
+  {
+    l = iov[j].iov_len - off;
+    memcpy(e->out + e->out_len, (const char *)(iov[j].iov_base) + off, l);
+    e->out_len += l;
+  } // End for
+
+  if (was_empty && (0 != pdip_loop_watch(e)))
+  {
+    err_sav = errno;
+    PDIP_ERR(e->ctxp, "epoll_ctl(%d): '%m' (%d)\n", e->ctxp->pty_master, errno);
+    e->out_off = e->out_len = 0;
+    errno = err_sav;
+    return -1;
+  }
+
+  PDIP_DBG(e->ctxp, 3, "Loop: %"PRISIZE" bytes queued for process %"PRIPID"\n", len, e->ctxp->pid);
+
+  return 0;
+} // pdip_loop_queue
+
+
+//----------------------------------------------------------------------------
+// Name        : pdip_writev_unlocked
+// Description : Write out the data of 'iovcnt' buffers. In an event loop,
+//               the data which do not fit in the PTY are queued and written
+//               out by the loop: the caller is not blocked
+// Return      : Total length of the buffers, if OK
+//               Amount of data written, if the controlled program died
+//               -1, if error (errno is set)
+//----------------------------------------------------------------------------
+static int pdip_writev_unlocked(
+                                pdip_ctx_t         *ctxp,
+                                const struct iovec *iov,
+                                int                 iovcnt
+                               )
+{
+struct iovec       chunk[PDIP_SEND_IOV_NB];
+ssize_t            rc;
+size_t             total, l, sz, len, off, o;
+int                i, j, n;
+int                state;
+int                err_sav;
+pdip_loop_entry_t *e = ctxp->loop_entry;
+
+  total = 0;
+  for (i = 0; i < iovcnt; i ++)
+  {
+    total += iov[i].iov_len;
+  } // End for
+
+  // Date of the request for the measurement of the reply time
+  if (total)
+  {
+    __atomic_store_n(&(ctxp->send_ns), pdip_ns(), __ATOMIC_RELAXED);
+  }
+
+  // The data must not overtake the data queued in the event loop
+  if (e && e->out_len)
+  {
+    if (0 != pdip_loop_queue(e, iov, iovcnt, 0, 0))
+    {
+      return -1;
+    }
+
+    return (int)total;
+  }
+
+  // Current position: offset 'off' in the buffer 'i'
+  i = 0;
+  off = 0;
+  l = 0;
+  while (l != total)
+  {
+    // Gather the next chunk
+    n = 0;
+    sz = 0;
+    for (j = i, o = off; (j < iovcnt) && (n < PDIP_SEND_IOV_NB) && (sz < PDIP_SEND_CHUNK); j ++, o = 0)
+    {
+      len = iov[j].iov_len - o;
+      if (len)
+      {
+        if (len > (PDIP_SEND_CHUNK - sz))
+        {
+          len = PDIP_SEND_CHUNK - sz;
+        }
+
+        chunk[n].iov_base = (char *)(iov[j].iov_base) + o;
+        chunk[n].iov_len  = len;
+        n ++;
+        sz += len;
+      }
+    } // End for
+
+    rc = writev(ctxp->pty_master, chunk, n);
+    ctxp->stats.write_calls ++;
+
+    if (rc < 0)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+
+      // The PTY is in non blocking mode in an event loop: the rest of the
+      // data is written out by the loop when there is room
+      if ((EAGAIN == errno) && e)
+      {
+        if (0 != pdip_loop_queue(e, iov, iovcnt, i, off))
+        {
+          return (l ? (int)l : -1);
+        }
+
+        return (int)total;
+      }
+
+      // Non blocking PTY out of an event loop: wait for room
+      if (EAGAIN == errno)
+      {
+      struct pollfd pfd;
+
+        pfd.fd = ctxp->pty_master;
+        pfd.events = POLLOUT;
+        (void)poll(&pfd, 1, -1);
+        continue;
+      }
+
+      err_sav = errno;
+
+      pdip_pidfd_check(ctxp);
+
+      PDIP_MASK_SIG();
+      state = PDIP_STATE_GET(ctxp);
+      PDIP_UNMASK_SIG();
+
+      // The controlled program may be dead
+      if (state != PDIP_STATE_ALIVE)
+      {
+        PDIP_ERR(ctxp, "Controlled program '%s' (%"PRIPID") is dead\n", ctxp->av[0], ctxp->pid);
+
+        errno = err_sav;
+
+        // Report an error or the amount of data written until now ?
+        if (l)
+	{
+          return (int)l;
+        }
+        else
+	{
+          return -1;
+	}
+      }
+
+      PDIP_ERR(ctxp, "writev(%"PRISIZE"): '%m' (%d)\n", sz, errno);
+      errno = err_sav;
+      return -1;
+    }
+
+    assert((size_t)rc <= sz);
+    l += (size_t)rc;
+    ctxp->stats.write_bytes += (unsigned long long)rc;
+
+    if (__atomic_load_n(&(ctxp->rec), __ATOMIC_RELAXED))
+    {
+      pdip_rec_eventv(ctxp, PDIP_REC_SEND, chunk, n, (size_t)rc);
+    }
+
+    // Move the current position forward
+    while (rc)
+    {
+      len = iov[i].iov_len - off;
+      if ((size_t)rc < len)
+      {
+        off += (size_t)rc;
+        rc = 0;
+      }
+      else
+      {
+        rc -= (ssize_t)len;
+        i ++;
+        off = 0;
+      }
+    } // End while
+  } // End while
+
+  return (int)total;
+
+} // pdip_writev_unlocked
+
+
+//----------------------------------------------------------------------------
+// Name        : pdip_writev
+// Description : Write out the data of 'iovcnt' buffers under the sending
+//               lock of the object: the data of concurrent senders are not
+//               interleaved and a receiving thread is not blocked
+// Return      : cf. pdip_writev_unlocked()
+//----------------------------------------------------------------------------
+static int pdip_writev(
+                       pdip_ctx_t         *ctxp,
+                       const struct iovec *iov,
+                       int                 iovcnt
+                      )
+{
+int rc;
+
+  PDIP_OBJ_LOCK(ctxp, send_mtx);
+  rc = pdip_writev_unlocked(ctxp, iov, iovcnt);
+  PDIP_OBJ_UNLOCK(ctxp, send_mtx);
+
+  return rc;
+} // pdip_writev
+
+
+//----------------------------------------------------------------------------
+// Name        : pdip_write
+// Description : Write out data
+// Return      : len, if OK
+//               -1, if error (errno is set)
+//----------------------------------------------------------------------------
+static int pdip_write(
+                      pdip_ctx_t *ctxp,
+                      const char *buf,
+                      size_t      len
+                     )
+{
+struct iovec iov;
+
+  // The members of struct iovec are not const but writev() only reads the
+  // data: this is the only place where the const qualifier is dropped
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wcast-qual"
+  iov.iov_base = (void *)buf;
+#pragma GCC diagnostic pop
+  iov.iov_len  = len;
+
+  return pdip_writev(ctxp, &iov, 1);
+} // pdip_write
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_output_end
+// Usage  : Pass the pending incomplete line (if any) to the output callback
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_output_end(pdip_ctx_t *ctxp)
+{
+size_t len = ctxp->output_line_len;
+
+  if (len)
+  {
+    ctxp->output_line_len = 0;
+    ctxp->on_output((pdip_t)ctxp, ctxp->output_line, len, ctxp->on_output_user);
+  }
+} // pdip_output_end
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_output_keep
+// Usage  : Append data to the pending incomplete line
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_output_keep(
+                            pdip_ctx_t *ctxp,
+                            const char *data,
+                            size_t      len
+                           )
+{
+size_t  sz;
+char   *p;
+
+  if ((ctxp->output_line_len + len) > ctxp->output_line_sz)
+  {
+    sz = (ctxp->output_line_sz ? ctxp->output_line_sz : ctxp->buf_resize_increment);
+    while (sz < (ctxp->output_line_len + len))
+    {
+      sz *= 2;
+    } // End while
+
+    p = (char *)realloc(ctxp->output_line, sz);
+    if (!p)
+    {
+      return -1;
+    }
+
+    ctxp->output_line = p;
+    ctxp->output_line_sz = sz;
+  }
+
+  memcpy(ctxp->output_line + ctxp->output_line_len, data, len);
+  ctxp->output_line_len += len;
+
+  return 0;
+} // pdip_output_keep
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_output
+// Usage  : Pass the data read from the controlled process to the output
+//          callback: as they are or line by line (PDIP_FLAG_OUTPUT_LINES).
+//          The complete lines are passed without copy. Only the last
+//          incomplete line is kept (up to 'buf_max_sz' bytes if set)
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_output(
+                        pdip_ctx_t *ctxp,
+                        const char *data,
+                        size_t      len
+                       )
+{
+const char *eol;
+size_t      l;
+
+  if (!(ctxp->on_output))
+  {
+    return;
+  }
+
+  if (!(ctxp->flags & PDIP_FLAG_OUTPUT_LINES))
+  {
+    ctxp->on_output((pdip_t)ctxp, data, len, ctxp->on_output_user);
+    return;
+  }
+
+  while (len)
+  {
+    eol = (const char *)memchr(data, '\n', len);
+    l = (eol ? (size_t)(eol + 1 - data) : len);
+
+    if (ctxp->output_line_len || !eol)
+    {
+      // End of the pending line or beginning of an incomplete line
+      if (0 != pdip_output_keep(ctxp, data, l))
+      {
+        // Not enough memory: the line is passed in pieces
+        pdip_output_end(ctxp);
+        ctxp->on_output((pdip_t)ctxp, data, l, ctxp->on_output_user);
+      }
+      else if (eol || (ctxp->buf_max_sz && (ctxp->output_line_len >= ctxp->buf_max_sz)))
+      {
+        pdip_output_end(ctxp);
+      }
+    }
+    else
+    {
+      ctxp->on_output((pdip_t)ctxp, data, l, ctxp->on_output_user);
+    }
+
+    data += l;
+    len  -= l;
+  } // End while
+} // pdip_output
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_scr_blank
+// Usage  : Erase the cells [c0, c1[ of a row of the virtual screen
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_scr_blank(
+                           pdip_screen_t *scr,
+                           unsigned int   r,
+                           unsigned int   c0,
+                           unsigned int   c1
+                          )
+{
+uint32_t *p = scr->cells + ((size_t)r * scr->cols);
+
+  for (; c0 < c1; c0 ++)
+  {
+    p[c0] = ' ';
+  } // End for
+
+  scr->dirty[r] = 1;
+} // pdip_scr_blank
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_scr_scroll_up
+// Usage  : Scroll up the rows [top, bottom] of the virtual screen by 'n'
+//          rows (blank rows appear at the bottom)
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_scr_scroll_up(
+                               pdip_screen_t *scr,
+                               unsigned int   top,
+                               unsigned int   bottom,
+                               unsigned int   n
+                              )
+{
+unsigned int r;
+
+  if (n > bottom + 1 - top)
+  {
+    n = bottom + 1 - top;
+  }
+
+  memmove(scr->cells + ((size_t)top * scr->cols),
+          scr->cells + ((size_t)(top + n) * scr->cols),
+          (size_t)(bottom + 1 - top - n) * scr->cols * sizeof(uint32_t));
+
+  for (r = bottom + 1 - n; r <= bottom; r ++)
+  {
+    pdip_scr_blank(scr, r, 0, scr->cols);
+  } // End for
+
+  memset(scr->dirty + top, 1, bottom + 1 - top);
+} // pdip_scr_scroll_up
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_scr_scroll_down
+// Usage  : Scroll down the rows [top, bottom] of the virtual screen by 'n'
+//          rows (blank rows appear at the top)
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_scr_scroll_down(
+                                 pdip_screen_t *scr,
+                                 unsigned int   top,
+                                 unsigned int   bottom,
+                                 unsigned int   n
+                                )
+{
+unsigned int r;
+
+  if (n > bottom + 1 - top)
+  {
+    n = bottom + 1 - top;
+  }
+
+  memmove(scr->cells + ((size_t)(top + n) * scr->cols),
+          scr->cells + ((size_t)top * scr->cols),
+          (size_t)(bottom + 1 - top - n) * scr->cols * sizeof(uint32_t));
+
+  for (r = top; r < top + n; r ++)
+  {
+    pdip_scr_blank(scr, r, 0, scr->cols);
+  } // End for
+
+  memset(scr->dirty + top, 1, bottom + 1 - top);
+} // pdip_scr_scroll_down
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_scr_goto
+// Usage  : Move the cursor of the virtual screen (the position is clamped
+//          into the screen)
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_scr_goto(
+                          pdip_screen_t *scr,
+                          unsigned int   r,
+                          unsigned int   c
+                         )
+{
+  scr->row  = (r < scr->rows ? r : scr->rows - 1);
+  scr->col  = (c < scr->cols ? c : scr->cols - 1);
+  scr->wrap = 0;
+} // pdip_scr_goto
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_scr_lf
+// Usage  : Move the cursor of the virtual screen one row down (the scrolling
+//          region scrolls up if the cursor is on its last row)
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_scr_lf(pdip_screen_t *scr)
+{
+  scr->wrap = 0;
+
+  if (scr->row == scr->bottom)
+  {
+    pdip_scr_scroll_up(scr, scr->top, scr->bottom, 1);
+  }
+  else if (scr->row + 1 < scr->rows)
+  {
+    scr->row ++;
+  }
+} // pdip_scr_lf
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_scr_ri
+// Usage  : Move the cursor of the virtual screen one row up (the scrolling
+//          region scrolls down if the cursor is on its first row)
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_scr_ri(pdip_screen_t *scr)
+{
+  scr->wrap = 0;
+
+  if (scr->row == scr->top)
+  {
+    pdip_scr_scroll_down(scr, scr->top, scr->bottom, 1);
+  }
+  else if (scr->row)
+  {
+    scr->row --;
+  }
+} // pdip_scr_ri
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_scr_put
+// Usage  : Display a character at the cursor of the virtual screen. As on
+//          the terminals, the cursor goes to the next line with the character
+//          following the one written in the last column
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_scr_put(
+                         pdip_screen_t *scr,
+                         uint32_t       cp
+                        )
+{
+  if (scr->wrap)
+  {
+    scr->col = 0;
+    pdip_scr_lf(scr);
+  }
+
+  scr->cells[((size_t)(scr->row) * scr->cols) + scr->col] = cp;
+  scr->dirty[scr->row] = 1;
+
+  if (scr->col + 1 < scr->cols)
+  {
+    scr->col ++;
+  }
+  else
+  {
+    scr->wrap = 1;
+  }
+} // pdip_scr_put
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_scr_reset
+// Usage  : Reset the virtual screen into its initial state (blank main
+//          screen, cursor at the top left corner)
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_scr_reset(pdip_screen_t *scr)
+{
+unsigned int  r;
+uint32_t     *p;
+
+  if (scr->alt_on)
+  {
+    p = scr->cells;
+    scr->cells = scr->alt;
+    scr->alt = p;
+    scr->alt_on = 0;
+  }
+
+  for (r = 0; r < scr->rows; r ++)
+  {
+    pdip_scr_blank(scr, r, 0, scr->cols);
+  } // End for
+
+  scr->row       = 0;
+  scr->col       = 0;
+  scr->wrap      = 0;
+  scr->saved_row = 0;
+  scr->saved_col = 0;
+  scr->top       = 0;
+  scr->bottom    = scr->rows - 1;
+  scr->state     = PDIP_SCR_GROUND;
+  scr->cp_left   = 0;
+} // pdip_scr_reset
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_scr_alt
+// Usage  : Switch to/from the alternate screen of the full screen
+//          applications ('cursor' is set if the cursor is saved/restored
+//          as well)
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_scr_alt(
+                         pdip_screen_t *scr,
+                         int            on,
+                         int            cursor
+                        )
+{
+unsigned int  r;
+uint32_t     *p;
+
+  if (on == scr->alt_on)
+  {
+    return;
+  }
+
+  if (on && cursor)
+  {
+    scr->saved_row = scr->row;
+    scr->saved_col = scr->col;
+  }
+
+  p = scr->cells;
+  scr->cells = scr->alt;
+  scr->alt = p;
+  scr->alt_on = on;
+
+  if (on)
+  {
+    // The alternate screen starts blank
+    for (r = 0; r < scr->rows; r ++)
+    {
+      pdip_scr_blank(scr, r, 0, scr->cols);
+    } // End for
+  }
+  else
+  {
+    memset(scr->dirty, 1, scr->rows);
+
+    if (cursor)
+    {
+      pdip_scr_goto(scr, scr->saved_row, scr->saved_col);
+    }
+  }
+} // pdip_scr_alt
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_scr_ctrl
+// Usage  : Execute a control character on the virtual screen. As the PTY
+//          does not turn the newlines into CR/LF (no ONLCR), a newline
+//          moves the cursor to the beginning of the next line
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_scr_ctrl(
+                          pdip_screen_t *scr,
+                          unsigned char  c
+                         )
+{
+  switch(c)
+  {
+    case '\r' :
+    {
+      scr->col  = 0;
+      scr->wrap = 0;
+    }
+    break;
+
+    case '\n' :
+    case '\v' :
+    case '\f' :
+    {
+      scr->col = 0;
+      pdip_scr_lf(scr);
+    }
+    break;
+
+    case '\b' :
+    {
+      if (scr->col)
+      {
+        scr->col --;
+      }
+      scr->wrap = 0;
+    }
+    break;
+
+    case '\t' :
+    {
+      pdip_scr_goto(scr, scr->row, (scr->col | 7) + 1);
+    }
+    break;
+
+    default : // BEL, SO, SI... do not change the display
+    {
+    }
+    break;
+  } // End switch
+} // pdip_scr_ctrl
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_scr_csi
+// Usage  : Execute a control sequence (ESC [ params final) on the virtual
+//          screen. The sequences which do not change the text (e.g.
+//          colors) are ignored
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_scr_csi(
+                         pdip_screen_t *scr,
+                         unsigned char  final
+                        )
+{
+unsigned int  n;
+unsigned int  r;
+unsigned int  i;
+uint32_t     *p;
+
+  // Most of the parameters default to 1
+  n = (scr->params[0] ? scr->params[0] : 1);
+
+  // The only private sequences changing the display are the switches
+  // to/from the alternate screen
+  if (scr->priv)
+  {
+    if (('?' == scr->priv) && (('h' == final) || ('l' == final)))
+    {
+      for (i = 0; i <= scr->nparams; i ++)
+      {
+        if ((1049 == scr->params[i]) || (1047 == scr->params[i]) || (47 == scr->params[i]))
+        {
+          pdip_scr_alt(scr, ('h' == final), (1049 == scr->params[i]));
+        }
+      } // End for
+    }
+
+    return;
+  }
+
+  switch(final)
+  {
+    case 'A' : // Cursor up (stopped by the top of the scrolling region)
+    case 'F' : // Cursor up at the beginning of the line
+    {
+      r = (scr->row >= scr->top ? scr->top : 0);
+      pdip_scr_goto(scr, (scr->row - r > n ? scr->row - n : r), ('F' == final ? 0 : scr->col));
+    }
+    break;
+
+    case 'B' : // Cursor down (stopped by the bottom of the scrolling region)
+    case 'e' :
+    case 'E' : // Cursor down at the beginning of the line
+    {
+      r = (scr->row <= scr->bottom ? scr->bottom : scr->rows - 1);
+      pdip_scr_goto(scr, (r - scr->row > n ? scr->row + n : r), ('E' == final ? 0 : scr->col));
+    }
+    break;
+
+    case 'C' : // Cursor forward
+    case 'a' :
+    {
+      pdip_scr_goto(scr, scr->row, (scr->cols - scr->col > n ? scr->col + n : scr->cols));
+    }
+    break;
+
+    case 'D' : // Cursor backward
+    {
+      pdip_scr_goto(scr, scr->row, (scr->col > n ? scr->col - n : 0));
+    }
+    break;
+
+    case 'G' : // Cursor at column
+    case '`' :
+    {
+      pdip_scr_goto(scr, scr->row, n - 1);
+    }
+    break;
+
+    case 'd' : // Cursor at row
+    {
+      pdip_scr_goto(scr, n - 1, scr->col);
+    }
+    break;
+
+    case 'H' : // Cursor at row and column
+    case 'f' :
+    {
+      pdip_scr_goto(scr, n - 1, (scr->params[1] ? scr->params[1] - 1 : 0));
+    }
+    break;
+
+    case 'J' : // Erase in display
+    {
+      for (r = 0; r < scr->rows; r ++)
+      {
+        if (((0 == scr->params[0]) && (r > scr->row)) ||
+            ((1 == scr->params[0]) && (r < scr->row)) ||
+            (scr->params[0] >= 2))
+        {
+          pdip_scr_blank(scr, r, 0, scr->cols);
+        }
+      } // End for
+
+      switch(scr->params[0])
+      {
+        case 0  : pdip_scr_blank(scr, scr->row, scr->col, scr->cols); break;
+        case 1  : pdip_scr_blank(scr, scr->row, 0, scr->col + 1); break;
+        default : break;
+      } // End switch
+    }
+    break;
+
+    case 'K' : // Erase in line
+    {
+      switch(scr->params[0])
+      {
+        case 0  : pdip_scr_blank(scr, scr->row, scr->col, scr->cols); break;
+        case 1  : pdip_scr_blank(scr, scr->row, 0, scr->col + 1); break;
+        default : pdip_scr_blank(scr, scr->row, 0, scr->cols); break;
+      } // End switch
+    }
+    break;
+
+    case 'L' : // Insert lines
+    case 'M' : // Delete lines
+    {
+      if ((scr->row >= scr->top) && (scr->row <= scr->bottom))
+      {
+        if ('L' == final)
+        {
+          pdip_scr_scroll_down(scr, scr->row, scr->bottom, n);
+        }
+        else
+        {
+          pdip_scr_scroll_up(scr, scr->row, scr->bottom, n);
+        }
+        pdip_scr_goto(scr, scr->row, 0);
+      }
+    }
+    break;
+
+    case 'P' : // Delete characters
+    case '@' : // Insert blank characters
+    {
+      if (n > scr->cols - scr->col)
+      {
+        n = scr->cols - scr->col;
+      }
+
+      p = scr->cells + ((size_t)(scr->row) * scr->cols) + scr->col;
+      if ('P' == final)
+      {
+        memmove(p, p + n, (scr->cols - scr->col - n) * sizeof(uint32_t));
+        pdip_scr_blank(scr, scr->row, scr->cols - n, scr->cols);
+      }
+      else
+      {
+        memmove(p + n, p, (scr->cols - scr->col - n) * sizeof(uint32_t));
+        pdip_scr_blank(scr, scr->row, scr->col, scr->col + n);
+      }
+      scr->wrap = 0;
+    }
+    break;
+
+    case 'X' : // Erase characters
+    {
+      pdip_scr_blank(scr, scr->row, scr->col, (scr->cols - scr->col > n ? scr->col + n : scr->cols));
+    }
+    break;
+
+    case 'S' : // Scroll up
+    {
+      pdip_scr_scroll_up(scr, scr->top, scr->bottom, n);
+    }
+    break;
+
+    case 'T' : // Scroll down
+    {
+      pdip_scr_scroll_down(scr, scr->top, scr->bottom, n);
+    }
+    break;
+
+    case 'r' : // Scrolling region
+    {
+      r = (scr->params[1] && (scr->params[1] <= scr->rows) ? scr->params[1] : scr->rows) - 1;
+      if (n - 1 < r)
+      {
+        scr->top    = n - 1;
+        scr->bottom = r;
+        pdip_scr_goto(scr, 0, 0);
+      }
+    }
+    break;
+
+    case 's' : // Save the cursor
+    {
+      scr->saved_row = scr->row;
+      scr->saved_col = scr->col;
+    }
+    break;
+
+    case 'u' : // Restore the cursor
+    {
+      pdip_scr_goto(scr, scr->saved_row, scr->saved_col);
+    }
+    break;
+
+    default : // Attributes, modes, reports...
+    {
+    }
+    break;
+  } // End switch
+} // pdip_scr_csi
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_scr_utf8
+// Usage  : Decode a byte of a UTF-8 sequence and display the character when
+//          the sequence is complete. The invalid sequences are displayed
+//          as U+FFFD
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_scr_utf8(
+                          pdip_screen_t *scr,
+                          unsigned char  c
+                         )
+{
+  // Continuation byte
+  if (c < 0xC0)
+  {
+    if (!(scr->cp_left))
+    {
+      pdip_scr_put(scr, 0xFFFD);
+      return;
+    }
+
+    scr->cp = (scr->cp << 6) | (c & 0x3F);
+    scr->cp_left --;
+    if (!(scr->cp_left))
+    {
+      // The C1 controls are not displayed
+      if (scr->cp > 0x10FFFF)
+      {
+        pdip_scr_put(scr, 0xFFFD);
+      }
+      else if (scr->cp >= 0xA0)
+      {
+        pdip_scr_put(scr, scr->cp);
+      }
+    }
+
+    return;
+  }
+
+  // Truncated sequence
+  if (scr->cp_left)
+  {
+    pdip_scr_put(scr, 0xFFFD);
+  }
+
+  if (c < 0xE0)
+  {
+    scr->cp      = c & 0x1F;
+    scr->cp_left = 1;
+  }
+  else if (c < 0xF0)
+  {
+    scr->cp      = c & 0x0F;
+    scr->cp_left = 2;
+  }
+  else if (c < 0xF8)
+  {
+    scr->cp      = c & 0x07;
+    scr->cp_left = 3;
+  }
+  else
+  {
+    scr->cp_left = 0;
+    pdip_scr_put(scr, 0xFFFD);
+  }
+} // pdip_scr_utf8
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_screen_feed
+// Usage  : Render data received from the controlled process on the virtual
+//          screen
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_screen_feed(
+                             pdip_screen_t *scr,
+                             const char    *data,
+                             size_t         len
+                            )
+{
+const unsigned char *p;
+const unsigned char *end;
+unsigned char        c;
+
+  end = (const unsigned char *)data + len;
+  for (p = (const unsigned char *)data; p < end; p ++)
+  {
+    c = *p;
+
+    switch(scr->state)
+    {
+      case PDIP_SCR_GROUND :
+      {
+        if (c >= 0x80)
+        {
+          pdip_scr_utf8(scr, c);
+          break;
+        }
+
+        if (scr->cp_left)
+        {
+          scr->cp_left = 0;
+          pdip_scr_put(scr, 0xFFFD);
+        }
+
+        if ((c >= 0x20) && (c != 0x7F))
+        {
+          pdip_scr_put(scr, c);
+        }
+        else if (0x1B == c)
+        {
+          scr->state = PDIP_SCR_ESC;
+        }
+        else
+        {
+          pdip_scr_ctrl(scr, c);
+        }
+      }
+      break;
+
+      case PDIP_SCR_ESC :
+      {
+        scr->state = PDIP_SCR_GROUND;
+
+        switch(c)
+        {
+          case '[' :
+          {
+            scr->state   = PDIP_SCR_CSI;
+            scr->nparams = 0;
+            scr->priv    = 0;
+            memset(scr->params, 0, sizeof(scr->params));
+          }
+          break;
+
+          case ']' : scr->state = PDIP_SCR_OSC; break;
+
+          case '(' :
+          case ')' :
+          case '*' :
+          case '+' : scr->state = PDIP_SCR_CHARSET; break;
+
+          case '7' : // Save the cursor
+          {
+            scr->saved_row = scr->row;
+            scr->saved_col = scr->col;
+          }
+          break;
+
+          case '8' : pdip_scr_goto(scr, scr->saved_row, scr->saved_col); break;
+          case 'D' : pdip_scr_lf(scr); break;
+          case 'E' : scr->col = 0; pdip_scr_lf(scr); break;
+          case 'M' : pdip_scr_ri(scr); break;
+          case 'c' : pdip_scr_reset(scr); break;
+          case 0x1B : scr->state = PDIP_SCR_ESC; break;
+
+          default : // Keypad modes...
+          {
+          }
+          break;
+        } // End switch
+      }
+      break;
+
+      case PDIP_SCR_CSI :
+      {
+        if ((c >= '0') && (c <= '9'))
+        {
+          if (scr->params[scr->nparams] < 10000)
+          {
+            scr->params[scr->nparams] = (scr->params[scr->nparams] * 10) + (c - '0');
+          }
+        }
+        else if ((';' == c) || (':' == c))
+        {
+          if (scr->nparams + 1 < PDIP_SCR_PARAMS_MAX)
+          {
+            scr->nparams ++;
+          }
+        }
+        else if ((c >= 0x3C) && (c <= 0x3F))
+        {
+          scr->priv = c;
+        }
+        else if ((c >= 0x40) && (c <= 0x7E))
+        {
+          scr->state = PDIP_SCR_GROUND;
+          pdip_scr_csi(scr, c);
+        }
+        else if (0x1B == c)
+        {
+          scr->state = PDIP_SCR_ESC;
+        }
+        else if (c < 0x20)
+        {
+          // The control characters are executed in the sequences
+          pdip_scr_ctrl(scr, c);
+        }
+
+        // The intermediate bytes are ignored
+      }
+      break;
+
+      case PDIP_SCR_OSC : // Skipped until BEL or ST (ESC \)
+      {
+        if (0x07 == c)
+        {
+          scr->state = PDIP_SCR_GROUND;
+        }
+        else if (0x1B == c)
+        {
+          scr->state = PDIP_SCR_OSC_ESC;
+        }
+      }
+      break;
+
+      case PDIP_SCR_OSC_ESC :
+      case PDIP_SCR_CHARSET :
+      default :
+      {
+        scr->state = PDIP_SCR_GROUND;
+      }
+      break;
+    } // End switch
+  } // End for
+} // pdip_screen_feed
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_screen_line
+// Usage  : Render a row of the virtual screen in UTF-8 without the
+//          trailing blanks
+// Return : The length of the row (NUL terminated in scr->line)
+// ----------------------------------------------------------------------------
+static size_t pdip_screen_line(
+                               pdip_screen_t *scr,
+                               unsigned int   r
+                              )
+{
+const uint32_t *cell;
+char           *s;
+size_t          len;
+size_t          end;
+unsigned int    c;
+uint32_t        cp;
+
+  cell = scr->cells + ((size_t)r * scr->cols);
+  s = scr->line;
+  len = end = 0;
+
+  for (c = 0; c < scr->cols; c ++)
+  {
+    cp = cell[c];
+    if (cp < 0x80)
+    {
+      s[len ++] = (char)cp;
+    }
+    else if (cp < 0x800)
+    {
+      s[len ++] = (char)(0xC0 | (cp >> 6));
+      s[len ++] = (char)(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000)
+    {
+      s[len ++] = (char)(0xE0 | (cp >> 12));
+      s[len ++] = (char)(0x80 | ((cp >> 6) & 0x3F));
+      s[len ++] = (char)(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+      s[len ++] = (char)(0xF0 | (cp >> 18));
+      s[len ++] = (char)(0x80 | ((cp >> 12) & 0x3F));
+      s[len ++] = (char)(0x80 | ((cp >> 6) & 0x3F));
+      s[len ++] = (char)(0x80 | (cp & 0x3F));
+    }
+
+    if (' ' != cp)
+    {
+      end = len;
+    }
+  } // End for
+
+  s[end] = '\0';
+
+  return end;
+} // pdip_screen_line
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_screen_free
+// Usage  : Free a virtual screen
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_screen_free(pdip_screen_t *scr)
+{
+  if (!scr)
+  {
+    return;
+  }
+
+  free(scr->cells);
+  free(scr->alt);
+  free(scr->dirty);
+  free(scr->line);
+  free(scr);
+} // pdip_screen_free
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_screen_new
+// Usage  : Allocate a blank virtual screen
+// Return : The virtual screen, if OK
+//          NULL, if error (errno is set)
+// ----------------------------------------------------------------------------
+static pdip_screen_t *pdip_screen_new(
+                                      unsigned int rows,
+                                      unsigned int cols
+                                     )
+{
+pdip_screen_t *scr;
+
+  scr = (pdip_screen_t *)calloc(1, sizeof(pdip_screen_t));
+  if (!scr)
+  {
+    return (pdip_screen_t *)0;
+  }
+
+  scr->rows  = rows;
+  scr->cols  = cols;
+  scr->cells = (uint32_t *)malloc((size_t)rows * cols * sizeof(uint32_t));
+  scr->alt   = (uint32_t *)malloc((size_t)rows * cols * sizeof(uint32_t));
+  scr->dirty = (unsigned char *)malloc(rows);
+  scr->line  = (char *)malloc(((size_t)cols * 4) + 1);
+  if (!(scr->cells) || !(scr->alt) || !(scr->dirty) || !(scr->line))
+  {
+    pdip_screen_free(scr);
+    errno = ENOMEM;
+    return (pdip_screen_t *)0;
+  }
+
+  pdip_scr_reset(scr);
+
+  // Nothing displayed yet
+  memset(scr->dirty, 0, rows);
+
+  return scr;
+} // pdip_screen_new
+
+
+//----------------------------------------------------------------------------
+// Name        : pdip_read
+// Description : Read input data
+// Return      : Number of read bytes if OK
+//               -1, if error
+//----------------------------------------------------------------------------
+static int pdip_read(
+                      pdip_ctx_t   *ctxp,
+                      char         *buf,
+                      size_t        l
+                    )
+{
+int rc;
+int err_sav;
+int state;
+
+  do
+  {
+    rc = read(ctxp->pty_master, buf, l);
+    ctxp->stats.read_calls ++;
+    if (-1 == rc)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+
+      err_sav = errno;
+
+      pdip_pidfd_check(ctxp);
+
+      PDIP_MASK_SIG();
+      state = PDIP_STATE_GET(ctxp);
+      PDIP_UNMASK_SIG();
+
+      // The controlled program may be dead (but experimentations show that we may get the error
+      // here before the signal handler updates the state of the object!)
+      if (state != PDIP_STATE_ALIVE)
+      {
+        PDIP_DBG(ctxp, 1, "Controlled program '%s' (%"PRIPID") is dead\n", ctxp->av[0], ctxp->pid);
+      }
+
+      PDIP_DBG(ctxp, 1, "read(fd:%d, l:%"PRISIZE"): '%m' (%d), state=%d\n", ctxp->pty_master, l, errno, state);
+
+      // End of the data (the slave side is closed)
+      if (ctxp->on_output)
+      {
+        pdip_output_end(ctxp);
+      }
+
+      errno = err_sav;
+      return -1;
+    } // End if read error
+  } while (rc < 0);
+
+  if (rc > 0)
+  {
+    ctxp->stats.read_bytes += (unsigned long long)rc;
+
+    PDIP_REC_EVENT(ctxp, PDIP_REC_RECV, buf, rc);
+
+    if (ctxp->screen)
+    {
+      pdip_screen_feed(ctxp->screen, buf, (size_t)rc);
+    }
+  }
+
+  if (ctxp->on_output)
+  {
+    if (rc > 0)
+    {
+      pdip_output(ctxp, buf, (size_t)rc);
+    }
+    else
+    {
+      pdip_output_end(ctxp);
+    }
+  }
+
+  return rc;
+} // pdip_read
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : PDIP_RESIZE_INCREMENT
+// Usage  : Allocation increment for the receiving buffers
+//          (must be bigger than 1 !)
+// ----------------------------------------------------------------------------
+#define PDIP_RESIZE_INCREMENT  1024
+
+
+// ----------------------------------------------------------------------------
+// Name   : PDIP_GROWTH_FACTOR
+// Usage  : Default multiplier of the geometric growth of the receiving buffers
+// ----------------------------------------------------------------------------
+#define PDIP_GROWTH_FACTOR  2
+
+
+// ----------------------------------------------------------------------------
+// Name   : PDIP_REGEX_CACHE_SZ
+// Usage  : Default number of entries in the cache of compiled regular
+//          expressions
+// ----------------------------------------------------------------------------
+#define PDIP_REGEX_CACHE_SZ  8
+
+
+// ----------------------------------------------------------------------------
+// Name   : PDIP_SPAWN_STACK_SZ
+// Usage  : Size of the stack of the child process with PDIP_SPAWN_VFORK
+//          (execvp() allocates its temporary buffers into the stack)
+// ----------------------------------------------------------------------------
+#define PDIP_SPAWN_STACK_SZ  (64 * 1024)
+
+
+// ----------------------------------------------------------------------------
+// Name   : PDIP_REGCOMP_FLAGS
+// Usage  : Flags passed to regcomp()
+// ----------------------------------------------------------------------------
+#define PDIP_REGCOMP_FLAGS  (REG_EXTENDED|REG_NEWLINE)
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_buf_grow_sz
+// Usage  : Compute the new size of a reception buffer of 'cur_sz' bytes
+//          which must contain at least 'sz' bytes according to the growth
+//          policy of the object
+// Return : New size, if OK
+//          0, if 'sz' is bigger than the maximum size (errno is set)
+// ----------------------------------------------------------------------------
+static size_t pdip_buf_grow_sz(
+                               pdip_ctx_t *ctxp,
+                               size_t      cur_sz,
+                               size_t      sz
+                              )
+{
+size_t new_sz;
+
+  if (ctxp->buf_max_sz && (sz > ctxp->buf_max_sz))
+  {
+    PDIP_DBG(ctxp, 1, "Buffer of %"PRISIZE" bytes exceeds the maximum size (%"PRISIZE")\n", sz, ctxp->buf_max_sz);
+    errno = ENOSPC;
+    return 0;
+  }
+
+  if (PDIP_BUF_GROWTH_LINEAR == ctxp->buf_growth)
+  {
+    new_sz = cur_sz + ctxp->buf_resize_increment;
+  }
+  else
+  {
+    // Beware of the overflow
+    if (cur_sz > ((size_t)-1 / ctxp->buf_growth_factor))
+    {
+      new_sz = sz;
+    }
+    else
+    {
+      new_sz = cur_sz * ctxp->buf_growth_factor;
+    }
+
+    if (new_sz < ctxp->buf_resize_increment)
+    {
+      new_sz = ctxp->buf_resize_increment;
+    }
+  }
+
+  if (new_sz < sz)
+  {
+    new_sz = sz;
+  }
+
+  if (ctxp->buf_max_sz && (new_sz > ctxp->buf_max_sz))
+  {
+    new_sz = ctxp->buf_max_sz;
+  }
+
+  return new_sz;
+} // pdip_buf_grow_sz
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_buf_realloc
+// Usage  : realloc() of the reception buffers. The calls are counted to
+//          check that the steady state reception loops do not allocate
+//          memory (cf. pdip_stats())
+// Return : New buffer, if OK
+//          0, if error (errno is set and 'ptr' is unchanged)
+// ----------------------------------------------------------------------------
+static void *pdip_buf_realloc(
+                              pdip_ctx_t *ctxp,
+                              void       *ptr,
+                              size_t      sz
+                             )
+{
+  ctxp->stats.allocs ++;
+
+  return realloc(ptr, sz);
+} // pdip_buf_realloc
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_display_enlarge
+// Usage  : Make sure that the user buffer has room for 'sz' bytes. The buffer
+//          is enlarged according to the growth policy of the object
+// Return : 0, if OK
+//          -1, if error (errno is set, the user buffer is unchanged)
+// ----------------------------------------------------------------------------
+static int pdip_display_enlarge(
+                                pdip_ctx_t  *ctxp,
+                                char       **display,
+                                size_t      *display_sz,
+                                size_t       sz
+                               )
+{
+char   *p;
+size_t  new_sz;
+int     err_sav;
+
+  if (*display_sz >= sz)
+  {
+    return 0;
+  }
+
+  new_sz = pdip_buf_grow_sz(ctxp, *display_sz, sz);
+  if (!new_sz)
+  {
+    // Errno is set
+    return -1;
+  }
+
+  p = (char *)pdip_buf_realloc(ctxp, *display, new_sz);
+  if (!p)
+  {
+    err_sav = errno;
+    PDIP_ERR(ctxp, "realloc(%"PRISIZE"): '%m' (%d)\n", new_sz, errno);
+    errno = err_sav;
+    return -1;
+  }
+
+  PDIP_DBG(ctxp, 8, "Realloced reception buffer %p with %"PRISIZE" bytes\n", p, new_sz);
+
+  *display = p;
+  *display_sz = new_sz;
+
+  return 0;
+} // pdip_display_enlarge
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_display_room
+// Usage  : Make sure that the user buffer has room for a read after its
+//          'data_sz' bytes. The buffer is enlarged by the resize increment
+//          without exceeding the maximum size of the buffers
+// Return : 0, if OK
+//          -1, if error (errno is set, ENOSPC if the buffer is full)
+// ----------------------------------------------------------------------------
+static int pdip_display_room(
+                             pdip_ctx_t  *ctxp,
+                             char       **display,
+                             size_t      *display_sz,
+                             size_t       data_sz
+                            )
+{
+size_t sz;
+
+  if ((*display_sz - data_sz) >= ctxp->buf_resize_increment)
+  {
+    return 0;
+  }
+
+  // At the maximum size, the remaining space is used
+  sz = *display_sz + ctxp->buf_resize_increment;
+  if (ctxp->buf_max_sz && (sz > ctxp->buf_max_sz))
+  {
+    sz = ctxp->buf_max_sz;
+  }
+
+  if (0 != pdip_display_enlarge(ctxp, display, display_sz, sz))
+  {
+    // Errno is set
+    return -1;
+  }
+
+  // Room for at least one byte and the terminating NUL
+  if ((*display_sz - data_sz) <= 1)
+  {
+    PDIP_DBG(ctxp, 1, "Buffer of %"PRISIZE" bytes is full\n", *display_sz);
+    errno = ENOSPC;
+    return -1;
+  }
+
+  return 0;
+} // pdip_display_room
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_deadline
+// Usage  : Compute the absolute deadline of a timeout on CLOCK_MONOTONIC
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_deadline(
+                          struct timespec      *deadline,
+                          const struct timeval *timeout
+                         )
+{
+  pdip_now(deadline);
+  deadline->tv_sec  += timeout->tv_sec;
+  deadline->tv_nsec += timeout->tv_usec * 1000;
+  if (deadline->tv_nsec >= 1000000000)
+  {
+    deadline->tv_sec  += 1;
+    deadline->tv_nsec -= 1000000000;
+  }
+} // pdip_deadline
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_deadline_left
+// Usage  : Time left between 'now' and 'deadline'
+// Return : 1, if the deadline is not passed
+//          0, if the deadline is passed ('left' is 0)
+// ----------------------------------------------------------------------------
+static int pdip_deadline_left(
+                              const struct timespec *now,
+                              const struct timespec *deadline,
+                              struct timespec       *left
+                             )
+{
+  left->tv_sec  = deadline->tv_sec - now->tv_sec;
+  left->tv_nsec = deadline->tv_nsec - now->tv_nsec;
+  if (left->tv_nsec < 0)
+  {
+    left->tv_sec  -= 1;
+    left->tv_nsec += 1000000000;
+  }
+
+  if ((left->tv_sec < 0) || ((0 == left->tv_sec) && (0 == left->tv_nsec)))
+  {
+    left->tv_sec  = 0;
+    left->tv_nsec = 0;
+    return 0;
+  }
+
+  return 1;
+} // pdip_deadline_left
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_deadline_ms
+// Usage  : Number of milliseconds (rounded up) between 'now' and 'deadline'
+// Return : Number of milliseconds (0 if the deadline is passed)
+// ----------------------------------------------------------------------------
+static int pdip_deadline_ms(
+                            const struct timespec *now,
+                            const struct timespec *deadline
+                           )
+{
+long long ns;
+
+  ns = ((long long)(deadline->tv_sec - now->tv_sec) * 1000000000LL) + (deadline->tv_nsec - now->tv_nsec);
+  if (ns <= 0)
+  {
+    return 0;
+  }
+
+  if (ns >= (INT_MAX * 1000000LL))
+  {
+    return INT_MAX;
+  }
+
+  return (int)((ns + 999999) / 1000000);
+} // pdip_deadline_ms
+
+
+//----------------------------------------------------------------------------
+// Name        : pdip_read_until_deadline
+// Description : Read input data until the deadline on CLOCK_MONOTONIC (if
+//               requested by the user). A passed deadline merely makes the
+//               function read the data already available
+// Return      : 0, if OK
+//               -1, if error (data may have been read !)
+//----------------------------------------------------------------------------
+static int pdip_read_until_deadline(
+                                    pdip_ctx_t             *ctxp,
+                                    char                  **display,
+                                    size_t                 *display_sz,
+                                    size_t                 *data_sz,
+                                    const struct timespec  *deadline
+                                   )
+{
+int             rc;
+struct pollfd   pfd;
+struct timespec now, left;
+int             err_sav = 0;
+size_t          len;
+
+ PDIP_DBG(ctxp, 1, "Reading data from %"PRIPID", deadline %p (%ld s, %ld ns)\n", ctxp->pid, deadline, (deadline ? (long)(deadline->tv_sec) : 0), (deadline ? deadline->tv_nsec : 0));
+
+do_it_again:
+
+  // The remaining time is computed from the absolute deadline: there is no
+  // drift when the wait is interrupted
+  if (deadline)
+  {
+    pdip_now(&now);
+    (void)pdip_deadline_left(&now, deadline, &left);
+  }
+
+  // Contrary to select(), poll() is not limited by FD_SETSIZE
+  pfd.fd      = ctxp->pty_master;
+  pfd.events  = POLLIN;
+  pfd.revents = 0;
+  rc = ppoll(&pfd, 1, (deadline ? &left : (struct timespec *)0), (const sigset_t *)0);
+  switch(rc)
+  {
+    case -1:
+    {
+      err_sav = errno;
+      if (EINTR == errno)
+      {
+        goto do_it_again;
+      }
+
+      PDIP_ERR(ctxp, "ppoll(): '%m' (%d), data_sz=%"PRISIZE"\n", errno, *data_sz);
+      rc = -1;
+      goto end;
+    }
+    break;
+
+    case 0: // Timeout
+    {
+      PDIP_DBG(ctxp, 5, "Timeout (data_sz=%"PRISIZE")\n", *data_sz);
+
+      rc = 0;
+      goto end;
+    }
+    break;
+
+    default: // There are data (or hang up/error reported by the read)
+    {
+      assert(pfd.revents);
+
+      // If there is not enough space in the buffer, enlarge it
+      if (0 != pdip_display_room(ctxp, display, display_sz, *data_sz))
+      {
+        // Errno is set
+        return -1;
+      }
+
+      // Read the data, keep one slot for terminating NUL
+      len = (*display_sz) - (*data_sz) - 1;
+      rc = pdip_read(ctxp, *display + *data_sz, len);
+      err_sav = errno;
+      PDIP_DBG(ctxp, 3, "Read %d bytes from process %"PRIPID" in buffer %p at offset %"PRISIZE"\n", rc, ctxp->pid, *display, *data_sz);
+      if (rc >= 0)
+      {
+        // If rc == 0 : No more data to read (i.e. An error occured while reading
+        // or the controlled process is dead)
+
+        (*data_sz) += rc;
+
+        // NUL terminate the string
+        (*display)[*data_sz] = '\0';
+
+        rc = 0;
+      }
+      else // Error
+      {
+        // NUL terminate the string (data read until now)
+        (*display)[*data_sz] = '\0';
+
+        PDIP_DBG(ctxp, 1, "Error '%m' (%d), data_sz=%"PRISIZE"\n", errno, *data_sz);
+
+        // errno is set
+        rc = -1;
+      }
+    } // break;
+  } // End switch
+
+end:
+
+  errno = err_sav;
+
+  return rc;
+
+} // pdip_read_until_deadline
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_outstanding_consume
+// Usage  : Remove 'len' bytes from the beginning of the outstanding data.
+//          This is merely a move of the beginning of the data in the
+//          outstanding buffer (the buffer is rewound when it becomes empty)
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_outstanding_consume(
+                                     pdip_ctx_t *ctxp,
+                                     size_t      len
+                                    )
+{
+  assert(len <= ctxp->outstanding_data_offset);
+
+  // The offset of the last scan is relative to the consumed data
+  ctxp->outstanding_scan_offset = 0;
+  ctxp->outstanding_scan_id = 0;
+
+  // The remaining data are filtered again by the next pattern matching
+  ctxp->filt_len = 0;
+  ctxp->filt_raw = 0;
+  ctxp->filt_gaps_nb = 0;
+
+  ctxp->outstanding_data_offset -= len;
+  if (ctxp->outstanding_data_offset)
+  {
+    ctxp->outstanding_data += len;
+  }
+  else
+  {
+    ctxp->outstanding_data = ctxp->outstanding_buf;
+    ctxp->outstanding_data[0] = '\0';
+  }
+} // pdip_outstanding_consume
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_outstanding_to_display
+// Usage  : Copy the first 'len' bytes of the outstanding data into the user
+//          buffer (NUL terminated) and remove them from the outstanding data
+//          (or merely make them the borrowed view of pdip_recv_view())
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_outstanding_to_display(
+                                       pdip_ctx_t  *ctxp,
+                                       size_t       len,
+                                       char       **display,
+                                       size_t      *display_sz,
+                                       size_t      *data_sz
+                                      )
+{
+  // With pdip_recv_view(), the data stay in place until pdip_release()
+  if (ctxp->view)
+  {
+    ctxp->view_data = ctxp->outstanding_data;
+    ctxp->view_consume = len;
+    *data_sz = len;
+    return 0;
+  }
+
+  if (0 != pdip_display_enlarge(ctxp, display, display_sz, len + 1))
+  {
+    // Errno is set
+    *data_sz = 0;
+    return -1;
+  }
+
+  memcpy(*display, ctxp->outstanding_data, len);
+  (*display)[len] = '\0';
+  *data_sz = len;
+
+  pdip_outstanding_consume(ctxp, len);
+
+  return 0;
+} // pdip_outstanding_to_display
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_flush_internal
+// Usage  : Flush the outstanding data
+// Return : 0, if OK
+//          -1, if error
+// ----------------------------------------------------------------------------
+static int pdip_flush_internal(
+ 	                       pdip_ctx_t  *ctxp,
+                               char       **display,
+                               size_t      *display_sz,
+                               size_t      *data_sz
+                              )
+{
+  if (ctxp->outstanding_data_offset)
+  {
+    // The outstanding data is NUL terminated
+    assert('\0' == *(ctxp->outstanding_data + ctxp->outstanding_data_offset));
+
+    return pdip_outstanding_to_display(ctxp, ctxp->outstanding_data_offset, display, display_sz, data_sz);
+  }
+  else // No outstanding data
+  {
+    *data_sz = 0;
+  } // End if outstanding data
+
+  return 0;
+} // pdip_flush_internal
+
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_flush_outstanding
+// Usage  : Flush the outstanding data except the last line if it is not
+//          complete as the following unread yet data may complete the line and
+//          make the regex match
+// Return : 0, if at least one line flushed
+//          1, no line to flush
+//          -1, if error
+// ----------------------------------------------------------------------------
+static int pdip_flush_outstanding(
+ 	                          pdip_ctx_t  *ctxp,
+                                  char       **display,
+                                  size_t      *display_sz,
+                                  size_t      *data_sz
+                                 )
+{
+size_t  len;
+char   *p;
+
+  // If there are no outstanding data
+  if (!(ctxp->outstanding_data_offset))
+  {
+    return 1;
+  }
+
+  assert('\0' == ctxp->outstanding_data[ctxp->outstanding_data_offset]);
+
+  // Look for the end of the last complete line
+  p = (char *)memrchr(ctxp->outstanding_data, '\n', ctxp->outstanding_data_offset);
+
+  // If there is not a complete line
+  if (!p)
+  {
+    return 1;
+  }
+
+  // Amount of data to return: the complete lines
+  len = (p + 1) - ctxp->outstanding_data;
+
+  PDIP_DBG(ctxp, 5, "len=%"PRISIZE" + 1\n", len);
+
+  if (0 != pdip_outstanding_to_display(ctxp, len, display, display_sz, data_sz))
+  {
+    // errno is set
+    return -1;
+  }
+
+  // The remaining incomplete line (if any) must be scanned again
+  ctxp->outstanding_scan_offset = 0;
+  ctxp->outstanding_scan_id = 0;
+
+  return 0;
+} // pdip_flush_outstanding
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_spill
+// Usage  : Get rid of the oldest received data according to the overflow
+//          policy of the object: they are either discarded or appended to
+//          a temporary file (created upon the first call)
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_spill(
+                      pdip_ctx_t *ctxp,
+                      const char *data,
+                      size_t      len
+                     )
+{
+const char *dir;
+char        path[PATH_MAX];
+ssize_t     rc;
+int         err_sav;
+
+  if (PDIP_BUF_OVERFLOW_SPILL == ctxp->buf_overflow)
+  {
+    if (ctxp->spill_fd < 0)
+    {
+      dir = getenv("TMPDIR");
+      if (!dir || !(*dir))
+      {
+        dir = P_tmpdir;
+      }
+
+      (void)snprintf(path, sizeof(path), "%s/pdip_spill_XXXXXX", dir);
+
+      // The writes go at the end of the file whatever the offset set by
+      // the user
+      ctxp->spill_fd = mkostemp(path, O_APPEND | O_CLOEXEC);
+      if (ctxp->spill_fd < 0)
+      {
+        err_sav = errno;
+        PDIP_ERR(ctxp, "mkostemp(%s): '%m' (%d)\n", path, errno);
+        errno = err_sav;
+        return -1;
+      }
+
+      // The file disappears with its last file descriptor
+      (void)unlink(path);
+    }
+
+    while (len)
+    {
+      rc = write(ctxp->spill_fd, data, len);
+      if (rc < 0)
+      {
+        if (EINTR == errno)
+        {
+          continue;
+        }
+
+        err_sav = errno;
+        PDIP_ERR(ctxp, "write(spill, %"PRISIZE"): '%m' (%d)\n", len, errno);
+        errno = err_sav;
+        return -1;
+      }
+
+      ctxp->stats.overflow_bytes += (unsigned long long)rc;
+      data += rc;
+      len -= (size_t)rc;
+    } // End while
+  }
+  else
+  {
+    ctxp->stats.overflow_bytes += len;
+  }
+
+  return 0;
+} // pdip_spill
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_outstanding_overflow
+// Usage  : Make room for 'data_sz' new bytes in the outstanding data without
+//          exceeding the maximum size of the buffers: only the last
+//          'buf_lookback' bytes of the outstanding data are kept (from the
+//          beginning of a line if there is one). The new data lose their
+//          beginning if they can not fit alone
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_outstanding_overflow(
+                                     pdip_ctx_t  *ctxp,
+                                     char        *data,
+                                     size_t      *data_sz
+                                    )
+{
+size_t  keep;
+size_t  drop;
+char   *nl;
+
+  keep = (ctxp->buf_lookback ? ctxp->buf_lookback : ctxp->buf_max_sz / 2);
+
+  // Room for the new data and the terminating NUL
+  if (keep + *data_sz + 1 > ctxp->buf_max_sz)
+  {
+    keep = (*data_sz + 1 < ctxp->buf_max_sz ? ctxp->buf_max_sz - *data_sz - 1 : 0);
+  }
+
+  if (ctxp->outstanding_data_offset > keep)
+  {
+    drop = ctxp->outstanding_data_offset - keep;
+
+    // The kept data begin with a line to preserve the meaning of '^'
+    nl = (char *)memchr(ctxp->outstanding_data + drop, '\n', keep);
+    if (nl)
+    {
+      drop = (size_t)(nl + 1 - ctxp->outstanding_data);
+    }
+
+    PDIP_DBG(ctxp, 2, "Outstanding data overflow: %"PRISIZE" bytes removed, %"PRISIZE" bytes kept\n", drop, ctxp->outstanding_data_offset - drop);
+
+    if (0 != pdip_spill(ctxp, ctxp->outstanding_data, drop))
+    {
+      // Errno is set
+      return -1;
+    }
+
+    pdip_outstanding_consume(ctxp, drop);
+  }
+
+  if (*data_sz + 1 > ctxp->buf_max_sz)
+  {
+    drop = *data_sz + 1 - ctxp->buf_max_sz;
+
+    if (0 != pdip_spill(ctxp, data, drop))
+    {
+      // Errno is set
+      return -1;
+    }
+
+    // Include the terminating NUL in the move
+    memmove(data, data + drop, *data_sz - drop + 1);
+    *data_sz -= drop;
+  }
+
+  return 0;
+} // pdip_outstanding_overflow
+
+
+
+//----------------------------------------------------------------------------
+// Name        : pdip_append_to_outstanding
+// Description : Copy the data of the user buffer at the end of the
+//               outstanding data. The space freed at the beginning of the
+//               outstanding buffer by the consumed data is reused before
+//               enlarging the buffer. Beyond the maximum size of the
+//               buffers, the oldest data may be discarded or spilled
+//               (cf. buf_overflow)
+// Return      : 0, if OK
+//              -1, if error
+//----------------------------------------------------------------------------
+static int pdip_append_to_outstanding(
+                                      pdip_ctx_t  *ctxp,
+                                      char       **display,
+                                      size_t      *display_sz,
+                                      size_t      *data_sz
+		   		     )
+{
+int     err_sav;
+size_t  head, needed, new_sz;
+char   *p;
+
+  PDIP_DBG(ctxp, 5, "Appending %"PRISIZE" bytes to outstanding data (%p) at offset %"PRISIZE"\n", *data_sz, ctxp->outstanding_data, ctxp->outstanding_data_offset);
+
+  if (!(*data_sz))
+  {
+    return 0;
+  }
+
+  // There is always a terminating NUL not counted by data_sz
+  assert(*display_sz > *data_sz);
+  pdip_assert('\0' == (*display)[*data_sz], "*display_sz=%"PRISIZE", *data_sz=%"PRISIZE"\n", *display_sz, *data_sz);
+
+  if (ctxp->buf_max_sz &&
+      ((ctxp->outstanding_data_offset + *data_sz + 1) > ctxp->buf_max_sz) &&
+      ((PDIP_BUF_OVERFLOW_DISCARD == ctxp->buf_overflow) || (PDIP_BUF_OVERFLOW_SPILL == ctxp->buf_overflow)))
+  {
+    if (0 != pdip_outstanding_overflow(ctxp, *display, data_sz))
+    {
+      // Errno is set
+      return -1;
+    }
+  }
+
+  head = (ctxp->outstanding_buf ? (size_t)(ctxp->outstanding_data - ctxp->outstanding_buf) : 0);
+
+  // Room for the outstanding data, the new data and the terminating NUL
+  needed = ctxp->outstanding_data_offset + *data_sz + 1;
+
+  // If there is not enough space behind the outstanding data
+  if ((head + needed) > ctxp->outstanding_buf_sz)
+  {
+    // Move the outstanding data at the beginning of the buffer
+    if (head)
+    {
+      memmove(ctxp->outstanding_buf, ctxp->outstanding_data, ctxp->outstanding_data_offset + 1);
+      ctxp->outstanding_data = ctxp->outstanding_buf;
+    }
+
+    // If it is still not enough
+    if (needed > ctxp->outstanding_buf_sz)
+    {
+      new_sz = pdip_buf_grow_sz(ctxp, ctxp->outstanding_buf_sz, needed);
+      if (!new_sz)
+      {
+        // Errno is set
+        return -1;
+      }
+
+      p = (char *)pdip_buf_realloc(ctxp, ctxp->outstanding_buf, new_sz);
+      if (!p)
+      {
+        // Errno is set
+        err_sav = errno;
+        PDIP_ERR(ctxp, "realloc(%"PRISIZE"): '%m' (%d)\n", new_sz, errno);
+        errno = err_sav;
+        return -1;
+      }
+
+      ctxp->outstanding_buf = ctxp->outstanding_data = p;
+      ctxp->outstanding_buf_sz = new_sz;
+      if (new_sz > ctxp->stats.buf_peak_sz)
+      {
+        ctxp->stats.buf_peak_sz = new_sz;
+      }
+    } // End if buffer to enlarge
+  } // End if not enough space
+
+  // Include terminating NUL in the copy
+  memcpy(ctxp->outstanding_data + ctxp->outstanding_data_offset, *display, *data_sz + 1);
+  ctxp->outstanding_data_offset += *data_sz;
+
+  // The user buffer is kept for the following receptions
+  *data_sz = 0;
+
+  return 0;
+} // pdip_append_to_outstanding
+
+
+// Maximum length of an escape sequence (the ESC of a longer sequence is
+// merely removed)
+#define PDIP_ESC_MAX 256
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_esc_len
+// Usage  : Length of the escape sequence beginning at 'str' (ESC): CSI
+//          sequences ("ESC [ ... final"), OSC sequences ("ESC ] ... BEL" or
+//          "ESC ] ... ESC \"), designations of character sets (three
+//          characters "ESC ( B", "ESC ) 0"...) and two characters sequences
+// Return : Length of the sequence, if complete
+//          0, if the sequence may be completed by the following data
+//          1, if the sequence is too long (only ESC is removed)
+// ----------------------------------------------------------------------------
+static size_t pdip_esc_len(
+                           const char *str,
+                           size_t      len
+                          )
+{
+size_t i;
+
+  if (len < 2)
+  {
+    return 0;
+  }
+
+  switch(str[1])
+  {
+    case '[' :
+    {
+      for (i = 2; (i < len) && (i < PDIP_ESC_MAX); i ++)
+      {
+        if (((unsigned char)(str[i]) >= 0x40) && ((unsigned char)(str[i]) <= 0x7E))
+        {
+          return i + 1;
+        }
+      } // End for
+    }
+    break;
+
+    case ']' :
+    {
+      for (i = 2; (i < len) && (i < PDIP_ESC_MAX); i ++)
+      {
+        if ('\a' == str[i])
+        {
+          return i + 1;
+        }
+
+        if ('\033' == str[i])
+        {
+          if ((i + 1) == len)
+          {
+            return 0;
+          }
+
+          if ('\\' == str[i + 1])
+          {
+            return i + 2;
+          }
+        }
+      } // End for
+    }
+    break;
+
+    case '(' :
+    case ')' :
+    case '*' :
+    case '+' :
+    {
+      // The designated character set follows
+      return (len < 3 ? 0 : 3);
+    }
+
+    default :
+    {
+      return 2;
+    }
+  } // End switch
+
+  return (i < PDIP_ESC_MAX ? 0 : 1);
+} // pdip_esc_len
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_filter_outstanding
+// Usage  : Append the outstanding data not filtered yet to the filtered copy
+//          without the control characters and the escape sequences. An
+//          incomplete escape sequence at the end of the outstanding data is
+//          left for the next call
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_filter_outstanding(
+                                   pdip_ctx_t *ctxp
+                                  )
+{
+const char      *raw;
+size_t           len;
+size_t           pos, n;
+char            *p;
+pdip_filt_gap_t *gaps;
+size_t           sz;
+
+  raw = ctxp->outstanding_data;
+  len = ctxp->outstanding_data_offset;
+  pos = ctxp->filt_raw;
+
+  // The filtered data are not longer than the outstanding data
+  if (ctxp->filt_buf_sz < (len + 1))
+  {
+    p = (char *)pdip_buf_realloc(ctxp, ctxp->filt_buf, ctxp->outstanding_buf_sz);
+    if (!p)
+    {
+      return -1;
+    }
+    ctxp->filt_buf = p;
+    ctxp->filt_buf_sz = ctxp->outstanding_buf_sz;
+  }
+
+  while (pos < len)
+  {
+    // Copy the bytes up to the next byte to remove
+    n = pdip_ctrl_span(raw + pos, len - pos);
+    memcpy(ctxp->filt_buf + ctxp->filt_len, raw + pos, n);
+    ctxp->filt_len += n;
+    pos += n;
+
+    if (pos == len)
+    {
+      break;
+    }
+
+    // Skip the control character or the escape sequence
+    if ('\033' == raw[pos])
+    {
+      n = pdip_esc_len(raw + pos, len - pos);
+      if (!n)
+      {
+        break;
+      }
+    }
+    else
+    {
+      n = 1;
+    }
+    pos += n;
+
+    // Record the gap (a gap at the same filtered offset is extended)
+    if (ctxp->filt_gaps_nb && (ctxp->filt_gaps[ctxp->filt_gaps_nb - 1].filt == ctxp->filt_len))
+    {
+      ctxp->filt_gaps[ctxp->filt_gaps_nb - 1].raw = pos;
+      continue;
+    }
+
+    if (ctxp->filt_gaps_nb == ctxp->filt_gaps_sz)
+    {
+      sz = (ctxp->filt_gaps_sz ? ctxp->filt_gaps_sz * 2 : 16);
+      gaps = (pdip_filt_gap_t *)pdip_buf_realloc(ctxp, ctxp->filt_gaps, sz * sizeof(pdip_filt_gap_t));
+      if (!gaps)
+      {
+        return -1;
+      }
+      ctxp->filt_gaps = gaps;
+      ctxp->filt_gaps_sz = sz;
+    }
+
+    ctxp->filt_gaps[ctxp->filt_gaps_nb].filt = ctxp->filt_len;
+    ctxp->filt_gaps[ctxp->filt_gaps_nb].raw = pos;
+    ctxp->filt_gaps_nb ++;
+  } // End while
+
+  ctxp->filt_raw = pos;
+  ctxp->filt_buf[ctxp->filt_len] = '\0';
+
+  return 0;
+} // pdip_filter_outstanding
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_filter_raw
+// Usage  : Offset in the outstanding data of the byte at offset 'off' in the
+//          filtered copy (binary search of the last gap before it)
+// Return : Offset in the outstanding data
+// ----------------------------------------------------------------------------
+static size_t pdip_filter_raw(
+                              const pdip_ctx_t *ctxp,
+                              size_t            off
+                             )
+{
+size_t lo, hi, mid;
+
+  lo = 0;
+  hi = ctxp->filt_gaps_nb;
+  while (lo < hi)
+  {
+    mid = (lo + hi) / 2;
+    if (ctxp->filt_gaps[mid].filt <= off)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  } // End while
+
+  if (!lo)
+  {
+    return off;
+  }
+
+  return ctxp->filt_gaps[lo - 1].raw + (off - ctxp->filt_gaps[lo - 1].filt);
+} // pdip_filter_raw
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_lit_exec
+// Usage  : Look for the first match of a literal in the 'len' bytes of a
+//          string (which may contain NUL bytes) with a substring search
+//          (two-way algorithm of the C library) followed by the checks of
+//          the anchors. This gives the same result as regexec() with
+//          REG_EXTENDED|REG_NEWLINE
+// Return : 0, if found
+//          REG_NOMATCH, if not found
+// ----------------------------------------------------------------------------
+static int pdip_lit_exec(
+                         const pdip_pat_t *pat,
+                         const char       *str,
+                         size_t            len,
+                         regmatch_t       *result
+                        )
+{
+const char *p;
+const char *end = str + len;
+
+  p = str;
+  while ((p = (const char *)memmem(p, end - p, pat->literal, pat->literal_len)))
+  {
+    // '^' matches at the beginning of the string or after a newline
+    if (pat->literal_bol && (p != str) && ('\n' != p[-1]))
+    {
+      // The next candidate is at the beginning of the next line
+      p = (const char *)memchr(p, '\n', end - p);
+      if (!p)
+      {
+        break;
+      }
+
+      p ++;
+      continue;
+    }
+
+    // '$' matches at the end of the string or before a newline
+    if (pat->literal_eol && ((p + pat->literal_len) != end) && ('\n' != p[pat->literal_len]))
+    {
+      p ++;
+      continue;
+    }
+
+    result->rm_so = (regoff_t)(p - str);
+    result->rm_eo = (regoff_t)(result->rm_so + pat->literal_len);
+
+    return 0;
+  } // End while
+
+  return REG_NOMATCH;
+} // pdip_lit_exec
+
+
+// ----------------------------------------------------------------------------
+// Name   : PDIP_MATCH_BEFORE
+// Usage  : Check if a match (so, eo) of the alternative 'alt' comes before
+//          the best match found so far (the earliest, then the longest, then
+//          the alternative with the lowest index)
+// ----------------------------------------------------------------------------
+#define PDIP_MATCH_BEFORE(so, eo, alt, best, best_alt)                  \
+          (((so) < (best).rm_so) ||                                     \
+           (((so) == (best).rm_so) && (((eo) > (best).rm_eo) ||         \
+                                       (((eo) == (best).rm_eo) && ((alt) < (best_alt))))))
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_ac_exec
+// Usage  : Look for the first match of several literals in the 'len' bytes
+//          of a string in one pass with an Aho-Corasick automaton
+// Return : 0, if found
+//          REG_NOMATCH, if not found
+// ----------------------------------------------------------------------------
+static int pdip_ac_exec(
+                        const pdip_pat_t *pat,
+                        const char       *str,
+                        size_t            len,
+                        regmatch_t       *result,
+                        unsigned int     *alt
+                       )
+{
+const pdip_ac_t  *ac = pat->ac;
+const pdip_pat_t *lit;
+size_t            i;
+int               state, o, k;
+regoff_t          so, eo;
+unsigned int      best_alt = 0;
+int               found = 0;
+
+  state = 0;
+  for (i = 0; i < len; i ++)
+  {
+    state = ac->next[(state << 8) + (unsigned char)(str[i])];
+
+    // Literals ending at offset i
+    for (o = ((ac->out[state] >= 0) ? state : ac->dict[state]); o >= 0; o = ac->dict[o])
+    {
+      for (k = ac->out[o]; k >= 0; k = ac->out_next[k])
+      {
+        lit = pat->alt[k];
+        eo = (regoff_t)(i + 1);
+        so = (regoff_t)(eo - lit->literal_len);
+
+        if (lit->literal_bol && so && ('\n' != str[so - 1]))
+        {
+          continue;
+        }
+
+        if (lit->literal_eol && ((size_t)eo != len) && ('\n' != str[eo]))
+        {
+          continue;
+        }
+
+        if (!found || PDIP_MATCH_BEFORE(so, eo, (unsigned int)k, *result, best_alt))
+        {
+          result->rm_so = so;
+          result->rm_eo = eo;
+          best_alt = (unsigned int)k;
+          found = 1;
+        }
+      } // End for
+    } // End for
+
+    // The following matches can not begin before the best one
+    if (found && ((i + 2) > ((size_t)(result->rm_so) + ac->max_len)))
+    {
+      break;
+    }
+  } // End for
+
+  if (!found)
+  {
+    return REG_NOMATCH;
+  }
+
+  *alt = best_alt;
+
+  return 0;
+} // pdip_ac_exec
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pat_exec
+// Usage  : Look for the first match of a compiled regular expression in the
+//          'len' bytes of a string. The string may contain NUL bytes: the
+//          search is bounded by the length (REG_STARTEND) instead of the
+//          first NUL. For a combination of patterns, 'alt' is set with the
+//          index of the alternative which matched (0 otherwise)
+// Return : 0, if found
+//          REG_NOMATCH, if not found
+// ----------------------------------------------------------------------------
+static int pdip_pat_exec(
+                         const pdip_pat_t *pat,
+                         const char       *str,
+                         size_t            len,
+                         regmatch_t       *result,
+                         unsigned int     *alt
+                        )
+{
+unsigned int i;
+int          found;
+regmatch_t   m;
+
+  *alt = 0;
+
+  if (!(pat->alt_nb))
+  {
+    if (pat->literal)
+    {
+      return pdip_lit_exec(pat, str, len, result);
+    }
+
+    result->rm_so = 0;
+    result->rm_eo = (regoff_t)len;
+    return regexec(&(pat->regex), str, 1, result, REG_STARTEND);
+  }
+
+  if (pat->ac)
+  {
+    return pdip_ac_exec(pat, str, len, result, alt);
+  }
+
+  if (pat->alt_group)
+  {
+  regmatch_t match[pat->regex.re_nsub + 1];
+
+    match[0].rm_so = 0;
+    match[0].rm_eo = (regoff_t)len;
+    if (0 != regexec(&(pat->regex), str, pat->regex.re_nsub + 1, match, REG_STARTEND))
+    {
+      return REG_NOMATCH;
+    }
+
+    // The alternative which matched is the one whose group is set
+    for (i = 0; i < pat->alt_nb; i ++)
+    {
+      if (match[pat->alt_group[i]].rm_so >= 0)
+      {
+        *alt = i;
+        break;
+      }
+    } // End for
+
+    *result = match[0];
+
+    return 0;
+  }
+
+  // Back-references prevent the combination: the alternatives are looked
+  // for one by one
+  found = 0;
+  for (i = 0; i < pat->alt_nb; i ++)
+  {
+  unsigned int unused;
+
+    if (0 == pdip_pat_exec(pat->alt[i], str, len, &m, &unused))
+    {
+      if (!found || PDIP_MATCH_BEFORE(m.rm_so, m.rm_eo, i, *result, *alt))
+      {
+        *result = m;
+        *alt = i;
+        found = 1;
+      }
+    }
+  } // End for
+
+  return (found ? 0 : REG_NOMATCH);
+} // pdip_pat_exec
+
+
+//----------------------------------------------------------------------------
+// Name        : pdip_look_for_regex
+// Description : Handle the synchronization string
+// Note        : The data may contain NUL chars: the lengths are used
+//
+// Return      : 0, if synchro string found
+//               1, if synchro string not found
+//              -1, if error
+//----------------------------------------------------------------------------
+static int pdip_look_for_regex(
+                               pdip_ctx_t    *ctxp,
+                               pdip_pat_t    *pat,
+                               char         **display,
+                               size_t        *display_sz,
+                               size_t        *data_sz
+                              )
+{
+int         rc;
+regmatch_t  result;
+size_t      offset;
+char       *nl;
+uint64_t    t0;
+const char *str;
+size_t      len;
+
+  if (*data_sz)
+  {
+    // Append the incoming data to the outstanding one
+    // If the last line in the outstanding was incomplete, the incoming data may
+    // complete it
+    rc = pdip_append_to_outstanding(ctxp, display, display_sz, data_sz);
+    if (rc != 0)
+    {
+      // Errno is set
+      return -1;
+    }
+  } // End if incoming data to add to the outstanding ones
+
+  // If there are outstanding data
+  if (ctxp->outstanding_data_offset > 0)
+  {
+    // The pattern is looked for in the outstanding data or in their
+    // filtered copy
+    if (ctxp->flags & PDIP_FLAG_FILTER_CTRL)
+    {
+      if (0 != pdip_filter_outstanding(ctxp))
+      {
+        // Errno is set
+        rc = errno;
+        PDIP_ERR(ctxp, "realloc(): '%m' (%d)\n", errno);
+        errno = rc;
+        return -1;
+      }
+
+      str = ctxp->filt_buf;
+      len = ctxp->filt_len;
+    }
+    else
+    {
+      str = ctxp->outstanding_data;
+      len = ctxp->outstanding_data_offset;
+    }
+
+    PDIP_DUMP(ctxp, 2, "Looking for a match of <%s> in (%p):\n", str, len, pat->regular_expr, str);
+
+    // If the regular expression can not match a newline, the complete lines
+    // already scanned for it do not need to be scanned again
+    if (pat->single_line && (pat->id == ctxp->outstanding_scan_id))
+    {
+      offset = ctxp->outstanding_scan_offset;
+      assert(offset <= len);
+    }
+    else
+    {
+      offset = 0;
+    }
+
+    PDIP_DBG(ctxp, 4, "Scanning outstanding data from offset %"PRISIZE"/%"PRISIZE"\n", offset, len);
+
+    // Look for the regular expression in the outstanding data
+    // As the scan starts at the beginning of a line, '^' keeps its meaning
+    t0 = pdip_ns();
+    rc = pdip_pat_exec(pat, str + offset, len - offset, &result, &(ctxp->match_alt));
+    ctxp->stats.match_ns += pdip_ns() - t0;
+    ctxp->stats.match_calls ++;
+    if (0 == rc)
+    {
+      // Make the offsets relative to the beginning of the outstanding data
+      result.rm_so += offset;
+      result.rm_eo += offset;
+
+      // The relative 'rm_eo' field indicates the end offset of the match
+      // If 'rm_eo' == 0, this means that we are matching a beginning or end
+      // of line
+      // regoff_t type of result.rm_eo is sometimes "int" and sometimes
+      // "long int". Hence, the cast to "long int"
+      PDIP_DBG(ctxp, 2, "Pattern matching SUCCEEDED at offset %ld in outstanding data !\n", (long int)(result.rm_eo));
+
+      if (0 == result.rm_eo)
+      {
+	// Here, we are sure that there is at least one
+        // byte (ctxp->outstanding_data_offset > 0)
+        if (len && ('\n' == str[0]))
+	{
+          // Skip the new line
+          PDIP_DBG(ctxp, 2, "Match at offset 0 ==> Skipping end of line !\n");
+          result.rm_eo = 1;
+	}
+      } // End if match beginning/end of line
+
+      // The offsets in the filtered copy are turned into offsets in the
+      // outstanding data: the match ends after its last byte (the following
+      // removed bytes stay in the outstanding data)
+      if (ctxp->flags & PDIP_FLAG_FILTER_CTRL)
+      {
+        result.rm_so = (regoff_t)pdip_filter_raw(ctxp, result.rm_so);
+        if (result.rm_eo)
+        {
+          result.rm_eo = (regoff_t)(pdip_filter_raw(ctxp, result.rm_eo - 1) + 1);
+        }
+        if (result.rm_so > result.rm_eo)
+        {
+          result.rm_so = result.rm_eo;
+        }
+      }
+
+      ctxp->match_start = result.rm_so;
+
+      // The data up to the end offset of the matching pattern are
+      // returned to the user. The remaining data stay in the outstanding
+      // buffer
+      rc = pdip_outstanding_to_display(ctxp, result.rm_eo, display, display_sz, data_sz);
+      if (rc != 0)
+      {
+        // Errno is set
+        return -1;
+      }
+
+      // The remaining data begin after the match: they must be scanned again
+      ctxp->outstanding_scan_offset = 0;
+      ctxp->outstanding_scan_id = 0;
+
+      PDIP_DUMP(ctxp, 2, "Remaining outstanding data (%"PRISIZE" bytes):\n", ctxp->outstanding_data, ctxp->outstanding_data_offset, ctxp->outstanding_data_offset);
+
+      return 0;
+    }
+    else // Regex not found
+    {
+      PDIP_DBG(ctxp, 2, "Pattern matching FAILED!\n");
+
+      // The data is kept in the outstanding space
+
+      // The next scan for the same regular expression will start after the
+      // last complete line
+      if (pat->single_line)
+      {
+        nl = (char *)memrchr(str + offset, '\n', len - offset);
+        if (nl)
+        {
+          offset = (nl - str) + 1;
+        }
+
+        ctxp->outstanding_scan_offset = offset;
+        ctxp->outstanding_scan_id = pat->id;
+      }
+
+    } // End if regex found
+  }
+  else
+  {
+    PDIP_DBG(ctxp, 2, "No outstanding data to look for a match of <%s>\n", pat->regular_expr);
+  } // End if outstanding data
+
+  return 1;
+} // pdip_look_for_regex
+
+
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_check
+// Usage  : Check the parameters of the reception services
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_recv_check(
+                           pdip_t           ctx,
+                           char           **display,
+                           size_t          *display_sz,
+                           size_t          *data_sz
+                          )
+{
+pdip_ctx_t *ctxp;
+
+  if (!data_sz)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // No data for the moment
+  *data_sz = 0;
+
+  if (!display || !display_sz || !ctx)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Some coherency checks
+  if ((*display_sz && !(*display)) ||
+      (!(*display_sz) && *display))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ctxp = (pdip_ctx_t *)ctx;
+
+  // The data returned by pdip_recv_view() must be released first and the
+  // objects registered in an event loop are serviced by the loop
+  if (ctxp->view_data || ctxp->loop_entry)
+  {
+    errno = EBUSY;
+    return -1;
+  }
+
+  // The process may be dead but there may be outstanding data
+  // in internal buffers or PTY. Hence we don't check ALIVE state
+  // but the validity of the file descriptor on the master side
+  // The file descriptor on the master side is equal to -1
+  // only if the object is not linked to any process (i.e. pdip_exec()
+  // not called or process is dead)
+  // No need for mutual exclusion with the signal handler as the
+  // reception services of a given object are serialized by its reception
+  // lock and the file descriptor is only changed by pdip_exec() and
+  // pdip_delete() which must not run concurrently
+  if (ctxp->pty_master < 0)
+  {
+    errno = EPERM;
+    return -1;
+  }
+
+  return 0;
+} // pdip_recv_check
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_deadline
+// Usage  : Receive data from the controlled process until an absolute
+//          deadline on CLOCK_MONOTONIC
+//          If the deadline is NULL and the regular expression is not found,
+//          the function blocks indefinitely
+// Return : PDIP_RECV_FOUND
+//          PDIP_RECV_TIMEOUT
+//          PDIP_RECV_DATA
+//          PDIP_RECV_ERROR (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_recv_deadline(
+                              pdip_ctx_t             *ctxp,
+                              pdip_pat_t             *pat,
+                              char                  **display,
+                              size_t                 *display_sz,
+                              size_t                 *data_sz,      // OUT: strlen() of the received data (i.e. Terminating NUL not counted)
+                              const struct timespec  *deadline
+                             )
+{
+int             rc;
+int             err_sav = 0;
+struct timespec now, left;
+
+  rc = PDIP_RECV_ERROR;
+
+  // If a regular expression is not passed for synchronization
+  if (!pat)
+  {
+    // Flush the outstanding data
+    rc = pdip_flush_internal(ctxp, display, display_sz, data_sz);
+    if (rc < 0)
+    {
+      // Errno is set
+      err_sav = errno;
+      rc = PDIP_RECV_ERROR;
+      goto end_no_regex;
+    }
+
+    // If outstanding data have been flushed ==> Return them to the user
+    if (*data_sz)
+    {
+      PDIP_DBG(ctxp, 4, "Returning %"PRISIZE" outstanding data bytes\n", *data_sz);
+      rc = PDIP_RECV_DATA;
+      goto end_no_regex;
+    }
+
+    // If a deadline is passed
+    if (deadline)
+    {
+      // Get new data if any
+      rc = pdip_read_until_deadline(ctxp, display, display_sz, data_sz, deadline);
+      err_sav = errno;
+
+      switch(rc)
+      {
+        case 0: // No error
+        {
+          // If data have been read
+          if (*data_sz > 0)
+	  {
+            rc = PDIP_RECV_DATA;
+	  }
+          else // No data
+	  {
+            rc = PDIP_RECV_TIMEOUT;
+	  }
+        }
+        break;
+
+        case -1: // Error
+        {
+          // Data may have been read (data_sz >= 0)
+          // If we received data, return OK!
+          if (*data_sz)
+	  {
+            rc = PDIP_RECV_DATA;
+	  }
+          else
+	  {
+            err_sav = errno;
+            rc = PDIP_RECV_ERROR;
+	  }
+        }
+        break;
+
+        default: // Bug !?!
+        {
+          assert(0);
+          err_sav = errno;
+          rc = PDIP_RECV_ERROR;
+        }
+      } // End switch
+    }
+    else // No timeout
+    {
+      // If there is not enough space in the buffer, enlarge it
+      if (0 != pdip_display_room(ctxp, display, display_sz, 0))
+      {
+        // Errno is set
+        err_sav = errno;
+        rc = PDIP_RECV_ERROR;
+        goto end_no_regex;
+      }
+
+      // Blocking data reception (let 1 slot for terminating NUL)
+      rc = pdip_read(ctxp, *display, *display_sz - 1);
+      if (rc > 0)
+      {
+        (*display)[rc] = '\0';
+        *data_sz = rc;
+        rc = PDIP_RECV_DATA;
+      }
+      else // Error
+      {
+        assert(0 != rc);
+
+        err_sav = errno;
+        rc = PDIP_RECV_ERROR;
+      }
+    } // End if timeout
+
+end_no_regex:
+
+    if ((PDIP_RECV_ERROR == rc) && (ENOSPC == err_sav) && (PDIP_BUF_OVERFLOW_FAIL == ctxp->buf_overflow))
+    {
+      rc = PDIP_RECV_OVERFLOW;
+    }
+
+    PDIP_DBG(ctxp, 5, "Return code: %d\n", rc);
+
+    if (PDIP_RECV_TIMEOUT == rc)
+    {
+      ctxp->stats.recv_timeouts ++;
+    }
+
+    errno = err_sav;
+
+    return rc;
+  }
+  else // A regular expression has been passed
+  {
+    // First of all, look for a match in the outstanding data if any
+    rc = pdip_look_for_regex(ctxp, pat, display, display_sz, data_sz);
+
+    // If pattern matching succeeded
+    if (0 == rc)
+    {
+      rc = PDIP_RECV_FOUND;
+      goto end_regex;
+    } // End if pattern matching succeeded
+
+    if (deadline)
+    {
+
+read_again:
+
+      rc = pdip_read_until_deadline(ctxp, display, display_sz, data_sz, deadline);
+      err_sav = errno;
+
+      switch(rc)
+      {
+        case 0: // No error
+        {
+          // If data have been read
+          if (*data_sz > 0)
+	  {
+            // Look for the regular expression
+            rc = pdip_look_for_regex(ctxp, pat, display, display_sz, data_sz);
+            switch(rc)
+            {
+              case 0 : // Regular expression found
+              {
+                // The read data located after the pattern matching is stored in the
+                // outstanding data of the context.
+                rc = PDIP_RECV_FOUND;
+                goto end_regex;
+              }
+              break;
+              case 1 : // Regular expression not found
+              {
+                // If the deadline is not passed
+                pdip_now(&now);
+                if (pdip_deadline_left(&now, deadline, &left))
+	        {
+                  // Reiterate the read with the remaining timeout only if flag
+                  // RECV_ON_THE_FLOW is not set
+                  if (ctxp->flags & PDIP_FLAG_RECV_ON_THE_FLOW)
+		  {
+                    PDIP_DBG(ctxp, 7, "Flag RECV_ON_THE_FLOW is set ==> Trying an intermediate return of outstanding data\n");
+
+                    // The user wants to receive intermediate data
+                    // ==> Return the data read until now except the last line if it is not complete
+                    //     as the following data may complete the line and make the regex match
+                    rc = pdip_flush_outstanding(ctxp, display, display_sz, data_sz);
+                    switch(rc)
+		    {
+   		      case 0: // Outstanding data to return
+		      {
+                        rc = PDIP_RECV_DATA;
+                        goto end_regex;
+		      }
+                      break;
+
+		      case 1: // Not enough outstanding data (at least not a complete line to return)
+		      {
+                        // Loop again to read more data as the timeout is not elapsed
+                        goto read_again;
+		      }
+                      break;
+
+	  	      default : // Error
+		      {
+                        err_sav = errno;
+                        rc = PDIP_RECV_ERROR;
+                        goto end_regex;
+		      }
+                      break;
+		    } // End switch
+
+		  }
+                  else // No reception on the flow
+		  {
+                    // Reiterate the read
+                    goto read_again;
+		  }
+	        }
+                else // Timeout elapsed
+	        {
+                  // We received data but the deadline passed in the meantime
+                  // (e.g. null timeout or multiple steps sharing the same
+                  // deadline)
+
+                  // Return outstanding data only if RECV_ON_THE_FLOW is set
+                  if ((ctxp->flags & PDIP_FLAG_RECV_ON_THE_FLOW) && (ctxp->outstanding_data_offset))
+		  {
                     // The timeout expired, return the data read until now
                     // ==> Transfer the outstanding data into the user buffer
                     rc = pdip_flush_internal(ctxp, display, display_sz, data_sz);
@@ -1099,184 +4578,3978 @@ read_again:
           else // No data
 	  {
 
-            // The timeout elapsed
-            pdip_assert(0 == timeout->tv_sec && 0 == timeout->tv_usec, "sec=%lu, usec=%lu\n", timeout->tv_sec, timeout->tv_usec);
-            rc = PDIP_RECV_TIMEOUT;
-	  }
-        }
-        break;
+            // The deadline passed
+            rc = PDIP_RECV_TIMEOUT;
+	  }
+        }
+        break;
+
+        case -1: // Error
+        {
+          // Data may have been read (data_sz >= 0)
+          // If we received data, return OK!
+          if (*data_sz)
+	  {
+            rc = PDIP_RECV_DATA;
+	  }
+          else
+	  {
+            err_sav = errno;
+            rc = PDIP_RECV_ERROR;
+	  }
+        }
+        break;
+
+        default: // Bug !?!
+        {
+          assert(0);
+          err_sav = errno;
+          rc = PDIP_RECV_ERROR;
+        }
+      } // End switch
+    }
+    else // No timeout
+    {
+      while(1)
+      {
+        // If there is not enough space in the buffer, enlarge it
+        if (0 != pdip_display_room(ctxp, display, display_sz, *data_sz))
+        {
+          // Errno is set
+          err_sav = errno;
+          rc = PDIP_RECV_ERROR;
+          goto end_regex;
+        }
+
+        // Blocking data reception (let one slot for terminating NUL)
+        rc = pdip_read(ctxp, *display, *display_sz - 1);
+        PDIP_DBG(ctxp, 8, "pdip_read() = %d\n", rc);
+        if (rc > 0)
+        {
+          *data_sz = rc;
+
+          // NUL terminate the string
+          (*display)[*data_sz] = '\0';
+
+          // Append data to the outstanding space and look for the regular expression
+          rc = pdip_look_for_regex(ctxp, pat, display, display_sz, data_sz);
+          switch(rc)
+	  {
+  	    case 0: // Regex found
+	    {
+              // The read data located after the pattern matching is stored in the
+              // outstanding data of the context.
+              rc = PDIP_RECV_FOUND;
+              goto end_regex;
+	    }
+            break;
+
+	    case 1 : // Regex not found
+	    {
+              // Data read until now does not contain the regular expression
+              if (ctxp->flags & PDIP_FLAG_RECV_ON_THE_FLOW)
+	      {
+                // The user wants to receive intermediate data
+                // ==> Return the data read until now except the last line if it is not complete
+                //     as the following data may complete the line and make the regex match
+                rc = pdip_flush_outstanding(ctxp, display, display_sz, data_sz);
+                PDIP_DBG(ctxp, 10, "pdip_flush_outstanding()=%d\n", rc);
+                switch(rc)
+		{
+   		  case 0: // Outstanding data to return
+		  {
+                    rc = PDIP_RECV_DATA;
+                    goto end_regex;
+		  }
+                  break;
+
+		  case 1: // Not enough outstanding data (at least not a complete line to return)
+		  {
+                    // Loop again to read more data as the timeout is infinite
+		  }
+                  break;
+
+		  default : // Error
+		  {
+                    err_sav = errno;
+                    rc = PDIP_RECV_ERROR;
+                    goto end_regex;
+		  }
+                  break;
+		} // End switch
+	      }
+              else // ! RECV_ON_THE_FLOW
+	      {
+                // Loop again to read more data as the timeout is infinite
+
+	      } // RECV_ON_THE_FLOW
+	    }
+            break;
+
+	    case -1 : // Error
+	    {
+              err_sav = errno;
+              rc = PDIP_RECV_ERROR;
+              goto end_regex;
+	    }
+            break;
+
+	    default: // Bug
+	    {
+              assert(0);
+	    }
+            break;
+	  } // End switch
+        }
+        else // Error
+        {
+          assert(0 != rc);
+
+          err_sav = errno;
+          rc = PDIP_RECV_ERROR;
+          goto end_regex;
+        }
+      } // End while
+
+    } // End if timeout
+
+end_regex:
+
+    if ((PDIP_RECV_ERROR == rc) && (ENOSPC == err_sav) && (PDIP_BUF_OVERFLOW_FAIL == ctxp->buf_overflow))
+    {
+      rc = PDIP_RECV_OVERFLOW;
+    }
+
+    PDIP_DBG(ctxp, 5, "Return code: %d\n", rc);
+
+    switch(rc)
+    {
+      case PDIP_RECV_FOUND   : pdip_stats_reply(ctxp); break;
+      case PDIP_RECV_TIMEOUT : ctxp->stats.recv_timeouts ++; break;
+      default : break;
+    } // End switch
+
+    errno = err_sav;
+    return rc;
+
+  } // End if regular expression
+
+} // pdip_recv_deadline
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_internal
+// Usage  : Receive data from the controlled process
+//          If the timeout is NULL and the regular expression is not found,
+//          the function blocks indefinitely. Otherwise, the timeout is
+//          turned into an absolute deadline and it is updated with the
+//          remaining time upon return
+// Return : PDIP_RECV_FOUND
+//          PDIP_RECV_TIMEOUT
+//          PDIP_RECV_DATA
+//          PDIP_RECV_ERROR (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_recv_internal(
+                              pdip_ctx_t      *ctxp,
+                              pdip_pat_t      *pat,
+                              char           **display,
+                              size_t          *display_sz,
+                              size_t          *data_sz,
+                              struct timeval  *timeout
+                             )
+{
+int             rc;
+int             err_sav;
+struct timespec deadline, now, left;
+
+  if (!timeout)
+  {
+    return pdip_recv_deadline(ctxp, pat, display, display_sz, data_sz, (const struct timespec *)0);
+  }
+
+  pdip_deadline(&deadline, timeout);
+
+  rc = pdip_recv_deadline(ctxp, pat, display, display_sz, data_sz, &deadline);
+  err_sav = errno;
+
+  pdip_now(&now);
+  (void)pdip_deadline_left(&now, &deadline, &left);
+  timeout->tv_sec  = left.tv_sec;
+  timeout->tv_usec = left.tv_nsec / 1000;
+
+  errno = err_sav;
+
+  return rc;
+} // pdip_recv_internal
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pat_id
+// Usage  : Source of the unique identifiers of the compiled regular
+//          expressions
+// ----------------------------------------------------------------------------
+static unsigned long pdip_pat_id;
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pat_single_line
+// Usage  : Check if a regular expression compiled with REG_NEWLINE can not
+//          match a newline. In that case, all the matches are confined into
+//          one line.
+//          The analysis is conservative: the regular expression is considered
+//          multi-line as soon as it contains a newline, a matching bracket
+//          expression which may contain a newline ([[:space:]], [[:cntrl:]],
+//          ranges, collating elements...) or any escape sequence which is not
+//          known to be newline free (GNU operators like '\s', '\W' or '\`')
+// Return : 1, if the regular expression is confined into one line
+//          0, otherwise
+// ----------------------------------------------------------------------------
+static int pdip_pat_single_line(
+                                const char *regular_expr
+                               )
+{
+const char *p;
+const char *e;
+int         non_matching;
+
+  p = regular_expr;
+  while (*p)
+  {
+    switch(*p)
+    {
+      case '\n' :
+      {
+        return 0;
+      }
+      break;
+
+      case '\\' :
+      {
+        // Only the escaped metacharacters, the back-references and the GNU
+        // operators which never match a newline are accepted ('\W' and '\s'
+        // match a newline, '\`' and '\'' refer to the whole buffer)
+        if (!(p[1]) ||
+            !strchr(".[]*+?{}()|^$\\/<>wSbB123456789", p[1]))
+        {
+          return 0;
+        }
+
+        // The escaped character is skipped
+        p ++;
+      }
+      break;
+
+      case '[' : // Bracket expression
+      {
+        p ++;
+
+        // A non matching list never matches a newline with REG_NEWLINE
+        non_matching = ('^' == *p);
+        if (non_matching)
+        {
+          p ++;
+        }
+
+        // A leading ']' is part of the list
+        if (']' == *p)
+        {
+          p ++;
+        }
+
+        while (*p && (']' != *p))
+        {
+          if (('[' == p[0]) && ((':' == p[1]) || ('.' == p[1]) || ('=' == p[1])))
+          {
+            // Look for the end of the class/collating element
+            e = p + 2;
+            while (*e && ((*e != p[1]) || (']' != e[1])))
+            {
+              e ++;
+            } // End while
+
+            if (!(*e))
+            {
+              return 0;
+            }
+
+            if (!non_matching)
+            {
+              if (':' != p[1])
+              {
+                return 0;
+              }
+
+              if (!strncmp(p + 2, "space:", 6) || !strncmp(p + 2, "cntrl:", 6))
+              {
+                return 0;
+              }
+            }
+
+            p = e + 2;
+            continue;
+          }
+
+          // Range including the newline
+          if (!non_matching && ('-' == p[1]) && p[2] && (']' != p[2]) &&
+              ((unsigned char)(p[0]) <= '\n') && ((unsigned char)(p[2]) >= '\n'))
+          {
+            return 0;
+          }
+
+          p ++;
+        } // End while
+
+        if (!(*p))
+        {
+          // Unterminated bracket expression
+          return 0;
+        }
+      }
+      break;
+
+      default :
+      {
+        // Nothing to do
+      }
+      break;
+    } // End switch
+
+    p ++;
+  } // End while
+
+  return 1;
+} // pdip_pat_single_line
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pat_literal
+// Usage  : If the regular expression does not contain any metacharacter
+//          except a leading '^' and/or a trailing '$', store the
+//          corresponding literal string (with the escaped metacharacters
+//          unescaped) into the pattern descriptor
+// Return : 0, if OK (pat->literal is NULL if the regular expression is not
+//             a literal)
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_pat_literal(
+                            pdip_pat_t *pat,
+                            const char *regular_expr
+                           )
+{
+const char *p;
+const char *pEnd;
+char       *l;
+size_t      len;
+
+  pat->literal     = (char *)0;
+  pat->literal_len = 0;
+  pat->literal_bol = 0;
+  pat->literal_eol = 0;
+
+  p = regular_expr;
+  len = strlen(regular_expr);
+  pEnd = p + len;
+
+  if ('^' == *p)
+  {
+    pat->literal_bol = 1;
+    p ++;
+  }
+
+  // A trailing '$' is an anchor if it is not escaped (i.e. preceded by
+  // an odd number of backslashes)
+  if ((pEnd > p) && ('$' == pEnd[-1]))
+  {
+  const char *b = pEnd - 1;
+
+    while ((b > p) && ('\\' == b[-1]))
+    {
+      b --;
+    } // End while
+
+    if (0 == ((pEnd - 1 - b) % 2))
+    {
+      pat->literal_eol = 1;
+      pEnd --;
+    }
+  }
+
+  // Check the metacharacters
+  len = 0;
+  while (p < pEnd)
+  {
+    if ('\\' == *p)
+    {
+      // Only the escaped metacharacters are literals (the other escaped
+      // characters may be GNU operators like '\w' or '\<')
+      if (!(p[1]) || !strchr(".[]()*+?{}|^$\\", p[1]))
+      {
+        return 0;
+      }
+
+      p += 2;
+    }
+    else if (strchr(".[]()*+?{}|^$", *p))
+    {
+      return 0;
+    }
+    else
+    {
+      p ++;
+    }
+
+    len ++;
+  } // End while
+
+  // The empty regular expression is left to regexec()
+  if (0 == len)
+  {
+    return 0;
+  }
+
+  pat->literal = (char *)malloc(len + 1);
+  if (!(pat->literal))
+  {
+    // Errno is set
+    return -1;
+  }
+
+  // Copy the literal without the backslashes
+  p = regular_expr + (pat->literal_bol ? 1 : 0);
+  l = pat->literal;
+  while (p < pEnd)
+  {
+    if ('\\' == *p)
+    {
+      p ++;
+    }
+
+    *(l ++) = *(p ++);
+  } // End while
+  *l = '\0';
+
+  pat->literal_len = len;
+
+  return 0;
+} // pdip_pat_literal
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pat_compile
+// Usage  : Compile a regular expression into a pattern descriptor
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_pat_compile(
+                            pdip_ctx_t *ctxp,
+                            pdip_pat_t *pat,
+                            const char *regular_expr
+                           )
+{
+int  rc;
+char regex_err[256];
+
+  memset(&(pat->regex), 0, sizeof(pat->regex));
+
+  pat->alt_nb    = 0;
+  pat->alt       = (pdip_pat_t **)0;
+  pat->alt_id    = (unsigned long *)0;
+  pat->alt_group = (size_t *)0;
+  pat->ac        = (pdip_ac_t *)0;
+
+  pat->regular_expr = strdup(regular_expr);
+  if (!(pat->regular_expr))
+  {
+    // Errno is set
+    return -1;
+  }
+
+  if (ctxp)
+  {
+    ctxp->stats.strdups ++;
+  }
+
+  // Compile the regular expression
+  //
+  // . After compilation, the compiler returns the number of parenthesized
+  //   subexpressions in regex.re_nsub
+  //
+  PDIP_DBG(ctxp, 3, "Compiling <%s>\n", regular_expr);
+  pat->cflags = PDIP_REGCOMP_FLAGS;
+  rc = regcomp(&(pat->regex), regular_expr, pat->cflags);
+  //rc = regcomp(&(pat->regex), regular_expr, REG_EXTENDED);
+  if (0 != rc)
+  {
+    (void)regerror(rc, &(pat->regex), regex_err, sizeof(regex_err));
+    PDIP_ERR(ctxp, "Bad regular expression <%s>: %s\n", regular_expr, regex_err);
+    free(pat->regular_expr);
+    pat->regular_expr = (char *)0;
+    errno = EINVAL;
+    return -1;
+  }
+
+  PDIP_DBG(ctxp, 5, "Number of sub expressions in regex (%s): %"PRISIZE"\n", regular_expr, pat->regex.re_nsub);
+
+  pat->id = __sync_add_and_fetch(&pdip_pat_id, 1);
+  pat->single_line = (pat->cflags & REG_NEWLINE) ? pdip_pat_single_line(regular_expr) : 0;
+
+  PDIP_DBG(ctxp, 5, "Regex (%s) is %s\n", regular_expr, (pat->single_line ? "single-line" : "multi-line"));
+
+  // The literal search gives the same result as regexec() only with
+  // REG_EXTENDED|REG_NEWLINE
+  pat->literal = (char *)0;
+  if (PDIP_REGCOMP_FLAGS == pat->cflags)
+  {
+    if (0 != pdip_pat_literal(pat, regular_expr))
+    {
+    int err_sav = errno;
+
+      regfree(&(pat->regex));
+      free(pat->regular_expr);
+      pat->regular_expr = (char *)0;
+      errno = err_sav;
+      return -1;
+    }
+  }
+
+  PDIP_DBG(ctxp, 5, "Regex (%s) is %sa literal\n", regular_expr, (pat->literal ? "" : "not "));
+
+  return 0;
+} // pdip_pat_compile
+
+
+// ----------------------------------------------------------------------------
+// Name   : PDIP_AC_MAX_STATES
+// Usage  : Maximum number of states of an Aho-Corasick automaton (each state
+//          needs 1 KB of transitions). Over this limit, the literals are
+//          looked for with the alternation of the regular expressions
+// ----------------------------------------------------------------------------
+#define PDIP_AC_MAX_STATES  1024
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_ac_free
+// Usage  : Free an Aho-Corasick automaton
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_ac_free(
+                         pdip_ac_t *ac
+                        )
+{
+  free(ac->next);
+  free(ac->out);
+  free(ac->dict);
+  free(ac->out_next);
+  free(ac);
+} // pdip_ac_free
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_ac_new
+// Usage  : Build the Aho-Corasick automaton recognizing the literals of
+//          'alt'. The transitions of the trie are completed with the failure
+//          links so that the scan makes exactly one transition per byte
+// Return : 0, if OK ('ac' is NULL if the automaton is too big)
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_ac_new(
+                       pdip_pat_t   **alt,
+                       unsigned int   nb,
+                       pdip_ac_t    **ac
+                      )
+{
+pdip_ac_t    *a;
+int          *fail = (int *)0;
+int          *queue = (int *)0;
+unsigned int  i, head, tail, nb_states;
+size_t        j;
+int           s, u, v, c, k;
+int           err_sav;
+
+  *ac = (pdip_ac_t *)0;
+
+  nb_states = 1;
+  for (i = 0; i < nb; i ++)
+  {
+    nb_states += alt[i]->literal_len;
+  } // End for
+
+  if (nb_states > PDIP_AC_MAX_STATES)
+  {
+    return 0;
+  }
+
+  a = (pdip_ac_t *)calloc(1, sizeof(pdip_ac_t));
+  if (!a)
+  {
+    // Errno is set
+    return -1;
+  }
+
+  a->next     = (int *)malloc(nb_states * 256 * sizeof(int));
+  a->out      = (int *)malloc(nb_states * sizeof(int));
+  a->dict     = (int *)malloc(nb_states * sizeof(int));
+  a->out_next = (int *)malloc(nb * sizeof(int));
+  fail        = (int *)malloc(nb_states * sizeof(int));
+  queue       = (int *)malloc(nb_states * sizeof(int));
+  if (!(a->next) || !(a->out) || !(a->dict) || !(a->out_next) || !fail || !queue)
+  {
+    goto error;
+  }
+
+  memset(a->next, 0xFF, nb_states * 256 * sizeof(int));
+  memset(a->out, 0xFF, nb_states * sizeof(int));
+  memset(a->dict, 0xFF, nb_states * sizeof(int));
+
+  // Build the trie
+  a->nb_states = 1;
+  for (i = 0; i < nb; i ++)
+  {
+    s = 0;
+    for (j = 0; j < alt[i]->literal_len; j ++)
+    {
+      c = (unsigned char)(alt[i]->literal[j]);
+      if (a->next[(s << 8) + c] < 0)
+      {
+        a->next[(s << 8) + c] = (int)(a->nb_states ++);
+      }
+
+      s = a->next[(s << 8) + c];
+    } // End for
+
+    // Chain the literal at the end of the list of the state
+    a->out_next[i] = -1;
+    if (a->out[s] < 0)
+    {
+      a->out[s] = (int)i;
+    }
+    else
+    {
+      for (k = a->out[s]; a->out_next[k] >= 0; k = a->out_next[k])
+      {
+      } // End for
+
+      a->out_next[k] = (int)i;
+    }
+
+    if (alt[i]->literal_len > a->max_len)
+    {
+      a->max_len = alt[i]->literal_len;
+    }
+  } // End for
+
+  // Breadth first computation of the failure links
+  head = tail = 0;
+  for (c = 0; c < 256; c ++)
+  {
+    v = a->next[c];
+    if (v < 0)
+    {
+      a->next[c] = 0;
+    }
+    else
+    {
+      fail[v] = 0;
+      queue[tail ++] = v;
+    }
+  } // End for
+
+  while (head != tail)
+  {
+    u = queue[head ++];
+
+    for (c = 0; c < 256; c ++)
+    {
+      v = a->next[(u << 8) + c];
+      if (v < 0)
+      {
+        // Missing transition: same as the one of the failure state
+        a->next[(u << 8) + c] = a->next[(fail[u] << 8) + c];
+      }
+      else
+      {
+        fail[v] = a->next[(fail[u] << 8) + c];
+        a->dict[v] = ((a->out[fail[v]] >= 0) ? fail[v] : a->dict[fail[v]]);
+        queue[tail ++] = v;
+      }
+    } // End for
+  } // End while
+
+  free(fail);
+  free(queue);
+
+  *ac = a;
+
+  return 0;
+
+error:
+
+  err_sav = errno;
+  free(fail);
+  free(queue);
+  pdip_ac_free(a);
+  errno = err_sav;
+
+  return -1;
+} // pdip_ac_new
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pat_backref
+// Usage  : Check if a regular expression contains back-references
+// Return : 1, if there are back-references
+//          0, otherwise
+// ----------------------------------------------------------------------------
+static int pdip_pat_backref(
+                            const char *regular_expr
+                           )
+{
+const char *p;
+
+  for (p = regular_expr; *p; p ++)
+  {
+    if ('\\' == *p)
+    {
+      if ((p[1] >= '1') && (p[1] <= '9'))
+      {
+        return 1;
+      }
+
+      if (p[1])
+      {
+        p ++;
+      }
+    }
+  } // End for
+
+  return 0;
+} // pdip_pat_backref
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pat_compile_any
+// Usage  : Combine several compiled patterns into one pattern descriptor
+//          looking for all of them in one pass
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_pat_compile_any(
+                                pdip_ctx_t    *ctxp,
+                                pdip_pat_t    *pat,
+                                pdip_pat_t   **alt,
+                                unsigned int   nb
+                               )
+{
+size_t        len;
+unsigned int  i;
+char         *p;
+int           rc;
+int           backref, all_literal;
+size_t        group;
+char          regex_err[256];
+int           err_sav;
+
+  memset(pat, 0, sizeof(*pat));
+
+  backref = 0;
+  all_literal = 1;
+  pat->single_line = 1;
+  len = 1;
+  for (i = 0; i < nb; i ++)
+  {
+    len += strlen(alt[i]->regular_expr) + 3;
+    backref |= pdip_pat_backref(alt[i]->regular_expr);
+    all_literal &= (alt[i]->literal ? 1 : 0);
+    pat->single_line &= alt[i]->single_line;
+  } // End for
+
+  // Alternation of the regular expressions
+  pat->regular_expr = (char *)malloc(len);
+  pat->alt = (pdip_pat_t **)malloc(nb * sizeof(pdip_pat_t *));
+  pat->alt_id = (unsigned long *)malloc(nb * sizeof(unsigned long));
+  pat->alt_group = (size_t *)malloc(nb * sizeof(size_t));
+  if (!(pat->regular_expr) || !(pat->alt) || !(pat->alt_id) || !(pat->alt_group))
+  {
+    goto error;
+  }
+
+  p = pat->regular_expr;
+  group = 1;
+  for (i = 0; i < nb; i ++)
+  {
+    p += sprintf(p, "%s(%s)", (i ? "|" : ""), alt[i]->regular_expr);
+    pat->alt[i] = alt[i];
+    pat->alt_id[i] = alt[i]->id;
+    pat->alt_group[i] = group;
+    group += alt[i]->regex.re_nsub + 1;
+  } // End for
+
+  pat->alt_nb = nb;
+  pat->cflags = PDIP_REGCOMP_FLAGS;
+
+  if (all_literal)
+  {
+    rc = pdip_ac_new(alt, nb, &(pat->ac));
+    if (rc != 0)
+    {
+      goto error;
+    }
+  }
+
+  if (pat->ac)
+  {
+    PDIP_DBG(ctxp, 3, "Literals <%s> looked for with an automaton of %u states\n", pat->regular_expr, pat->ac->nb_states);
+    free(pat->alt_group);
+    pat->alt_group = (size_t *)0;
+  }
+  else if (backref)
+  {
+    // The alternation would renumber the back-references
+    PDIP_DBG(ctxp, 3, "Back-references in <%s> ==> The alternatives are looked for one by one\n", pat->regular_expr);
+    free(pat->alt_group);
+    pat->alt_group = (size_t *)0;
+  }
+  else
+  {
+    PDIP_DBG(ctxp, 3, "Compiling <%s>\n", pat->regular_expr);
+    rc = regcomp(&(pat->regex), pat->regular_expr, pat->cflags);
+    if (0 != rc)
+    {
+      (void)regerror(rc, &(pat->regex), regex_err, sizeof(regex_err));
+      PDIP_ERR(ctxp, "Bad regular expression <%s>: %s\n", pat->regular_expr, regex_err);
+      free(pat->alt_group);
+      pat->alt_group = (size_t *)0;
+      errno = EINVAL;
+      goto error;
+    }
+  }
+
+  pat->id = __sync_add_and_fetch(&pdip_pat_id, 1);
+
+  return 0;
+
+error:
+
+  err_sav = errno;
+  free(pat->regular_expr);
+  free(pat->alt);
+  free(pat->alt_id);
+  free(pat->alt_group);
+  memset(pat, 0, sizeof(*pat));
+  errno = err_sav;
+
+  return -1;
+} // pdip_pat_compile_any
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pat_free
+// Usage  : Free the resources of a pattern descriptor
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_pat_free(
+                          pdip_pat_t *pat
+                         )
+{
+  // A combination has a compiled regular expression only if it is
+  // looked for with regexec()
+  if (!(pat->alt_nb) || pat->alt_group)
+  {
+    regfree(&(pat->regex));
+  }
+
+  free(pat->regular_expr);
+  pat->regular_expr = (char *)0;
+  free(pat->literal);
+  pat->literal = (char *)0;
+
+  if (pat->alt_nb)
+  {
+    free(pat->alt);
+    free(pat->alt_id);
+    free(pat->alt_group);
+    if (pat->ac)
+    {
+      pdip_ac_free(pat->ac);
+    }
+
+    pat->alt_nb = 0;
+  }
+} // pdip_pat_free
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pattern_new
+// Usage  : Compile a regular expression for subsequent calls to
+//          pdip_recv_pattern()
+// Return : Pattern, if OK
+//          0, if error (errno is set)
+// ----------------------------------------------------------------------------
+pdip_pattern_t pdip_pattern_new(
+                                const char *regular_expr
+                               )
+{
+pdip_pat_t *pat;
+int         err_sav;
+
+  if (!regular_expr)
+  {
+    errno = EINVAL;
+    return (pdip_pattern_t)0;
+  }
+
+  pat = (pdip_pat_t *)malloc(sizeof(pdip_pat_t));
+  if (!pat)
+  {
+    err_sav = errno;
+    PDIP_ERR(0, "malloc(%"PRISIZE"): '%m' (%d)\n", sizeof(pdip_pat_t), errno);
+    errno = err_sav;
+    return (pdip_pattern_t)0;
+  }
+
+  if (0 != pdip_pat_compile(0, pat, regular_expr))
+  {
+    err_sav = errno;
+    free(pat);
+    errno = err_sav;
+    return (pdip_pattern_t)0;
+  }
+
+  return (pdip_pattern_t)pat;
+} // pdip_pattern_new
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pattern_delete
+// Usage  : Free a pattern allocated by pdip_pattern_new()
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_pattern_delete(
+                        pdip_pattern_t pattern
+                       )
+{
+pdip_pat_t *pat;
+
+  if (!pattern)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pat = (pdip_pat_t *)pattern;
+
+  pdip_pat_free(pat);
+  free(pat);
+
+  return 0;
+} // pdip_pattern_delete
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pattern_match
+// Usage  : Look for the first match of a precompiled regular expression in
+//          a string
+// Return : 0, if found
+//          1, if not found
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_pattern_match(
+                       pdip_pattern_t  pattern,
+                       const char     *str,
+                       size_t         *start,
+                       size_t         *end
+                      )
+{
+regmatch_t   result;
+unsigned int alt;
+
+  if (!pattern || !str)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (0 != pdip_pat_exec((pdip_pat_t *)pattern, str, strlen(str), &result, &alt))
+  {
+    return 1;
+  }
+
+  if (start)
+  {
+    *start = (size_t)(result.rm_so);
+  }
+
+  if (end)
+  {
+    *end = (size_t)(result.rm_eo);
+  }
+
+  return 0;
+} // pdip_pattern_match
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_regex_cache_get
+// Usage  : Look for a regular expression (or a combination of 'alt_nb'
+//          precompiled patterns if 'alt_nb' is not 0) in the cache of the
+//          object. If it is not found, it is compiled and inserted in the
+//          cache in place of the least recently used entry
+// Return : Pattern (belonging to the cache), if OK
+//          0, if error (errno is set)
+// ----------------------------------------------------------------------------
+static pdip_pat_t *pdip_regex_cache_get(
+                                        pdip_ctx_t    *ctxp,
+                                        const char    *regular_expr,
+                                        pdip_pat_t   **alt,
+                                        unsigned int   alt_nb
+                                       )
+{
+unsigned int  i, j;
+pdip_pat_t   *pat;
+int           err_sav;
+int           rc;
+
+  for (i = 0; i < ctxp->regex_cache_nb; i ++)
+  {
+    pat = ctxp->regex_cache[i];
+    if (alt_nb)
+    {
+      // The combinations are identified by the ids of their patterns
+      if (pat->alt_nb != alt_nb)
+      {
+        continue;
+      }
+
+      for (j = 0; j < alt_nb; j ++)
+      {
+        if (pat->alt_id[j] != alt[j]->id)
+        {
+          break;
+        }
+      } // End for
+
+      if (j < alt_nb)
+      {
+        continue;
+      }
+    }
+    else if (pat->alt_nb ||
+             (PDIP_REGCOMP_FLAGS != pat->cflags) ||
+             strcmp(pat->regular_expr, regular_expr))
+    {
+      continue;
+    }
+
+    ctxp->regex_cache_hits ++;
+
+    // Move the entry at the beginning of the cache
+    if (i)
+    {
+      memmove(&(ctxp->regex_cache[1]), &(ctxp->regex_cache[0]), i * sizeof(pdip_pat_t *));
+      ctxp->regex_cache[0] = pat;
+    }
+
+    return pat;
+  } // End for
+
+  ctxp->regex_cache_misses ++;
+
+  // The cache is allocated upon the first miss
+  if (!(ctxp->regex_cache))
+  {
+    ctxp->regex_cache = (pdip_pat_t **)malloc(ctxp->regex_cache_sz * sizeof(pdip_pat_t *));
+    if (!(ctxp->regex_cache))
+    {
+      err_sav = errno;
+      PDIP_ERR(ctxp, "malloc(%"PRISIZE"): '%m' (%d)\n", ctxp->regex_cache_sz * sizeof(pdip_pat_t *), errno);
+      errno = err_sav;
+      return (pdip_pat_t *)0;
+    }
+  }
+
+  // If the cache is full, the least recently used entry is recycled
+  if (ctxp->regex_cache_nb == ctxp->regex_cache_sz)
+  {
+    ctxp->regex_cache_nb --;
+    pat = ctxp->regex_cache[ctxp->regex_cache_nb];
+    PDIP_DBG(ctxp, 4, "Evicting <%s> from the regex cache\n", pat->regular_expr);
+    pdip_pat_free(pat);
+  }
+  else
+  {
+    pat = (pdip_pat_t *)malloc(sizeof(pdip_pat_t));
+    if (!pat)
+    {
+      err_sav = errno;
+      PDIP_ERR(ctxp, "malloc(%"PRISIZE"): '%m' (%d)\n", sizeof(pdip_pat_t), errno);
+      errno = err_sav;
+      return (pdip_pat_t *)0;
+    }
+  }
+
+  if (alt_nb)
+  {
+    rc = pdip_pat_compile_any(ctxp, pat, alt, alt_nb);
+  }
+  else
+  {
+    rc = pdip_pat_compile(ctxp, pat, regular_expr);
+  }
+
+  if (0 != rc)
+  {
+    err_sav = errno;
+    free(pat);
+    errno = err_sav;
+    return (pdip_pat_t *)0;
+  }
+
+  memmove(&(ctxp->regex_cache[1]), &(ctxp->regex_cache[0]), ctxp->regex_cache_nb * sizeof(pdip_pat_t *));
+  ctxp->regex_cache[0] = pat;
+  ctxp->regex_cache_nb ++;
+
+  return pat;
+} // pdip_regex_cache_get
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_regex_cache_stats
+// Usage  : Get the hit and miss counters of the cache of compiled regular
+//          expressions of an object
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_regex_cache_stats(
+                           pdip_t         ctx,
+                           unsigned long *hits,
+                           unsigned long *misses
+                          )
+{
+pdip_ctx_t *ctxp;
+
+  if (!ctx)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ctxp = (pdip_ctx_t *)ctx;
+
+  if (hits)
+  {
+    *hits = ctxp->regex_cache_hits;
+  }
+
+  if (misses)
+  {
+    *misses = ctxp->regex_cache_misses;
+  }
+
+  return 0;
+} // pdip_regex_cache_stats
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_stats_add
+// Usage  : Add performance counters to others
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_stats_add(
+                           pdip_stats_t       *dst,
+                           const pdip_stats_t *src
+                          )
+{
+  dst->read_bytes     += src->read_bytes;
+  dst->read_calls     += src->read_calls;
+  dst->write_bytes    += src->write_bytes;
+  dst->write_calls    += src->write_calls;
+  dst->match_calls    += src->match_calls;
+  dst->match_ns       += src->match_ns;
+  dst->allocs         += src->allocs;
+  dst->strdups        += src->strdups;
+  dst->buf_sz         += src->buf_sz;
+  dst->recv_timeouts  += src->recv_timeouts;
+  dst->replies        += src->replies;
+  dst->reply_ns       += src->reply_ns;
+  dst->overflow_bytes += src->overflow_bytes;
+
+  if (src->buf_peak_sz > dst->buf_peak_sz)
+  {
+    dst->buf_peak_sz = src->buf_peak_sz;
+  }
+
+  if (src->reply_max_ns > dst->reply_max_ns)
+  {
+    dst->reply_max_ns = src->reply_max_ns;
+  }
+} // pdip_stats_add
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_stats
+// Usage  : Get the performance counters of an object or, if 'ctx' is NULL,
+//          of the library (all the objects, including the deleted ones).
+//          The counters are plain fields updated by the services of the
+//          objects: the counters of an object used by another thread at the
+//          same time may be slightly behind
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_stats(
+               pdip_t        ctx,
+               pdip_stats_t *stats
+              )
+{
+pdip_ctx_t *ctxp;
+
+  if (!stats)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (ctx)
+  {
+    ctxp = (pdip_ctx_t *)ctx;
+    *stats = ctxp->stats;
+    stats->buf_sz = ctxp->outstanding_buf_sz;
+    return 0;
+  }
+
+  PDIP_MASK_SIG();
+  PDIP_LOCK();
+
+  // The buffers of the deleted objects are freed
+  *stats = pdip_stats_deleted;
+  for (ctxp = pdip_ctx_list; ctxp; ctxp = ctxp->next)
+  {
+    pdip_stats_add(stats, &(ctxp->stats));
+    stats->buf_sz += ctxp->outstanding_buf_sz;
+  } // End for
+
+  PDIP_UNLOCK();
+  PDIP_UNMASK_SIG();
+
+  return 0;
+} // pdip_stats
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_alloc_stats
+// Usage  : Get the number of allocations of reception buffers made for an
+//          object and the current size of its outstanding data buffer. This
+//          is a subset of pdip_stats() kept for the existing applications
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_alloc_stats(
+                     pdip_t         ctx,
+                     unsigned long *allocs,
+                     size_t        *buf_sz
+                    )
+{
+pdip_stats_t stats;
+
+  if (!ctx)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (0 != pdip_stats(ctx, &stats))
+  {
+    // Errno is set
+    return -1;
+  }
+
+  if (allocs)
+  {
+    *allocs = stats.allocs;
+  }
+
+  if (buf_sz)
+  {
+    *buf_sz = stats.buf_sz;
+  }
+
+  return 0;
+} // pdip_alloc_stats
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_unlocked
+// Usage  : Receive data from the controlled process
+//          If the timeout is NULL and the regular expression is not found,
+//          the function blocks indefinitely
+//          The compiled regular expressions are kept in a per object
+//          cache unless PDIP_FLAG_NO_REGEX_CACHE is set
+// Return : PDIP_RECV_FOUND
+//          PDIP_RECV_TIMEOUT
+//          PDIP_RECV_DATA
+//          PDIP_RECV_ERROR (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_recv_unlocked(
+                              pdip_t          *ctx,
+                              const char      *regular_expr,
+                              char           **display,
+                              size_t          *display_sz,
+                              size_t          *data_sz,      // OUT: strlen() of the received data (i.e. Terminating NUL not counted)
+                              struct timeval  *timeout
+                             )
+{
+int         rc;
+pdip_ctx_t *ctxp;
+pdip_pat_t  pat;
+int         err_sav;
+
+  if (0 != pdip_recv_check(ctx, display, display_sz, data_sz))
+  {
+    // Errno is set
+    return PDIP_RECV_ERROR;
+  }
+
+  ctxp = (pdip_ctx_t *)ctx;
+
+  // If a regular expression is not passed for synchronization
+  if (!regular_expr)
+  {
+    return pdip_recv_internal(ctxp, (pdip_pat_t *)0, display, display_sz, data_sz, timeout);
+  }
+
+  if (!(ctxp->flags & PDIP_FLAG_NO_REGEX_CACHE))
+  {
+  pdip_pat_t *cached;
+
+    cached = pdip_regex_cache_get(ctxp, regular_expr, (pdip_pat_t **)0, 0);
+    if (!cached)
+    {
+      // Errno is set
+      return PDIP_RECV_ERROR;
+    }
+
+    return pdip_recv_internal(ctxp, cached, display, display_sz, data_sz, timeout);
+  }
+
+  rc = pdip_pat_compile(ctxp, &pat, regular_expr);
+  if (0 != rc)
+  {
+    // Errno is set
+    return PDIP_RECV_ERROR;
+  }
+
+  rc = pdip_recv_internal(ctxp, &pat, display, display_sz, data_sz, timeout);
+  err_sav = errno;
+
+  pdip_pat_free(&pat);
+
+  errno = err_sav;
+
+  return rc;
+} // pdip_recv_unlocked
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv
+// Usage  : pdip_recv_unlocked() under the reception lock of the object
+// Return : cf. pdip_recv_unlocked()
+// ----------------------------------------------------------------------------
+int pdip_recv(
+              pdip_t          *ctx,
+	      const char      *regular_expr,
+              char           **display,
+              size_t          *display_sz,
+              size_t          *data_sz,      // OUT: strlen() of the received data (i.e. Terminating NUL not counted)
+              struct timeval  *timeout
+             )
+{
+int rc;
+
+  PDIP_OBJ_LOCK(ctx, recv_mtx);
+  rc = pdip_recv_unlocked(ctx, regular_expr, display, display_sz, data_sz, timeout);
+  PDIP_OBJ_UNLOCK(ctx, recv_mtx);
+
+  return rc;
+} // pdip_recv
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_pattern_unlocked
+// Usage  : Same as pdip_recv() with a regular expression precompiled with
+//          pdip_pattern_new()
+// Return : PDIP_RECV_FOUND
+//          PDIP_RECV_TIMEOUT
+//          PDIP_RECV_DATA
+//          PDIP_RECV_ERROR (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_recv_pattern_unlocked(
+                                      pdip_t           ctx,
+                                      pdip_pattern_t   pattern,
+                                      char           **display,
+                                      size_t          *display_sz,
+                                      size_t          *data_sz,
+                                      struct timeval  *timeout
+                                     )
+{
+  if (0 != pdip_recv_check(ctx, display, display_sz, data_sz))
+  {
+    // Errno is set
+    return PDIP_RECV_ERROR;
+  }
+
+  return pdip_recv_internal((pdip_ctx_t *)ctx, (pdip_pat_t *)pattern, display, display_sz, data_sz, timeout);
+} // pdip_recv_pattern_unlocked
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_pattern
+// Usage  : pdip_recv_pattern_unlocked() under the reception lock of the object
+// Return : cf. pdip_recv_pattern_unlocked()
+// ----------------------------------------------------------------------------
+int pdip_recv_pattern(
+                      pdip_t           ctx,
+                      pdip_pattern_t   pattern,
+                      char           **display,
+                      size_t          *display_sz,
+                      size_t          *data_sz,
+                      struct timeval  *timeout
+                     )
+{
+int rc;
+
+  PDIP_OBJ_LOCK(ctx, recv_mtx);
+  rc = pdip_recv_pattern_unlocked(ctx, pattern, display, display_sz, data_sz, timeout);
+  PDIP_OBJ_UNLOCK(ctx, recv_mtx);
+
+  return rc;
+} // pdip_recv_pattern
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_until_unlocked
+// Usage  : Same as pdip_recv_pattern() with an absolute deadline on
+//          CLOCK_MONOTONIC
+// Return : PDIP_RECV_FOUND
+//          PDIP_RECV_TIMEOUT
+//          PDIP_RECV_DATA
+//          PDIP_RECV_ERROR (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_recv_until_unlocked(
+                                    pdip_t                  ctx,
+                                    pdip_pattern_t          pattern,
+                                    char                  **display,
+                                    size_t                 *display_sz,
+                                    size_t                 *data_sz,
+                                    const struct timespec  *deadline
+                                   )
+{
+  if (deadline && ((deadline->tv_nsec < 0) || (deadline->tv_nsec >= 1000000000)))
+  {
+    errno = EINVAL;
+    return PDIP_RECV_ERROR;
+  }
+
+  if (0 != pdip_recv_check(ctx, display, display_sz, data_sz))
+  {
+    // Errno is set
+    return PDIP_RECV_ERROR;
+  }
+
+  return pdip_recv_deadline((pdip_ctx_t *)ctx, (pdip_pat_t *)pattern, display, display_sz, data_sz, deadline);
+} // pdip_recv_until_unlocked
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_until
+// Usage  : pdip_recv_until_unlocked() under the reception lock of the object
+// Return : cf. pdip_recv_until_unlocked()
+// ----------------------------------------------------------------------------
+int pdip_recv_until(
+                    pdip_t                  ctx,
+                    pdip_pattern_t          pattern,
+                    char                  **display,
+                    size_t                 *display_sz,
+                    size_t                 *data_sz,
+                    const struct timespec  *deadline
+                   )
+{
+int rc;
+
+  PDIP_OBJ_LOCK(ctx, recv_mtx);
+  rc = pdip_recv_until_unlocked(ctx, pattern, display, display_sz, data_sz, deadline);
+  PDIP_OBJ_UNLOCK(ctx, recv_mtx);
+
+  return rc;
+} // pdip_recv_until
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_any_unlocked
+// Usage  : Same as pdip_recv_pattern() with several precompiled regular
+//          expressions looked for in one pass over the received data
+//          The combinations of patterns are kept in the per object cache
+//          unless PDIP_FLAG_NO_REGEX_CACHE is set
+// Return : PDIP_RECV_FOUND
+//          PDIP_RECV_TIMEOUT
+//          PDIP_RECV_DATA
+//          PDIP_RECV_ERROR (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_recv_any_unlocked(
+                                  pdip_t           ctx,
+                                  pdip_pattern_t   patterns[],
+                                  unsigned int     nb,
+                                  unsigned int    *index,
+                                  size_t          *offset,
+                                  char           **display,
+                                  size_t          *display_sz,
+                                  size_t          *data_sz,
+                                  struct timeval  *timeout
+                                 )
+{
+int           rc;
+pdip_ctx_t   *ctxp;
+pdip_pat_t   *pat;
+pdip_pat_t    combined;
+unsigned int  i;
+int           err_sav;
+
+  if (!patterns || !nb)
+  {
+    errno = EINVAL;
+    return PDIP_RECV_ERROR;
+  }
+
+  for (i = 0; i < nb; i ++)
+  {
+    if (!(patterns[i]))
+    {
+      errno = EINVAL;
+      return PDIP_RECV_ERROR;
+    }
+  } // End for
+
+  if (0 != pdip_recv_check(ctx, display, display_sz, data_sz))
+  {
+    // Errno is set
+    return PDIP_RECV_ERROR;
+  }
+
+  ctxp = (pdip_ctx_t *)ctx;
+
+  if (1 == nb)
+  {
+    rc = pdip_recv_internal(ctxp, (pdip_pat_t *)(patterns[0]), display, display_sz, data_sz, timeout);
+  }
+  else if (!(ctxp->flags & PDIP_FLAG_NO_REGEX_CACHE))
+  {
+    pat = pdip_regex_cache_get(ctxp, (const char *)0, (pdip_pat_t **)patterns, nb);
+    if (!pat)
+    {
+      // Errno is set
+      return PDIP_RECV_ERROR;
+    }
+
+    rc = pdip_recv_internal(ctxp, pat, display, display_sz, data_sz, timeout);
+  }
+  else
+  {
+    rc = pdip_pat_compile_any(ctxp, &combined, (pdip_pat_t **)patterns, nb);
+    if (0 != rc)
+    {
+      // Errno is set
+      return PDIP_RECV_ERROR;
+    }
+
+    rc = pdip_recv_internal(ctxp, &combined, display, display_sz, data_sz, timeout);
+    err_sav = errno;
+
+    pdip_pat_free(&combined);
+
+    errno = err_sav;
+  }
+
+  if (PDIP_RECV_FOUND == rc)
+  {
+    if (index)
+    {
+      *index = ctxp->match_alt;
+    }
+
+    if (offset)
+    {
+      *offset = ctxp->match_start;
+    }
+  }
+
+  return rc;
+} // pdip_recv_any_unlocked
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_any
+// Usage  : pdip_recv_any_unlocked() under the reception lock of the object
+// Return : cf. pdip_recv_any_unlocked()
+// ----------------------------------------------------------------------------
+int pdip_recv_any(
+                  pdip_t           ctx,
+                  pdip_pattern_t   patterns[],
+                  unsigned int     nb,
+                  unsigned int    *index,
+                  size_t          *offset,
+                  char           **display,
+                  size_t          *display_sz,
+                  size_t          *data_sz,
+                  struct timeval  *timeout
+                 )
+{
+int rc;
+
+  PDIP_OBJ_LOCK(ctx, recv_mtx);
+  rc = pdip_recv_any_unlocked(ctx, patterns, nb, index, offset, display, display_sz, data_sz, timeout);
+  PDIP_OBJ_UNLOCK(ctx, recv_mtx);
+
+  return rc;
+} // pdip_recv_any
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_view_unlocked
+// Usage  : Same as pdip_recv_pattern() without copy of the received data
+//          into a user buffer. The returned data stay valid until the call
+//          to pdip_release()
+// Return : PDIP_RECV_FOUND
+//          PDIP_RECV_TIMEOUT
+//          PDIP_RECV_DATA
+//          PDIP_RECV_ERROR (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_recv_view_unlocked(
+                                   pdip_t           ctx,
+                                   pdip_pattern_t   pattern,
+                                   const char     **data,
+                                   size_t          *data_sz,
+                                   struct timeval  *timeout
+                                  )
+{
+int         rc;
+pdip_ctx_t *ctxp;
+int         err_sav;
+
+  if (!data || !ctx)
+  {
+    errno = EINVAL;
+    return PDIP_RECV_ERROR;
+  }
+
+  *data = (const char *)0;
+
+  ctxp = (pdip_ctx_t *)ctx;
+
+  // The reception buffer of the object replaces the user buffer
+  if (0 != pdip_recv_check(ctx, &(ctxp->view_buf), &(ctxp->view_buf_sz), data_sz))
+  {
+    // Errno is set
+    return PDIP_RECV_ERROR;
+  }
+
+  ctxp->view = 1;
+  rc = pdip_recv_internal(ctxp, (pdip_pat_t *)pattern, &(ctxp->view_buf), &(ctxp->view_buf_sz), data_sz, timeout);
+  err_sav = errno;
+  ctxp->view = 0;
+
+  if (*data_sz)
+  {
+    // If the data have not been taken from the outstanding data, they have
+    // been read directly into the reception buffer
+    if (!(ctxp->view_data))
+    {
+      ctxp->view_data = ctxp->view_buf;
+      ctxp->view_consume = 0;
+    }
+
+    *data = ctxp->view_data;
+  }
+  else
+  {
+    // Nothing to release (e.g. empty match)
+    assert(0 == ctxp->view_consume);
+    ctxp->view_data = (const char *)0;
+    ctxp->view_consume = 0;
+  }
+
+  errno = err_sav;
+
+  return rc;
+} // pdip_recv_view_unlocked
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_view
+// Usage  : pdip_recv_view_unlocked() under the reception lock of the object
+// Return : cf. pdip_recv_view_unlocked()
+// ----------------------------------------------------------------------------
+int pdip_recv_view(
+                   pdip_t           ctx,
+                   pdip_pattern_t   pattern,
+                   const char     **data,
+                   size_t          *data_sz,
+                   struct timeval  *timeout
+                  )
+{
+int rc;
+
+  PDIP_OBJ_LOCK(ctx, recv_mtx);
+  rc = pdip_recv_view_unlocked(ctx, pattern, data, data_sz, timeout);
+  PDIP_OBJ_UNLOCK(ctx, recv_mtx);
+
+  return rc;
+} // pdip_recv_view
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_release_unlocked
+// Usage  : Release the data returned by pdip_recv_view()
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_release_unlocked(
+                                 pdip_t ctx
+                                )
+{
+pdip_ctx_t *ctxp;
+
+  if (!ctx)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ctxp = (pdip_ctx_t *)ctx;
+
+  // Nothing to do if no data are held
+  if (ctxp->view_data)
+  {
+    if (ctxp->view_consume)
+    {
+      pdip_outstanding_consume(ctxp, ctxp->view_consume);
+    }
+    ctxp->view_data = (const char *)0;
+    ctxp->view_consume = 0;
+  }
+
+  return 0;
+} // pdip_release_unlocked
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_release
+// Usage  : pdip_release_unlocked() under the reception lock of the object
+// Return : cf. pdip_release_unlocked()
+// ----------------------------------------------------------------------------
+int pdip_release(
+                 pdip_t ctx
+                )
+{
+int rc;
+
+  PDIP_OBJ_LOCK(ctx, recv_mtx);
+  rc = pdip_release_unlocked(ctx);
+  PDIP_OBJ_UNLOCK(ctx, recv_mtx);
+
+  return rc;
+} // pdip_release
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_screen_search
+// Usage  : Look for a pattern in the rows of the virtual screen, from the
+//          top to the bottom ('all' is 0 to look only into the rows modified
+//          since the last search)
+// Return : 0, if found ('row' and 'col' are the position of the match)
+//          1, if not found
+// ----------------------------------------------------------------------------
+static int pdip_screen_search(
+                              pdip_ctx_t    *ctxp,
+                              pdip_pat_t    *pat,
+                              int            all,
+                              unsigned int  *row,
+                              unsigned int  *col
+                             )
+{
+pdip_screen_t *scr = ctxp->screen;
+unsigned int   r;
+unsigned int   c;
+size_t         len;
+size_t         i;
+regmatch_t     result;
+uint64_t       t0;
+int            rc;
+
+  for (r = 0; r < scr->rows; r ++)
+  {
+    if (!all && !(scr->dirty[r]))
+    {
+      continue;
+    }
+
+    scr->dirty[r] = 0;
+
+    len = pdip_screen_line(scr, r);
+
+    PDIP_DBG(ctxp, 4, "Looking for a match of <%s> in row %u: <%s>\n", pat->regular_expr, r, scr->line);
+
+    t0 = pdip_ns();
+    rc = pdip_pat_exec(pat, scr->line, len, &result, &(ctxp->match_alt));
+    ctxp->stats.match_ns += pdip_ns() - t0;
+    ctxp->stats.match_calls ++;
+    if (0 == rc)
+    {
+      // The column is the number of characters before the match
+      c = 0;
+      for (i = 0; i < (size_t)(result.rm_so); i ++)
+      {
+        if (0x80 != (scr->line[i] & 0xC0))
+        {
+          c ++;
+        }
+      } // End for
+
+      *row = r;
+      *col = c;
+
+      return 0;
+    }
+  } // End for
+
+  return 1;
+} // pdip_screen_search
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_screen_unlocked
+// Usage  : Receive data from the controlled process until a pattern matches
+//          one of the rows of the virtual screen. Only the rows modified
+//          since the last search are searched ('all' is 1 to search the
+//          whole screen first). The received data are consumed (they are
+//          only rendered on the virtual screen)
+//          If the timeout is NULL and the pattern is not found, the function
+//          blocks indefinitely. Otherwise, it is updated with the remaining
+//          time upon return
+// Return : PDIP_RECV_FOUND
+//          PDIP_RECV_TIMEOUT
+//          PDIP_RECV_ERROR (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_recv_screen_unlocked(
+                                     pdip_t           ctx,
+                                     pdip_pattern_t   pattern,
+                                     unsigned int    *row,
+                                     unsigned int    *col,
+                                     struct timeval  *timeout,
+                                     int              all
+                                    )
+{
+pdip_ctx_t      *ctxp;
+size_t           data_sz;
+int              rc;
+int              err_sav = 0;
+struct timespec  deadline, now, left;
+
+  if (!ctx || !pattern || !row || !col)
+  {
+    errno = EINVAL;
+    return PDIP_RECV_ERROR;
+  }
+
+  ctxp = (pdip_ctx_t *)ctx;
+
+  if (!(ctxp->screen))
+  {
+    errno = EINVAL;
+    return PDIP_RECV_ERROR;
+  }
+
+  // The reception buffer of the object receives the data
+  if (0 != pdip_recv_check(ctx, &(ctxp->view_buf), &(ctxp->view_buf_sz), &data_sz))
+  {
+    // Errno is set
+    return PDIP_RECV_ERROR;
+  }
+
+  // The outstanding data are already rendered on the screen
+  if (ctxp->outstanding_data_offset)
+  {
+    pdip_outstanding_consume(ctxp, ctxp->outstanding_data_offset);
+  }
+
+  if (timeout)
+  {
+    pdip_deadline(&deadline, timeout);
+  }
+
+  while (1)
+  {
+    if (0 == pdip_screen_search(ctxp, (pdip_pat_t *)pattern, all, row, col))
+    {
+      PDIP_DBG(ctxp, 4, "Pattern found at row %u, column %u\n", *row, *col);
+      rc = PDIP_RECV_FOUND;
+      break;
+    }
+
+    all = 0;
+    data_sz = 0;
+    rc = pdip_read_until_deadline(ctxp, &(ctxp->view_buf), &(ctxp->view_buf_sz), &data_sz, (timeout ? &deadline : (const struct timespec *)0));
+    if (0 != rc)
+    {
+      err_sav = errno;
+      rc = PDIP_RECV_ERROR;
+      break;
+    }
+
+    // No data: the deadline passed (or end of the data)
+    if (!data_sz)
+    {
+      if (timeout)
+      {
+        rc = PDIP_RECV_TIMEOUT;
+      }
+      else
+      {
+        err_sav = EIO;
+        rc = PDIP_RECV_ERROR;
+      }
+      break;
+    }
+  } // End while
+
+  switch(rc)
+  {
+    case PDIP_RECV_FOUND   : pdip_stats_reply(ctxp); break;
+    case PDIP_RECV_TIMEOUT : ctxp->stats.recv_timeouts ++; break;
+    default : break;
+  } // End switch
+
+  if (timeout)
+  {
+    pdip_now(&now);
+    (void)pdip_deadline_left(&now, &deadline, &left);
+    timeout->tv_sec  = left.tv_sec;
+    timeout->tv_usec = left.tv_nsec / 1000;
+  }
+
+  errno = err_sav;
+
+  return rc;
+} // pdip_recv_screen_unlocked
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_screen
+// Usage  : pdip_recv_screen_unlocked() under the reception lock of the object
+//          (only the modified rows are searched)
+// Return : cf. pdip_recv_screen_unlocked()
+// ----------------------------------------------------------------------------
+int pdip_recv_screen(
+                     pdip_t           ctx,
+                     pdip_pattern_t   pattern,
+                     unsigned int    *row,
+                     unsigned int    *col,
+                     struct timeval  *timeout
+                    )
+{
+int rc;
+
+  PDIP_OBJ_LOCK(ctx, recv_mtx);
+  rc = pdip_recv_screen_unlocked(ctx, pattern, row, col, timeout, 0);
+  PDIP_OBJ_UNLOCK(ctx, recv_mtx);
+
+  return rc;
+} // pdip_recv_screen
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_recv_screen_all
+// Usage  : pdip_recv_screen_unlocked() under the reception lock of the object
+//          (the whole screen is searched first)
+// Return : cf. pdip_recv_screen_unlocked()
+// ----------------------------------------------------------------------------
+int pdip_recv_screen_all(
+                         pdip_t           ctx,
+                         pdip_pattern_t   pattern,
+                         unsigned int    *row,
+                         unsigned int    *col,
+                         struct timeval  *timeout
+                        )
+{
+int rc;
+
+  PDIP_OBJ_LOCK(ctx, recv_mtx);
+  rc = pdip_recv_screen_unlocked(ctx, pattern, row, col, timeout, 1);
+  PDIP_OBJ_UNLOCK(ctx, recv_mtx);
+
+  return rc;
+} // pdip_recv_screen_all
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_screen_get_unlocked
+// Usage  : Copy the content of the virtual screen into a user buffer (one
+//          line per row without the trailing blanks)
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_screen_get_unlocked(
+                                    pdip_t    ctx,
+                                    char    **display,
+                                    size_t   *display_sz,
+                                    size_t   *data_sz
+                                   )
+{
+pdip_ctx_t   *ctxp;
+unsigned int  r;
+size_t        len;
+
+  if (!ctx || !display || !display_sz || !data_sz)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  *data_sz = 0;
+
+  // Some coherency checks
+  if ((*display_sz && !(*display)) ||
+      (!(*display_sz) && *display))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ctxp = (pdip_ctx_t *)ctx;
+
+  if (!(ctxp->screen))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (r = 0; r < ctxp->screen->rows; r ++)
+  {
+    len = pdip_screen_line(ctxp->screen, r);
+
+    // Room for the newline and the terminating NUL
+    if (0 != pdip_display_enlarge(ctxp, display, display_sz, *data_sz + len + 2))
+    {
+      // Errno is set
+      return -1;
+    }
+
+    memcpy(*display + *data_sz, ctxp->screen->line, len);
+    *data_sz += len;
+    (*display)[(*data_sz) ++] = '\n';
+  } // End for
+
+  (*display)[*data_sz] = '\0';
+
+  return 0;
+} // pdip_screen_get_unlocked
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_screen_get
+// Usage  : pdip_screen_get_unlocked() under the reception lock of the object
+// Return : cf. pdip_screen_get_unlocked()
+// ----------------------------------------------------------------------------
+int pdip_screen_get(
+                    pdip_t    ctx,
+                    char    **display,
+                    size_t   *display_sz,
+                    size_t   *data_sz
+                   )
+{
+int rc;
+
+  PDIP_OBJ_LOCK(ctx, recv_mtx);
+  rc = pdip_screen_get_unlocked(ctx, display, display_sz, data_sz);
+  PDIP_OBJ_UNLOCK(ctx, recv_mtx);
+
+  return rc;
+} // pdip_screen_get
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_send_check
+// Usage  : Check that data can be sent to the controlled process
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_send_check(pdip_ctx_t *ctxp)
+{
+int state;
+
+  // Mutual exclusion with the signal handler
+  PDIP_MASK_SIG();
+  state = PDIP_STATE_GET(ctxp);
+  PDIP_UNMASK_SIG();
+
+  if (PDIP_STATE_ALIVE != state)
+  {
+    PDIP_ERR(ctxp, "Controlled process is not alive\n");
+    errno = EPERM;
+    return -1;
+  }
+
+  return 0;
+} // pdip_send_check
+
+
+// ----------------------------------------------------------------------------
+// Name   : PDIP_SEND_BUF_SZ
+// Usage  : Size of the stack buffer to format the strings in pdip_send().
+//          The longer strings are formatted in a dynamic buffer
+// ----------------------------------------------------------------------------
+#define PDIP_SEND_BUF_SZ  4096
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_send
+// Usage  : Send a formated string to the controlled process
+// Return : Amount of sent data, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_send(
+              pdip_t      ctx,
+              const char *format,
+              ...
+             )
+{
+pdip_ctx_t *ctxp;
+int         rc;
+char        str[PDIP_SEND_BUF_SZ];
+char       *p;
+va_list     ap;
+int         err_sav;
+
+  if (!ctx || !format)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ctxp = (pdip_ctx_t *)ctx;
+
+  if (0 != pdip_send_check(ctxp))
+  {
+    // Errno is set
+    return -1;
+  }
+
+  // Without conversion specification, there is nothing to format
+  if (!strchr(format, '%'))
+  {
+    PDIP_DBG(ctxp, 2, "Sending '%s'\n", format);
+
+    return pdip_write(ctxp, format, strlen(format));
+  }
+
+  va_start(ap, format);
+  rc = vsnprintf(str, sizeof(str), format, ap);
+  va_end(ap);
+
+  if (rc < 0)
+  {
+    // errno is set
+    return -1;
+  }
+
+  p = str;
+
+  // The string is too long for the stack buffer
+  if ((size_t)rc >= sizeof(str))
+  {
+    p = (char *)malloc(rc + 1);
+    if (!p)
+    {
+      err_sav = errno;
+      PDIP_ERR(ctxp, "malloc(%d): '%m' (%d)\n", rc + 1, errno);
+      errno = err_sav;
+      return -1;
+    }
+
+    va_start(ap, format);
+    rc = vsnprintf(p, rc + 1, format, ap);
+    va_end(ap);
+  }
+
+  PDIP_DBG(ctxp, 2, "Sending %d bytes: '%s'\n", rc, p);
+
+  rc = pdip_write(ctxp, p, rc);
+
+  // In case of error, errno is set
+
+  if (p != str)
+  {
+    err_sav = errno;
+    free(p);
+    errno = err_sav;
+  }
+
+  return rc;
+} // pdip_send
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_send_raw
+// Usage  : Send a buffer as is to the controlled process
+// Return : Amount of sent data, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_send_raw(
+                  pdip_t      ctx,
+                  const void *buf,
+                  size_t      len
+                 )
+{
+pdip_ctx_t *ctxp;
+
+  if (!ctx || (!buf && len) || (len > INT_MAX))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ctxp = (pdip_ctx_t *)ctx;
+
+  if (0 != pdip_send_check(ctxp))
+  {
+    // Errno is set
+    return -1;
+  }
+
+  PDIP_DUMP(ctxp, 2, "Sending %"PRISIZE" bytes:\n", (const char *)buf, len, len);
+
+  // In case of error, errno is set
+  return pdip_write(ctxp, (const char *)buf, len);
+} // pdip_send_raw
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_sendv
+// Usage  : Send the data of 'iovcnt' buffers as is to the controlled process
+// Return : Amount of sent data, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_sendv(
+               pdip_t              ctx,
+               const struct iovec *iov,
+               int                 iovcnt
+              )
+{
+pdip_ctx_t *ctxp;
+size_t      len;
+int         i;
+
+  if (!ctx || (iovcnt < 0) || (!iov && iovcnt))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  len = 0;
+  for (i = 0; i < iovcnt; i ++)
+  {
+    if ((!(iov[i].iov_base) && iov[i].iov_len) ||
+        (iov[i].iov_len > (INT_MAX - len)))
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+    len += iov[i].iov_len;
+  } // End for
+
+  ctxp = (pdip_ctx_t *)ctx;
+
+  if (0 != pdip_send_check(ctxp))
+  {
+    // Errno is set
+    return -1;
+  }
+
+  PDIP_DBG(ctxp, 2, "Sending %"PRISIZE" bytes from %d buffers\n", len, iovcnt);
+
+  // In case of error, errno is set
+  return pdip_writev(ctxp, iov, iovcnt);
+} // pdip_sendv
+
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_display_term_settings
+// Usage  : Display the terminal settings
+// ----------------------------------------------------------------------------
+static void pdip_display_term_settings(
+                                       const char     *side,
+                                       struct termios *term_settings
+                                      )
+{
+  fprintf(stderr, "PTY settings on %s side:\n"
+                  "\tInput modes: %s %s %s %s %s %s %s %s %s %s %s %s %s %s %s\n"
+                  "\tOutput modes: %s %s %s %s %s %s %s %s %s %s %s %s %s %s\n"
+                  "\tLocal modes: %s %s %s %s %s %s %s %s %s %s %s %s %s %s %s\n"
+                ,
+          side,
+	  term_settings->c_iflag & IGNBRK ? "IGNBRK" : ".",
+	  term_settings->c_iflag & BRKINT ? "BRKINT" : ".",
+	  term_settings->c_iflag & IGNPAR ? "IGNPAR" : ".",
+	  term_settings->c_iflag & PARMRK ? "PARMRK" : ".",
+	  term_settings->c_iflag & INPCK ? "INPCK" : ".",
+	  term_settings->c_iflag & ISTRIP ? "ISTRIP" : ".",
+	  term_settings->c_iflag & INLCR ? "INLCR" : ".",
+	  term_settings->c_iflag & IGNCR ? "IGNCR" : ".",
+	  term_settings->c_iflag & ICRNL ? "ICRNL" : ".",
+	  term_settings->c_iflag & IUCLC ? "IUCLC" : ".",
+	  term_settings->c_iflag & IXON ? "IXON" : ".",
+	  term_settings->c_iflag & IXANY ? "IXANY" : ".",
+	  term_settings->c_iflag & IXOFF  ? "IXOFF" : ".",
+	  term_settings->c_iflag & IMAXBEL ? "IMAXBEL" : ".",
+	  term_settings->c_iflag & IUTF8 ? "IUTF8" : ".",
+	  term_settings->c_oflag & OPOST  ? "OPOST" : ".",
+	  term_settings->c_oflag & OLCUC ? "OLCUC" : ".",
+	  term_settings->c_oflag & ONLCR ? "ONLCR" : ".",
+	  term_settings->c_oflag & OCRNL ? "OCRNL" : ".",
+	  term_settings->c_oflag & ONOCR ? "ONOCR" : ".",
+	  term_settings->c_oflag & ONLRET ? "ONLRET" : ".",
+	  term_settings->c_oflag & OFILL ? "OFILL" : ".",
+	  term_settings->c_oflag & OFDEL ? "OFDEL" : ".",
+	  term_settings->c_oflag & NLDLY ? "NLDLY" : ".",
+	  term_settings->c_oflag & CRDLY ? "CRDLY" : ".",
+	  term_settings->c_oflag & TABDLY ? "TABDLY" : ".",
+	  term_settings->c_oflag & BSDLY ? "BSDLY" : ".",
+	  term_settings->c_oflag & VTDLY ? "VTDLY" : ".",
+	  term_settings->c_oflag & FFDLY ? "FFDLY" : ".",
+	  term_settings->c_lflag & ISIG ? "ISIG" : ".",
+	  term_settings->c_lflag & ICANON ? "ICANON" : ".",
+	  term_settings->c_lflag & XCASE ? "XCASE" : ".",
+	  term_settings->c_lflag & ECHO ? "ECHO" : ".",
+	  term_settings->c_lflag & ECHOE ? "ECHOE" : ".",
+	  term_settings->c_lflag & ECHOK ? "ECHOK" : ".",
+	  term_settings->c_lflag & ECHONL ? "ECHONL" : ".",
+	  term_settings->c_lflag & ECHOCTL ? "ECHOCTL" : ".",
+	  term_settings->c_lflag & ECHOPRT ? "ECHOPRT" : ".",
+	  term_settings->c_lflag & ECHOKE ? "ECHOKE" : ".",
+	  term_settings->c_lflag & FLUSHO ? "FLUSHO" : ".",
+	  term_settings->c_lflag & NOFLSH ? "NOFLSH" : ".",
+	  term_settings->c_lflag & TOSTOP ? "TOSTOP" : ".",
+	  term_settings->c_lflag & PENDIN ? "PENDIN" : ".",
+	  term_settings->c_lflag & IEXTEN ? "IEXTEN" : "."
+         );
+} // pdip_display_term_settings
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : PDIP_PID_TAB_MIN_SZ
+// Usage  : Minimum number of slots of the table of the controlled processes
+// ----------------------------------------------------------------------------
+#define PDIP_PID_TAB_MIN_SZ  64
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pid_hash
+// Usage  : Index of the first slot to probe for a pid (multiplicative hash)
+// Return : Index
+// ----------------------------------------------------------------------------
+static unsigned int pdip_pid_hash(
+                                  pid_t        pid,
+                                  unsigned int sz
+                                 )
+{
+  return ((unsigned int)pid * 2654435761U) & (sz - 1);
+} // pdip_pid_hash
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pid_quiesce
+// Usage  : Wait until no signal handler is looking into the table of the
+//          controlled processes (the caller must mask the signals)
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_pid_quiesce(void)
+{
+  while (__atomic_load_n(&pdip_sig_active, __ATOMIC_SEQ_CST))
+  {
+    (void)sched_yield();
+  } // End while
+} // pdip_pid_quiesce
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pid_lookup
+// Usage  : Look for the object controlling a process. This is called without
+//          lock from the signal handler
+// Return : Object, if found
+//          NULL, if not found
+// ----------------------------------------------------------------------------
+static pdip_ctx_t *pdip_pid_lookup(pid_t pid)
+{
+pdip_pid_tab_t *tab;
+unsigned int    i, n;
+pid_t           slot_pid;
+
+  tab = __atomic_load_n(&pdip_pid_tab, __ATOMIC_SEQ_CST);
+  if (!tab || (pid <= 0))
+  {
+    return (pdip_ctx_t *)0;
+  }
+
+  i = pdip_pid_hash(pid, tab->sz);
+  for (n = 0; n < tab->sz; n ++)
+  {
+    slot_pid = __atomic_load_n(&(tab->slots[i].pid), __ATOMIC_SEQ_CST);
+    if (pid == slot_pid)
+    {
+      return tab->slots[i].ctxp;
+    }
+
+    if (PDIP_PID_FREE == slot_pid)
+    {
+      break;
+    }
+
+    i = (i + 1) & (tab->sz - 1);
+  } // End for
+
+  return (pdip_ctx_t *)0;
+} // pdip_pid_lookup
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pid_resize
+// Usage  : Allocate a table of the controlled processes for 'nb' processes
+//          (without deleted slots) and make it replace the current one
+//          (called with the global mutex locked and the signals masked)
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_pid_resize(unsigned int nb)
+{
+pdip_pid_tab_t *tab, *old;
+unsigned int    sz, i, j;
+int             err_sav;
+
+  // Load factor of at most 1/2 after the resizing
+  sz = PDIP_PID_TAB_MIN_SZ;
+  while (sz < (2 * nb))
+  {
+    sz *= 2;
+  } // End while
+
+  tab = (pdip_pid_tab_t *)malloc(sizeof(pdip_pid_tab_t));
+  if (!tab)
+  {
+    err_sav = errno;
+    PDIP_ERR(0, "malloc(%"PRISIZE"): '%m' (%d)\n", sizeof(pdip_pid_tab_t), errno);
+    errno = err_sav;
+    return -1;
+  }
+
+  tab->slots = (pdip_pid_slot_t *)calloc(sz, sizeof(pdip_pid_slot_t));
+  if (!(tab->slots))
+  {
+    err_sav = errno;
+    PDIP_ERR(0, "calloc(%u): '%m' (%d)\n", sz, errno);
+    free(tab);
+    errno = err_sav;
+    return -1;
+  }
+
+  tab->sz   = sz;
+  tab->nb   = 0;
+  tab->used = 0;
+
+  // Copy the processes
+  old = pdip_pid_tab;
+  if (old)
+  {
+    for (i = 0; i < old->sz; i ++)
+    {
+      if (old->slots[i].pid > 0)
+      {
+        j = pdip_pid_hash(old->slots[i].pid, sz);
+        while (PDIP_PID_FREE != tab->slots[j].pid)
+        {
+          j = (j + 1) & (sz - 1);
+        } // End while
+
+        tab->slots[j] = old->slots[i];
+        tab->nb ++;
+        tab->used ++;
+      }
+    } // End for
+  }
+
+  // Publish the new table and free the old one once the signal handlers
+  // running on the other CPUs stopped looking into it
+  __atomic_store_n(&pdip_pid_tab, tab, __ATOMIC_SEQ_CST);
+  if (old)
+  {
+    pdip_pid_quiesce();
+    free(old->slots);
+    free(old);
+  }
+
+  return 0;
+} // pdip_pid_resize
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pid_reserve
+// Usage  : Make room for one more process in the table of the controlled
+//          processes (called with the global mutex locked and the signals
+//          masked)
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_pid_reserve(void)
+{
+pdip_pid_tab_t *tab = pdip_pid_tab;
+
+  // Load factor (processes and deleted slots) of at most 3/4
+  if (!tab || (4 * (tab->used + 1) > 3 * tab->sz))
+  {
+    return pdip_pid_resize(tab ? (tab->nb + 1) : 1);
+  }
+
+  return 0;
+} // pdip_pid_reserve
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pid_insert
+// Usage  : Register a controlled process in the table (called with the
+//          global mutex locked and the signals masked after a successful
+//          call to pdip_pid_reserve())
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_pid_insert(pdip_ctx_t *ctxp)
+{
+pdip_pid_tab_t *tab;
+unsigned int    i;
+
+  // Another thread may have consumed the room reserved before the fork():
+  // a failure of the resizing only matters if the table is full (at least
+  // one free slot is kept to stop the lookups)
+  (void)pdip_pid_reserve();
+  tab = pdip_pid_tab;
+  if (!tab || (tab->used + 1 >= tab->sz))
+  {
+    PDIP_ERR(ctxp, "No room to register process %"PRIPID" for the signal handler\n", ctxp->pid);
+    return;
+  }
+
+  i = pdip_pid_hash(ctxp->pid, tab->sz);
+  while (tab->slots[i].pid > 0)
+  {
+    i = (i + 1) & (tab->sz - 1);
+  } // End while
+
+  if (PDIP_PID_FREE == tab->slots[i].pid)
+  {
+    tab->used ++;
+  }
+  tab->nb ++;
+
+  // The object is set before the pid which makes the slot visible
+  tab->slots[i].ctxp = ctxp;
+  __atomic_store_n(&(tab->slots[i].pid), ctxp->pid, __ATOMIC_SEQ_CST);
+} // pdip_pid_insert
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pid_remove
+// Usage  : Unregister a controlled process from the table and wait until
+//          the signal handlers running on the other CPUs stopped using its
+//          object (called with the signals masked)
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_pid_remove(pdip_ctx_t *ctxp)
+{
+pdip_pid_tab_t *tab;
+unsigned int    i, n;
+
+  if (ctxp->pid <= 0)
+  {
+    return;
+  }
+
+  PDIP_LOCK();
+
+  tab = pdip_pid_tab;
+  if (tab)
+  {
+    i = pdip_pid_hash(ctxp->pid, tab->sz);
+    for (n = 0; n < tab->sz; n ++)
+    {
+      if (PDIP_PID_FREE == tab->slots[i].pid)
+      {
+        break;
+      }
+
+      if ((ctxp->pid == tab->slots[i].pid) && (ctxp == tab->slots[i].ctxp))
+      {
+        // The slot stays used to keep the probing sequences of the other
+        // processes
+        __atomic_store_n(&(tab->slots[i].pid), PDIP_PID_DELETED, __ATOMIC_SEQ_CST);
+        tab->nb --;
+        break;
+      }
+
+      i = (i + 1) & (tab->sz - 1);
+    } // End for
+  }
+
+  PDIP_UNLOCK();
+
+  pdip_pid_quiesce();
+} // pdip_pid_remove
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_init_ctx
+// Usage  : Initialize the fields of an object
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_init_ctx(
+                          pdip_ctx_t *ctxp
+                         )
+{
+  ctxp->av                      = (char **)0;
+  ctxp->ac                      = 0;
+  ctxp->pty_master              = -1;
+  ctxp->pidfd                   = -1;
+  ctxp->debug                   = 0;
+  ctxp->pid                     = -1;
+  ctxp->status                  = 0;
+  PDIP_STATE_SET(ctxp, PDIP_STATE_INIT);
+  ctxp->outstanding_buf         = (char *)0;
+  ctxp->outstanding_buf_sz      = 0;
+  ctxp->outstanding_data        = (char *)0;
+  ctxp->outstanding_data_offset = 0;
+  ctxp->outstanding_scan_offset = 0;
+  ctxp->outstanding_scan_id     = 0;
+  ctxp->filt_buf                = (char *)0;
+  ctxp->filt_buf_sz             = 0;
+  ctxp->filt_len                = 0;
+  ctxp->filt_raw                = 0;
+  ctxp->filt_gaps               = (pdip_filt_gap_t *)0;
+  ctxp->filt_gaps_nb            = 0;
+  ctxp->filt_gaps_sz            = 0;
+  ctxp->dbg_output              = stderr;
+  ctxp->err_output              = stderr;
+  ctxp->flags                   = 0;
+  ctxp->spawn                   = PDIP_SPAWN_FORK;
+  ctxp->cpu                     = (unsigned char *)0;
+  ctxp->buf_resize_increment    = PDIP_RESIZE_INCREMENT;
+  ctxp->buf_growth              = PDIP_BUF_GROWTH_GEOMETRIC;
+  ctxp->buf_growth_factor       = PDIP_GROWTH_FACTOR;
+  ctxp->buf_max_sz              = 0;
+  ctxp->buf_overflow            = PDIP_BUF_OVERFLOW_ERROR;
+  ctxp->buf_lookback            = 0;
+  ctxp->spill_fd                = -1;
+  ctxp->regex_cache             = (pdip_pat_t **)0;
+  ctxp->regex_cache_sz          = PDIP_REGEX_CACHE_SZ;
+  ctxp->regex_cache_nb          = 0;
+  ctxp->regex_cache_hits        = 0;
+  ctxp->regex_cache_misses      = 0;
+  ctxp->match_alt               = 0;
+  ctxp->match_start             = 0;
+  ctxp->view                    = 0;
+  ctxp->view_data               = (const char *)0;
+  ctxp->view_consume            = 0;
+  ctxp->view_buf                = (char *)0;
+  ctxp->view_buf_sz             = 0;
+  memset(&(ctxp->stats), 0, sizeof(ctxp->stats));
+  ctxp->send_ns                 = 0;
+  ctxp->loop_entry              = (pdip_loop_entry_t *)0;
+  ctxp->on_output               = (pdip_output_cb_t)0;
+  ctxp->on_output_user          = (void *)0;
+  ctxp->rec                     = (pdip_rec_t *)0;
+  ctxp->screen                  = (pdip_screen_t *)0;
+  ctxp->output_line             = (char *)0;
+  ctxp->output_line_sz          = 0;
+  ctxp->output_line_len         = 0;
+
+  // Don't touch prev & next pointers
+} // pdip_init_ctx
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_free_resources
+// Usage  : Free the resources of a context
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_free_resources(pdip_ctx_t *ctxp)
+{
+pdip_rec_t   *rec;
+pdip_stats_t  stats;
+
+  // For debug purposes, we reset the fields in
+  // case the user would reuse them after deallocation
+
+  if (ctxp->av)
+  {
+  unsigned int i;
+
+    for (i = 0; i < (unsigned)(ctxp->ac); i++)
+    {
+      // In case the allocation failed
+      if (ctxp->av[i])
+      {
+        free(ctxp->av[i]);
+      }
+    } // End for
+
+    free(ctxp->av);
+  } // End if
+
+  if (ctxp->pty_master >= 0)
+  {
+    (void)close(ctxp->pty_master);
+  }
+
+  if (ctxp->pidfd >= 0)
+  {
+    (void)close(ctxp->pidfd);
+  }
+
+  if (ctxp->spill_fd >= 0)
+  {
+    (void)close(ctxp->spill_fd);
+  }
+
+  if (ctxp->outstanding_buf)
+  {
+    free(ctxp->outstanding_buf);
+  }
+
+  free(ctxp->filt_buf);
+  free(ctxp->filt_gaps);
+
+  pdip_screen_free(ctxp->screen);
+
+  if (ctxp->view_buf)
+  {
+    free(ctxp->view_buf);
+  }
+
+  if (ctxp->output_line)
+  {
+    free(ctxp->output_line);
+  }
+
+  if (ctxp->cpu)
+  {
+    (void)pdip_cpu_free(ctxp->cpu);
+  }
+
+  if (ctxp->regex_cache)
+  {
+  unsigned int i;
+
+    for (i = 0; i < ctxp->regex_cache_nb; i ++)
+    {
+      pdip_pat_free(ctxp->regex_cache[i]);
+      free(ctxp->regex_cache[i]);
+    } // End for
+
+    free(ctxp->regex_cache);
+  }
+
+  // The recording and the counters go on with the next program (the
+  // recording is stopped by pdip_delete())
+  rec = ctxp->rec;
+  stats = ctxp->stats;
+
+  pdip_init_ctx(ctxp);
+
+  ctxp->rec = rec;
+  ctxp->stats = stats;
+
+  // If linked, the context is not unlinked
+  // So, we don't touch ctxp->prev & ctxp->next
+} // pdip_free_resources
+
+
+
+
+
+
+
+#define PDIP_NB_BYTES_FOR_CPU() ((pdip_nb_cpu + 0x7) >> 3)
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_cpu_nb
+// Usage  : Return the number of CPUs
+// Return : Number of CPUs
+// ----------------------------------------------------------------------------
+unsigned int pdip_cpu_nb(void)
+{
+  return pdip_nb_cpu;
+} // pdip_cpu_nb
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_cpu_alloc
+// Usage  : Allocate a bitmap of CPUs
+// Return : bitmap, if OK
+//          0, if error (errno is set)
+// ----------------------------------------------------------------------------
+unsigned char *pdip_cpu_alloc(void)
+{
+unsigned char *cpu = (unsigned char *)malloc(PDIP_NB_BYTES_FOR_CPU() * sizeof(unsigned char *));
+
+  if (cpu)
+  {
+    memset(cpu, 0, PDIP_NB_BYTES_FOR_CPU());
+
+    // By default, we don't set any CPU in the bitmap: the system's defaults will
+    // apply
+  }
+
+  return cpu;
+
+} // pdip_cpu_alloc
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_cpu_free
+// Usage  : Free a bitmap of CPUs
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_cpu_free(unsigned char *cpu)
+{
+  if (cpu)
+  {
+    free(cpu);
+    return 0;
+  }
+
+  errno = EINVAL;
+  return -1;
+} // pdip_cpu_free
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_cpu_zero
+// Usage  : Reset a bitmap of CPUs
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_cpu_zero(unsigned char *cpu)
+{
+  if (!cpu)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memset(cpu, 0, PDIP_NB_BYTES_FOR_CPU());
+
+  return 0;
+
+} // pdip_cpu_zero
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_cpu_all
+// Usage  : Set all the bits in a bitmap of CPUs
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_cpu_all(unsigned char *cpu)
+{
+  if (!cpu)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memset(cpu, 0xFF, PDIP_NB_BYTES_FOR_CPU());
+
+  return 0;
+
+} // pdip_cpu_all
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_cpu_set
+// Usage  : Set the CPU number n in the bitmap
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_cpu_set(
+                  unsigned char *cpu,
+                  unsigned int   n
+                 )
+{
+  if (n >= pdip_nb_cpu)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  cpu[n >> 3] |=  (1 << (n & 0x7));
+
+  return 0;
+} // pdip_cpu_set
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_cpu_unset
+// Usage  : Unset the CPU number n in the bitmap
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_cpu_unset(
+                   unsigned char *cpu,
+                   unsigned int   n
+                  )
+{
+  if (n >= pdip_nb_cpu)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  cpu[n >> 3] &=  ~(1 << (n & 0x7));
+
+  return 0;
+} // pdip_cpu_unset
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_cpu_isset
+// Usage  : Check if the CPU number n is set in the bitmap
+// Return : 1, if CPU number is set
+//          0, if CPU number is not set
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_cpu_isset(
+                   unsigned char *cpu,
+                   unsigned int   n
+                  )
+{
+  if (n >= pdip_nb_cpu)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (cpu[n >> 3] & (1 << (n & 0x7)))
+  {
+    return 1;
+  }
+
+  return 0;
+} // pdip_cpu_isset
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_cpu_dup
+// Usage  : Duplicate a bitmap of CPUs
+// Return : bitmap, if OK
+//          0, if error (errno is set)
+// ----------------------------------------------------------------------------
+unsigned char *pdip_cpu_dup(unsigned char *cpu_src)
+{
+unsigned char *cpu;
+
+  if (!cpu_src)
+  {
+    errno = EINVAL;
+    return 0;
+  }
+
+  cpu = (unsigned char *)malloc(PDIP_NB_BYTES_FOR_CPU() * sizeof(unsigned char *));
+
+  if (cpu)
+  {
+  unsigned int i;
+
+    for (i = 0; i < PDIP_NB_BYTES_FOR_CPU(); i ++)
+    {
+      cpu[i] = cpu_src[i];
+    } // End for
+  }
+
+  return cpu;
+
+} // pdip_cpu_dup
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_get_user_cfg
+// Usage  : Get the user configurable fields from the object descriptor
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_get_user_cfg(
+                              pdip_ctx_t     *ctxp,
+                              pdip_cfg_t     *cfg
+                             )
+{
+  cfg->dbg_output           = ctxp->dbg_output;
+  cfg->err_output           = ctxp->err_output;
+  cfg->debug_level          = ctxp->debug;
+  cfg->flags                = ctxp->flags;
+  cfg->cpu                  = ctxp->cpu;
+  cfg->buf_resize_increment = ctxp->buf_resize_increment;
+  cfg->buf_growth           = ctxp->buf_growth;
+  cfg->buf_growth_factor    = ctxp->buf_growth_factor;
+  cfg->buf_max_sz           = ctxp->buf_max_sz;
+  cfg->buf_overflow         = ctxp->buf_overflow;
+  cfg->buf_lookback         = ctxp->buf_lookback;
+  cfg->regex_cache_sz       = ctxp->regex_cache_sz;
+  cfg->on_output            = ctxp->on_output;
+  cfg->on_output_user       = ctxp->on_output_user;
+  cfg->spawn                = ctxp->spawn;
+  cfg->record               = (ctxp->rec ? ctxp->rec->path : (const char *)0);
+  cfg->screen_rows          = (ctxp->screen ? ctxp->screen->rows : 0);
+  cfg->screen_cols          = (ctxp->screen ? ctxp->screen->cols : 0);
+} // pdip_get_user_cfg
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_set_user_cfg
+// Usage  : Set the user configurable fields in the object descriptor
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_set_user_cfg(
+                              pdip_ctx_t     *ctxp,
+                              pdip_cfg_t     *cfg
+                            )
+{
+  // Check the parameters before any allocation
+  if ((cfg->buf_growth != PDIP_BUF_GROWTH_GEOMETRIC) &&
+      (cfg->buf_growth != PDIP_BUF_GROWTH_LINEAR))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if ((cfg->spawn != PDIP_SPAWN_FORK) &&
+      (cfg->spawn != PDIP_SPAWN_VFORK))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // The oldest data can only be removed from a bounded buffer and the
+  // kept data must leave room for the new ones
+  if ((cfg->buf_overflow > PDIP_BUF_OVERFLOW_SPILL) ||
+      ((cfg->buf_overflow >= PDIP_BUF_OVERFLOW_DISCARD) && !(cfg->buf_max_sz)) ||
+      (cfg->buf_max_sz && (cfg->buf_lookback >= cfg->buf_max_sz)))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // The dimensions of the virtual screen are set together and must fit
+  // into the window size of the PTY
+  if ((!(cfg->screen_rows) != !(cfg->screen_cols)) ||
+      (cfg->screen_rows > USHRT_MAX) || (cfg->screen_cols > USHRT_MAX))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // There must be room for at least one read
+  if (cfg->buf_max_sz &&
+      (cfg->buf_max_sz <= (cfg->buf_resize_increment > 1 ? cfg->buf_resize_increment : ctxp->buf_resize_increment)))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (cfg->dbg_output)
+  {
+    ctxp->dbg_output = cfg->dbg_output;
+  }
+
+  if (cfg->err_output)
+  {
+    ctxp->err_output = cfg->err_output;
+  }
+
+  ctxp->debug = cfg->debug_level;
+
+  ctxp->flags = cfg->flags;
+
+  ctxp->spawn = cfg->spawn;
+
+  if (cfg->cpu)
+  {
+  unsigned int i;
+
+    // Duplicate the array to make sure that the user will not free
+    // it after this call
+    ctxp->cpu = pdip_cpu_alloc();
+    if (!(ctxp->cpu))
+    {
+    int err_sav;
+
+      err_sav = errno;
+      PDIP_ERR(0, "malloc(%"PRISIZE"): '%m' (%d)\n", PDIP_NB_BYTES_FOR_CPU() * sizeof(unsigned char *), errno);
+      errno = err_sav;
+      return -1;
+    }
+
+    for (i = 0; i < PDIP_NB_BYTES_FOR_CPU(); i ++)
+    {
+      ctxp->cpu[i] = cfg->cpu[i];
+    } // End for
+  } // End if affinity
+
+  // At least one slot for the terminating NUL
+  if (cfg->buf_resize_increment > 1)
+  {
+    ctxp->buf_resize_increment = cfg->buf_resize_increment;
+  }
+
+  ctxp->buf_growth = cfg->buf_growth;
+
+  // The buffers must grow
+  if (cfg->buf_growth_factor > 1)
+  {
+    ctxp->buf_growth_factor = cfg->buf_growth_factor;
+  }
+
+  ctxp->buf_max_sz = cfg->buf_max_sz;
+
+  ctxp->buf_overflow = cfg->buf_overflow;
+  ctxp->buf_lookback = cfg->buf_lookback;
+
+  if (cfg->regex_cache_sz)
+  {
+    ctxp->regex_cache_sz = cfg->regex_cache_sz;
+  }
+
+  ctxp->on_output      = cfg->on_output;
+  ctxp->on_output_user = cfg->on_output_user;
+
+  if (cfg->screen_rows)
+  {
+    ctxp->screen = pdip_screen_new(cfg->screen_rows, cfg->screen_cols);
+    if (!(ctxp->screen))
+    {
+    int err_sav;
+
+      err_sav = errno;
+      PDIP_ERR(ctxp, "malloc(%ux%u screen): '%m' (%d)\n", cfg->screen_rows, cfg->screen_cols, errno);
+      errno = err_sav;
+      return -1;
+    }
+  }
+
+  // The recording is started last as it is kept across the executions
+  if (cfg->record && !(ctxp->rec))
+  {
+    if (0 != pdip_rec_open(ctxp, cfg->record))
+    {
+      // errno is set
+      return -1;
+    }
+  }
+
+  return 0;
+} // pdip_set_user_cfg
+
+
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pty_close
+// Usage  : Close the sides of a PTY
+// ----------------------------------------------------------------------------
+static void pdip_pty_close(
+                           pdip_pty_t *pty
+                          )
+{
+  if (pty->slave >= 0)
+  {
+    (void)close(pty->slave);
+    pty->slave = -1;
+  }
+
+  if (pty->master >= 0)
+  {
+    (void)close(pty->master);
+    pty->master = -1;
+  }
+} // pdip_pty_close
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pty_open
+// Usage  : Open a PTY configured for the controlled processes
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_pty_open(
+                         pdip_ctx_t *ctxp,
+                         pdip_pty_t *pty
+                        )
+{
+int             err_sav;
+int             rc;
+char            pty_slave_name[PATH_MAX];
+struct termios  term_settings;
+
+  pty->slave = -1;
+
+  // Get a master pty
+  //
+  // posix_openpt() opens a pseudo-terminal master and returns its file
+  // descriptor.
+  // It is equivalent to open("/dev/ptmx",O_RDWR|O_NOCTTY) on Linux systems :
+  //
+  //       . O_RDWR Open the device for both reading and writing
+  //       . O_NOCTTY Do not make this device the controlling terminal for the process
+  //       . O_CLOEXEC Do not leak it into the processes launched concurrently
+  //         by other threads
+  pty->master = posix_openpt(O_RDWR |O_NOCTTY | O_CLOEXEC);
+  if (pty->master < 0)
+  {
+    err_sav = errno;
+    PDIP_ERR(ctxp, "Impossible to get a master pseudo-terminal - errno = '%m' (%d)\n", errno);
+    goto error;
+  }
+
+  // Grant access to the slave pseudo-terminal
+  // (Chown the slave to the calling user)
+  if (0 != grantpt(pty->master))
+  {
+    err_sav = errno;
+    PDIP_ERR(ctxp, "Impossible to grant access to slave pseudo-terminal - errno = '%m' (%d)\n", errno);
+    goto error;
+  }
+
+  // Unlock pseudo-terminal master/slave pair
+  // (Release an internal lock so the slave can be opened)
+  if (0 != unlockpt(pty->master))
+  {
+    err_sav = errno;
+    PDIP_ERR(ctxp, "Impossible to unlock pseudo-terminal master/slave pair - errno = '%m' (%d)\n", errno);
+    goto error;
+  }
+
+  // Get the name of the slave pty (reentrant version as several threads
+  // may run pdip_exec() concurrently)
+  rc = ptsname_r(pty->master, pty_slave_name, sizeof(pty_slave_name));
+  if (0 != rc)
+  {
+    err_sav = rc;
+    errno = rc;
+    PDIP_ERR(ctxp, "Impossible to get the name of the slave pseudo-terminal - errno = '%m' (%d)\n", errno);
+    goto error;
+  }
+
+  // Open the slave part of the terminal (close on exec to avoid leaking it
+  // into the processes launched concurrently by other threads). It becomes
+  // the controlling terminal of the child with TIOCSCTTY only
+  pty->slave = open(pty_slave_name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if (pty->slave < 0)
+  {
+    err_sav = errno;
+    PDIP_ERR(ctxp, "Impossible to open the slave pseudo-terminal - errno = '%m' (%d)\n", errno);
+    goto error;
+  }
+
+  // To make "$" wildcard work, the end of lines must be Linux compatible (i.e. LF
+  // instead of CR/LF). So, we disable mapping of LF to CR/LF on slave side.
+  // We do it on master side (this impacts the whole PTY slave and master side) to
+  // make sure that the user acting on master side will begin its interactions
+  // after this configuration. If we do it on slave side, the user may send data
+  // before the child configures the terminal
+  rc = tcgetattr(pty->master, &term_settings);
+  if (rc != 0)
+  {
+    err_sav = errno;
+    PDIP_ERR(ctxp, "tcgetattr(): '%m' (%d)\n", errno);
+    goto error;
+  }
+  if ((ctxp ? ctxp->debug : pdip_debug_level) >= 20)
+  {
+    pdip_display_term_settings("master", &term_settings);
+  }
+
+  term_settings.c_oflag &= ~ONLCR;
+  rc = tcsetattr(pty->master, TCSANOW, &term_settings);
+  if (rc != 0)
+  {
+    err_sav = errno;
+    PDIP_ERR(ctxp, "tcsetattr(): '%m' (%d)\n", errno);
+    goto error;
+  }
+
+  return 0;
+
+error:
+
+  pdip_pty_close(pty);
+
+  errno = err_sav;
+
+  return -1;
+} // pdip_pty_open
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pty_pool_thread
+// Usage  : Background thread refilling the pool of PTY
+// Return : NULL
+// ----------------------------------------------------------------------------
+static void *pdip_pty_pool_thread(
+                                  void *arg
+                                 )
+{
+pdip_pty_t pty;
+int        rc;
+
+  (void)arg;
+
+  pthread_mutex_lock(&pdip_pty_pool_mtx);
+
+  while (!pdip_pty_pool_stop)
+  {
+    // Wait for room in the pool
+    if (pdip_pty_pool_nb >= pdip_pty_pool_sz)
+    {
+      (void)pthread_cond_wait(&pdip_pty_pool_cond, &pdip_pty_pool_mtx);
+      continue;
+    }
+
+    // The system calls are done without the mutex
+    pthread_mutex_unlock(&pdip_pty_pool_mtx);
+    rc = pdip_pty_open((pdip_ctx_t *)0, &pty);
+    pthread_mutex_lock(&pdip_pty_pool_mtx);
+
+    if (0 != rc)
+    {
+      // Retry upon the next drawing (pdip_exec() opens its PTY by itself
+      // in the meantime)
+      (void)pthread_cond_wait(&pdip_pty_pool_cond, &pdip_pty_pool_mtx);
+      continue;
+    }
+
+    // The pool may have been shrunk in the meantime
+    if (!pdip_pty_pool_stop && (pdip_pty_pool_nb < pdip_pty_pool_sz))
+    {
+      pdip_pty_pool[pdip_pty_pool_nb ++] = pty;
+    }
+    else
+    {
+      pdip_pty_close(&pty);
+    }
+  } // End while
+
+  pthread_mutex_unlock(&pdip_pty_pool_mtx);
+
+  return NULL;
+} // pdip_pty_pool_thread
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pty_get
+// Usage  : Draw a PTY from the pool or open it if the pool is empty
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static int pdip_pty_get(
+                        pdip_ctx_t *ctxp,
+                        pdip_pty_t *pty
+                       )
+{
+int found = 0;
+
+  pthread_mutex_lock(&pdip_pty_pool_mtx);
+  if (pdip_pty_pool_nb)
+  {
+    *pty = pdip_pty_pool[-- pdip_pty_pool_nb];
+    found = 1;
+  }
+
+  // Wake up the thread to refill the pool
+  if (pdip_pty_pool_sz)
+  {
+    (void)pthread_cond_signal(&pdip_pty_pool_cond);
+  }
+  pthread_mutex_unlock(&pdip_pty_pool_mtx);
+
+  if (found)
+  {
+    PDIP_DBG(ctxp, 1, "PTY drawn from the pool (master=%d, slave=%d)\n", pty->master, pty->slave);
+    return 0;
+  }
+
+  return pdip_pty_open(ctxp, pty);
+} // pdip_pty_get
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_exec_child
+// Usage  : Attach the child process to the slave side of the PTY and execute
+//          the controlled program. As the child may share the memory of the
+//          father (PDIP_SPAWN_VFORK), only system calls are used
+// Return : -1, if error ('err_step' and 'err' are set)
+// ----------------------------------------------------------------------------
+static int pdip_exec_child(
+                           pdip_spawn_t *sp
+                          )
+{
+int          rc;
+unsigned int i;
+
+  // Redirect input/outputs to the slave side of PTY
+  // (dup2() clears the close on exec flag)
+  if ((dup2(sp->fds, 0) < 0) ||
+      (dup2(sp->fds, 1) < 0) ||
+      ((sp->flags & PDIP_FLAG_ERR_REDIRECT) && (dup2(sp->fds, 2) < 0)))
+  {
+    sp->err_step = "dup2()";
+    goto error;
+  }
+
+  // Make some cleanups
+  close(sp->fds);
+  close(sp->pty_master);
+
+  // Make the child become a process session leader
+  rc = setsid();
+  if (rc < 0)
+  {
+    sp->err_step = "setsid()";
+    goto error;
+  }
+
+  // As the child is a session leader, set the controlling terminal to be the slave
+  // side of the PTY
+  rc = ioctl(0, TIOCSCTTY, 1);
+  if (rc < 0)
+  {
+    sp->err_step = "ioctl(TIOCSCTTY)";
+    goto error;
+  }
+
+  // Make the foreground process group on the terminal be the process id of the child
+  rc = tcsetpgrp(0, getpid());
+  if (rc < 0)
+  {
+    sp->err_step = "tcsetpgrp()";
+    goto error;
+  }
+
+  // Set the CPU affinity if requested
+  if (sp->cpu)
+  {
+  cpu_set_t mask;
+  int       one = 0;
+
+    CPU_ZERO(&mask);
+
+    for (i = 0; i < sp->nb_cpu; i ++)
+    {
+      if (sp->cpu[i >> 3] & (1 << (i & 0x7)))
+      {
+        one = 1;
+        CPU_SET(i, &mask);
+      } // End if CPU is set
+    } // End for
+
+    // If at least one bit is set otherwise we keep system defaults
+    if (one)
+    {
+      rc = sched_setaffinity(0, sizeof(cpu_set_t), &mask);
+      if (0 != rc)
+      {
+        sp->err_step = "sched_setaffinity()";
+        goto error;
+      }
+    }
+  } // End if affinity
+
+  (void)pthread_sigmask(SIG_SETMASK, &(sp->sigmask), 0);
+
+  // Exec the program
+  (void)execvp(sp->av[0], sp->av);
+
+  sp->err_step = "execvp()";
+
+error:
+
+  sp->err = errno;
+
+  return -1;
+} // pdip_exec_child
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_spawn_child
+// Usage  : Entry point of the child process with PDIP_SPAWN_VFORK
+// Return : None (the process exits upon error)
+// ----------------------------------------------------------------------------
+static int pdip_spawn_child(
+                            void *arg
+                           )
+{
+pdip_spawn_t     *sp = (pdip_spawn_t *)arg;
+struct sigaction  act;
+int               sig;
+
+  // The signals are blocked. The handlers of the father must not run
+  // in the shared memory: they are reset before unblocking the signals
+  for (sig = 1; sig < _NSIG; sig ++)
+  {
+    if ((0 == sigaction(sig, 0, &act)) &&
+        (SIG_IGN != act.sa_handler)    &&
+        (SIG_DFL != act.sa_handler))
+    {
+      act.sa_handler = SIG_DFL;
+      act.sa_flags   = 0;
+      sigemptyset(&(act.sa_mask));
+      (void)sigaction(sig, &act, 0);
+    }
+  } // End for
+
+  (void)pdip_exec_child(sp);
+
+  // The father displays the error
+  _exit(1);
+
+  return 1;
+} // pdip_spawn_child
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_spawn
+// Usage  : Create the child process with clone(CLONE_VM|CLONE_VFORK). The
+//          father is suspended until the child executes the program or exits
+//          while the page tables of the father are not copied
+// Return : pid of the child, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+static pid_t pdip_spawn(
+                        pdip_spawn_t *sp
+                       )
+{
+pid_t     pid;
+int       err_sav;
+size_t    stack_sz;
+char     *stack;
+sigset_t  sigall;
+
+  // execvp() may copy the parameters into the stack (scripts)
+  stack_sz = PDIP_SPAWN_STACK_SZ + ((sp->ac + 2) * sizeof(char *));
+  stack = (char *)mmap(0, stack_sz, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (MAP_FAILED == stack)
+  {
+    return -1;
+  }
+
+  // No signal handler must run in the child before the reset of the
+  // handlers (cf. pdip_spawn_child())
+  sigfillset(&sigall);
+  (void)pthread_sigmask(SIG_BLOCK, &sigall, &(sp->sigmask));
+
+  // The stack grows downward
+  pid = clone(pdip_spawn_child, stack + stack_sz,
+              CLONE_VM | CLONE_VFORK | SIGCHLD, sp);
+  err_sav = errno;
+
+  (void)pthread_sigmask(SIG_SETMASK, &(sp->sigmask), 0);
+
+  munmap(stack, stack_sz);
+
+  errno = err_sav;
+  return pid;
+} // pdip_spawn
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_exec
+// Usage  : Execute the process to be controlled
+// Return : pid of the controlled program, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_exec(
+              pdip_t  ctx,
+              int     ac,
+              char   *av[]
+	     )
+{
+int             err_sav = 0;
+int             rc;
+pdip_pty_t      pty;
+int             fds;
+pdip_ctx_t     *ctxp, child_ctx;
+unsigned int    i;
+int             state;
+pid_t           pid;
+pdip_cfg_t      cfg;
+pdip_spawn_t    sp;
+
+  if ((ac <= 0) || !av || !(av[0]) || !(av[ac - 1]) || (av[ac]) || !ctx)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ctxp = (pdip_ctx_t *)ctx;
+
+  // The object must be removed from its event loop first
+  if (ctxp->loop_entry)
+  {
+    errno = EBUSY;
+    return -1;
+  }
+
+  // Mutual exclusion with the signal handler
+  PDIP_MASK_SIG();
+  state = PDIP_STATE_GET(ctxp);
+  PDIP_UNMASK_SIG();
+
+  // If a program is already under control
+  switch (state)
+  {
+    case PDIP_STATE_ALIVE: // A process is already attached to the object
+    {
+      PDIP_ERR(ctxp, "A process is already attached to the object\n");
+      errno = EPERM;
+      return -1;
+    }
+    break;
+
+    case PDIP_STATE_DEAD: // Previous process attached to the context is dead
+    {
+      // Save user configurable fields
+      pdip_get_user_cfg(ctxp, &cfg);
+
+      // We want to attach a new process
+      // Free the content of the object (but it is not unlinked)
+      // and reinitialize the fields
+      pdip_free_resources(ctxp);
+
+      // Set the saved user configurable fields
+      rc = pdip_set_user_cfg(ctxp, &cfg);
+      if (0 != rc)
+      {
+        // errno is set
+        return -1;
+      }
+    }
+    break;
+
+    case PDIP_STATE_INIT: // Context ready to exec
+    {
+    }
+    break;
+
+    case PDIP_STATE_ZOMBIE: // Process is dead but no pdip_status()/pdip_delete() done yet
+    {
+      PDIP_ERR(ctxp, "A dead process still attached to the object, pdip_status() or pdip_delete() is needed\n");
+      errno = EPERM;
+      return -1;
+    }
+    break;
+
+    default : // Bad object, BUG ?!?
+    {
+      errno = EINVAL;
+      return -1;
+    }
+    break;
+  } // End switch
+
+  // Populate the context with the program parameters
+  ctxp->av = (char **)malloc((ac + 1) * sizeof(char *));
+  if (!(ctxp->av))
+  {
+    // Errno is set
+    return -1;
+  }
+  ctxp->ac = ac;
+  for (i = 0; i < (unsigned)ac; i ++)
+  {
+    ctxp->av[i] = strdup(av[i]);
+    if (!(ctxp->av[i]))
+    {
+      // Errno is set
+      return -1;
+    }
+  } // End for
+  ctxp->stats.strdups += ac;
+  ctxp->av[i] = (char *)0;
+
+  // Get a PTY (pool or opened on the fly)
+  rc = pdip_pty_get(ctxp, &pty);
+  if (0 != rc)
+  {
+    err_sav = errno;
+    goto error;
+  }
+  ctxp->pty_master = pty.master;
+  fds = pty.slave;
+
+  // The window of the terminal has the size of the virtual screen
+  if (ctxp->screen)
+  {
+  struct winsize ws;
 
-        case -1: // Error
-        {
-          // Data may have been read (data_sz >= 0)
-          // If we received data, return OK!
-          if (*data_sz)
-	  {
-            rc = PDIP_RECV_DATA;
-	  }
-          else
-	  {
-            err_sav = errno;
-            rc = PDIP_RECV_ERROR;
-	  }
-        }
-        break;
+    memset(&ws, 0, sizeof(ws));
+    ws.ws_row = (unsigned short)(ctxp->screen->rows);
+    ws.ws_col = (unsigned short)(ctxp->screen->cols);
+    if (0 != ioctl(ctxp->pty_master, TIOCSWINSZ, &ws))
+    {
+      err_sav = errno;
+      PDIP_ERR(ctxp, "ioctl(TIOCSWINSZ): '%m' (%d)\n", errno);
+      (void)close(fds);
+      goto error;
+    }
+  }
 
-        default: // Bug !?!
-        {
-          assert(0);
-          err_sav = errno;
-          rc = PDIP_RECV_ERROR;
-        }
-      } // End switch
+  // Make room for the process in the table used by the signal handler
+  PDIP_MASK_SIG();
+  PDIP_LOCK();
+  rc = pdip_pid_reserve();
+  err_sav = errno;
+  PDIP_UNLOCK();
+  PDIP_UNMASK_SIG();
+  if (rc != 0)
+  {
+    close(fds);
+    goto error;
+  }
+  err_sav = 0;
+
+  // Parameters of the child
+  sp.fds        = fds;
+  sp.pty_master = ctxp->pty_master;
+  sp.flags      = ctxp->flags;
+  sp.ac         = ac;
+  sp.av         = av;
+  sp.cpu        = ctxp->cpu;
+  sp.nb_cpu     = pdip_nb_cpu;
+  sp.err_step   = (const char *)0;
+  sp.err        = 0;
+  (void)pthread_sigmask(SIG_SETMASK, 0, &(sp.sigmask));
+
+  assert(fds > 2);
+  pdip_assert(ctxp->pty_master > 2, "ctxp->pty_master=%d\n", ctxp->pty_master);
+
+  if (PDIP_SPAWN_VFORK == ctxp->spawn)
+  {
+    // The child shares the memory of the father and does not run the
+    // pthread_atfork() routines: the context is used as it is
+    pid = pdip_spawn(&sp);
+  }
+  else
+  {
+    // The pthread_atfork() routine of the library clears all the contexts in the
+    // forked processes. So, we need to save the context in a local variable which
+    // will be used by the child.
+    // ==> Copy all the static fields and duplicate the dynamic ones
+    //
+    //     . av[] is not used from the context but from the parameters
+    //     . cpu needs to be copied
+    //     . pdip_nb_cpu needs to be copied (done above)
+    child_ctx = *ctxp;
+    if (ctxp->cpu)
+    {
+      child_ctx.cpu = sp.cpu = pdip_cpu_dup(ctxp->cpu);
     }
-    else // No timeout
+
+    // Fork a child
+    pid = fork();
+  }
+
+  // Update the pid field in the context and register the process for the
+  // signal handler as it may be called if the process dies prematurely
+  // (the mutex is not usable in the child which reinitializes the library)
+  PDIP_MASK_SIG();
+  ctxp->pid = child_ctx.pid = pid;
+  if (pid > 0)
+  {
+    PDIP_LOCK();
+    pdip_pid_insert(ctxp);
+    PDIP_UNLOCK();
+  }
+  PDIP_UNMASK_SIG();
+
+  switch(pid)
+  {
+    case -1 :
     {
-      while(1)
+      err_sav = errno;
+      PDIP_ERR(ctxp, "%s(): '%m' (%d)\n", (PDIP_SPAWN_VFORK == ctxp->spawn ? "clone" : "fork"), errno);
+      close(fds);
+      goto error;
+    }
+    break;
+
+    case 0 : // Child (PDIP_SPAWN_FORK)
+    {
+      // Point on the copy of the context
+      ctxp = &child_ctx;
+
+      (void)pdip_exec_child(&sp);
+
+      // The error message of execvp() can't be generated as the outputs are
+      // redirected to the PTY
+      if (strcmp(sp.err_step, "execvp()"))
       {
-        // If there is not enough space in the buffer, enlarge it
-        if ((*display_sz - *data_sz) < ctxp->buf_resize_increment)
-        {
-          *display_sz += ctxp->buf_resize_increment;
-          *display = (char *)realloc(*display, *display_sz);
-          if (!(*display))
-          {
-            *display_sz = *data_sz = 0;
-            // Errno is set
-            err_sav = errno;
-            rc = PDIP_RECV_ERROR;
-            goto end_regex;
-          }
+        errno = sp.err;
+        PDIP_ERR(ctxp, "%s: '%m' (%d)\n", sp.err_step, errno);
+        exit(1);
+      }
 
-          PDIP_DBG(ctxp, 8, "Realloced reception buffer %p with %"PRISIZE" bytes (data_sz=%"PRISIZE")\n", *display, *display_sz, *data_sz);
-        } // End if not enough space in the buffer
+      _exit(1);
+    }
+    break;
 
-        // Blocking data reception (let one slot for terminating NUL)
-        rc = pdip_read(ctxp, *display, *display_sz - 1);
-        PDIP_DBG(ctxp, 8, "pdip_read() = %d\n", rc);
-        if (rc > 0)
-        {
-          *data_sz = rc;
+    default: // Father
+    {
+      PDIP_DBG(ctxp, 1, "Forked process %"PRIPID" for program '%s'\n", ctxp->pid, av[0]);
 
-          // NUL terminate the string
-          (*display)[*data_sz] = '\0';
+      if (ctxp->rec)
+      {
+        pdip_rec_exec(ctxp, pid);
+      }
 
-          // Append data to the outstanding space and look for the regular expression
-          rc = pdip_look_for_regex(ctxp, regular_expr, &regex, display, display_sz, data_sz);
-          switch(rc)
-	  {
-  	    case 0: // Regex found
-	    {
-              // The read data located after the pattern matching is stored in the
-              // outstanding data of the context.
-              rc = PDIP_RECV_FOUND;
-              goto end_regex;
-	    }
-            break;
+      // Close the slave side of the PTY
+      close(fds);
 
-	    case 1 : // Regex not found
-	    {
-              // Data read until now does not contain the regular expression
-              if (ctxp->flags & PDIP_FLAG_RECV_ON_THE_FLOW)
-	      {
-                // The user wants to receive intermediate data
-                // ==> Return the data read until now except the last line if it is not complete
-                //     as the following data may complete the line and make the regex match
-                rc = pdip_flush_outstanding(ctxp, display, display_sz, data_sz);
-                PDIP_DBG(ctxp, 10, "pdip_flush_outstanding()=%d\n", rc);
-                switch(rc)
-		{
-   		  case 0: // Outstanding data to return
-		  {
-                    rc = PDIP_RECV_DATA;
-                    goto end_regex;
-		  }
-                  break;
+      // With PDIP_SPAWN_VFORK, the child has either executed the program or
+      // exited with the status 1 upon error
+      if (sp.err_step)
+      {
+        errno = sp.err;
+        PDIP_ERR(ctxp, "%s: '%m' (%d)\n", sp.err_step, errno);
+      }
 
-		  case 1: // Not enough outstanding data (at least not a complete line to return)
-		  {
-                    // Loop again to read more data as the timeout is infinite
-		  }
-                  break;
+      // The process is not reaped before pdip_status() or pdip_delete():
+      // the pidfd refers to it even if it is already dead
+      if (pdip_sig_pidfd)
+      {
+        ctxp->pidfd = pdip_pidfd_open(pid);
+        if (ctxp->pidfd < 0)
+        {
+          PDIP_ERR(ctxp, "pidfd_open(%"PRIPID"): '%m' (%d)\n", pid, errno);
+        }
+      }
 
-		  default : // Error
-		  {
-                    err_sav = errno;
-                    rc = PDIP_RECV_ERROR;
-                    goto end_regex;
-		  }
-                  break;
-		} // End switch
-	      }
-              else // ! RECV_ON_THE_FLOW
-	      {
-                // Loop again to read more data as the timeout is infinite
+      // Be careful here : the child process may have died for some reasons
+      // So, its state may not be INIT but DEAD
 
-	      } // RECV_ON_THE_FLOW
-	    }
-            break;
+      // Update the context
+      // The signal handler may run in another thread: the state is changed
+      // only if it is still INIT
+      PDIP_MASK_SIG();
+      if (!pdip_state_move(ctxp, PDIP_STATE_INIT, PDIP_STATE_ALIVE))
+      {
+        pdip_assert(PDIP_STATE_ZOMBIE == PDIP_STATE_GET(ctxp), "Unexpected state %d for process %"PRIPID"\n", PDIP_STATE_GET(ctxp), ctxp->pid);
 
-	    case -1 : // Error
-	    {
-              err_sav = errno;
-              rc = PDIP_RECV_ERROR;
-              goto end_regex;
-	    }
-            break;
+        // Let the field as it is. We return OK to the user.
+      }
+      PDIP_UNMASK_SIG();
+    }
+    break;
+  } // End switch
 
-	    default: // Bug
-	    {
-              assert(0);
-	    }
-            break;
-	  } // End switch
-        }
-        else // Error
-        {
-          assert(0 != rc);
+  // If the signal handler detected the death of the process, this field
+  // may be -1
+  PDIP_MASK_SIG();
+  pid = ctxp->pid;
+  PDIP_UNMASK_SIG();
 
-          err_sav = errno;
-          rc = PDIP_RECV_ERROR;
-          goto end_regex;
-        }
-      } // End while
+  if (-1 == pid)
+  {
+    // In this situation, errno is unknown
+    errno = ECHILD;
+  }
+  return pid;
 
-    } // End if timeout
+error:
 
-end_regex:
+  // Save user configurable fields
+  pdip_get_user_cfg(ctxp, &cfg);
 
-    PDIP_DBG(ctxp, 5, "Return code: %d\n", rc);
+  // The context is not unlinked
+  pdip_free_resources(ctxp);
 
-    regfree(&regex);
+  // Restore the user configurable resources
+  (void)pdip_set_user_cfg(ctxp, &cfg);
 
+  if (err_sav)
+  {
     errno = err_sav;
-    return rc;
+  }
 
-  } // End if regular expression
+  return -1;
 
-} // pdip_recv
+} // pdip_exec
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_term_settings
+// Usage  : Display the terminal settings
+//          (this is not exported in header file, it for debug purposes)
+// Return : None
+// ----------------------------------------------------------------------------
+void pdip_term_settings(pdip_t ctx)
+{
+struct termios  term_settings;
+int             rc;
+pdip_ctx_t     *ctxp;
+int             err_sav;
+
+  ctxp = (pdip_ctx_t *)ctx;
 
+  rc = tcgetattr(ctxp->pty_master, &term_settings);
+  if (rc != 0)
+  {
+    err_sav = errno;
+    PDIP_ERR(ctxp, "tcgetattr(): '%m' (%d)\n", errno);
+    errno = err_sav;
+  }
+  else
+  {
+    pdip_display_term_settings("master", &term_settings);
+  }
+} // pdip_term_settings
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_send
-// Usage  : Send a formated string to the controlled process
-// Return : Amount of sent data, if OK
+// Name   : pdip_flush_unlocked
+// Usage  : Flush the outstanding data
+// Return : 0, if OK
 //          -1, if error (errno is set)
-// ----------------------------------------------------------------------------
-int pdip_send(
-              pdip_t      ctx,
-              const char *format,
-              ...
-             )
+// ----------------------------------------------------------------------------
+static int pdip_flush_unlocked(
+                               pdip_t    ctx,
+                               char    **display,
+                               size_t   *display_sz,
+                               size_t   *data_sz
+                              )
 {
 pdip_ctx_t *ctxp;
-int         rc;
-char        str[4096];
-va_list     ap;
 int         state;
 
-  if (!ctx || !format)
+  if (!display || !display_sz || !data_sz || !ctx)
   {
     errno = EINVAL;
     return -1;
@@ -1286,1433 +8559,1664 @@ int         state;
 
   // Mutual exclusion with the signal handler
   PDIP_MASK_SIG();
-  state = ctxp->state;
+  state = PDIP_STATE_GET(ctxp);
   PDIP_UNMASK_SIG();
 
-  if (PDIP_STATE_ALIVE != state)
+  if ((state != PDIP_STATE_ALIVE) && (state != PDIP_STATE_DEAD))
   {
-    PDIP_ERR(ctxp, "Controlled process is not alive\n");
     errno = EPERM;
     return -1;
   }
 
-  va_start(ap, format);
-  rc = vsnprintf(str, sizeof(str), format, ap);
-  va_end(ap);
-
-  if (rc < 0)
-  {
-    // errno is set
-    return -1;
-  }
-  else if ((size_t)(rc + 1) > sizeof(str))
+  // The data returned by pdip_recv_view() must be released first
+  if (ctxp->view_data)
   {
-    PDIP_ERR(ctxp, "format '%s' is too long (rc=%d) for internal buffer (%"PRISIZE" bytes max)\n", format, rc, sizeof(str));
-    errno = ENOSPC;
+    errno = EBUSY;
     return -1;
   }
 
-  PDIP_DBG(ctxp, 2, "Sending %d bytes: '%s'\n", rc, str);
-
-  rc = pdip_write(ctxp, str, rc);
-
-  // In case of error, errno is set
-
-  return rc;
-} // pdip_send
-
+  return pdip_flush_internal(ctxp, display, display_sz, data_sz);
 
+} // pdip_flush_unlocked
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_display_term_settings
-// Usage  : Display the terminal settings
+// Name   : pdip_flush
+// Usage  : pdip_flush_unlocked() under the reception lock of the object
+// Return : cf. pdip_flush_unlocked()
 // ----------------------------------------------------------------------------
-static void pdip_display_term_settings(
-                                       const char     *side,
-                                       struct termios *term_settings
-                                      )
+int pdip_flush(
+               pdip_t    ctx,
+               char    **display,
+               size_t   *display_sz,
+               size_t   *data_sz
+              )
 {
-  fprintf(stderr, "PTY settings on %s side:\n"
-                  "\tInput modes: %s %s %s %s %s %s %s %s %s %s %s %s %s %s %s\n"
-                  "\tOutput modes: %s %s %s %s %s %s %s %s %s %s %s %s %s %s\n"
-                  "\tLocal modes: %s %s %s %s %s %s %s %s %s %s %s %s %s %s %s\n"
-                ,
-          side,
-	  term_settings->c_iflag & IGNBRK ? "IGNBRK" : ".",
-	  term_settings->c_iflag & BRKINT ? "BRKINT" : ".",
-	  term_settings->c_iflag & IGNPAR ? "IGNPAR" : ".",
-	  term_settings->c_iflag & PARMRK ? "PARMRK" : ".",
-	  term_settings->c_iflag & INPCK ? "INPCK" : ".",
-	  term_settings->c_iflag & ISTRIP ? "ISTRIP" : ".",
-	  term_settings->c_iflag & INLCR ? "INLCR" : ".",
-	  term_settings->c_iflag & IGNCR ? "IGNCR" : ".",
-	  term_settings->c_iflag & ICRNL ? "ICRNL" : ".",
-	  term_settings->c_iflag & IUCLC ? "IUCLC" : ".",
-	  term_settings->c_iflag & IXON ? "IXON" : ".",
-	  term_settings->c_iflag & IXANY ? "IXANY" : ".",
-	  term_settings->c_iflag & IXOFF  ? "IXOFF" : ".",
-	  term_settings->c_iflag & IMAXBEL ? "IMAXBEL" : ".",
-	  term_settings->c_iflag & IUTF8 ? "IUTF8" : ".",
-	  term_settings->c_oflag & OPOST  ? "OPOST" : ".",
-	  term_settings->c_oflag & OLCUC ? "OLCUC" : ".",
-	  term_settings->c_oflag & ONLCR ? "ONLCR" : ".",
-	  term_settings->c_oflag & OCRNL ? "OCRNL" : ".",
-	  term_settings->c_oflag & ONOCR ? "ONOCR" : ".",
-	  term_settings->c_oflag & ONLRET ? "ONLRET" : ".",
-	  term_settings->c_oflag & OFILL ? "OFILL" : ".",
-	  term_settings->c_oflag & OFDEL ? "OFDEL" : ".",
-	  term_settings->c_oflag & NLDLY ? "NLDLY" : ".",
-	  term_settings->c_oflag & CRDLY ? "CRDLY" : ".",
-	  term_settings->c_oflag & TABDLY ? "TABDLY" : ".",
-	  term_settings->c_oflag & BSDLY ? "BSDLY" : ".",
-	  term_settings->c_oflag & VTDLY ? "VTDLY" : ".",
-	  term_settings->c_oflag & FFDLY ? "FFDLY" : ".",
-	  term_settings->c_lflag & ISIG ? "ISIG" : ".",
-	  term_settings->c_lflag & ICANON ? "ICANON" : ".",
-	  term_settings->c_lflag & XCASE ? "XCASE" : ".",
-	  term_settings->c_lflag & ECHO ? "ECHO" : ".",
-	  term_settings->c_lflag & ECHOE ? "ECHOE" : ".",
-	  term_settings->c_lflag & ECHOK ? "ECHOK" : ".",
-	  term_settings->c_lflag & ECHONL ? "ECHONL" : ".",
-	  term_settings->c_lflag & ECHOCTL ? "ECHOCTL" : ".",
-	  term_settings->c_lflag & ECHOPRT ? "ECHOPRT" : ".",
-	  term_settings->c_lflag & ECHOKE ? "ECHOKE" : ".",
-	  term_settings->c_lflag & FLUSHO ? "FLUSHO" : ".",
-	  term_settings->c_lflag & NOFLSH ? "NOFLSH" : ".",
-	  term_settings->c_lflag & TOSTOP ? "TOSTOP" : ".",
-	  term_settings->c_lflag & PENDIN ? "PENDIN" : ".",
-	  term_settings->c_lflag & IEXTEN ? "IEXTEN" : "."
-         );
-} // pdip_display_term_settings
+int rc;
 
+  PDIP_OBJ_LOCK(ctx, recv_mtx);
+  rc = pdip_flush_unlocked(ctx, display, display_sz, data_sz);
+  PDIP_OBJ_UNLOCK(ctx, recv_mtx);
 
+  return rc;
+} // pdip_flush
 
-// ----------------------------------------------------------------------------
-// Name   : pdip_init_ctx
-// Usage  : Initialize the fields of an object
-// Return : None
-// ----------------------------------------------------------------------------
-static void pdip_init_ctx(
-                          pdip_ctx_t *ctxp
-                         )
-{
-  ctxp->av                      = (char **)0;
-  ctxp->ac                      = 0;
-  ctxp->pty_master              = -1;
-  ctxp->debug                   = 0;
-  ctxp->pid                     = -1;
-  ctxp->status                  = 0;
-  ctxp->state                   = PDIP_STATE_INIT;
-  ctxp->outstanding_data        = 0;
-  ctxp->outstanding_data_sz     = 0;
-  ctxp->outstanding_data_offset = 0;
-  ctxp->dbg_output              = stderr;
-  ctxp->err_output              = stderr;
-  ctxp->flags                   = 0;
-  ctxp->cpu                     = (unsigned char *)0;
-  ctxp->buf_resize_increment    = PDIP_RESIZE_INCREMENT;
 
-  // Don't touch prev & next pointers
-} // pdip_init_ctx
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_free_resources
-// Usage  : Free the resources of a context
-// Return : None
+// Name   : pdip_display_status
+// Usage  : Display the exit status of a dead process
 // ----------------------------------------------------------------------------
-static void pdip_free_resources(pdip_ctx_t *ctxp)
+static void pdip_display_status(
+                                pdip_ctx_t *ctxp
+                               )
 {
-  // For debug purposes, we reset the fields in
-  // case the user would reuse them after deallocation
-
-  if (ctxp->av)
-  {
-  unsigned int i;
-
-    for (i = 0; i < (unsigned)(ctxp->ac); i++)
-    {
-      // In case the allocation failed
-      if (ctxp->av[i])
-      {
-        free(ctxp->av[i]);
-      }
-    } // End for
-
-    free(ctxp->av);
-  } // End if
-
-  if (ctxp->pty_master >= 0)
-  {
-    (void)close(ctxp->pty_master);
-  }
-
-  if (ctxp->outstanding_data)
+  if (WIFEXITED(ctxp->status))
   {
-    free(ctxp->outstanding_data);
+    PDIP_DBG(ctxp, 3, "Process '%s' (%"PRIPID") exited with status %d\n", ctxp->av[0], ctxp->pid, WEXITSTATUS(ctxp->status));
+    return;
   }
 
-  if (ctxp->cpu)
+  if (WIFSIGNALED(ctxp->status))
   {
-    (void)pdip_cpu_free(ctxp->cpu);
+    PDIP_DBG(ctxp, 3, "Process '%s' (%"PRIPID") received signal %d\n", ctxp->av[0], ctxp->pid, WTERMSIG(ctxp->status));
+    return;
   }
+} // pdip_display_status
 
-  pdip_init_ctx(ctxp);
 
-  // If linked, the context is not unlinked
-  // So, we don't touch ctxp->prev & ctxp->next
-} // pdip_free_resources
+//----------------------------------------------------------------------------
+// Name        : pdip_update_dead_child
+// Description : Update the context of a dead child
+// Return      : None
+//----------------------------------------------------------------------------
+static void pdip_update_dead_child(
+                                   pdip_ctx_t *ctxp,
+                                   int         status
+                                  )
+{
 
+  // Update the context once the signal handler can no longer find it
+  PDIP_MASK_SIG();
+  pdip_pid_remove(ctxp);
+  ctxp->status = status;
+  PDIP_STATE_SET(ctxp, PDIP_STATE_DEAD);
+  ctxp->pid    = -1;
+  PDIP_UNMASK_SIG();
 
+  // The process file descriptor is useless once the process is reaped
+  if (ctxp->pidfd >= 0)
+  {
+    (void)close(ctxp->pidfd);
+    ctxp->pidfd = -1;
+  }
 
+  pdip_display_status(ctxp);
 
+  // The end of the session is written out at once
+  if (__atomic_load_n(&(ctxp->rec), __ATOMIC_RELAXED))
+  {
+  int32_t rec_status = status;
 
+    PDIP_REC_EVENT(ctxp, PDIP_REC_EXIT, &rec_status, sizeof(rec_status));
 
+    // The recorder may have been stopped by an error in the meantime
+    (void)pthread_mutex_lock(&(ctxp->rec_mtx));
+    if (ctxp->rec && !(ctxp->rec->map))
+    {
+      (void)pdip_rec_flush(ctxp->rec);
+    }
+    (void)pthread_mutex_unlock(&(ctxp->rec_mtx));
+  }
 
-#define PDIP_NB_BYTES_FOR_CPU() ((pdip_nb_cpu + 0x7) >> 3)
+} // pdip_update_dead_child
 
-// ----------------------------------------------------------------------------
-// Name   : pdip_cpu_nb
-// Usage  : Return the number of CPUs
-// Return : Number of CPUs
-// ----------------------------------------------------------------------------
-unsigned int pdip_cpu_nb(void)
-{
-  return pdip_nb_cpu;
-} // pdip_cpu_nb
 
 
-// ----------------------------------------------------------------------------
-// Name   : pdip_cpu_alloc
-// Usage  : Allocate a bitmap of CPUs
-// Return : bitmap, if OK
-//          0, if error (errno is set)
-// ----------------------------------------------------------------------------
-unsigned char *pdip_cpu_alloc(void)
+//----------------------------------------------------------------------------
+// Name        : pdip_wait_child
+// Description : Wait for the termination of a child process (blocking)
+// Return      : 0, if OK (process is dead)
+//               -1, if error (errno is set)
+//----------------------------------------------------------------------------
+static int pdip_wait_child(
+                           pdip_ctx_t *ctxp,
+                           int        *status
+                          )
 {
-unsigned char *cpu = (unsigned char *)malloc(PDIP_NB_BYTES_FOR_CPU() * sizeof(unsigned char *));
-
-  if (cpu)
-  {
-    memset(cpu, 0, PDIP_NB_BYTES_FOR_CPU());
-
-    // By default, we don't set any CPU in the bitmap: the system's defaults will
-    // apply
-  }
-
-  return cpu;
-
-} // pdip_cpu_alloc
+int   rc;
+int   state;
+pid_t pid;
 
+  PDIP_MASK_SIG();
+  state = PDIP_STATE_GET(ctxp);
+  *status = ctxp->status;
+  pid = ctxp->pid;
+  PDIP_UNMASK_SIG();
 
-// ----------------------------------------------------------------------------
-// Name   : pdip_cpu_free
-// Usage  : Free a bitmap of CPUs
-// Return : 0, if OK
-//          -1, if error (errno is set)
-// ----------------------------------------------------------------------------
-int pdip_cpu_free(unsigned char *cpu)
-{
-  if (cpu)
+  // If the process is not marked dead, call the system to check
+  if (PDIP_STATE_DEAD != state)
   {
-    free(cpu);
-    return 0;
-  }
-
-  errno = EINVAL;
-  return -1;
-} // pdip_cpu_free
+    // When they dies, the childs interrupt waitpid()
+    do
+    {
+      rc = waitpid(pid, status, 0);
+    } while ((-1 == rc) && (EINTR == errno));
 
+    // waitpid() returns the pid if the child is dead
+    // otherwise it returns -1
+    if (pid == rc)
+    {
+      // Child is dead
+      rc = 0;
 
-// ----------------------------------------------------------------------------
-// Name   : pdip_cpu_zero
-// Usage  : Reset a bitmap of CPUs
-// Return : 0, if OK
-//          -1, if error (errno is set)
-// ----------------------------------------------------------------------------
-int pdip_cpu_zero(unsigned char *cpu)
-{
-  if (!cpu)
+      // Update the context
+      pdip_update_dead_child(ctxp, *status);
+    }
+
+    // If -1 == rc, child is not dead or error
+  }
+  else // Process marked dead
   {
-    errno = EINVAL;
-    return -1;
+    rc = 0;
   }
 
-  memset(cpu, 0, PDIP_NB_BYTES_FOR_CPU());
+  // errno is set if rc is negative
+  return rc;
 
-  return 0;
+} // pdip_wait_child
 
-} // pdip_cpu_zero
 
-// ----------------------------------------------------------------------------
-// Name   : pdip_cpu_all
-// Usage  : Set all the bits in a bitmap of CPUs
-// Return : 0, if OK
-//          -1, if error (errno is set)
-// ----------------------------------------------------------------------------
-int pdip_cpu_all(unsigned char *cpu)
+//----------------------------------------------------------------------------
+// Name        : pdip_check_child
+// Description : Check if a child process is terminated (not blocking)
+// Return      : 1, if child is dead
+//               0, if child is not dead
+//               -1, if error (errno is set)
+//----------------------------------------------------------------------------
+static int pdip_check_child(
+			    pdip_ctx_t *ctxp,
+                            int        *status
+                           )
 {
-  if (!cpu)
-  {
-    errno = EINVAL;
-    return -1;
-  }
+int   rc;
+int   state;
+pid_t pid;
 
-  memset(cpu, 0xFF, PDIP_NB_BYTES_FOR_CPU());
+  PDIP_MASK_SIG();
+  state   = PDIP_STATE_GET(ctxp);
+  *status = ctxp->status;
+  pid     = ctxp->pid;
+  PDIP_UNMASK_SIG();
 
-  return 0;
+  // If the process is not marked dead, call the system to check
+  if (PDIP_STATE_DEAD != state)
+  {
+    if (PDIP_STATE_INIT == state)
+    {
+      errno = EPERM;
+      rc = -1;
+    }
+    else // Program attached to the object
+    {
+      // When they dies, the childs interrupt waitpid()
+      do
+      {
+        rc = waitpid(pid, status, WNOHANG);
+      } while ((-1 == rc) && (EINTR == errno));
 
-} // pdip_cpu_all
+      // waitpid(WNOHANG) returns 0 if the child is not dead yet
+      // otherwise it returns -1
+      if (pid == rc)
+      {
+        // Child is dead
+        rc = 1;
 
+        // Update the context
+        pdip_update_dead_child(ctxp, *status);
+      }
 
-// ----------------------------------------------------------------------------
-// Name   : pdip_cpu_set
-// Usage  : Set the CPU number n in the bitmap
-// Return : 0, if OK
-//          -1, if error (errno is set)
-// ----------------------------------------------------------------------------
-int pdip_cpu_set(
-                  unsigned char *cpu,
-                  unsigned int   n
-                 )
-{
-  if (n >= pdip_nb_cpu)
+      // If 0 == rc, child is not dead
+      // otherwise error
+
+    } // End if no program attached to the object
+  }
+  else // Process marked dead
   {
-    errno = EINVAL;
-    return -1;
+    rc = 1;
   }
 
-  cpu[n >> 3] |=  (1 << (n & 0x7));
+  // errno is set if rc is negative
+  return rc;
 
-  return 0;
-} // pdip_cpu_set
+} // pdip_check_child
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_cpu_unset
-// Usage  : Unset the CPU number n in the bitmap
+// Name   : pdip_status
+// Usage  : Return the status of the dead controlled program
 // Return : 0, if OK
 //          -1, if error (errno is set)
 // ----------------------------------------------------------------------------
-int pdip_cpu_unset(
-                   unsigned char *cpu,
-                   unsigned int   n
-                  )
+int pdip_status(
+                pdip_t  ctx,
+                int    *status,
+                int     blocking
+               )
 {
-  if (n >= pdip_nb_cpu)
+int         obj_status;
+pdip_ctx_t *ctxp;
+int         rc;
+
+  if (!ctx)
   {
     errno = EINVAL;
     return -1;
   }
 
-  cpu[n >> 3] &=  ~(1 << (n & 0x7));
-
-  return 0;
-} // pdip_cpu_unset
-
+  ctxp = (pdip_ctx_t *)ctx;
 
-// ----------------------------------------------------------------------------
-// Name   : pdip_cpu_isset
-// Usage  : Check if the CPU number n is set in the bitmap
-// Return : 1, if CPU number is set
-//          0, if CPU number is not set
-//          -1, if error (errno is set)
-// ----------------------------------------------------------------------------
-int pdip_cpu_isset(
-                   unsigned char *cpu,
-                   unsigned int   n
-                  )
-{
-  if (n >= pdip_nb_cpu)
+  if (blocking)
   {
-    errno = EINVAL;
-    return -1;
+    rc = pdip_wait_child(ctxp, &obj_status);
+    if ((0 == rc) && status)
+    {
+      *status = obj_status;
+    }
   }
-
-  if (cpu[n >> 3] & (1 << (n & 0x7)))
+  else // Non bloking mode
   {
-    return 1;
-  }
+    rc = pdip_check_child(ctxp, &obj_status);
+    if (1 == rc)
+    {
+      if (status)
+      {
+        *status = obj_status;
+      }
+
+      rc = 0;
+    }
+    else if (0 == rc)
+    {
+      rc = -1;
+      errno = EAGAIN;
+    }
+  } // End if blocking mode
+
+  return rc;
+} // pdip_status
 
-  return 0;
-} // pdip_cpu_isset
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_cpu_dup
-// Usage  : Duplicate a bitmap of CPUs
-// Return : bitmap, if OK
-//          0, if error (errno is set)
+// Name   : pdip_set_debug_level
+// Usage  : Set the debug level for a given PDIP context (ctx != 0) or
+//          set the global debug level
+// Return : 0, if OK
+//          !0, if error (errno is set)
 // ----------------------------------------------------------------------------
-unsigned char *pdip_cpu_dup(unsigned char *cpu_src)
+int pdip_set_debug_level(
+                         pdip_t ctx,
+                         int    level
+                        )
 {
-unsigned char *cpu;
+  // Mutual exclusion with the signal handler
+  PDIP_MASK_SIG();
 
-  if (!cpu_src)
+  if (!ctx)
   {
-    errno = EINVAL;
-    return 0;
+    pdip_debug_level = level;
   }
-
-  cpu = (unsigned char *)malloc(PDIP_NB_BYTES_FOR_CPU() * sizeof(unsigned char *));
-
-  if (cpu)
+  else
   {
-  unsigned int i;
+  pdip_ctx_t *ctxp;
 
-    for (i = 0; i < PDIP_NB_BYTES_FOR_CPU(); i ++)
-    {
-      cpu[i] = cpu_src[i];
-    } // End for
+    ctxp = (pdip_ctx_t *)ctx;
+    ctxp->debug = level;
   }
 
-  return cpu;
+  PDIP_UNMASK_SIG();
+
+  return 0;
+} // pdip_set_debug_level
+
 
-} // pdip_cpu_dup
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_get_user_cfg
-// Usage  : Get the user configurable fields from the object descriptor
-// Return : None
+// Name   : pdip_cfg_init
+// Usage  : Initialize the configuration of a PDIP object to its default values
+// Return : 0, if OK
+//          -1, if error (errno is set)
 // ----------------------------------------------------------------------------
-static void pdip_get_user_cfg(
-                              pdip_ctx_t     *ctxp,
-                              pdip_cfg_t     *cfg
-                             )
+int pdip_cfg_init(
+                  pdip_cfg_t *cfg
+                 )
 {
-  cfg->dbg_output           = ctxp->dbg_output;
-  cfg->err_output           = ctxp->err_output;
-  cfg->debug_level          = ctxp->debug;
-  cfg->flags                = ctxp->flags;
-  cfg->cpu                  = ctxp->cpu;
-  cfg->buf_resize_increment = ctxp->buf_resize_increment;
-} // pdip_get_user_cfg
+  if (!cfg)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  cfg->dbg_output           = (FILE *)0;
+  cfg->err_output           = (FILE *)0;
+  cfg->debug_level          = 0;
+  cfg->flags                = 0;
+  cfg->cpu                  = (unsigned char *)0;
+  cfg->buf_resize_increment = 0;
+  cfg->buf_growth           = PDIP_BUF_GROWTH_GEOMETRIC;
+  cfg->buf_growth_factor    = 0;
+  cfg->buf_max_sz           = 0;
+  cfg->buf_overflow         = PDIP_BUF_OVERFLOW_ERROR;
+  cfg->buf_lookback         = 0;
+  cfg->regex_cache_sz       = 0;
+  cfg->on_output            = (pdip_output_cb_t)0;
+  cfg->on_output_user       = (void *)0;
+  cfg->spawn                = PDIP_SPAWN_FORK;
+  cfg->record               = (const char *)0;
+  cfg->screen_rows          = 0;
+  cfg->screen_cols          = 0;
 
+  return 0;
+} // pdip_cfg_init
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_set_user_cfg
-// Usage  : Set the user configurable fields in the object descriptor
-// Return : 0, if OK
-//          -1, if error (errno is set)
+// Name   : pdip_new
+// Usage  : Allocate a PDIP context
+// Return : PDIP object, if OK
+//          0, if error (errno is set)
 // ----------------------------------------------------------------------------
-static int pdip_set_user_cfg(
-                              pdip_ctx_t     *ctxp,
-                              pdip_cfg_t     *cfg
-                            )
+pdip_t pdip_new(
+                pdip_cfg_t *cfg
+               )
 {
-  if (cfg->dbg_output)
-  {
-    ctxp->dbg_output = cfg->dbg_output;
-  }
+pdip_ctx_t *ctxp;
 
-  if (cfg->err_output)
+  // Allocate the context
+  ctxp = (pdip_ctx_t *)malloc(sizeof(pdip_ctx_t));
+  if (!ctxp)
   {
-    ctxp->err_output = cfg->err_output;
+    PDIP_ERR(0, "malloc(%"PRISIZE"): '%m' (%d)\n", sizeof(pdip_ctx_t), errno);
+    return (pdip_t)0;
   }
 
-  ctxp->debug = cfg->debug_level;
+  // Populate the context
+  pdip_init_ctx(ctxp);
 
-  ctxp->flags = cfg->flags;
+  // The locks are kept across the executions of programs (they are not
+  // reset by pdip_init_ctx())
+  (void)pthread_mutex_init(&(ctxp->send_mtx), 0);
+  (void)pthread_mutex_init(&(ctxp->recv_mtx), 0);
+  (void)pthread_mutex_init(&(ctxp->rec_mtx), 0);
 
-  if (cfg->cpu)
+  if (cfg)
   {
-  unsigned int i;
+  int rc;
 
-    // Duplicate the array to make sure that the user will not free
-    // it after this call
-    ctxp->cpu = pdip_cpu_alloc();
-    if (!(ctxp->cpu))
+    rc = pdip_set_user_cfg(ctxp, cfg);
+    if (0 != rc)
     {
     int err_sav;
 
       err_sav = errno;
-      PDIP_ERR(0, "malloc(%"PRISIZE"): '%m' (%d)\n", PDIP_NB_BYTES_FOR_CPU() * sizeof(unsigned char *), errno);
+      (void)pthread_mutex_destroy(&(ctxp->send_mtx));
+      (void)pthread_mutex_destroy(&(ctxp->recv_mtx));
+      (void)pthread_mutex_destroy(&(ctxp->rec_mtx));
+      free(ctxp);
       errno = err_sav;
-      return -1;
+      return (pdip_t)0;
     }
+  } // End if a configuration is passed
 
-    for (i = 0; i < PDIP_NB_BYTES_FOR_CPU(); i ++)
+  ctxp->prev = 0;
+
+  // Insert the object in the global list
+
+  // Mutual exclusion with the signal handler
+  PDIP_MASK_SIG();
+
+  // Mutual exclusion with any other thread creating/deleting an object
+  PDIP_LOCK();
+
+  ctxp->next = pdip_ctx_list;
+  if (pdip_ctx_list)
+  {
+    pdip_ctx_list->prev = ctxp;
+  }
+  pdip_ctx_list = ctxp;
+
+  PDIP_UNLOCK();
+  PDIP_UNMASK_SIG();
+
+  return (pdip_t)ctxp;
+} // pdip_new
+
+
+//----------------------------------------------------------------------------
+// Name        : pdip_kill_child
+// Description : Send a signal safely to a child process
+//----------------------------------------------------------------------------
+static int pdip_kill_child(
+                           pdip_ctx_t *ctxp,
+                           int         sig
+                          )
+{
+int rc;
+
+  // Mask the SIGCHLD otherwise if the process dies, the signal handler will
+  // set the pid to -1 in the context and so, we would send the signal to
+  // all the processes!
+  PDIP_MASK_SIG();
+  if (ctxp->pid > 0)
+  {
+    PDIP_DBG(ctxp, 2, "Sending signal %d to '%s' (%"PRIPID")\n", sig, ctxp->av[0], ctxp->pid);
+    rc = kill(ctxp->pid, sig);
+    if (0 == rc)
     {
-      ctxp->cpu[i] = cfg->cpu[i];
-    } // End for
-  } // End if affinity
+    int32_t rec_sig = sig;
 
-  // At least one slot for the terminating NUL
-  if (cfg->buf_resize_increment > 1)
+      PDIP_REC_EVENT(ctxp, PDIP_REC_SIGNAL, &rec_sig, sizeof(rec_sig));
+    }
+  }
+  else
   {
-    ctxp->buf_resize_increment = cfg->buf_resize_increment;
+    errno = ENOENT;
+    rc = -1;
   }
+  PDIP_UNMASK_SIG();
 
-  return 0;
-} // pdip_set_user_cfg
+  PDIP_DBG(ctxp, 4, "kill returned %d\n", rc);
 
+  return rc;
+} // pdip_kill_child
 
 
 
 
-// ----------------------------------------------------------------------------
-// Name   : pdip_exec
-// Usage  : Execute the process to be controlled
-// Return : pid of the controlled program, if OK
-//          -1, if error (errno is set)
-// ----------------------------------------------------------------------------
-int pdip_exec(
-              pdip_t  ctx,
-              int     ac,
-              char   *av[]
-	     )
+
+
+//----------------------------------------------------------------------------
+// Name        : pdip_terminate_child
+// Description : Terminate the child process
+//----------------------------------------------------------------------------
+static void pdip_terminate_child(
+                                 pdip_ctx_t *ctxp,
+                                 int        *status
+                                )
 {
-int             err_sav = 0;
+int             obj_status;
+pid_t           pid = ctxp->pid;
 int             rc;
-char           *pty_slave_name;
-int             fds;
-pdip_ctx_t     *ctxp, child_ctx;
-unsigned int    i;
-struct termios  term_settings;
-int             state;
-pid_t           pid;
-pdip_cfg_t      cfg;
-unsigned int    saved_pdip_nb_cpu;
 
-  if ((ac <= 0) || !av || !(av[0]) || !(av[ac - 1]) || (av[ac]) || !ctx)
+  // Mask the SIGCHLD otherwise if the process dies, the signal handler will
+  // set the pid to -1 in the context
+  (void)pdip_kill_child(ctxp, SIGTERM);
+
+  // From here, the signal handler for SIGCHLD may be triggered
+  // at any moment if the child dies
+
+  // We check immediately as if we are lucky, the kill() system call triggered a
+  // rescheduling giving a chance to the target process to die and report its status
+  rc = pdip_check_child(ctxp, &obj_status);
+
+  if (rc != 0)
   {
-    errno = EINVAL;
-    return -1;
+    PDIP_ERR(ctxp, "Checking for the termination of '%s' (%d) returned an error: '%m' (%d)...\n", ctxp->av[0], pid, errno);
   }
 
-  ctxp = (pdip_ctx_t *)ctx;
+  // If the child is not dead
+  if (1 != rc)
+  {
+  struct timespec timeout;
 
-  // Mutual exclusion with the signal handler
-  PDIP_MASK_SIG();
-  state = ctxp->state;
-  PDIP_UNMASK_SIG();
+    if (rc != 0)
+    {
+      PDIP_ERR(ctxp, "Checking for the termination of '%s' (%d) returned an error: '%m' (%d)...\n", ctxp->av[0], pid, errno);
+    }
 
-  // If a program is already under control
-  switch (state)
-  {
-    case PDIP_STATE_ALIVE: // A process is already attached to the object
+    // Let's wait some ms before sending SIGKILL
+    // nanosleep() may return prematurely if a signal is
+    // received (e.g. SIGCHLD). In this case it returns -1 and sets errno to EINTR
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = 25000000; // 25 ms
+    rc = nanosleep(&timeout, 0);
+    if (rc != 0)
     {
-      PDIP_ERR(ctxp, "A process is already attached to the object\n");
-      errno = EPERM;
-      return -1;
+      PDIP_DBG(ctxp, 9, "nanosleep(): rc=%d, errno='%m' (%d)\n", rc, errno);
     }
-    break;
 
-    case PDIP_STATE_DEAD: // Previous process attached to the context is dead
+    // Check the process status after timeout
+    rc = pdip_check_child(ctxp, &obj_status);
+
+    // If the sub-process didn't died ==> SIGKILL
+    if (1 != rc)
     {
-      // Save user configurable fields
-      pdip_get_user_cfg(ctxp, &cfg);
+      (void)pdip_kill_child(ctxp, SIGKILL);
 
-      // We want to attach a new process
-      // Free the content of the object (but it is not unlinked)
-      // and reinitialize the fields
-      pdip_free_resources(ctxp);
+      PDIP_DBG(ctxp, 2, "Waiting for the termination of '%s' (%d)...\n", ctxp->av[0], pid);
 
-      // Set the saved user configurable fields
-      rc = pdip_set_user_cfg(ctxp, &cfg);
-      if (0 != rc)
+      // Wait until the child is dead
+      rc = pdip_wait_child(ctxp, &obj_status);
+
+      if (rc != 0)
       {
-        // errno is set
-        return -1;
+        PDIP_ERR(ctxp, "Waiting for the termination of '%s' (%d) returned an error: '%m' (%d)...\n", ctxp->av[0], pid, errno);
       }
-    }
-    break;
 
-    case PDIP_STATE_INIT: // Context ready to exec
-    {
-    }
-    break;
+    } // End if sub-process didn't die
+  } // End if sub-process didn't die
 
-    case PDIP_STATE_ZOMBIE: // Process is dead but no pdip_status()/pdip_delete() done yet
-    {
-      PDIP_ERR(ctxp, "A dead process still attached to the object, pdip_status() or pdip_delete() is needed\n");
-      errno = EPERM;
-      return -1;
-    }
-    break;
+  PDIP_DBG(ctxp, 2, "Process '%s' (%d) is terminated with status %d\n", ctxp->av[0], pid, obj_status);
 
-    default : // Bad object, BUG ?!?
-    {
-      errno = EINVAL;
-      return -1;
-    }
-    break;
-  } // End switch
+  *status = obj_status;
+
+} // pdip_terminate_child
+
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_sig
+// Usage  : Send a signal to the controlled process
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_sig(
+              pdip_t  ctx,
+              int     sig
+            )
+{
+pdip_ctx_t *ctxp;
+int         state;
 
-  // Populate the context with the program parameters
-  ctxp->av = (char **)malloc((ac + 1) * sizeof(char *));
-  if (!(ctxp->av))
+  if (!ctx)
   {
-    // Errno is set
+    errno = EINVAL;
     return -1;
   }
-  ctxp->ac = ac;
-  for (i = 0; i < (unsigned)ac; i ++)
-  {
-    ctxp->av[i] = strdup(av[i]);
-    if (!(ctxp->av[i]))
-    {
-      // Errno is set
-      return -1;
-    }
-  } // End for
-  ctxp->av[i] = (char *)0;
-
-  // Get a master pty
-  //
-  // posix_openpt() opens a pseudo-terminal master and returns its file
-  // descriptor.
-  // It is equivalent to open("/dev/ptmx",O_RDWR|O_NOCTTY) on Linux systems :
-  //
-  //       . O_RDWR Open the device for both reading and writing
-  //       . O_NOCTTY Do not make this device the controlling terminal for the process
-  ctxp->pty_master = posix_openpt(O_RDWR |O_NOCTTY);
-  if (ctxp->pty_master < 0)
-  {
-    err_sav = errno;
-    PDIP_ERR(ctxp, "Impossible to get a master pseudo-terminal - errno = '%m' (%d)\n", errno);
-    goto error;
-  }
 
-  // Grant access to the slave pseudo-terminal
-  // (Chown the slave to the calling user)
-  if (0 != grantpt(ctxp->pty_master))
-  {
-    err_sav = errno;
-    PDIP_ERR(ctxp, "Impossible to grant access to slave pseudo-terminal - errno = '%m' (%d)\n", errno);
-    goto error;
-  }
+  ctxp = (pdip_ctx_t *)ctx;
 
-  // Unlock pseudo-terminal master/slave pair
-  // (Release an internal lock so the slave can be opened)
-  if (0 != unlockpt(ctxp->pty_master))
-  {
-    err_sav = errno;
-    PDIP_ERR(ctxp, "Impossible to unlock pseudo-terminal master/slave pair - errno = '%m' (%d)\n", errno);
-    goto error;
-  }
+  // Mutual exclusion with the signal handler
+  PDIP_MASK_SIG();
+  state = PDIP_STATE_GET(ctxp);
+  PDIP_UNMASK_SIG();
 
-  // Get the name of the slave pty
-  pty_slave_name = ptsname(ctxp->pty_master);
-  if (NULL == pty_slave_name)
+  if (PDIP_STATE_ALIVE != state)
   {
-    err_sav = errno;
-    PDIP_ERR(ctxp, "Impossible to get the name of the slave pseudo-terminal - errno = '%m' (%d)\n", errno);
-    goto error;
+    errno = EPERM;
+    return -1;
   }
 
-  // Open the slave part of the terminal
-  fds = open(pty_slave_name, O_RDWR);
-  if (fds < 0)
-  {
-    err_sav = errno;
-    PDIP_ERR(ctxp, "Impossible to open the slave pseudo-terminal - errno = '%m' (%d)\n", errno);
-    goto error;
-  }
+  return pdip_kill_child(ctxp, sig);
+} // pdip_sig
 
-  // To make "$" wildcard work, the end of lines must be Linux compatible (i.e. LF
-  // instead of CR/LF). So, we disable mapping of LF to CR/LF on slave side.
-  // We do it on master side (this impacts the whole PTY slave and master side) to
-  // make sure that the user acting on master side will begin its interactions
-  // after this configuration. If we do it on slave side, the user may send data
-  // before the child configures the terminal
-  rc = tcgetattr(ctxp->pty_master, &term_settings);
-  if (rc != 0)
-  {
-    err_sav = errno;
-    PDIP_ERR(ctxp, "tcgetattr(): '%m' (%d)\n", errno);
-    errno = err_sav;
-    exit(1);
-  }
-  if (ctxp->debug >= 20)
-  {
-    pdip_display_term_settings("master", &term_settings);
-  }
 
-  term_settings.c_oflag &= ~ONLCR;
-  rc = tcsetattr(ctxp->pty_master, TCSANOW, &term_settings);
-  if (rc != 0)
-  {
-    err_sav = errno;
-    PDIP_ERR(ctxp, "tcsetattr(): '%m' (%d)\n", errno);
-    errno = err_sav;
-    exit(1);
-  }
+// ----------------------------------------------------------------------------
+// Name   : pdip_fd
+// Usage  : Return the file descriptor of a PDIP object
+// Return : File descriptor, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_fd(
+            pdip_t  ctx
+           )
+{
+pdip_ctx_t *ctxp;
+int         state;
 
-  // The pthread_atfork() routine of the library clears all the contexts in the
-  // forked processes. So, we need to save the context in a local variable which
-  // will be used by the child.
-  // ==> Copy all the static fields and duplicate the dynamic ones
-  //
-  //     . av[] is not used from the context but from the parameters
-  //     . cpu needs to be copied
-  //     . pdip_nb_cpu needs to be copied
-  child_ctx = *ctxp;
-  if (ctxp->cpu)
+  if (!ctx)
   {
-    child_ctx.cpu = pdip_cpu_dup(ctxp->cpu);
+    errno = EINVAL;
+    return -1;
   }
-  saved_pdip_nb_cpu = pdip_nb_cpu;
 
-  // Fork a child
-  pid = fork();
+  ctxp = (pdip_ctx_t *)ctx;
 
-  // Update the pid field in the context as the signal handler
-  // may be called if the process dies prematurely
   PDIP_MASK_SIG();
-  ctxp->pid = child_ctx.pid = pid;
+  state = PDIP_STATE_GET(ctxp);
   PDIP_UNMASK_SIG();
 
-  switch(pid)
+  if (PDIP_STATE_ALIVE != state)
   {
-    case -1 :
-    {
-      err_sav = errno;
-      PDIP_ERR(ctxp, "fork(): '%m' (%d)\n", errno);
-      goto error;
-    }
-    break;
+    PDIP_ERR(ctxp, "Controlled process is not alive\n");
+    errno = EPERM;
+    return -1;
+  }
 
-    case 0 : // Child
-    {
-    int fd;
+  return ctxp->pty_master;
 
-      // Point on the copy of the context
-      ctxp = &child_ctx;
+} // pdip_fd
 
-      assert(fds > 2);
-      pdip_assert(ctxp->pty_master > 2, "ctxp->pty_master=%d\n", ctxp->pty_master);
 
-      // Redirect input/outputs to the slave side of PTY
-      close(0);
-      close(1);
-      if (ctxp->flags & PDIP_FLAG_ERR_REDIRECT)
-      {
-        close(2);
-      }
-      fd = dup(fds);
-      assert(0 == fd);
-      fd = dup(fds);
-      assert(1 == fd);
-      if (ctxp->flags & PDIP_FLAG_ERR_REDIRECT)
-      {
-        fd = dup(fds);
-        assert(2 == fd);
-      }
+// ----------------------------------------------------------------------------
+// Name   : pdip_pidfd
+// Usage  : Return the process file descriptor of the controlled process
+// Return : File descriptor, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_pidfd(
+               pdip_t  ctx
+              )
+{
+pdip_ctx_t *ctxp;
+int         state;
 
-      // Make some cleanups
-      close(fds);
-      close(ctxp->pty_master);
+  if (!ctx)
+  {
+    errno = EINVAL;
+    return -1;
+  }
 
-      // fds becomes the standard input
-      fds = 0;
+  ctxp = (pdip_ctx_t *)ctx;
 
-      // Make the child become a process session leader
-      rc = setsid();
-      if (rc < 0)
-      {
-        err_sav = errno;
-        PDIP_ERR(ctxp, "setsid(): '%m' (%d)\n", errno);
-        errno = err_sav;
-        exit(1);
-      }
+  PDIP_MASK_SIG();
+  state = PDIP_STATE_GET(ctxp);
+  PDIP_UNMASK_SIG();
 
-      // As the child is a session leader, set the controlling terminal to be the slave
-      // side of the PTY
-      rc = ioctl(fds, TIOCSCTTY, 1);
-      if (rc < 0)
-      {
-        err_sav = errno;
-        PDIP_ERR(ctxp, "ioctl(TIOCSCTTY): '%m' (%d)\n", errno);
-        errno = err_sav;
-        exit(1);
-      }
+  if ((PDIP_STATE_ALIVE != state) && (PDIP_STATE_ZOMBIE != state))
+  {
+    PDIP_ERR(ctxp, "No controlled process\n");
+    errno = EPERM;
+    return -1;
+  }
 
-      // Make the foreground process group on the terminal be the process id of the child
-      rc = tcsetpgrp(fds, getpid());
-      if (rc < 0)
-      {
-        err_sav = errno;
-        PDIP_ERR(ctxp, "setpgid(): '%m' (%d)\n", errno);
-        errno = err_sav;
-        exit(1);
-      }
+  // Not in PDIP_SIG_HDL_PIDFD mode when the process was launched
+  if (ctxp->pidfd < 0)
+  {
+    errno = ENOENT;
+    return -1;
+  }
 
-      rc = tcgetattr(fds, &term_settings);
-      if (rc != 0)
-      {
-        err_sav = errno;
-        PDIP_ERR(ctxp, "tcgetattr(): '%m' (%d)\n", errno);
-        errno = err_sav;
-        exit(1);
-      }
+  return ctxp->pidfd;
 
-      /*
+} // pdip_pidfd
 
-        This perturbates the programs synchronizing on the output
-        of the child as this output is not expected from the child process
 
-      if (ctxp->debug >= 20)
-      {
-        pdip_display_term_settings("slave", &term_settings);
-      }
-      */
+// ----------------------------------------------------------------------------
+// Name   : pdip_spill_fd
+// Usage  : Return the file descriptor of the temporary file into which the
+//          oldest received data are appended (PDIP_BUF_OVERFLOW_SPILL)
+// Return : File descriptor, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_spill_fd(
+                  pdip_t  ctx
+                 )
+{
+pdip_ctx_t *ctxp;
 
-      // Set the CPU affinity if requested
-      if (ctxp->cpu)
-      {
-      cpu_set_t mask;
-      int       one = 0;
+  if (!ctx)
+  {
+    errno = EINVAL;
+    return -1;
+  }
 
-        CPU_ZERO(&mask);
+  ctxp = (pdip_ctx_t *)ctx;
 
-        for (i = 0; i < saved_pdip_nb_cpu; i ++)
-	{
-          if (pdip_cpu_isset(ctxp->cpu, i))
-	  {
-            one = 1;
-            CPU_SET(i, &mask);
-	  } // End if CPU is set
-	} // End for
+  // Nothing spilled since the last execution
+  if (ctxp->spill_fd < 0)
+  {
+    errno = ENOENT;
+    return -1;
+  }
 
-        // If at least one bit is set otherwise we keep system defaults
-        if (one)
-	{
-          rc = sched_setaffinity(0, sizeof(cpu_set_t), &mask);
-          if (0 != rc)
-	  {
-            err_sav = errno;
-            PDIP_ERR(ctxp, "sched_setaffinity(): '%m' (%d)\n", errno);
-            errno = err_sav;
-            exit(1);
-	  }
-	}
-      } // End if affinity
+  return ctxp->spill_fd;
+} // pdip_spill_fd
 
-      // Exec the program (donc use av/ac from context as they are deallocated
-      // upon fork() by the "atfork()" routine
-      rc = execvp(av[0], av);
 
-      // The error message can't be generated as the outputs are redirected to the PTY
-      //PDIP_ERR(ctxp, "Error '%m' (%d) while running '%s'\n", errno, av[0]);
 
-      _exit(1);
-    }
-    break;
+// ----------------------------------------------------------------------------
+// Name   : PDIP_LOOP_READ_SZ
+// Usage  : Size of the reception buffer of an event loop: amount of data read
+//          at most from an object each time it is ready (the level-triggered
+//          epoll gives the hand to the other objects between the reads)
+// ----------------------------------------------------------------------------
+#define PDIP_LOOP_READ_SZ  4096
 
-    default: // Father
-    {
-      PDIP_DBG(ctxp, 1, "Forked process %"PRIPID" for program '%s'\n", ctxp->pid, av[0]);
 
-      // Close the slave side of the PTY
-      close(fds);
+// ----------------------------------------------------------------------------
+// Name   : PDIP_LOOP_EVENTS_NB
+// Usage  : Maximum number of events returned by one epoll_wait()
+// ----------------------------------------------------------------------------
+#define PDIP_LOOP_EVENTS_NB  64
 
-      // Be careful here : the child process may have died for some reasons
-      // So, its state may not be INIT but DEAD
 
-      // Update the context
-      PDIP_MASK_SIG();
-      if (PDIP_STATE_INIT != ctxp->state)
-      {
-        pdip_assert(PDIP_STATE_ZOMBIE == ctxp->state, "Unexpected state %d for process %"PRIPID"\n", ctxp->state, ctxp->pid);
+// ----------------------------------------------------------------------------
+// Name   : PDIP_LOOP_DEATH_POLL_MS
+// Usage  : Period (in ms) of the checks of the death of the controlled
+//          processes which closed their terminal (when they are not
+//          supervised through a process file descriptor)
+// ----------------------------------------------------------------------------
+#define PDIP_LOOP_DEATH_POLL_MS  10
 
-        // Let the field as it is. We return OK to the user.
-      }
-      else
-      {
-        ctxp->state = PDIP_STATE_ALIVE;
-      }
-      PDIP_UNMASK_SIG();
-    }
-    break;
-  } // End switch
 
-  // If the signal handler detected the death of the process, this field
-  // may be -1
-  PDIP_MASK_SIG();
-  pid = ctxp->pid;
-  PDIP_UNMASK_SIG();
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_release
+// Usage  : Consume the outstanding data passed to a callback
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_loop_release(pdip_ctx_t *ctxp)
+{
+  if (ctxp->view_data)
+  {
+    pdip_outstanding_consume(ctxp, ctxp->view_consume);
+    ctxp->view_data = (const char *)0;
+    ctxp->view_consume = 0;
+  }
+} // pdip_loop_release
 
-  if (-1 == pid)
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_unlink
+// Usage  : Unlink an entry from the list of a loop
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_loop_unlink(
+                             pdip_loop_ctx_t   *loopp,
+                             pdip_loop_entry_t *e
+                            )
+{
+  if (e->prev)
+  {
+    e->prev->next = e->next;
+  }
+  else
+  {
+    loopp->entries = e->next;
+  }
+
+  if (e->next)
   {
-    // In this situation, errno is unknown
-    errno = ECHILD;
+    e->next->prev = e->prev;
   }
-  return pid;
+} // pdip_loop_unlink
 
-error:
 
-  // Save user configurable fields
-  pdip_get_user_cfg(ctxp, &cfg);
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_purge
+// Usage  : Free the entries removed during an iteration of the loop
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_loop_purge(pdip_loop_ctx_t *loopp)
+{
+pdip_loop_entry_t *e;
 
-  // The context is not unlinked
-  pdip_free_resources(ctxp);
+  while (loopp->removed)
+  {
+    e = loopp->removed;
+    loopp->removed = e->next;
+    free(e->out);
+    free(e);
+  } // End while
+} // pdip_loop_purge
 
-  // Restore the user configurable resources
-  (void)pdip_set_user_cfg(ctxp, &cfg);
 
-  if (err_sav)
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_pend
+// Usage  : Make the loop process the outstanding data of an entry without
+//          waiting for new data
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_loop_pend(pdip_loop_entry_t *e)
+{
+pdip_loop_ctx_t *loopp = e->loop;
+
+  if (e->pending)
   {
-    errno = err_sav;
+    return;
   }
 
-  return -1;
-
-} // pdip_exec
+  e->pending   = 1;
+  e->pend_next = (pdip_loop_entry_t *)0;
+  e->pend_prev = loopp->pend_tail;
+  if (loopp->pend_tail)
+  {
+    loopp->pend_tail->pend_next = e;
+  }
+  else
+  {
+    loopp->pend_head = e;
+  }
+  loopp->pend_tail = e;
+  loopp->pend_nb ++;
+} // pdip_loop_pend
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_term_settings
-// Usage  : Display the terminal settings
-//          (this is not exported in header file, it for debug purposes)
+// Name   : pdip_loop_unpend
+// Usage  : Remove an entry from the list of the pending entries of its loop
 // Return : None
 // ----------------------------------------------------------------------------
-void pdip_term_settings(pdip_t ctx)
+static void pdip_loop_unpend(pdip_loop_entry_t *e)
 {
-struct termios  term_settings;
-int             rc;
-pdip_ctx_t     *ctxp;
-int             err_sav;
+pdip_loop_ctx_t *loopp = e->loop;
 
-  ctxp = (pdip_ctx_t *)ctx;
+  if (!(e->pending))
+  {
+    return;
+  }
 
-  rc = tcgetattr(ctxp->pty_master, &term_settings);
-  if (rc != 0)
+  if (e->pend_prev)
   {
-    err_sav = errno;
-    PDIP_ERR(ctxp, "tcgetattr(): '%m' (%d)\n", errno);
-    errno = err_sav;
+    e->pend_prev->pend_next = e->pend_next;
   }
   else
   {
-    pdip_display_term_settings("master", &term_settings);
+    loopp->pend_head = e->pend_next;
   }
-} // pdip_term_settings
+
+  if (e->pend_next)
+  {
+    e->pend_next->pend_prev = e->pend_prev;
+  }
+  else
+  {
+    loopp->pend_tail = e->pend_prev;
+  }
+
+  e->pending = 0;
+  loopp->pend_nb --;
+} // pdip_loop_unpend
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_flush
-// Usage  : Flush the outstanding data
-// Return : 0, if OK
-//          -1, if error (errno is set)
+// Name   : pdip_loop_before
+// Usage  : Compare two dates
+// Return : 1, if 'a' is before 'b'
+//          0, otherwise
 // ----------------------------------------------------------------------------
-int pdip_flush(
-               pdip_t    ctx,
-               char    **display,
-               size_t   *display_sz,
-               size_t   *data_sz
-              )
+static int pdip_loop_before(
+                            const struct timespec *a,
+                            const struct timespec *b
+                           )
 {
-pdip_ctx_t *ctxp;
-int         state;
+  return ((a->tv_sec < b->tv_sec) || ((a->tv_sec == b->tv_sec) && (a->tv_nsec < b->tv_nsec)));
+} // pdip_loop_before
 
-  if (!display || !display_sz || !data_sz || !ctx)
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_heap_set
+// Usage  : Store an entry at the index 'i' of the heap of the timers
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_loop_heap_set(
+                               pdip_loop_ctx_t   *loopp,
+                               unsigned int       i,
+                               pdip_loop_entry_t *e
+                              )
+{
+  loopp->heap[i] = e;
+  e->heap_idx = (int)i;
+} // pdip_loop_heap_set
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_heap_up
+// Usage  : Move the entry at the index 'i' of the heap of the timers up to
+//          its place
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_loop_heap_up(
+                              pdip_loop_ctx_t *loopp,
+                              unsigned int     i
+                             )
+{
+pdip_loop_entry_t *e = loopp->heap[i];
+unsigned int       parent;
+
+  while (i)
   {
-    errno = EINVAL;
-    return -1;
-  }
+    parent = (i - 1) / 2;
+    if (!pdip_loop_before(&(e->wake), &(loopp->heap[parent]->wake)))
+    {
+      break;
+    }
 
-  ctxp = (pdip_ctx_t *)ctx;
+    pdip_loop_heap_set(loopp, i, loopp->heap[parent]);
+    i = parent;
+  } // End while
 
-  // Mutual exclusion with the signal handler
-  PDIP_MASK_SIG();
-  state = ctxp->state;
-  PDIP_UNMASK_SIG();
+  pdip_loop_heap_set(loopp, i, e);
+} // pdip_loop_heap_up
 
-  if ((state != PDIP_STATE_ALIVE) && (state != PDIP_STATE_DEAD))
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_heap_down
+// Usage  : Move the entry at the index 'i' of the heap of the timers down to
+//          its place
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_loop_heap_down(
+                                pdip_loop_ctx_t *loopp,
+                                unsigned int     i
+                               )
+{
+pdip_loop_entry_t *e = loopp->heap[i];
+unsigned int       child;
+
+  for (;;)
   {
-    errno = EPERM;
-    return -1;
-  }
+    child = (2 * i) + 1;
+    if (child >= loopp->heap_nb)
+    {
+      break;
+    }
 
-  return pdip_flush_internal(ctxp, display, display_sz, data_sz);
+    if (((child + 1) < loopp->heap_nb) &&
+        pdip_loop_before(&(loopp->heap[child + 1]->wake), &(loopp->heap[child]->wake)))
+    {
+      child ++;
+    }
 
-} // pdip_flush
+    if (!pdip_loop_before(&(loopp->heap[child]->wake), &(e->wake)))
+    {
+      break;
+    }
 
+    pdip_loop_heap_set(loopp, i, loopp->heap[child]);
+    i = child;
+  } // End for
 
+  pdip_loop_heap_set(loopp, i, e);
+} // pdip_loop_heap_down
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_display_status
-// Usage  : Display the exit status of a dead process
+// Name   : pdip_loop_arm
+// Usage  : Compute the next date at which an entry must be looked at (deadline
+//          of the awaited pattern or check of the death of the controlled
+//          process) and update its place in the heap of the timers of its
+//          loop. To be called each time one of them changes
+// Return : None
 // ----------------------------------------------------------------------------
-static void pdip_display_status(
-                                pdip_ctx_t *ctxp
-                               )
+static void pdip_loop_arm(pdip_loop_entry_t *e)
 {
-  if (WIFEXITED(ctxp->status))
+pdip_loop_ctx_t   *loopp = e->loop;
+pdip_loop_entry_t *last;
+unsigned int       i;
+int                armed = 0;
+
+  if (!(e->removed))
   {
-    PDIP_DBG(ctxp, 3, "Process '%s' (%"PRIPID") exited with status %d\n", ctxp->av[0], ctxp->pid, WEXITSTATUS(ctxp->status));
-    return;
+    if (e->pat && (e->deadline.tv_sec >= 0))
+    {
+      e->wake = e->deadline;
+      armed = 1;
+    }
+
+    if (e->hup && (e->pidfd < 0) && (!armed || pdip_loop_before(&(e->poll), &(e->wake))))
+    {
+      e->wake = e->poll;
+      armed = 1;
+    }
   }
 
-  if (WIFSIGNALED(ctxp->status))
+  if (armed)
   {
-    PDIP_DBG(ctxp, 3, "Process '%s' (%"PRIPID") received signal %d\n", ctxp->av[0], ctxp->pid, WTERMSIG(ctxp->status));
+    // The heap has room for all the entries (cf. pdip_loop_add())
+    if (e->heap_idx < 0)
+    {
+      pdip_loop_heap_set(loopp, loopp->heap_nb, e);
+      loopp->heap_nb ++;
+    }
+
+    pdip_loop_heap_up(loopp, (unsigned int)(e->heap_idx));
+    pdip_loop_heap_down(loopp, (unsigned int)(e->heap_idx));
     return;
   }
-} // pdip_display_status
+
+  // No timer: the last entry of the heap takes the place of the entry
+  if (e->heap_idx >= 0)
+  {
+    i = (unsigned int)(e->heap_idx);
+    e->heap_idx = -1;
+    loopp->heap_nb --;
+    if (i < loopp->heap_nb)
+    {
+      last = loopp->heap[loopp->heap_nb];
+      pdip_loop_heap_set(loopp, i, last);
+      pdip_loop_heap_up(loopp, i);
+      pdip_loop_heap_down(loopp, (unsigned int)(last->heap_idx));
+    }
+  }
+} // pdip_loop_arm
 
 
-//----------------------------------------------------------------------------
-// Name        : pdip_update_dead_child
-// Description : Update the context of a dead child
-// Return      : None
-//----------------------------------------------------------------------------
-static void pdip_update_dead_child(
-                                   pdip_ctx_t *ctxp,
-                                   int         status
-                                  )
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_detach
+// Usage  : Remove an object from its loop. The entry is freed at once if the
+//          loop is not running, otherwise at the end of the current iteration
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_loop_detach(pdip_loop_entry_t *e)
 {
+pdip_loop_ctx_t *loopp = e->loop;
+pdip_ctx_t      *ctxp = e->ctxp;
 
-  // Update the context
-  PDIP_MASK_SIG();
-  ctxp->status = status;
-  ctxp->state  = PDIP_STATE_DEAD;
-  ctxp->pid    = -1;
-  PDIP_UNMASK_SIG();
+  if (!(e->hup))
+  {
+    (void)epoll_ctl(loopp->epfd, EPOLL_CTL_DEL, ctxp->pty_master, (struct epoll_event *)0);
+  }
+  else if ((e->pidfd >= 0) && (e->pidfd == ctxp->pidfd))
+  {
+    // The process file descriptor is still open (process not reaped)
+    (void)epoll_ctl(loopp->epfd, EPOLL_CTL_DEL, e->pidfd, (struct epoll_event *)0);
+  }
 
-  pdip_display_status(ctxp);
+  // Restore the blocking mode of the PTY
+  if (ctxp->pty_master >= 0)
+  {
+    (void)fcntl(ctxp->pty_master, F_SETFL, e->fl);
+  }
 
-} // pdip_update_dead_child
+  // Data passed to a callback which removes the object
+  pdip_loop_release(ctxp);
 
+  PDIP_OBJ_LOCK(ctxp, send_mtx);
 
+  ctxp->loop_entry = (pdip_loop_entry_t *)0;
 
-//----------------------------------------------------------------------------
-// Name        : pdip_wait_child
-// Description : Wait for the termination of a child process (blocking)
-// Return      : 0, if OK (process is dead)
-//               -1, if error (errno is set)
-//----------------------------------------------------------------------------
-static int pdip_wait_child(
-                           pdip_ctx_t *ctxp,
-                           int        *status
-                          )
-{
-int   rc;
-int   state;
-pid_t pid;
+  // The queued data are written out as by pdip_send() out of the loop
+  if (!(e->hup) && (e->out_off < e->out_len))
+  {
+  struct iovec iov;
 
-  PDIP_MASK_SIG();
-  state = ctxp->state;
-  *status = ctxp->status;
-  pid = ctxp->pid;
-  PDIP_UNMASK_SIG();
+    iov.iov_base = e->out + e->out_off;
+    iov.iov_len  = e->out_len - e->out_off;
+    (void)pdip_writev_unlocked(ctxp, &iov, 1);
+  }
+  e->out_off = e->out_len = 0;
 
-  // If the process is not marked dead, call the system to check
-  if (PDIP_STATE_DEAD != state)
-  {
-    // When they dies, the childs interrupt waitpid()
-    do
-    {
-      rc = waitpid(pid, status, 0);
-    } while ((-1 == rc) && (EINTR == errno));
+  PDIP_OBJ_UNLOCK(ctxp, send_mtx);
 
-    // waitpid() returns the pid if the child is dead
-    // otherwise it returns -1
-    if (pid == rc)
-    {
-      // Child is dead
-      rc = 0;
+  e->removed = 1;
+  loopp->nb --;
 
-      // Update the context
-      pdip_update_dead_child(ctxp, *status);
-    }
+  pdip_loop_unpend(e);
+  pdip_loop_arm(e);
+  pdip_loop_unlink(loopp, e);
 
-    // If -1 == rc, child is not dead or error
+  // The entry may be referenced by the events of the current iteration
+  if (loopp->running)
+  {
+    e->next = loopp->removed;
+    loopp->removed = e;
   }
-  else // Process marked dead
+  else
   {
-    rc = 0;
+    free(e->out);
+    free(e);
   }
+} // pdip_loop_detach
 
-  // errno is set if rc is negative
-  return rc;
 
-} // pdip_wait_child
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_process
+// Usage  : Deliver the outstanding data of an object to its callbacks
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_loop_process(pdip_loop_entry_t *e)
+{
+pdip_ctx_t  *ctxp = e->ctxp;
+char        *display = (char *)0;
+size_t       display_sz = 0;
+size_t       data_sz;
+int          rc;
+
+  while (!(e->removed) && ctxp->outstanding_data_offset)
+  {
+    if (e->pat)
+    {
+      // The outstanding data are scanned in place
+      data_sz = 0;
+      ctxp->view = 1;
+      rc = pdip_look_for_regex(ctxp, e->pat, &display, &display_sz, &data_sz);
+      ctxp->view = 0;
+      if (0 != rc)
+      {
+        // Not found, wait for more data
+        return;
+      }
 
+      pdip_stats_reply(ctxp);
 
-//----------------------------------------------------------------------------
-// Name        : pdip_check_child
-// Description : Check if a child process is terminated (not blocking)
-// Return      : 1, if child is dead
-//               0, if child is not dead
-//               -1, if error (errno is set)
-//----------------------------------------------------------------------------
-static int pdip_check_child(
-			    pdip_ctx_t *ctxp,
-                            int        *status
+      // The pattern is no longer awaited (the callback may await another one)
+      e->pat = (pdip_pat_t *)0;
+      e->deadline.tv_sec = -1;
+      pdip_loop_arm(e);
+
+      PDIP_DBG(ctxp, 2, "Loop: pattern matched on %"PRISIZE" bytes\n", ctxp->view_consume);
+
+      if (e->cb.on_match)
+      {
+        e->cb.on_match((pdip_loop_t)(e->loop), (pdip_t)ctxp, ctxp->view_data, ctxp->view_consume, e->user);
+      }
+    }
+    else if (e->cb.on_data)
+    {
+      ctxp->view_data = ctxp->outstanding_data;
+      ctxp->view_consume = ctxp->outstanding_data_offset;
+      ctxp->outstanding_scan_offset = 0;
+      ctxp->outstanding_scan_id = 0;
+
+      e->cb.on_data((pdip_loop_t)(e->loop), (pdip_t)ctxp, ctxp->view_data, ctxp->view_consume, e->user);
+    }
+    else if (ctxp->on_output)
+    {
+      // The data have been passed to the output callback: they are not
+      // kept while no pattern is awaited
+      pdip_outstanding_consume(ctxp, ctxp->outstanding_data_offset);
+      return;
+    }
+    else
+    {
+      // The data are kept until a pattern is awaited
+      return;
+    }
+
+    // If the callback removed the object, it must not be accessed anymore
+    // (pdip_loop_remove() released the data)
+    if (e->removed)
+    {
+      return;
+    }
+
+    pdip_loop_release(ctxp);
+  } // End while
+} // pdip_loop_process
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_error
+// Usage  : Report a reception error on an object
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_loop_error(
+                            pdip_loop_entry_t *e,
+                            int                err
                            )
 {
-int   rc;
-int   state;
-pid_t pid;
+  e->pat = (pdip_pat_t *)0;
+  e->deadline.tv_sec = -1;
+  pdip_loop_arm(e);
 
-  PDIP_MASK_SIG();
-  state   = ctxp->state;
-  *status = ctxp->status;
-  pid     = ctxp->pid;
-  PDIP_UNMASK_SIG();
+  if (e->cb.on_error)
+  {
+    e->cb.on_error((pdip_loop_t)(e->loop), (pdip_t)(e->ctxp), err, e->user);
+  }
+} // pdip_loop_error
 
-  // If the process is not marked dead, call the system to check
-  if (PDIP_STATE_DEAD != state)
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_output
+// Usage  : Write out the data queued on an object when its PTY is writable
+// Return : None
+// ----------------------------------------------------------------------------
+static void pdip_loop_output(pdip_loop_entry_t *e)
+{
+pdip_ctx_t *ctxp = e->ctxp;
+ssize_t     rc;
+size_t      len;
+int         err = 0;
+
+  PDIP_OBJ_LOCK(ctxp, send_mtx);
+
+  while (e->out_off < e->out_len)
   {
-    if (PDIP_STATE_INIT == state)
+    len = e->out_len - e->out_off;
+    if (len > PDIP_SEND_CHUNK)
     {
-      errno = EPERM;
-      rc = -1;
+      len = PDIP_SEND_CHUNK;
     }
-    else // Program attached to the object
+
+    rc = write(ctxp->pty_master, e->out + e->out_off, len);
+    ctxp->stats.write_calls ++;
+    if (rc < 0)
     {
-      // When they dies, the childs interrupt waitpid()
-      do
+      if (EINTR == errno)
       {
-        rc = waitpid(pid, status, WNOHANG);
-      } while ((-1 == rc) && (EINTR == errno));
+        continue;
+      }
 
-      // waitpid(WNOHANG) returns 0 if the child is not dead yet
-      // otherwise it returns -1
-      if (pid == rc)
+      if (EAGAIN != errno)
       {
-        // Child is dead
-        rc = 1;
-
-        // Update the context
-        pdip_update_dead_child(ctxp, *status);
+        err = errno;
       }
 
-      // If 0 == rc, child is not dead
-      // otherwise error
+      break;
+    }
 
-    } // End if no program attached to the object
-  }
-  else // Process marked dead
+    ctxp->stats.write_bytes += (unsigned long long)rc;
+
+    PDIP_REC_EVENT(ctxp, PDIP_REC_SEND, e->out + e->out_off, rc);
+
+    e->out_off += (size_t)rc;
+  } // End while
+
+  // The room to write is no longer watched once the queue is empty
+  if (err || (e->out_off == e->out_len))
   {
-    rc = 1;
+    e->out_off = e->out_len = 0;
+    (void)pdip_loop_watch(e);
   }
 
-  // errno is set if rc is negative
-  return rc;
+  PDIP_OBJ_UNLOCK(ctxp, send_mtx);
 
-} // pdip_check_child
+  // The death of the controlled process (EIO) is reported by the reception
+  if (err && (EIO != err))
+  {
+    errno = err;
+    PDIP_ERR(ctxp, "write(%d): '%m' (%d)\n", ctxp->pty_master, errno);
+    pdip_loop_error(e, err);
+  }
+} // pdip_loop_output
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_status
-// Usage  : Return the status of the dead controlled program
-// Return : 0, if OK
-//          -1, if error (errno is set)
+// Name   : pdip_loop_input
+// Usage  : Read the data available on an object
+// Return : None
 // ----------------------------------------------------------------------------
-int pdip_status(
-                pdip_t  ctx,
-                int    *status,
-                int     blocking
-               )
+static void pdip_loop_input(pdip_loop_entry_t *e)
 {
-int         obj_status;
-pdip_ctx_t *ctxp;
-int         rc;
+pdip_loop_ctx_t *loopp = e->loop;
+pdip_ctx_t      *ctxp = e->ctxp;
+ssize_t          rc;
+size_t           data_sz;
 
-  if (!ctx)
+  do
   {
-    errno = EINVAL;
-    return -1;
-  }
+    rc = read(ctxp->pty_master, loopp->buf, loopp->buf_sz - 1);
+    ctxp->stats.read_calls ++;
+  } while ((rc < 0) && (EINTR == errno));
 
-  ctxp = (pdip_ctx_t *)ctx;
-
-  if (blocking)
+  if (rc > 0)
   {
-    rc = pdip_wait_child(ctxp, &obj_status);
-    if ((0 == rc) && status)
+    ctxp->stats.read_bytes += (unsigned long long)rc;
+
+    PDIP_DBG(ctxp, 3, "Loop: read %zd bytes from process %"PRIPID"\n", rc, ctxp->pid);
+
+    PDIP_REC_EVENT(ctxp, PDIP_REC_RECV, loopp->buf, rc);
+
+    if (ctxp->screen)
     {
-      *status = obj_status;
+      pdip_screen_feed(ctxp->screen, loopp->buf, (size_t)rc);
     }
-  }
-  else // Non bloking mode
-  {
-    rc = pdip_check_child(ctxp, &obj_status);
-    if (1 == rc)
-    {
-      if (status)
-      {
-        *status = obj_status;
-      }
 
-      rc = 0;
-    }
-    else if (0 == rc)
+    pdip_output(ctxp, loopp->buf, (size_t)rc);
+
+    loopp->buf[rc] = '\0';
+    data_sz = (size_t)rc;
+    if (0 != pdip_append_to_outstanding(ctxp, &(loopp->buf), &(loopp->buf_sz), &data_sz))
     {
-      rc = -1;
-      errno = EAGAIN;
+      pdip_loop_error(e, errno);
+      return;
     }
-  } // End if blocking mode
-
-  return rc;
-} // pdip_status
 
+    pdip_loop_process(e);
+    return;
+  }
 
+  if ((rc < 0) && (EAGAIN == errno))
+  {
+    return;
+  }
 
-// ----------------------------------------------------------------------------
-// Name   : pdip_set_debug_level
-// Usage  : Set the debug level for a given PDIP context (ctx != 0) or
-//          set the global debug level
-// Return : 0, if OK
-//          !0, if error (errno is set)
-// ----------------------------------------------------------------------------
-int pdip_set_debug_level(
-                         pdip_t ctx,
-                         int    level
-                        )
-{
-  // Mutual exclusion with the signal handler
-  PDIP_MASK_SIG();
+  // The slave side is closed (EIO): the controlled process is dying
+  PDIP_DBG(ctxp, 2, "Loop: end of data from process %"PRIPID" (rc=%zd)\n", ctxp->pid, rc);
 
-  if (!ctx)
+  if (ctxp->on_output)
   {
-    pdip_debug_level = level;
+    pdip_output_end(ctxp);
   }
-  else
-  {
-  pdip_ctx_t *ctxp;
 
-    ctxp = (pdip_ctx_t *)ctx;
-    ctxp->debug = level;
-  }
+  (void)epoll_ctl(loopp->epfd, EPOLL_CTL_DEL, ctxp->pty_master, (struct epoll_event *)0);
+  e->hup = 1;
 
-  PDIP_UNMASK_SIG();
+  // The queued data can not be written out anymore
+  PDIP_OBJ_LOCK(ctxp, send_mtx);
+  e->out_off = e->out_len = 0;
+  PDIP_OBJ_UNLOCK(ctxp, send_mtx);
 
-  return 0;
-} // pdip_set_debug_level
+  // The death is an event of the epoll instance if there is a process file
+  // descriptor, otherwise it is polled
+  if (ctxp->pidfd >= 0)
+  {
+  struct epoll_event ev;
 
+    ev.events   = EPOLLIN;
+    ev.data.ptr = e;
+    if (0 == epoll_ctl(loopp->epfd, EPOLL_CTL_ADD, ctxp->pidfd, &ev))
+    {
+      e->pidfd = ctxp->pidfd;
+    }
+  }
 
+  // Otherwise, the first check is done at once
+  if (e->pidfd < 0)
+  {
+    pdip_now(&(e->poll));
+    pdip_loop_arm(e);
+  }
+} // pdip_loop_input
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_cfg_init
-// Usage  : Initialize the configuration of a PDIP object to its default values
-// Return : 0, if OK
-//          -1, if error (errno is set)
+// Name   : pdip_loop_death
+// Usage  : Check the death of the controlled process of an entry whose
+//          terminal is closed. If it is dead, the object is removed from the
+//          loop and the death is reported, otherwise a polled process is
+//          checked again later
+// Return : None
 // ----------------------------------------------------------------------------
-int pdip_cfg_init(
-                  pdip_cfg_t *cfg
-                 )
+static void pdip_loop_death(pdip_loop_entry_t *e)
 {
-  if (!cfg)
+pdip_ctx_t     *ctxp = e->ctxp;
+int             status;
+struct timeval  period;
+
+  if (0 != pdip_status((pdip_t)ctxp, &status, 0))
   {
-    errno = EINVAL;
-    return -1;
+    if (e->pidfd < 0)
+    {
+      period.tv_sec  = 0;
+      period.tv_usec = PDIP_LOOP_DEATH_POLL_MS * 1000;
+      pdip_deadline(&(e->poll), &period);
+      pdip_loop_arm(e);
+    }
+
+    return;
   }
 
-  cfg->dbg_output           = (FILE *)0;
-  cfg->err_output           = (FILE *)0;
-  cfg->debug_level          = 0;
-  cfg->flags                = 0;
-  cfg->cpu                  = (unsigned char *)0;
-  cfg->buf_resize_increment = 0;
+  // The object is removed before the callback which may delete it
+  pdip_loop_detach(e);
 
-  return 0;
-} // pdip_cfg_init
+  if (e->cb.on_death)
+  {
+    e->cb.on_death((pdip_loop_t)(e->loop), (pdip_t)ctxp, status, e->user);
+  }
+} // pdip_loop_death
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_new
-// Usage  : Allocate a PDIP context
-// Return : PDIP object, if OK
-//          0, if error (errno is set)
+// Name   : pdip_loop_expire
+// Usage  : Handle an entry whose date in the heap of the timers is passed:
+//          expired deadline of the awaited pattern or check of the death of
+//          the controlled process
+// Return : None
 // ----------------------------------------------------------------------------
-pdip_t pdip_new(
-                pdip_cfg_t *cfg
-               )
+static void pdip_loop_expire(
+                             pdip_loop_entry_t     *e,
+                             const struct timespec *now
+                            )
 {
-pdip_ctx_t *ctxp;
-
-  // Allocate the context
-  ctxp = (pdip_ctx_t *)malloc(sizeof(pdip_ctx_t));
-  if (!ctxp)
+  if (e->pat && (e->deadline.tv_sec >= 0) && (0 == pdip_deadline_ms(now, &(e->deadline))))
   {
-    PDIP_ERR(0, "malloc(%"PRISIZE"): '%m' (%d)\n", sizeof(pdip_ctx_t), errno);
-    return (pdip_t)0;
-  }
+    PDIP_DBG(e->ctxp, 2, "Loop: timeout on process %"PRIPID"\n", e->ctxp->pid);
 
-  // Populate the context
-  pdip_init_ctx(ctxp);
+    e->ctxp->stats.recv_timeouts ++;
 
-  if (cfg)
-  {
-  int rc;
+    e->pat = (pdip_pat_t *)0;
+    e->deadline.tv_sec = -1;
+    pdip_loop_arm(e);
 
-    rc = pdip_set_user_cfg(ctxp, cfg);
-    if (0 != rc)
+    if (e->cb.on_timeout)
     {
-    int err_sav;
-
-      err_sav = errno;
-      free(ctxp);
-      errno = err_sav;
-      return (pdip_t)0;
+      e->cb.on_timeout((pdip_loop_t)(e->loop), (pdip_t)(e->ctxp), e->user);
     }
-  } // End if a configuration is passed
 
-  ctxp->prev = 0;
+    return;
+  }
 
-  // Insert the object in the global list
+  pdip_loop_death(e);
+} // pdip_loop_expire
 
-  // Mutual exclusion with the signal handler
-  PDIP_MASK_SIG();
 
-  // Mutual exclusion with any other thread creating/deleting an object
-  PDIP_LOCK();
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_new
+// Usage  : Allocate an event loop
+// Return : Event loop, if OK
+//          0, if error (errno is set)
+// ----------------------------------------------------------------------------
+pdip_loop_t pdip_loop_new(void)
+{
+pdip_loop_ctx_t *loopp;
+int              err_sav;
 
-  ctxp->next = pdip_ctx_list;
-  if (pdip_ctx_list)
+  loopp = (pdip_loop_ctx_t *)malloc(sizeof(pdip_loop_ctx_t));
+  if (!loopp)
   {
-    pdip_ctx_list->prev = ctxp;
+    err_sav = errno;
+    PDIP_ERR(0, "malloc(%"PRISIZE"): '%m' (%d)\n", sizeof(pdip_loop_ctx_t), errno);
+    errno = err_sav;
+    return (pdip_loop_t)0;
   }
-  pdip_ctx_list = ctxp;
 
-  PDIP_UNLOCK();
-  PDIP_UNMASK_SIG();
+  loopp->entries   = (pdip_loop_entry_t *)0;
+  loopp->nb        = 0;
+  loopp->pend_head = (pdip_loop_entry_t *)0;
+  loopp->pend_tail = (pdip_loop_entry_t *)0;
+  loopp->pend_nb   = 0;
+  loopp->heap      = (pdip_loop_entry_t **)0;
+  loopp->heap_nb   = 0;
+  loopp->heap_sz   = 0;
+  loopp->removed   = (pdip_loop_entry_t *)0;
+  loopp->running = 0;
+  loopp->stop    = 0;
+  loopp->buf_sz  = PDIP_LOOP_READ_SZ + 1;
+  loopp->buf     = (char *)malloc(loopp->buf_sz);
+  if (!(loopp->buf))
+  {
+    err_sav = errno;
+    PDIP_ERR(0, "malloc(%"PRISIZE"): '%m' (%d)\n", loopp->buf_sz, errno);
+    free(loopp);
+    errno = err_sav;
+    return (pdip_loop_t)0;
+  }
 
-  return (pdip_t)ctxp;
-} // pdip_new
+  loopp->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (loopp->epfd < 0)
+  {
+    err_sav = errno;
+    PDIP_ERR(0, "epoll_create1(): '%m' (%d)\n", errno);
+    free(loopp->buf);
+    free(loopp);
+    errno = err_sav;
+    return (pdip_loop_t)0;
+  }
 
+  return (pdip_loop_t)loopp;
+} // pdip_loop_new
 
-//----------------------------------------------------------------------------
-// Name        : pdip_kill_child
-// Description : Send a signal safely to a child process
-//----------------------------------------------------------------------------
-static int pdip_kill_child(
-                           pdip_ctx_t *ctxp,
-                           int         sig
-                          )
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_delete
+// Usage  : Deallocate an event loop (the objects are removed from it)
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_loop_delete(pdip_loop_t loop)
 {
-int rc;
+pdip_loop_ctx_t *loopp;
 
-  // Mask the SIGCHLD otherwise if the process dies, the signal handler will
-  // set the pid to -1 in the context and so, we would send the signal to
-  // all the processes!
-  PDIP_MASK_SIG();
-  if (ctxp->pid > 0)
-  {
-    PDIP_DBG(ctxp, 2, "Sending signal %d to '%s' (%"PRIPID")\n", sig, ctxp->av[0], ctxp->pid);
-    rc = kill(ctxp->pid, sig);
-  }
-  else
+  if (!loop)
   {
-    errno = ENOENT;
-    rc = -1;
+    errno = EINVAL;
+    return -1;
   }
-  PDIP_UNMASK_SIG();
-
-  PDIP_DBG(ctxp, 4, "kill returned %d\n", rc);
 
-  return rc;
-} // pdip_kill_child
+  loopp = (pdip_loop_ctx_t *)loop;
 
+  if (loopp->running)
+  {
+    errno = EBUSY;
+    return -1;
+  }
 
+  while (loopp->entries)
+  {
+    pdip_loop_detach(loopp->entries);
+  } // End while
 
+  (void)close(loopp->epfd);
+  free(loopp->heap);
+  free(loopp->buf);
+  free(loopp);
 
+  return 0;
+} // pdip_loop_delete
 
 
-//----------------------------------------------------------------------------
-// Name        : pdip_terminate_child
-// Description : Terminate the child process
-//----------------------------------------------------------------------------
-static void pdip_terminate_child(
-                                 pdip_ctx_t *ctxp,
-                                 int        *status
-                                )
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_add
+// Usage  : Register an object in an event loop
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_loop_add(
+                  pdip_loop_t           loop,
+                  pdip_t                ctx,
+                  const pdip_loop_cb_t *cb,
+                  void                 *user
+                 )
 {
-int             obj_status;
-pid_t           pid = ctxp->pid;
-int             rc;
-
-  // Mask the SIGCHLD otherwise if the process dies, the signal handler will
-  // set the pid to -1 in the context
-  (void)pdip_kill_child(ctxp, SIGTERM);
+pdip_loop_ctx_t    *loopp;
+pdip_ctx_t         *ctxp;
+pdip_loop_entry_t  *e;
+struct epoll_event  ev;
+int                 err_sav;
 
-  // From here, the signal handler for SIGCHLD may be triggered
-  // at any moment if the child dies
+  if (!loop || !ctx || !cb)
+  {
+    errno = EINVAL;
+    return -1;
+  }
 
-  // We check immediately as if we are lucky, the kill() system call triggered a
-  // rescheduling giving a chance to the target process to die and report its status
-  rc = pdip_check_child(ctxp, &obj_status);
+  loopp = (pdip_loop_ctx_t *)loop;
+  ctxp = (pdip_ctx_t *)ctx;
 
-  if (rc != 0)
+  if (ctxp->loop_entry || ctxp->view_data)
   {
-    PDIP_ERR(ctxp, "Checking for the termination of '%s' (%d) returned an error: '%m' (%d)...\n", ctxp->av[0], pid, errno);
+    errno = EBUSY;
+    return -1;
   }
 
-  // If the child is not dead
-  if (1 != rc)
+  // The object must be linked to a process
+  if (ctxp->pty_master < 0)
   {
-  struct timespec timeout;
+    errno = EPERM;
+    return -1;
+  }
 
-    if (rc != 0)
-    {
-      PDIP_ERR(ctxp, "Checking for the termination of '%s' (%d) returned an error: '%m' (%d)...\n", ctxp->av[0], pid, errno);
-    }
+  // The heap of the timers has room for all the entries: arming a timer
+  // never fails
+  if (loopp->nb == loopp->heap_sz)
+  {
+  pdip_loop_entry_t **heap;
+  unsigned int        sz = (loopp->heap_sz ? (2 * loopp->heap_sz) : 16);
 
-    // Let's wait some ms before sending SIGKILL
-    // nanosleep() may return prematurely if a signal is
-    // received (e.g. SIGCHLD). In this case it returns -1 and sets errno to EINTR
-    timeout.tv_sec = 0;
-    timeout.tv_nsec = 25000000; // 25 ms
-    rc = nanosleep(&timeout, 0);
-    if (rc != 0)
+    heap = (pdip_loop_entry_t **)realloc(loopp->heap, sz * sizeof(pdip_loop_entry_t *));
+    if (!heap)
     {
-      PDIP_DBG(ctxp, 9, "nanosleep(): rc=%d, errno='%m' (%d)\n", rc, errno);
+      err_sav = errno;
+      PDIP_ERR(ctxp, "realloc(%"PRISIZE"): '%m' (%d)\n", sz * sizeof(pdip_loop_entry_t *), errno);
+      errno = err_sav;
+      return -1;
     }
 
-    // Check the process status after timeout
-    rc = pdip_check_child(ctxp, &obj_status);
-
-    // If the sub-process didn't died ==> SIGKILL
-    if (1 != rc)
-    {
-      (void)pdip_kill_child(ctxp, SIGKILL);
-
-      PDIP_DBG(ctxp, 2, "Waiting for the termination of '%s' (%d)...\n", ctxp->av[0], pid);
-
-      // Wait until the child is dead
-      rc = pdip_wait_child(ctxp, &obj_status);
+    loopp->heap = heap;
+    loopp->heap_sz = sz;
+  }
 
-      if (rc != 0)
-      {
-        PDIP_ERR(ctxp, "Waiting for the termination of '%s' (%d) returned an error: '%m' (%d)...\n", ctxp->av[0], pid, errno);
-      }
+  e = (pdip_loop_entry_t *)malloc(sizeof(pdip_loop_entry_t));
+  if (!e)
+  {
+    err_sav = errno;
+    PDIP_ERR(ctxp, "malloc(%"PRISIZE"): '%m' (%d)\n", sizeof(pdip_loop_entry_t), errno);
+    errno = err_sav;
+    return -1;
+  }
 
-    } // End if sub-process didn't die
-  } // End if sub-process didn't die
+  e->loop             = loopp;
+  e->ctxp             = ctxp;
+  e->cb               = *cb;
+  e->user             = user;
+  e->pat              = (pdip_pat_t *)0;
+  e->deadline.tv_sec  = -1;
+  e->deadline.tv_nsec = 0;
+  e->hup              = 0;
+  e->pidfd            = -1;
+  e->removed          = 0;
+  e->out              = (char *)0;
+  e->out_off          = 0;
+  e->out_len          = 0;
+  e->out_sz           = 0;
+  e->pending          = 0;
+  e->heap_idx         = -1;
+
+  // The reads must not block the loop
+  e->fl = fcntl(ctxp->pty_master, F_GETFL);
+  if ((e->fl < 0) || (fcntl(ctxp->pty_master, F_SETFL, e->fl | O_NONBLOCK) < 0))
+  {
+    err_sav = errno;
+    PDIP_ERR(ctxp, "fcntl(%d): '%m' (%d)\n", ctxp->pty_master, errno);
+    free(e);
+    errno = err_sav;
+    return -1;
+  }
 
-  PDIP_DBG(ctxp, 2, "Process '%s' (%d) is terminated with status %d\n", ctxp->av[0], pid, obj_status);
+  ev.events   = EPOLLIN;
+  ev.data.ptr = e;
+  if (epoll_ctl(loopp->epfd, EPOLL_CTL_ADD, ctxp->pty_master, &ev) < 0)
+  {
+    err_sav = errno;
+    PDIP_ERR(ctxp, "epoll_ctl(%d): '%m' (%d)\n", ctxp->pty_master, errno);
+    (void)fcntl(ctxp->pty_master, F_SETFL, e->fl);
+    free(e);
+    errno = err_sav;
+    return -1;
+  }
 
-  *status = obj_status;
+  // Insert the entry at the beginning of the list
+  e->prev = (pdip_loop_entry_t *)0;
+  e->next = loopp->entries;
+  if (loopp->entries)
+  {
+    loopp->entries->prev = e;
+  }
+  loopp->entries = e;
+  loopp->nb ++;
 
-} // pdip_terminate_child
+  ctxp->loop_entry = e;
 
+  // The data received before the registration are delivered first
+  if (ctxp->outstanding_data_offset)
+  {
+    pdip_loop_pend(e);
+  }
 
+  return 0;
+} // pdip_loop_add
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_sig
-// Usage  : Send a signal to the controlled process
+// Name   : pdip_loop_remove
+// Usage  : Unregister an object from an event loop
 // Return : 0, if OK
 //          -1, if error (errno is set)
 // ----------------------------------------------------------------------------
-int pdip_sig(
-              pdip_t  ctx,
-              int     sig
-            )
+int pdip_loop_remove(
+                     pdip_loop_t  loop,
+                     pdip_t       ctx
+                    )
 {
 pdip_ctx_t *ctxp;
-int         state;
 
-  if (!ctx)
+  if (!loop || !ctx)
   {
     errno = EINVAL;
     return -1;
@@ -2720,56 +10224,248 @@ int         state;
 
   ctxp = (pdip_ctx_t *)ctx;
 
-  // Mutual exclusion with the signal handler
-  PDIP_MASK_SIG();
-  state = ctxp->state;
-  PDIP_UNMASK_SIG();
-
-  if (PDIP_STATE_ALIVE != state)
+  if (!(ctxp->loop_entry) || (ctxp->loop_entry->loop != (pdip_loop_ctx_t *)loop))
   {
-    errno = EPERM;
+    errno = ENOENT;
     return -1;
   }
 
-  return pdip_kill_child(ctxp, sig);
-} // pdip_sig
+  pdip_loop_detach(ctxp->loop_entry);
+
+  return 0;
+} // pdip_loop_remove
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_fd
-// Usage  : Return the file descriptor of a PDIP object
-// Return : File descriptor, if OK
+// Name   : pdip_loop_expect
+// Usage  : Await a pattern on an object registered in an event loop
+//          (NULL pattern to cancel). If 'timeout' is NULL, it is awaited
+//          indefinitely
+// Return : 0, if OK
 //          -1, if error (errno is set)
 // ----------------------------------------------------------------------------
-int pdip_fd(
-            pdip_t  ctx
-           )
+int pdip_loop_expect(
+                     pdip_loop_t      loop,
+                     pdip_t           ctx,
+                     pdip_pattern_t   pattern,
+                     struct timeval  *timeout
+                    )
 {
-pdip_ctx_t *ctxp;
-int         state;
+pdip_ctx_t        *ctxp;
+pdip_loop_entry_t *e;
 
-  if (!ctx)
+  if (!loop || !ctx)
   {
     errno = EINVAL;
     return -1;
   }
 
   ctxp = (pdip_ctx_t *)ctx;
+  e = ctxp->loop_entry;
 
-  PDIP_MASK_SIG();
-  state = ctxp->state;
-  PDIP_UNMASK_SIG();
+  if (!e || (e->loop != (pdip_loop_ctx_t *)loop))
+  {
+    errno = ENOENT;
+    return -1;
+  }
 
-  if (PDIP_STATE_ALIVE != state)
+  e->pat = (pdip_pat_t *)pattern;
+  if (pattern && timeout)
   {
-    PDIP_ERR(ctxp, "Controlled process is not alive\n");
-    errno = EPERM;
+    pdip_deadline(&(e->deadline), timeout);
+  }
+  else
+  {
+    e->deadline.tv_sec = -1;
+  }
+  pdip_loop_arm(e);
+
+  // The outstanding data may already contain the pattern
+  pdip_loop_pend(e);
+
+  return 0;
+} // pdip_loop_expect
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_stop
+// Usage  : Make pdip_loop_run() return
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_loop_stop(pdip_loop_t loop)
+{
+  if (!loop)
+  {
+    errno = EINVAL;
     return -1;
   }
 
-  return ctxp->pty_master;
+  ((pdip_loop_ctx_t *)loop)->stop = 1;
 
-} // pdip_fd
+  return 0;
+} // pdip_loop_stop
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_run
+// Usage  : Dispatch the events of the objects registered in an event loop.
+//          If 'timeout' is NULL, the function runs until the loop is empty
+//          or stopped
+// Return : PDIP_LOOP_EMPTY
+//          PDIP_LOOP_STOPPED
+//          PDIP_LOOP_TIMEOUT
+//          PDIP_LOOP_ERROR (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_loop_run(
+                  pdip_loop_t      loop,
+                  struct timeval  *timeout
+                 )
+{
+pdip_loop_ctx_t    *loopp;
+pdip_loop_entry_t  *e;
+struct epoll_event  events[PDIP_LOOP_EVENTS_NB];
+struct timespec     deadline, now;
+int                 ms, n, i;
+unsigned int        nb_pend;
+int                 rc;
+int                 err_sav;
+
+  if (!loop)
+  {
+    errno = EINVAL;
+    return PDIP_LOOP_ERROR;
+  }
+
+  loopp = (pdip_loop_ctx_t *)loop;
+
+  if (loopp->running)
+  {
+    errno = EBUSY;
+    return PDIP_LOOP_ERROR;
+  }
+
+  if (timeout)
+  {
+    pdip_deadline(&deadline, timeout);
+  }
+
+  loopp->running = 1;
+  loopp->stop = 0;
+  rc = PDIP_LOOP_EMPTY;
+
+  while (loopp->nb)
+  {
+    // Outstanding data to deliver without waiting for new data. The entries
+    // which become pending in the callbacks are processed at the next
+    // iteration
+    for (nb_pend = loopp->pend_nb; nb_pend && loopp->pend_head && !(loopp->stop); nb_pend --)
+    {
+      e = loopp->pend_head;
+      pdip_loop_unpend(e);
+      pdip_loop_process(e);
+    } // End for
+
+    if (loopp->stop)
+    {
+      rc = PDIP_LOOP_STOPPED;
+      break;
+    }
+
+    // Time to wait: up to the nearest timer
+    pdip_now(&now);
+    ms = (timeout ? pdip_deadline_ms(&now, &deadline) : -1);
+    if (loopp->pend_head)
+    {
+      ms = 0;
+    }
+    else if (loopp->heap_nb)
+    {
+    int ms1 = pdip_deadline_ms(&now, &(loopp->heap[0]->wake));
+
+      if ((ms < 0) || (ms1 < ms))
+      {
+        ms = ms1;
+      }
+    }
+
+    n = epoll_wait(loopp->epfd, events, PDIP_LOOP_EVENTS_NB, ms);
+    if (n < 0)
+    {
+      if (EINTR != errno)
+      {
+        err_sav = errno;
+        PDIP_ERR(0, "epoll_wait(): '%m' (%d)\n", errno);
+        errno = err_sav;
+        rc = PDIP_LOOP_ERROR;
+        break;
+      }
+
+      n = 0;
+    }
+
+    for (i = 0; (i < n) && !(loopp->stop); i ++)
+    {
+      e = (pdip_loop_entry_t *)(events[i].data.ptr);
+
+      // The entry may have been removed by a previous callback
+      if (e->removed)
+      {
+        continue;
+      }
+
+      // Process file descriptor of a process which closed its terminal
+      if (e->hup)
+      {
+        pdip_loop_death(e);
+        continue;
+      }
+
+      if (events[i].events & EPOLLOUT)
+      {
+        pdip_loop_output(e);
+      }
+
+      if (!(e->removed) && !(e->hup) && (events[i].events & ~EPOLLOUT))
+      {
+        pdip_loop_input(e);
+      }
+    } // End for
+
+    // Expired timers. The timers armed by the callbacks after 'now' are
+    // handled at the next iteration
+    pdip_now(&now);
+    while (loopp->heap_nb && !(loopp->stop) && pdip_loop_before(&(loopp->heap[0]->wake), &now))
+    {
+      pdip_loop_expire(loopp->heap[0], &now);
+    } // End while
+
+    pdip_loop_purge(loopp);
+
+    if (loopp->stop)
+    {
+      rc = PDIP_LOOP_STOPPED;
+      break;
+    }
+
+    if (timeout)
+    {
+      pdip_now(&now);
+      if (0 == pdip_deadline_ms(&now, &deadline))
+      {
+        rc = PDIP_LOOP_TIMEOUT;
+        break;
+      }
+    }
+  } // End while
+
+  // Entries removed before a break
+  pdip_loop_purge(loopp);
+
+  loopp->running = 0;
+
+  return rc;
+} // pdip_loop_run
 
 
 
@@ -2777,6 +10473,10 @@ static void pdip_unlink_ctx(pdip_ctx_t *ctxp)
 {
 
   PDIP_MASK_SIG();
+
+  // The process may not have been reaped
+  pdip_pid_remove(ctxp);
+
   PDIP_LOCK();
 
   // Unlink the context
@@ -2793,6 +10493,9 @@ static void pdip_unlink_ctx(pdip_ctx_t *ctxp)
     pdip_ctx_list = ctxp->next;
   }
 
+  // The counters of the object remain in those of the library
+  pdip_stats_add(&pdip_stats_deleted, &(ctxp->stats));
+
   PDIP_UNLOCK();
   PDIP_UNMASK_SIG();
 
@@ -2843,7 +10546,7 @@ int         obj_status;
   // to access it atomically
   if (p)
   {
-    state = ctxp->state;
+    state = PDIP_STATE_GET(ctxp);
     obj_status = ctxp->status;
   }
 
@@ -2856,6 +10559,13 @@ int         obj_status;
     return -1;
   }
 
+  // The object must be removed from its event loop first
+  if (ctxp->loop_entry)
+  {
+    errno = EBUSY;
+    return -1;
+  }
+
   // If the controlled program is not finished
   switch (state)
   {
@@ -2903,14 +10613,27 @@ int         obj_status;
   // Unlink the context
   pdip_unlink_ctx(p);
 
+  pdip_rec_close(ctxp);
+
   pdip_free_resources(ctxp);
 
   // The previous call does not touch the links
   // ==> Reset them
   ctxp->prev = ctxp->next = (pdip_ctx_t *)0;
 
+  (void)pthread_mutex_destroy(&(ctxp->send_mtx));
+  (void)pthread_mutex_destroy(&(ctxp->recv_mtx));
+  (void)pthread_mutex_destroy(&(ctxp->rec_mtx));
+
   free(ctxp);
 
+  // The stream of the debug messages of the object may be closed by the
+  // caller after the deletion
+  if (PDIP_LOG_SYNC != __atomic_load_n(&pdip_log_mode, __ATOMIC_RELAXED))
+  {
+    (void)pdip_log_flush();
+  }
+
   // Return the process status if requested
   if (status)
   {
@@ -2923,16 +10646,16 @@ int         obj_status;
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_signal_handler
+// Name   : pdip_signal_dispatch
 // Usage  : Signal handler
 // Return : PDIP_SIG_HANDLED, if the signal has been handled by the service
 //          PDIP_SIG_UNKNOWN, if the signal has not been handled by the service
 //          PDIP_SIG_ERROR, if error
 // ----------------------------------------------------------------------------
-int pdip_signal_handler(
-                        int        sig,   // Received signal
-                        siginfo_t *info   // Context of the signal
-                       )
+static int pdip_signal_dispatch(
+                                int        sig,   // Received signal
+                                siginfo_t *info   // Context of the signal
+                               )
 {
   if (!info)
   {
@@ -2940,6 +10663,12 @@ int pdip_signal_handler(
     return PDIP_SIG_ERROR;
   }
 
+  // The processes are supervised through their pidfd
+  if (pdip_sig_pidfd)
+  {
+    return PDIP_SIG_UNKNOWN;
+  }
+
   switch(sig)
   {
     case SIGCHLD:
@@ -2949,42 +10678,38 @@ int pdip_signal_handler(
       // A controlled program may be dead
 
       // Look for the context to check that it is a controlled program
-      // We use the lock because an alternate thread may run concurrently
-      // on another processor to create/delete objects
-      PDIP_LOCK();
-      ctxp = pdip_ctx_list;
-      while (ctxp)
-      {
-        if (info->si_pid == ctxp->pid)
-	{
-          PDIP_DBG(ctxp, 2, "Catched SIGCHLD from process '%s' (%"PRIPID"), state=%d\n", ctxp->av[0], ctxp->pid, ctxp->state);
-          break;
-	}
-
-        ctxp = ctxp->next;
-      } // End while
-      PDIP_UNLOCK();
+      // The table is read without lock: the other threads which
+      // create/delete objects concurrently on other processors wait for
+      // the end of the handler before freeing what it may be using
+      __atomic_add_fetch(&pdip_sig_active, 1, __ATOMIC_SEQ_CST);
+      ctxp = pdip_pid_lookup(info->si_pid);
 
       if (ctxp)
       {
+        PDIP_DBG(ctxp, 2, "Catched SIGCHLD from process '%s' (%"PRIPID"), state=%d\n", ctxp->av[0], ctxp->pid, PDIP_STATE_GET(ctxp));
+
         // A process may die immediately after execution and
         // consequently, the state may not be updated yet by the father
-        if (PDIP_STATE_ALIVE != ctxp->state)
+        if (PDIP_STATE_ALIVE != PDIP_STATE_GET(ctxp))
 	{
-          pdip_assert(PDIP_STATE_INIT == ctxp->state, "Unexpected state %d for process %"PRIPID"\n", ctxp->state, ctxp->pid);
+          pdip_assert(PDIP_STATE_INIT == PDIP_STATE_GET(ctxp), "Unexpected state %d for process %"PRIPID"\n", PDIP_STATE_GET(ctxp), ctxp->pid);
           PDIP_DBG(ctxp, 1, "Process %"PRIPID" died prematurely!\n", ctxp->pid);
 	}
 
-        ctxp->state = PDIP_STATE_ZOMBIE;
+        PDIP_STATE_SET(ctxp, PDIP_STATE_ZOMBIE);
 
         // The status and reset of pid will be done by a subsequente pdip_status() or pdip_delete()
 
-        PDIP_DBG(ctxp, 1, "ctxp=%p, State=%d\n", ctxp, ctxp->state);
+        PDIP_DBG(ctxp, 1, "ctxp=%p, State=%d\n", ctxp, PDIP_STATE_GET(ctxp));
+
+        __atomic_sub_fetch(&pdip_sig_active, 1, __ATOMIC_SEQ_CST);
 
         return PDIP_SIG_HANDLED;
       }
       else
       {
+        __atomic_sub_fetch(&pdip_sig_active, 1, __ATOMIC_SEQ_CST);
+
         PDIP_DBG(0, 3, "Catched SIGCHLD from process %d which is not linked to any PDIP object\n", info->si_pid);
         return PDIP_SIG_ERROR;
       }
@@ -2998,6 +10723,31 @@ int pdip_signal_handler(
     }
   } // End switch
 
+} // pdip_signal_dispatch
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_signal_handler
+// Usage  : Signal handler. The debug messages of a thread without ring are
+//          dropped while it runs (cf. pdip_log())
+// Return : cf. pdip_signal_dispatch()
+// ----------------------------------------------------------------------------
+int pdip_signal_handler(
+                        int        sig,   // Received signal
+                        siginfo_t *info   // Context of the signal
+                       )
+{
+int rc;
+
+  pdip_log_in_sig ++;
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+  rc = pdip_signal_dispatch(sig, info);
+
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+  pdip_log_in_sig --;
+
+  return rc;
 } // pdip_signal_handler
 
 
@@ -3015,6 +10765,9 @@ int rc;
 
   (void)p;
 
+  pdip_log_in_sig ++;
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
   rc = pdip_signal_handler(sig, info);
 
   // A process linked with PDIP may call fork() at any time. Hence, a SIGCHLD
@@ -3024,6 +10777,9 @@ int rc;
   {
     PDIP_DBG(0, 3, "Signal not handled: rc=%d, sig=%d\n", rc, sig);
   }
+
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+  pdip_log_in_sig --;
 } // pdip_internal_sig_hdl
 
 
@@ -3053,17 +10809,51 @@ int pdip_configure(
   PDIP_UNMASK_SIG();
   PDIP_UNLOCK();
 
-  if (sig_hdl_internal)
+  if (PDIP_SIG_HDL_PIDFD == sig_hdl_internal)
+  {
+  int fd;
+  int rc;
+  int err_sav;
+
+    // Make sure that the system supports the process file descriptors
+    fd = pdip_pidfd_open(getpid());
+    if (fd < 0)
+    {
+      err_sav = errno;
+      PDIP_ERR(0, "pidfd_open(): '%m' (%d)\n", errno);
+      errno = err_sav;
+      goto err;
+    }
+    (void)close(fd);
+
+    // The internal signal handler is no longer needed
+    if (pdip_sig_hdl_internal)
+    {
+      rc = sigaction(SIGCHLD, &pdip_saved_action, 0);
+      if (rc < 0)
+      {
+        err_sav = errno;
+        PDIP_ERR(0, "sigaction(SIGCHLD): '%m' (%d)\n", errno);
+        errno = err_sav;
+        goto err;
+      }
+
+      pdip_sig_hdl_internal = 0;
+    }
+
+    pdip_sig_pidfd = 1;
+  }
+  else if (sig_hdl_internal)
   {
   int              rc;
   int              err_sav;
   struct sigaction action;
 
-    // Register the signal handler
+    // Register the signal handler (the user's handler is saved only once)
     action.sa_sigaction = pdip_internal_sig_hdl;
     action.sa_mask      = pdip_sigset;
     action.sa_flags     = SA_SIGINFO;
-    rc = sigaction(SIGCHLD, &action, &pdip_saved_action);
+    rc = sigaction(SIGCHLD, &action, (pdip_sig_hdl_internal ? (struct sigaction *)0 : &pdip_saved_action));
     if (rc < 0)
     {
       err_sav = errno;
@@ -3073,11 +10863,13 @@ int pdip_configure(
     }
 
     pdip_sig_hdl_internal = 1;
+    pdip_sig_pidfd = 0;
   }
   else
   {
     // The user is supposed to call pdip_signal_handler() from its signal
     // handler for SIGCHLD
+    pdip_sig_pidfd = 0;
   }
 
   return 0;
@@ -3088,6 +10880,249 @@ err:
 } // pdip_configure
 
 
+// ----------------------------------------------------------------------------
+// Name   : pdip_configure_pty_pool
+// Usage  : Set the number of PTY kept ready for pdip_exec() by a background
+//          thread (0 to stop the thread and close the PTY). The calls are
+//          serialized by the global mutex: the thread is stopped and joined
+//          before another call can start or resize the pool
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_configure_pty_pool(
+                            unsigned int sz
+                           )
+{
+int          rc;
+int          err_sav;
+pdip_pty_t  *pool;
+sigset_t     sigall, sigsaved;
+int          join = 0;
+
+  PDIP_LOCK();
+  pthread_mutex_lock(&pdip_pty_pool_mtx);
+
+  // Close the PTY beyond the new size
+  while (pdip_pty_pool_nb > sz)
+  {
+    pdip_pty_close(&(pdip_pty_pool[-- pdip_pty_pool_nb]));
+  } // End while
+
+  if (sz > pdip_pty_pool_sz)
+  {
+    pool = (pdip_pty_t *)realloc(pdip_pty_pool, sz * sizeof(pdip_pty_t));
+    if (!pool)
+    {
+      err_sav = errno;
+      PDIP_ERR(0, "realloc(%u): '%m' (%d)\n", sz, errno);
+      goto err;
+    }
+    pdip_pty_pool = pool;
+  }
+
+  if (sz && !pdip_pty_pool_running)
+  {
+    // The thread does not handle any signal
+    sigfillset(&sigall);
+    (void)pthread_sigmask(SIG_BLOCK, &sigall, &sigsaved);
+    rc = pthread_create(&pdip_pty_pool_tid, NULL, pdip_pty_pool_thread, NULL);
+    (void)pthread_sigmask(SIG_SETMASK, &sigsaved, 0);
+    if (0 != rc)
+    {
+      err_sav = rc;
+      errno = rc;
+      PDIP_ERR(0, "pthread_create(): '%m' (%d)\n", errno);
+      goto err;
+    }
+    pdip_pty_pool_running = 1;
+  }
+  else if (!sz && pdip_pty_pool_running)
+  {
+    pdip_pty_pool_stop = 1;
+    join = 1;
+  }
+
+  pdip_pty_pool_sz = sz;
+  (void)pthread_cond_broadcast(&pdip_pty_pool_cond);
+
+  pthread_mutex_unlock(&pdip_pty_pool_mtx);
+
+  if (join)
+  {
+    (void)pthread_join(pdip_pty_pool_tid, NULL);
+
+    pthread_mutex_lock(&pdip_pty_pool_mtx);
+    pdip_pty_pool_running = 0;
+    pdip_pty_pool_stop = 0;
+    free(pdip_pty_pool);
+    pdip_pty_pool = (pdip_pty_t *)0;
+    pthread_mutex_unlock(&pdip_pty_pool_mtx);
+  }
+
+  PDIP_UNLOCK();
+
+  return 0;
+
+err:
+
+  pthread_mutex_unlock(&pdip_pty_pool_mtx);
+  PDIP_UNLOCK();
+
+  errno = err_sav;
+
+  return -1;
+} // pdip_configure_pty_pool
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_configure_log
+// Usage  : Set the output mode of the debug messages and the size of the
+//          rings allocated afterwards by the threads (rounded up to a power
+//          of 2, 0 for the default size)
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_configure_log(
+                       int    mode,
+                       size_t ring_sz
+                      )
+{
+int          rc;
+size_t       sz;
+sigset_t     sigall, sigsaved;
+int          join = 0;
+
+  switch(mode)
+  {
+    case PDIP_LOG_SYNC :
+    case PDIP_LOG_ASYNC :
+    case PDIP_LOG_DEFERRED : break;
+
+    default :
+    {
+      errno = EINVAL;
+      return -1;
+    }
+  } // End switch
+
+  if (ring_sz)
+  {
+    if (ring_sz > (((size_t)-1) / 2) + 1)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+    for (sz = PDIP_LOG_RING_SZ_MIN; sz < ring_sz; sz <<= 1)
+    {
+    } // End for
+  }
+  else
+  {
+    sz = PDIP_LOG_RING_SZ;
+  }
+
+  pthread_mutex_lock(&pdip_log_mtx);
+
+  __atomic_store_n(&pdip_log_ring_sz, sz, __ATOMIC_RELAXED);
+
+  if ((PDIP_LOG_ASYNC == mode) && !pdip_log_running)
+  {
+    // The thread does not handle any signal
+    sigfillset(&sigall);
+    (void)pthread_sigmask(SIG_BLOCK, &sigall, &sigsaved);
+    rc = pthread_create(&pdip_log_tid, NULL, pdip_log_thread, NULL);
+    (void)pthread_sigmask(SIG_SETMASK, &sigsaved, 0);
+    if (0 != rc)
+    {
+      pthread_mutex_unlock(&pdip_log_mtx);
+      errno = rc;
+      PDIP_ERR(0, "pthread_create(): '%m' (%d)\n", errno);
+      return -1;
+    }
+    pdip_log_running = 1;
+  }
+  else if ((PDIP_LOG_ASYNC != mode) && pdip_log_running)
+  {
+    pdip_log_stop = 1;
+    (void)pthread_cond_signal(&pdip_log_cond);
+    join = 1;
+  }
+
+  __atomic_store_n(&pdip_log_mode, mode, __ATOMIC_RELAXED);
+
+  // The messages stored so far are printed before the synchronous ones
+  if (PDIP_LOG_SYNC == mode)
+  {
+    pdip_log_drain();
+  }
+
+  pthread_mutex_unlock(&pdip_log_mtx);
+
+  if (join)
+  {
+    (void)pthread_join(pdip_log_tid, NULL);
+
+    pthread_mutex_lock(&pdip_log_mtx);
+    pdip_log_running = 0;
+    pdip_log_stop = 0;
+    pthread_mutex_unlock(&pdip_log_mtx);
+  }
+
+  return 0;
+} // pdip_configure_log
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_log_flush
+// Usage  : Print the debug messages stored in the rings of the threads
+// Return : 0, if OK
+//          -1, if error (errno is set)
+// ----------------------------------------------------------------------------
+int pdip_log_flush(void)
+{
+  pthread_mutex_lock(&pdip_log_mtx);
+
+  pdip_log_drain();
+
+  pthread_mutex_unlock(&pdip_log_mtx);
+
+  return 0;
+} // pdip_log_flush
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_atfork_done
+// Usage  : Set when the fork handlers are registered
+// ----------------------------------------------------------------------------
+static int pdip_atfork_done;
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_prepare_fork
+// Usage  : Hold the global mutex across fork() to make the child inherit a
+//          consistent list of contexts, table of processes and pool of PTY
+// ----------------------------------------------------------------------------
+static void pdip_prepare_fork(void)
+{
+  PDIP_LOCK();
+  pthread_mutex_lock(&pdip_pty_pool_mtx);
+  pthread_mutex_lock(&pdip_log_mtx);
+} // pdip_prepare_fork
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_parent_fork
+// Usage  : Release the global mutex in the father after fork()
+// ----------------------------------------------------------------------------
+static void pdip_parent_fork(void)
+{
+  pthread_mutex_unlock(&pdip_log_mtx);
+  pthread_mutex_unlock(&pdip_pty_pool_mtx);
+  PDIP_UNLOCK();
+} // pdip_parent_fork
+
+
 // ----------------------------------------------------------------------------
 // Name   : pdip_child_fork
 // Usage  : Clear all the contexts of the library without killing the
@@ -3095,8 +11130,29 @@ err:
 // ----------------------------------------------------------------------------
 static void pdip_child_fork(void)
 {
-pdip_ctx_t *ctxp;
-int         rc;
+pdip_ctx_t      *ctxp;
+pdip_log_ring_t *ring;
+int              rc;
+
+  // The mutex has been locked by the forking thread (pdip_prepare_fork())
+  // which is the only thread of the child
+  PDIP_UNLOCK();
+
+  // The drain thread does not exist in the child: the debug messages are
+  // printed synchronously and those of the father are discarded. The rings
+  // of the other threads are freed by the next drain
+  pthread_mutex_unlock(&pdip_log_mtx);
+  pdip_log_mode = PDIP_LOG_SYNC;
+  pdip_log_running = 0;
+  pdip_log_stop = 0;
+  for (ring = pdip_log_rings; ring; ring = ring->next)
+  {
+    ring->tail = ring->head;
+    if (ring != pdip_log_self)
+    {
+      ring->dead = 1;
+    }
+  } // End for
 
   PDIP_DBG(0, 5, "PDIP forked from process %d!\n", getppid());
 
@@ -3111,23 +11167,65 @@ int         rc;
     }
   }
 
+  // The signal handlers which were running in the other threads of the
+  // father do not exist in the child
+  pdip_sig_active = 0;
+
+  // The supervision mode is reset as the other settings of the library
+  pdip_sig_pidfd = 0;
+
+  // The contexts are only forgotten: their memory is not freed as the other
+  // threads of the father may have been updating them (without the global
+  // mutex) at the time of the fork(). The memory is released along with the
+  // address space of the child upon exec() or exit()
   while (pdip_ctx_list)
   {
     ctxp = pdip_ctx_list;
 
-    // Free the resources et reinitialize the context
-    (void)pdip_free_resources(ctxp);
+    // Close the master side of the PTY and the process file descriptor
+    if (ctxp->pty_master >= 0)
+    {
+      (void)close(ctxp->pty_master);
+    }
+    if (ctxp->pidfd >= 0)
+    {
+      (void)close(ctxp->pidfd);
+    }
+
+    // The recording belongs to the father
+    if (ctxp->rec)
+    {
+      (void)close(ctxp->rec->fd);
+    }
 
     // Unlink the context
     pdip_unlink_ctx(ctxp);
 
-    // For debug purposes before freeing
+    // For debug purposes
     ctxp->prev = ctxp->next = (pdip_ctx_t *)0;
 
-    // Free the context
-    free(ctxp);
+  } // End while
+
+  if (pdip_pid_tab)
+  {
+    free(pdip_pid_tab->slots);
+    free(pdip_pid_tab);
+    pdip_pid_tab = (pdip_pid_tab_t *)0;
+  }
 
+  // The refilling thread does not exist in the child: the pool is emptied.
+  // Its mutex and condition are not destroyed as the thread of the father
+  // may be waiting on them (they are reinitialized by pdip_lib_initialize())
+  pthread_mutex_unlock(&pdip_pty_pool_mtx);
+  while (pdip_pty_pool_nb)
+  {
+    pdip_pty_close(&(pdip_pty_pool[-- pdip_pty_pool_nb]));
   } // End while
+  free(pdip_pty_pool);
+  pdip_pty_pool = (pdip_pty_t *)0;
+  pdip_pty_pool_sz = 0;
+  pdip_pty_pool_running = 0;
+  pdip_pty_pool_stop = 0;
 
   pdip_nb_cpu = 0;
 
@@ -3156,7 +11254,8 @@ int         rc;
 // ----------------------------------------------------------------------------
 int pdip_lib_initialize(void)
 {
-int rc;
+int                rc;
+pthread_condattr_t cond_attr;
 
   // Initialize the mutex
   rc = pthread_mutex_init(&pdip_mtx, NULL);
@@ -3167,6 +11266,58 @@ int rc;
     return -1;
   }
 
+  // Initialize the mutex and the condition of the pool of PTY
+  rc = pthread_mutex_init(&pdip_pty_pool_mtx, NULL);
+  if (rc != 0)
+  {
+    errno = rc;
+    PDIP_ERR(0, "pthread_mutex_init(): '%m' (%d)\n", errno);
+    return -1;
+  }
+
+  rc = pthread_cond_init(&pdip_pty_pool_cond, NULL);
+  if (rc != 0)
+  {
+    errno = rc;
+    PDIP_ERR(0, "pthread_cond_init(): '%m' (%d)\n", errno);
+    return -1;
+  }
+
+  // Initialize the mutex and the condition of the debug messages (the
+  // condition is waited with a timeout on CLOCK_MONOTONIC)
+  rc = pthread_mutex_init(&pdip_log_mtx, NULL);
+  if (rc != 0)
+  {
+    errno = rc;
+    PDIP_ERR(0, "pthread_mutex_init(): '%m' (%d)\n", errno);
+    return -1;
+  }
+
+  (void)pthread_condattr_init(&cond_attr);
+  (void)pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+  rc = pthread_cond_init(&pdip_log_cond, &cond_attr);
+  (void)pthread_condattr_destroy(&cond_attr);
+  if (rc != 0)
+  {
+    errno = rc;
+    PDIP_ERR(0, "pthread_cond_init(): '%m' (%d)\n", errno);
+    return -1;
+  }
+
+  // The thread specific key is inherited by the child processes
+  if (!pdip_log_key_done)
+  {
+    rc = pthread_key_create(&pdip_log_key, pdip_log_thread_exit);
+    if (rc != 0)
+    {
+      errno = rc;
+      PDIP_ERR(0, "pthread_key_create(): '%m' (%d)\n", errno);
+      return -1;
+    }
+
+    pdip_log_key_done = 1;
+  }
+
   // Get the number of CPUs
   rc = sysconf(_SC_NPROCESSORS_ONLN);
   if (rc < 0)
@@ -3182,12 +11333,19 @@ int rc;
   (void)sigemptyset(&pdip_sigset);
   (void)sigaddset(&pdip_sigset, SIGCHLD);
 
-  rc = pthread_atfork(0, 0, pdip_child_fork);
-  if (0 != rc)
+  // The fork handlers are inherited by the child processes: they must be
+  // registered only once as pdip_prepare_fork() locks the mutex
+  if (!pdip_atfork_done)
   {
-    errno = rc;
-    PDIP_ERR(0, "pthread_atfork(): '%m' (%d)\n", errno);
-    return -1;
+    rc = pthread_atfork(pdip_prepare_fork, pdip_parent_fork, pdip_child_fork);
+    if (0 != rc)
+    {
+      errno = rc;
+      PDIP_ERR(0, "pthread_atfork(): '%m' (%d)\n", errno);
+      return -1;
+    }
+
+    pdip_atfork_done = 1;
   }
 
   return 0;
@@ -3226,6 +11384,26 @@ static void pdip_lib_exit(void)
     (void)pdip_delete(pdip_ctx_list, 0);
   } // End while
 
+  if (pdip_pid_tab)
+  {
+    free(pdip_pid_tab->slots);
+    free(pdip_pid_tab);
+    pdip_pid_tab = (pdip_pid_tab_t *)0;
+  }
+
+  // Stop the refilling of the pool of PTY
+  if (pdip_pty_pool_sz)
+  {
+    (void)pdip_configure_pty_pool(0);
+  }
+
+  // Stop the drain thread and print the remaining debug messages
+  (void)pdip_configure_log(PDIP_LOG_SYNC, 0);
+
+  (void)pthread_cond_destroy(&pdip_log_cond);
+  (void)pthread_mutex_destroy(&pdip_log_mtx);
+  (void)pthread_cond_destroy(&pdip_pty_pool_cond);
+  (void)pthread_mutex_destroy(&pdip_pty_pool_mtx);
   (void)pthread_mutex_destroy(&pdip_mtx);
 
 } // pdip_lib_exit
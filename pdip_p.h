@@ -36,6 +36,181 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <signal.h>
+#include <regex.h>
+#include <time.h>
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_ac_t
+// Usage  : Aho-Corasick automaton looking for several literals in one pass
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  // Number of states
+  unsigned int nb_states;
+
+  // Transitions (nb_states x 256 entries)
+  int *next;
+
+  // First literal recognized in each state (-1 if none)
+  int *out;
+
+  // Nearest state on the suffix links which recognizes a literal (-1 if none)
+  int *dict;
+
+  // Next literal equal to a given literal (-1 if none)
+  int *out_next;
+
+  // Length of the longest literal
+  size_t max_len;
+} pdip_ac_t;
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pat_t
+// Usage  : Precompiled regular expression
+// Note   : Once compiled, the object is only read by the reception services.
+//          Hence, it can be shared by multiple threads and objects
+// ----------------------------------------------------------------------------
+typedef struct pdip_pat
+{
+  // Source of the regular expression
+  char *regular_expr;
+
+  // Compilation flags passed to regcomp()
+  int cflags;
+
+  // Unique identifier of the compiled regular expression
+  unsigned long id;
+
+  // Set if the regular expression can not match a newline
+  // (the matches are confined into one line)
+  int single_line;
+
+  // If the regular expression does not contain any metacharacter except
+  // a leading '^' and/or a trailing '$', the literal string to look for
+  // with a substring search instead of regexec()
+  char   *literal;
+  size_t  literal_len;
+  int     literal_bol;  // Anchored at the beginning of a line ('^')
+  int     literal_eol;  // Anchored at the end of a line ('$')
+
+  // Compiled regular expression
+  regex_t regex;
+
+  // Combination of several patterns (pdip_recv_any())
+  // . If all the alternatives are literals, they are looked for with
+  //   an Aho-Corasick automaton
+  // . Otherwise, 'regex' is the alternation "(alt0)|(alt1)|..." and
+  //   'alt_group' is the subexpression number of each alternative. If it is
+  //   NULL (back-references), the alternatives are looked for one by one
+  unsigned int       alt_nb;     // Number of alternatives (0 if not a combination)
+  struct pdip_pat  **alt;        // Alternatives
+  unsigned long     *alt_id;     // Identifiers of the alternatives
+  size_t            *alt_group;
+  pdip_ac_t         *ac;
+} pdip_pat_t;
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_filt_gap_t
+// Usage  : Removed bytes in the filtered copy of the outstanding data: the
+//          byte at offset 'filt' in the copy is at offset 'raw' in the
+//          outstanding data (the following bytes up to the next gap are
+//          contiguous in both)
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  size_t filt;
+  size_t raw;
+} pdip_filt_gap_t;
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_screen_t
+// Usage  : Virtual screen on which the output of the controlled process is
+//          rendered by a VT100/xterm emulator (cf. pdip_recv_screen()). The
+//          parser keeps its state across the reads
+// ----------------------------------------------------------------------------
+#define PDIP_SCR_PARAMS_MAX 16
+
+typedef struct
+{
+  unsigned int    rows;
+  unsigned int    cols;
+
+  // Code points of the cells (rows x cols) and of the alternate screen
+  // (the one which is not displayed)
+  uint32_t       *cells;
+  uint32_t       *alt;
+  int             alt_on;
+
+  // Rows modified since the last search of pdip_recv_screen()
+  unsigned char  *dirty;
+
+  // Cursor. 'wrap' is set when a character has been written in the last
+  // column (the cursor goes to the next line with the next character)
+  unsigned int    row;
+  unsigned int    col;
+  int             wrap;
+  unsigned int    saved_row;
+  unsigned int    saved_col;
+
+  // Scrolling region (first and last rows)
+  unsigned int    top;
+  unsigned int    bottom;
+
+  // State of the parser
+  int             state;
+#define PDIP_SCR_GROUND   0
+#define PDIP_SCR_ESC      1  // ESC received
+#define PDIP_SCR_CSI      2  // Control sequence (ESC [)
+#define PDIP_SCR_OSC      3  // Operating system command (ESC ])
+#define PDIP_SCR_OSC_ESC  4  // ESC received in an OSC
+#define PDIP_SCR_CHARSET  5  // Designation of a character set (ESC ( ...)
+  unsigned int    params[PDIP_SCR_PARAMS_MAX];
+  unsigned int    nparams;   // Index of the current parameter
+  int             priv;      // Private marker of the control sequence
+
+  // Pending UTF-8 sequence
+  uint32_t        cp;
+  unsigned int    cp_left;
+
+  // A row rendered in UTF-8 (4 bytes per cell at most + NUL)
+  char           *line;
+} pdip_screen_t;
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_rec_t
+// Usage  : Recorder of the session of an object (cf. pdip_rec_hdr_t). The
+//          events are copied into a buffer written out when it is full or
+//          into a window of the file mapped in memory (PDIP_FLAG_RECORD_MMAP)
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  char            *path;
+  int              fd;
+
+  // Set if the file is mapped
+  int              map;
+
+  // Buffer or mapped window, 'buf_len' bytes are used
+  char            *buf;
+  size_t           buf_sz;
+  size_t           buf_len;
+
+  // Offset of the mapped window in the file
+  off_t            map_off;
+
+  // Start of the session (CLOCK_MONOTONIC)
+  struct timespec  start;
+} pdip_rec_t;
 
 
 
@@ -62,9 +237,16 @@ typedef struct pdip_ctx
   // Flags
   int flags;
 
+  // Creation of the controlled process (PDIP_SPAWN_xxx)
+  unsigned int spawn;
+
   // Master side of the PTY
   int pty_master;
 
+  // Process file descriptor of the controlled process (PDIP_SIG_HDL_PIDFD
+  // mode, -1 otherwise)
+  int pidfd;
+
   // Debug level
   int debug;
 
@@ -74,26 +256,305 @@ typedef struct pdip_ctx
   // Status of the dead controlled process
   volatile int status; // volatile as it is updated asynchronously by signal handler
 
-  // State of the controlled process
-  volatile sig_atomic_t state;  // volatile as it is updated asynchronously by signal handler
+  // State of the controlled process (accessed atomically as it is updated
+  // asynchronously by the signal handler and by the sending and receiving
+  // threads, cf. PDIP_STATE_GET())
+  volatile sig_atomic_t state;
 #define PDIP_STATE_INIT    0
 #define PDIP_STATE_ALIVE   1
 #define PDIP_STATE_ZOMBIE  2
 #define PDIP_STATE_DEAD    3
 
-  // Outstanding data
+  // Outstanding data: 'outstanding_data_offset' bytes (NUL terminated)
+  // beginning at 'outstanding_data' in 'outstanding_buf'. The consumed
+  // data merely move 'outstanding_data' forward
+  char    *outstanding_buf;
+  size_t   outstanding_buf_sz;
   char    *outstanding_data;
-  size_t   outstanding_data_sz;
   size_t   outstanding_data_offset;
 
+  // The complete lines before this offset in the outstanding data have
+  // already been scanned without success for the regular expression
+  // identified by 'outstanding_scan_id'
+  size_t         outstanding_scan_offset;
+  unsigned long  outstanding_scan_id;
+
+  // Copy of the first 'filt_raw' bytes of the outstanding data without the
+  // control characters and escape sequences (PDIP_FLAG_FILTER_CTRL). The
+  // gaps map the offsets in the copy to the offsets in the outstanding data
+  char            *filt_buf;
+  size_t           filt_buf_sz;
+  size_t           filt_len;
+  size_t           filt_raw;
+  pdip_filt_gap_t *filt_gaps;
+  size_t           filt_gaps_nb;
+  size_t           filt_gaps_sz;
+
+  // Last successful pattern matching: index of the alternative which
+  // matched (pdip_recv_any()) and offset of the beginning of the match
+  unsigned int   match_alt;
+  size_t         match_start;
+
+  // Borrowed view of the received data (pdip_recv_view()). 'view' is set
+  // during the reception to return the matching outstanding data without
+  // copy. They are consumed only by pdip_release() ('view_consume' bytes).
+  // The data read without synchronization land in 'view_buf'
+  int            view;
+  const char    *view_data;      // Not NULL while a view is held
+  size_t         view_consume;
+  char          *view_buf;
+  size_t         view_buf_sz;
+
   size_t buf_resize_increment;
 
+  // Growth policy of the reception buffers (cf. pdip_cfg_t)
+  unsigned int   buf_growth;
+  unsigned int   buf_growth_factor;
+  size_t         buf_max_sz;
+
+  // Overflow policy of the outstanding data (cf. pdip_cfg_t) and temporary
+  // file of PDIP_BUF_OVERFLOW_SPILL (-1 if not created yet)
+  unsigned int   buf_overflow;
+  size_t         buf_lookback;
+  int            spill_fd;
+
+  // Performance counters (cf. pdip_stats()) and date of the last
+  // pdip_send() in nanoseconds (0 if no reply is awaited)
+  pdip_stats_t   stats;
+  uint64_t       send_ns;
+
+  // Cache of the regular expressions compiled by pdip_recv()
+  // (the most recently used first)
+  pdip_pat_t    **regex_cache;
+  unsigned int    regex_cache_sz;  // Maximum number of entries
+  unsigned int    regex_cache_nb;  // Current number of entries
+  unsigned long   regex_cache_hits;
+  unsigned long   regex_cache_misses;
+
+  // Entry of the object in an event loop (NULL if not registered)
+  struct pdip_loop_entry *loop_entry;
+
+  // Callback of the received data (cf. pdip_cfg_t) and the incomplete last
+  // line ('output_line_len' bytes) kept until it is completed when
+  // PDIP_FLAG_OUTPUT_LINES is set
+  pdip_output_cb_t  on_output;
+  void             *on_output_user;
+  char             *output_line;
+  size_t            output_line_sz;
+  size_t            output_line_len;
+
+  // Recorder of the session (NULL if not recording). It is kept across the
+  // executions of programs
+  pdip_rec_t       *rec;
+
+  // Virtual screen (NULL if not configured)
+  pdip_screen_t    *screen;
+
+  // Serialization of the sending services, of the receiving services and
+  // of the recording of the session: one thread may send while another one
+  // receives (cf. pdip_send_lock())
+  pthread_mutex_t   send_mtx;
+  pthread_mutex_t   recv_mtx;
+  pthread_mutex_t   rec_mtx;
+
   struct pdip_ctx *next;
   struct pdip_ctx *prev;
 } pdip_ctx_t;
 
 
 
+// ----------------------------------------------------------------------------
+// Name   : pdip_pty_t
+// Usage  : Pair of master/slave sides of a PTY ready to be attached to a
+//          controlled process
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  int master;
+  int slave;
+} pdip_pty_t;
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_spawn_t
+// Usage  : Parameters of the child process running the controlled program
+//          until it calls execvp(). With PDIP_SPAWN_VFORK, the child shares
+//          the memory of the father: it reports the failures into 'err_step'
+//          and 'err' instead of displaying them
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  // Slave and master sides of the PTY
+  int             fds;
+  int             pty_master;
+
+  int             flags;
+  int             ac;
+  char          **av;
+
+  // CPU affinity (NULL if none)
+  unsigned char  *cpu;
+  unsigned int    nb_cpu;
+
+  // Signal mask to restore before the execution of the program
+  sigset_t        sigmask;
+
+  // Failed service (NULL if none) and its errno
+  const char     *err_step;
+  int             err;
+} pdip_spawn_t;
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pid_slot_t
+// Usage  : Slot of the table of the controlled processes
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  // Process id (PDIP_PID_FREE if the slot has never been used,
+  // PDIP_PID_DELETED if the process has been removed)
+  volatile pid_t       pid;
+#define PDIP_PID_FREE     0
+#define PDIP_PID_DELETED  -1
+
+  // Object controlling the process
+  pdip_ctx_t * volatile ctxp;
+} pdip_pid_slot_t;
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_pid_tab_t
+// Usage  : Open addressing hash table of the controlled processes indexed by
+//          their pid. It is read without lock by the signal handler: the
+//          updates are made under the global mutex and a table is freed only
+//          when no signal handler is running
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  // Number of slots (power of 2)
+  unsigned int      sz;
+
+  // Number of processes
+  unsigned int      nb;
+
+  // Number of slots which are not free (processes and deleted slots)
+  unsigned int      used;
+
+  pdip_pid_slot_t  *slots;
+} pdip_pid_tab_t;
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_entry_t
+// Usage  : Object registered in an event loop
+// ----------------------------------------------------------------------------
+typedef struct pdip_loop_entry
+{
+  struct pdip_loop *loop;
+  pdip_ctx_t       *ctxp;
+
+  // User callbacks and their parameter
+  pdip_loop_cb_t    cb;
+  void             *user;
+
+  // Flags of the master side of the PTY before the registration
+  int               fl;
+
+  // Awaited pattern (NULL if none) and its deadline on CLOCK_MONOTONIC
+  // (tv_sec < 0 if none)
+  pdip_pat_t       *pat;
+  struct timespec   deadline;
+
+  // Set when the outstanding data must be processed without waiting for
+  // new data (e.g. new pattern awaited). The entry is then linked in the
+  // list of the pending entries of the loop
+  int               pending;
+  struct pdip_loop_entry *pend_next;
+  struct pdip_loop_entry *pend_prev;
+
+  // Next date on CLOCK_MONOTONIC at which the entry must be looked at
+  // (deadline of the awaited pattern or check of the death of the process)
+  // and index of the entry in the heap of the timers of the loop (-1 if
+  // none)
+  struct timespec   wake;
+  int               heap_idx;
+
+  // Date of the next check of the death of the controlled process when it
+  // is polled
+  struct timespec   poll;
+
+  // Set when the slave side of the PTY is closed: the entry waits for the
+  // death of the controlled process
+  int               hup;
+
+  // Process file descriptor watched by the epoll instance while waiting for
+  // the death of the controlled process (-1 if the death is polled)
+  int               pidfd;
+
+  // Set when the entry is removed from the loop. It is freed at the end of
+  // the current iteration of the loop (it is then linked through 'next' in
+  // the list of the removed entries)
+  int               removed;
+
+  // Data sent while the master side of the PTY was full: they are written
+  // out from 'out_off' to 'out_len' when it becomes writable (EPOLLOUT).
+  // Protected by the sending lock of the object
+  char             *out;
+  size_t            out_off;
+  size_t            out_len;
+  size_t            out_sz;
+
+  struct pdip_loop_entry *next;
+  struct pdip_loop_entry *prev;
+} pdip_loop_entry_t;
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_loop_ctx_t
+// Usage  : Event loop
+// ----------------------------------------------------------------------------
+typedef struct pdip_loop
+{
+  // epoll instance watching the master sides of the PTY
+  int                 epfd;
+
+  // Registered objects
+  pdip_loop_entry_t  *entries;
+  unsigned int        nb;
+
+  // Entries with outstanding data to process without waiting for new data
+  // (FIFO)
+  pdip_loop_entry_t  *pend_head;
+  pdip_loop_entry_t  *pend_tail;
+  unsigned int        pend_nb;
+
+  // Min-heap of the entries with a timer ordered by their 'wake' date. It
+  // has room for all the registered entries
+  pdip_loop_entry_t **heap;
+  unsigned int        heap_nb;
+  unsigned int        heap_sz;
+
+  // Entries removed during the current iteration of the loop
+  pdip_loop_entry_t  *removed;
+
+  // Set while pdip_loop_run() is running
+  int                 running;
+
+  // Set by pdip_loop_stop()
+  int                 stop;
+
+  // Reception buffer shared by the objects (NUL terminated)
+  char               *buf;
+  size_t              buf_sz;
+} pdip_loop_ctx_t;
+
+
+
 // ----------------------------------------------------------------------------
 // Name   : PDIP_ERR
 // Usage  : Error messages
@@ -111,22 +572,103 @@ typedef struct pdip_ctx
 // ----------------------------------------------------------------------------
 extern int pdip_debug_level;
 
+// ----------------------------------------------------------------------------
+// Name   : PDIP_DEBUG_MAX
+// Usage  : Highest debug level compiled in the library (the debug messages
+//          of the higher levels are removed at compile time). The default
+//          keeps all the levels (cf. PDIP_DEBUG_MAX option of CMakeLists.txt)
+// ----------------------------------------------------------------------------
+#ifndef PDIP_DEBUG_MAX
+#define PDIP_DEBUG_MAX 10
+#endif // PDIP_DEBUG_MAX
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_log
+// Usage  : Print a debug message followed by a dump of 'dump_len' bytes (if
+//          'dump' is not NULL) or store it in the ring of the calling thread
+//          according to the logging mode (cf. pdip_configure_log())
+// ----------------------------------------------------------------------------
+extern void pdip_log(
+                     int          level,
+                     FILE        *out,
+                     const char  *func,
+                     int          line,
+                     const char  *dump,
+                     size_t       dump_len,
+                     const char  *format,
+                     ...
+                    ) __attribute__ ((format (printf, 7, 8)));
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_log_rec_t
+// Usage  : Debug message stored in a ring, followed by the 'msg_len' bytes of
+//          the formatted message and the 'dump_len' bytes of the dump. A
+//          'len' equal to 0 pads the ring up to its end
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  uint32_t     len;        // Size of the record (multiple of 8)
+  int32_t      level;
+  int32_t      line;
+  uint32_t     msg_len;
+  uint64_t     ts;         // CLOCK_MONOTONIC date in nanoseconds
+  FILE        *out;
+  const char  *func;
+  const void  *dump_addr;  // Address of the dumped zone
+  size_t       dump_len;   // Number of bytes copied in the record
+  size_t       dump_sz;    // Size of the dumped zone
+} pdip_log_rec_t;
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_log_ring_t
+// Usage  : Ring of debug messages of a thread. The thread is the only writer
+//          of 'head' and the drainer the only writer of 'tail' (the
+//          positions are not wrapped, the offsets are taken modulo 'sz')
+// ----------------------------------------------------------------------------
+typedef struct pdip_log_ring
+{
+  char                 *buf;
+  size_t                sz;         // Power of 2
+  uint64_t              head;
+  uint64_t              tail;
+
+  // Head at the beginning of the current drain (the records written
+  // afterwards are left for the next drain)
+  uint64_t              mark;
+
+  // Set while the thread writes a record (a signal handler interrupting
+  // the thread drops its messages)
+  int                   busy;
+
+  // Dropped messages (the ring was full) and those already reported
+  unsigned long         drops;
+  unsigned long         drops_reported;
+
+  // Set when the thread exited
+  int                   dead;
+
+  struct pdip_log_ring *next;
+} pdip_log_ring_t;
+
+
 // ----------------------------------------------------------------------------
 // Name   : PDIP_DBG
 // Usage  : Debug messages
 // ----------------------------------------------------------------------------
 #define PDIP_DBG(ctx, level, format, ...)			     \
-  do { if ((ctx) && (((pdip_ctx_t *)(ctx))->debug >= (level)))	     \
-                    fprintf(((pdip_ctx_t *)(ctx))->dbg_output,	     \
-                            "PDIP(%d-%d) - %s#%d: "format,         \
-                            getpid(), (level),			     \
-                            __FUNCTION__, __LINE__, ## __VA_ARGS__); \
+  do { if ((level) <= PDIP_DEBUG_MAX) {                              \
+    if ((ctx) && (((pdip_ctx_t *)(ctx))->debug >= (level)))	     \
+                    pdip_log((level), ((pdip_ctx_t *)(ctx))->dbg_output, \
+                             __FUNCTION__, __LINE__, (const char *)0, 0, \
+                             format, ## __VA_ARGS__);                \
     else if (pdip_debug_level >= (level))                            \
-                    fprintf(stderr,  	                             \
-                            "PDIP(%d-%d) - %s#%d: "format,         \
-                            getpid(), (level),			     \
-                            __FUNCTION__, __LINE__, ## __VA_ARGS__); \
-                } while(0)
+                    pdip_log((level), stderr,                        \
+                             __FUNCTION__, __LINE__, (const char *)0, 0, \
+                             format, ## __VA_ARGS__);                \
+                } } while(0)
 
 
 
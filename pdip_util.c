@@ -39,7 +39,7 @@
 // Return : None
 // ----------------------------------------------------------------------------
 static void ptr2char(
-                        void          *ptr,
+                        const void    *ptr,
                         unsigned char *buf,
                         unsigned int  len
                        )
@@ -78,14 +78,17 @@ static unsigned int blk_size = 512U;
 
 
 // ----------------------------------------------------------------------------
-// Name   : pdip_dump
-// Usage  : Dump a memory zone on stderr
+// Name   : pdip_dump_file
+// Usage  : Dump a memory zone on a stream. The addresses are displayed from
+//          'addr' (i.e. the original location of a copy of the zone)
 // Return : None
 // ----------------------------------------------------------------------------
-void pdip_dump(
-               char   *buf,
-               size_t  size_buf
-              )
+void pdip_dump_file(
+                    FILE       *out,
+                    const char *buf,
+                    size_t      size_buf,
+                    const void *addr
+                   )
 {
 /* Line format : sizeof(addr)_bytes(16 * 2 + 15)_*ascii(16)* */
 #define DUMP_LINE_SZ (sizeof(void *)*2 + 67)
@@ -122,7 +125,7 @@ size_t              size_line;
   for (i = 0; i < nb_line; i++)
   {
     /* Write the line address */
-    ptr2char(&(buf[k]), (unsigned char *)line, sizeof(void *)*2);
+    ptr2char((const char *)addr + k, (unsigned char *)line, sizeof(void *)*2);
 
     /* dump the "size_line" octets */
     for (j = 0; j < size_line; j ++, k++)
@@ -156,13 +159,13 @@ size_t              size_line;
       }
     } /* End for */
 
-    fprintf(stderr, "%s\n", line);
+    fprintf(out, "%s\n", line);
   } /* End for */
 
   if (last_line)
   {
     /* Line number */
-    ptr2char(&(buf[k]), (unsigned char *)line, sizeof(void *)*2);
+    ptr2char((const char *)addr + k, (unsigned char *)line, sizeof(void *)*2);
 
     /* dump of 16 bytes */
     for (j = 0; j < last_line; j ++, k++)
@@ -203,6 +206,20 @@ size_t              size_line;
       (line + sizeof(void *)*2 + 50)[j]         = ' ';
     } /* End for */
 
-    fprintf(stderr, "%s\n", line);
+    fprintf(out, "%s\n", line);
   } /* End if last_line */
+} // pdip_dump_file
+
+
+// ----------------------------------------------------------------------------
+// Name   : pdip_dump
+// Usage  : Dump a memory zone on stderr
+// Return : None
+// ----------------------------------------------------------------------------
+void pdip_dump(
+               const char *buf,
+               size_t      size_buf
+              )
+{
+  pdip_dump_file(stderr, buf, size_buf, buf);
 } // pdip_dump
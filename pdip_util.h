@@ -60,23 +60,36 @@
 // Return : None
 // ----------------------------------------------------------------------------
 extern void pdip_dump(
-                      char   *buf,
-                      size_t  size_buf
+                      const char *buf,
+                      size_t      size_buf
 	             );
 
 
+// ----------------------------------------------------------------------------
+// Name   : pdip_dump_file
+// Usage  : Dump a memory zone on a stream. The addresses are displayed from
+//          'addr'
+// Return : None
+// ----------------------------------------------------------------------------
+extern void pdip_dump_file(
+                           FILE       *out,
+                           const char *buf,
+                           size_t      size_buf,
+                           const void *addr
+	                  );
+
+
 // ----------------------------------------------------------------------------
 // Name   : PDIP_DUMP
 // Usage  : Print a formatted string followed by a dump of a buffer (b) of 'l'
 //          bytes
 // ----------------------------------------------------------------------------
 #define PDIP_DUMP(ctx, level, format, b, l, ...)		    \
-            do { if ((ctx)->debug >= (level))			    \
+            do { if (((level) <= PDIP_DEBUG_MAX) &&                 \
+                     ((ctx)->debug >= (level)))			    \
                  {                                                  \
-                   fprintf(stderr, "\nPDIP(%d-%d) - %s#%d: "format, \
-			   getpid(), (level),			    \
-                           __FUNCTION__, __LINE__, ## __VA_ARGS__); \
-                   pdip_dump((b), (l));                             \
+                   pdip_log((level), stderr, __FUNCTION__, __LINE__, \
+                            (b), (l), format, ## __VA_ARGS__);      \
                             }                                       \
                           } while(0)
 
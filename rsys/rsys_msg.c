@@ -103,10 +103,10 @@ int        rc;
 //         -1, if error
 //----------------------------------------------------------------------------
 int rsys_send_msg_data(
-                  int     sd,
-                  int     type,
-                  size_t  length,
-                  char   *data
+                  int         sd,
+                  int         type,
+                  size_t      length,
+                  const char *data
 		 )
 {
 rsys_msg_t msg;
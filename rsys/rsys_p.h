@@ -146,10 +146,10 @@ extern int rsys_send_eoc(
 //         -1, if error
 //----------------------------------------------------------------------------
 extern int rsys_send_msg_data(
-                  int     sd,
-                  int     type,
-                  size_t  length,
-                  char   *data
+                  int         sd,
+                  int         type,
+                  size_t      length,
+                  const char *data
 		  );
 
 
@@ -134,6 +134,13 @@ static const char *rsysd_version = PDIP_VERSION;
 #define RSYSD_SH_PROMPT "RSYSD_PDIP> "
 
 
+// ----------------------------------------------------------------------------
+// Name   : rsysd_prompt
+// Usage  : Precompiled regular expression to synchronize on the shells' prompt
+// ----------------------------------------------------------------------------
+static pdip_pattern_t rsysd_prompt;
+
+
 // ----------------------------------------------------------------------------
 // Name   : rsysd_longops
 // Usage  : Options on the command line
@@ -948,6 +955,14 @@ pdip_t          pdip;
     return -1;
   }
 
+  // Compile the regular expression of the prompt once for all the shells
+  rsysd_prompt = pdip_pattern_new("^" RSYSD_SH_PROMPT "$");
+  if (!rsysd_prompt)
+  {
+    RSYSD_ERR("pdip_pattern_new(): '%m' (%d)\n", errno);
+    return -1;
+  }
+
   // Configure the PDIP object (By default, the process attached to it
   // can run on any processor)
   (void)pdip_cfg_init(&cfg);
@@ -1011,8 +1026,8 @@ pdip_t          pdip;
     {
       to.tv_sec = 5;
       to.tv_usec = 0;
-      rc = pdip_recv(pdip, "^" RSYSD_SH_PROMPT "$",
-                     &(shell->display), &(shell->display_sz), &(shell->display_len), &to);
+      rc = pdip_recv_pattern(pdip, rsysd_prompt,
+                             &(shell->display), &(shell->display_sz), &(shell->display_len), &to);
       if ((rc != PDIP_RECV_DATA) && (rc != PDIP_RECV_FOUND))
       {
         RSYSD_ERR("pdip_recv(): Didn't received the prompt (rc = %d)?!?\n", rc);
@@ -1033,8 +1048,8 @@ pdip_t          pdip;
     {
       to.tv_sec = 5;
       to.tv_usec = 0;
-      rc = pdip_recv(pdip, "^" RSYSD_SH_PROMPT "$",
-                     &(shell->display), &(shell->display_sz), &(shell->display_len), &to);
+      rc = pdip_recv_pattern(pdip, rsysd_prompt,
+                             &(shell->display), &(shell->display_sz), &(shell->display_len), &to);
       if ((rc != PDIP_RECV_DATA) && (rc != PDIP_RECV_FOUND))
       {
         RSYSD_ERR("pdip_recv(): Didn't received the prompt (rc = %d)?!?\n", rc);
@@ -1065,6 +1080,12 @@ rsysd_shell_t *shell;
     (void)pdip_delete(shell->pdip, 0);
   } // End for
 
+  if (rsysd_prompt)
+  {
+    (void)pdip_pattern_delete(rsysd_prompt);
+    rsysd_prompt = (pdip_pattern_t)0;
+  }
+
 } // rsysd_delete_shells
 
 
@@ -1109,78 +1130,89 @@ int rc;
 // ----------------------------------------------------------------------------
 static int rsysd_read_shell_display(rsysd_shell_t *shell)
 {
-int   rc;
-char *p;
+int         rc;
+const char *data;
+size_t      data_sz;
+const char *p;
 
   // Wait for the prompt (no timeout as we now that data are available with the select() call)
-  rc = pdip_recv(shell->pdip, "^" RSYSD_SH_PROMPT "$",
-                 &(shell->display), &(shell->display_sz), &(shell->display_len), 0);
+  // The data are forwarded to the client from the internal buffers of PDIP
+  // (no copy)
+  rc = pdip_recv_view(shell->pdip, rsysd_prompt, &data, &data_sz, 0);
   switch(rc)
   {
     case PDIP_RECV_FOUND:
     {
-      // Point at the end of "display of program\nprompt"
-      p = shell->display + shell->display_len; // End of display
-
-      if ((sizeof(RSYSD_SH_PROMPT) - 1) > shell->display_len)
+      if ((sizeof(RSYSD_SH_PROMPT) - 1) > data_sz)
       {
-        RSYSD_ERR("Incoherent display from the shell: are we desynchronized?!? display_len=%zu, display_sz=%zu, display='%s', cmd='%s'\n",
-                 shell->display_len, shell->display_sz, shell->display, shell->client->cmd);
-        return -1;
+        RSYSD_ERR("Incoherent display from the shell: are we desynchronized?!? data_sz=%zu, display='%.*s', cmd='%s'\n",
+                 data_sz, (int)data_sz, (data ? data : ""), shell->client->cmd);
+        rc = -1;
+        break;
       }
- 
+
+      // Point at the end of "display of program\nprompt"
+      p = data + data_sz; // End of display
+
       // Point before the "prompt"
       p -= (sizeof(RSYSD_SH_PROMPT) - 1);
 
       // If there are data before the prompt
-      if (p > shell->display)
+      if (p > data)
       {
         if (*(p - 1) != '\n')
         {
-          RSYSD_ERR("Incoherent display from the shell: are we desynchronized?!? display_len=%zu, display_sz=%zu, display='%s', cmd='%s', p='%s'\n",
-                   shell->display_len, shell->display_sz, shell->display, shell->client->cmd, p);
-          return -1;
+          RSYSD_ERR("Incoherent display from the shell: are we desynchronized?!? data_sz=%zu, display='%.*s', cmd='%s'\n",
+                   data_sz, (int)data_sz, data, shell->client->cmd);
+          rc = -1;
+          break;
         }
 
-        // Put NUL right after the last '\n' before the prompt
-        *p = '\0';
-        rc = rsys_send_msg_data(shell->client->sd, RSYS_MSG_DISPLAY, p - shell->display + 1, shell->display);
+        // Send the data up to the last '\n' before the prompt
+        rc = rsys_send_msg_data(shell->client->sd, RSYS_MSG_DISPLAY, p - data, data);
         if (rc != 0)
         {
-          RSYSD_ERR("rsys_send_msg_data(%zu bytes): '%m' (%d)\n", p - shell->display + 1, errno);
-          return -1;
+          RSYSD_ERR("rsys_send_msg_data(%zu bytes): '%m' (%d)\n", (size_t)(p - data), errno);
+          rc = -1;
+          break;
         }
       }
 
-      return PDIP_RECV_FOUND;
+      rc = PDIP_RECV_FOUND;
     }
     break;
 
     case PDIP_RECV_DATA:
     {
-      // Send the output of the program (if any) to the client (NUL terminated)
-      if (shell->display_len)
+      // Send the output of the program (if any) to the client
+      if (data_sz)
       {
-        rc = rsys_send_msg_data(shell->client->sd, RSYS_MSG_DISPLAY, shell->display_len + 1, shell->display);
+        rc = rsys_send_msg_data(shell->client->sd, RSYS_MSG_DISPLAY, data_sz, data);
         if (rc != 0)
         {
-          RSYSD_ERR("rsys_send_msg_data(%zu bytes): '%m' (%d)\n", shell->display_len, errno);
-          return -1;
+          RSYSD_ERR("rsys_send_msg_data(%zu bytes): '%m' (%d)\n", data_sz, errno);
+          rc = -1;
+          break;
         }
       }
 
-      return PDIP_RECV_DATA;
+      rc = PDIP_RECV_DATA;
     }
     break;
 
     default:
     {
       RSYSD_ERR("pdip_recv(%s): Didn't received the shell prompt, rc = %d, errno='%m' (%d) ?!?\n", shell->client->cmd, rc, errno);
-      return -1;
+      rc = -1;
     }
     break;
   } // End switch
 
+  // Give the data back to PDIP
+  (void)pdip_release(shell->pdip);
+
+  return rc;
+
 } // rsysd_read_shell_display
 
 
@@ -1200,8 +1232,8 @@ int   rc;
 char *p;
 
   // Wait for the prompt (no timeout as we now that data are available with the select() call)
-  rc = pdip_recv(shell->pdip, "^" RSYSD_SH_PROMPT "$",
-                 &(shell->display), &(shell->display_sz), &(shell->display_len), 0);
+  rc = pdip_recv_pattern(shell->pdip, rsysd_prompt,
+                         &(shell->display), &(shell->display_sz), &(shell->display_len), 0);
   switch(rc)
   {
     case PDIP_RECV_FOUND:
@@ -1282,8 +1314,8 @@ static int rsysd_flush_shell_display(rsysd_shell_t *shell)
 int   rc;
 
   // Wait for the prompt (no timeout as we now that data are available with the select() call)
-  rc = pdip_recv(shell->pdip, "^" RSYSD_SH_PROMPT "$",
-                 &(shell->display), &(shell->display_sz), &(shell->display_len), 0);
+  rc = pdip_recv_pattern(shell->pdip, rsysd_prompt,
+                         &(shell->display), &(shell->display_sz), &(shell->display_len), 0);
   switch(rc)
   {
     case PDIP_RECV_FOUND:
@@ -21,8 +21,17 @@
 #include <unistd.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <fcntl.h>
+#include <time.h>
 #include <malloc.h>
+#include <pthread.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/stat.h>
 
 #include "check_all.h"
 #include "check_pdip.h"
@@ -523,7 +532,8 @@ int               status;
   rc = pdip_recv(pdip_1, "^qwerty", &display, &display_sz, &data_sz, &timeout);
   ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
   ck_assert_uint_eq(data_sz, 0);
-  ck_assert_uint_eq(display_sz, 0);
+  // The user buffer is kept for the following receptions
+  ck_assert_uint_gt(display_sz, 0);
 
   // There are outstanding data in the object. Receive one part with a regular expression.
   rc = pdip_recv(pdip_1, "zabcd", &display, &display_sz, &data_sz, &timeout);
@@ -575,7 +585,8 @@ int               status;
   rc = pdip_recv(pdip_1, "^qwerty", &display, &display_sz, &data_sz, &timeout);
   ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
   ck_assert_uint_eq(data_sz, 0);
-  ck_assert_uint_eq(display_sz, 0);
+  // The user buffer is kept for the following receptions
+  ck_assert_uint_gt(display_sz, 0);
 
   // Receive the outstanding data
   rc = pdip_recv(pdip_1, 0, &display, &display_sz, &data_sz, 0);
@@ -863,16 +874,21 @@ END_TEST
 
 // The unitary tests are run in separate processes
 // START_TEST is a "static" definition of a function
-START_TEST(test_pdip_flush)
+START_TEST(test_pdip_send_raw)
 
 int               rc;
 pdip_t            pdip_1;
 char             *display;
 size_t            display_sz;
 size_t            data_sz;
-char             *av[2];
+char             *av[4];
 struct timeval    timeout;
 pdip_cfg_t        cfg;
+char             *buf;
+struct iovec      iov[3];
+unsigned int      i;
+
+#define CK_PDIP_RAW_SZ  (300 * 1024)
 
   display_sz = 0;
   display = (char *)0;
@@ -880,15 +896,16 @@ pdip_cfg_t        cfg;
   rc = pdip_configure(1, 0);
   ck_assert_int_eq(rc, 0);
 
-  //
-  // Receive outstanding data
-  //
+  buf = (char *)malloc(CK_PDIP_RAW_SZ);
+  ck_assert_ptr_ne(buf, 0);
+  for (i = 0; i < CK_PDIP_RAW_SZ; i ++)
+  {
+    // Lines of 64 bytes
+    buf[i] = ((i % 64) == 63 ? '\n' : 'a' + (i % 26));
+  } // End for
 
   //
-  // As the shell sends its prompt on the standard error,
-  // we need to redirect its standard error to the PDIP terminal
-  // as we will use the shell prompt as outstanding data for the
-  // following tests
+  // Payload far bigger than the PTY buffers without line discipline
   //
   rc = pdip_cfg_init(&cfg);
   ck_assert_int_eq(rc, 0);
@@ -896,98 +913,124 @@ pdip_cfg_t        cfg;
   pdip_1 = pdip_new(&cfg);
   ck_assert(pdip_1 != NULL);
 
-  pdip_set_debug_level(pdip_1, 20);
-
   av[0] = "/bin/sh";
-  av[1] = NULL;
-  rc = pdip_exec(pdip_1, 1, av);
+  av[1] = "-c";
+  av[2] = "stty -icanon -echo min 1; echo READY; head -c 307200 | wc -c; sleep 5";
+  av[3] = NULL;
+  rc = pdip_exec(pdip_1, 3, av);
   ck_assert_int_gt(rc, 1);
 
-  // Wait for a regex which will not be found
-  // ==> The prompt of the shell will go inside the outstanding data
-  data_sz = 0;
   timeout.tv_sec = 2;
   timeout.tv_usec = 0;
-  rc = pdip_recv(pdip_1, "^qwerty =$", &display, &display_sz, &data_sz, &timeout);
-  ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
-  ck_assert_uint_eq(data_sz, 0);
+  rc = pdip_recv(pdip_1, "^READY", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
 
-  // Flush outstanding data
-  data_sz = 0;
-  rc = pdip_flush(pdip_1, &display, &display_sz, &data_sz);
+  rc = pdip_send_raw(pdip_1, buf, 0);
   ck_assert_int_eq(rc, 0);
-  ck_assert_uint_gt(data_sz, 0);
 
+  rc = pdip_send_raw(pdip_1, buf, CK_PDIP_RAW_SZ);
+  ck_assert_int_eq(rc, CK_PDIP_RAW_SZ);
+
+  timeout.tv_sec = 5;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^ *307200", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
 
   rc = pdip_delete(pdip_1, NULL);
   ck_assert_int_eq(rc, 0);
 
-
-  //
-  // Receive outstanding data with allocated receiving buffer
-  //
-
   //
-  // As the shell sends its prompt on the standard error,
-  // we need to redirect its standard error to the PDIP terminal
-  // as we will use the shell prompt as outstanding data for the
-  // following tests
+  // Here-document pushed through a shell from several buffers
   //
-  rc = pdip_cfg_init(&cfg);
-  ck_assert_int_eq(rc, 0);
-  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
   pdip_1 = pdip_new(&cfg);
   ck_assert(pdip_1 != NULL);
 
-  pdip_set_debug_level(pdip_1, 20);
-
   av[0] = "/bin/sh";
-  av[1] = NULL;
-  rc = pdip_exec(pdip_1, 1, av);
+  av[1] = "-c";
+  av[2] = "stty -echo; echo READY; exec /bin/sh";
+  av[3] = NULL;
+  rc = pdip_exec(pdip_1, 3, av);
   ck_assert_int_gt(rc, 1);
 
-  // Wait for a regex which will not be found
-  // ==> The prompt of the shell will go inside the outstanding data
-  data_sz = 0;
-  ck_assert_ptr_ne(display, 0);
   timeout.tv_sec = 2;
   timeout.tv_usec = 0;
-  rc = pdip_recv(pdip_1, "^qwerty =$", &display, &display_sz, &data_sz, &timeout);
-  ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
-  ck_assert_uint_eq(data_sz, 0);
+  rc = pdip_recv(pdip_1, "^READY", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
 
-  // Flush outstanding data
-  display_sz = 20;
-  data_sz = 0;
-  display = (char *)malloc(display_sz);
-  rc = pdip_flush(pdip_1, &display, &display_sz, &data_sz);
-  ck_assert_int_eq(rc, 0);
-  ck_assert_uint_gt(data_sz, 0);
-  ck_assert_uint_gt(display_sz, 0);
-  free(display);
+  iov[0].iov_base = "cat << 'EOF' | wc -l\n";
+  iov[0].iov_len  = strlen(iov[0].iov_base);
+  iov[1].iov_base = buf;
+  iov[1].iov_len  = CK_PDIP_RAW_SZ;
+  iov[2].iov_base = "EOF\n";
+  iov[2].iov_len  = 4;
+  rc = pdip_sendv(pdip_1, iov, 3);
+  ck_assert_int_eq(rc, (int)(iov[0].iov_len + CK_PDIP_RAW_SZ + 4));
 
+  timeout.tv_sec = 5;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "[ >]4800$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
 
   rc = pdip_delete(pdip_1, NULL);
   ck_assert_int_eq(rc, 0);
 
+  free(buf);
+  free(display);
+
 END_TEST
 
 
 
 
+#define CK_DUPLEX_LINES  2000
+
+typedef struct
+{
+  pdip_t pdip;
+  char   letter;
+} ck_duplex_t;
+
+// ----------------------------------------------------------------------------
+// Name   : ck_duplex_sender
+// Usage  : Thread sending numbered lines prefixed by a letter while the main
+//          thread receives the echoes
+// ----------------------------------------------------------------------------
+static void *ck_duplex_sender(void *arg)
+{
+ck_duplex_t *duplex = (ck_duplex_t *)arg;
+int          i, rc;
+
+  for (i = 0; i < CK_DUPLEX_LINES; i ++)
+  {
+    rc = pdip_send(duplex->pdip, "%c%04d\n", duplex->letter, i);
+    if (6 != rc)
+    {
+      return (void *)1;
+    }
+  } // End for
+
+  return NULL;
+} // ck_duplex_sender
+
+
 // The unitary tests are run in separate processes
 // START_TEST is a "static" definition of a function
-START_TEST(test_pdip_delete)
+START_TEST(test_pdip_duplex)
 
 int               rc;
-pdip_t            pdip_1, pdip_2, pdip_3, pdip_4;
+pdip_t            pdip_1;
+ck_duplex_t       duplex[2];
+pthread_t         tid[2];
 char             *display;
 size_t            display_sz;
 size_t            data_sz;
-char             *av[2];
+char             *av[4];
 struct timeval    timeout;
 pdip_cfg_t        cfg;
-int               status;
+pdip_stats_t      stats;
+void             *ret;
+int               next[2];
+int               i, n;
 
   display_sz = 0;
   display = (char *)0;
@@ -995,128 +1038,228 @@ int               status;
   rc = pdip_configure(1, 0);
   ck_assert_int_eq(rc, 0);
 
-
-  //
-  // Delete object without controlled program
-  //
-
   rc = pdip_cfg_init(&cfg);
   ck_assert_int_eq(rc, 0);
   cfg.flags = PDIP_FLAG_ERR_REDIRECT;
   pdip_1 = pdip_new(&cfg);
   ck_assert(pdip_1 != NULL);
 
-  pdip_set_debug_level(pdip_1, 20);
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "stty -echo; echo READY; exec cat";
+  av[3] = NULL;
+  rc = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(rc, 1);
+
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^READY", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  rc = pdip_recv(pdip_1, "\n", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+
+  //
+  // Two threads send far more than the PTY buffers can hold while the echoes
+  // are received: the data of a sender are never interleaved with the
+  // other's and the lines of each sender arrive in order
+  //
+  for (i = 0; i < 2; i ++)
+  {
+    duplex[i].pdip   = pdip_1;
+    duplex[i].letter = (char)('A' + i);
+    rc = pthread_create(&(tid[i]), NULL, ck_duplex_sender, &(duplex[i]));
+    ck_assert_int_eq(rc, 0);
+  } // End for
+
+  next[0] = next[1] = 0;
+  for (i = 0; i < (2 * CK_DUPLEX_LINES); i ++)
+  {
+    timeout.tv_sec = 5;
+    timeout.tv_usec = 0;
+    rc = pdip_recv(pdip_1, "\n", &display, &display_sz, &data_sz, &timeout);
+    ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+
+    // One line "<letter><number>\n"
+    ck_assert_uint_eq(data_sz, 6);
+    ck_assert_int_eq(display[5], '\n');
+    ck_assert(('A' == display[0]) || ('B' == display[0]));
+    n = atoi(display + 1);
+    ck_assert_int_eq(n, next[display[0] - 'A']);
+    next[display[0] - 'A'] ++;
+  } // End for
+
+  for (i = 0; i < 2; i ++)
+  {
+    rc = pthread_join(tid[i], &ret);
+    ck_assert_int_eq(rc, 0);
+    ck_assert_ptr_eq(ret, NULL);
+  } // End for
+
+  ck_assert_int_eq(next[0], CK_DUPLEX_LINES);
+  ck_assert_int_eq(next[1], CK_DUPLEX_LINES);
+
+  rc = pdip_stats(pdip_1, &stats);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(stats.write_bytes, 2 * CK_DUPLEX_LINES * 6);
 
   rc = pdip_delete(pdip_1, NULL);
   ck_assert_int_eq(rc, 0);
 
+  free(display);
+
+END_TEST
+
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_duplex_record)
+
+int               rc;
+pdip_t            pdip_1;
+ck_duplex_t       duplex;
+pthread_t         tid;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+char             *av[4];
+struct timeval    timeout;
+pdip_cfg_t        cfg;
+void             *ret;
+char              path[64];
+struct stat       st;
+int               status;
+int               i, round;
+
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "stty -echo; echo READY; exec cat";
+  av[3] = NULL;
 
   //
-  // Delete object with controlled
+  // The recording fails while both threads record: the recorder is stopped
+  // by one of them while the other one may be using it
   //
-
   rc = pdip_cfg_init(&cfg);
   ck_assert_int_eq(rc, 0);
   cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  cfg.err_output = fopen("/dev/null", "w");
+  ck_assert(cfg.err_output != NULL);
+  cfg.record = "/dev/full";
   pdip_1 = pdip_new(&cfg);
   ck_assert(pdip_1 != NULL);
 
-  pdip_set_debug_level(pdip_1, 20);
-
-  rc = setenv("PS1", CK_PDIP_PROMPT, 1);
-  ck_assert_int_eq(rc, 0);
-
-  av[0] = "/bin/sh";
-  av[1] = NULL;
-  rc = pdip_exec(pdip_1, 1, av);
+  rc = pdip_exec(pdip_1, 3, av);
   ck_assert_int_gt(rc, 1);
 
-  // Wait for the prompt to make sure that the program is started
-  data_sz = 0;
   timeout.tv_sec = 2;
   timeout.tv_usec = 0;
-  rc = pdip_recv(pdip_1, "^" CK_PDIP_PROMPT "$", &display, &display_sz, &data_sz, &timeout);
+  rc = pdip_recv(pdip_1, "^READY\n", &display, &display_sz, &data_sz, &timeout);
   ck_assert_int_eq(rc, PDIP_RECV_FOUND);
-  ck_assert_uint_gt(data_sz, 0);
 
-  rc = pdip_delete(pdip_1, &status);
-  ck_assert_int_eq(rc, 0);
-  ck_assert(WIFSIGNALED(status));
-  ck_assert_int_eq(WTERMSIG(status), SIGKILL);
+  // Several rounds to fill the buffer of the recorder
+  duplex.pdip   = pdip_1;
+  duplex.letter = 'A';
+  for (round = 0; round < 4; round ++)
+  {
+    rc = pthread_create(&tid, NULL, ck_duplex_sender, &duplex);
+    ck_assert_int_eq(rc, 0);
 
+    for (i = 0; i < CK_DUPLEX_LINES; i ++)
+    {
+      timeout.tv_sec = 5;
+      timeout.tv_usec = 0;
+      rc = pdip_recv(pdip_1, "\n", &display, &display_sz, &data_sz, &timeout);
+      ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+      ck_assert_int_eq(atoi(display + 1), i);
+    } // End for
+
+    rc = pthread_join(tid, &ret);
+    ck_assert_int_eq(rc, 0);
+    ck_assert_ptr_eq(ret, NULL);
+  } // End for
 
-  //
-  // Delete object with outstanding data
-  //
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+  fclose(cfg.err_output);
 
   //
-  // As the shell sends its prompt on the standard error,
-  // we need to redirect its standard error to the PDIP terminal
-  // as we will use the shell prompt as outstanding data for the
-  // following tests
+  // The end of the session is written out by pdip_status() while the other
+  // thread is sending
   //
+  snprintf(path, sizeof(path), "/tmp/pdip_rec_%d", getpid());
+  (void)unlink(path);
+
   rc = pdip_cfg_init(&cfg);
   ck_assert_int_eq(rc, 0);
   cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  cfg.record = path;
   pdip_1 = pdip_new(&cfg);
   ck_assert(pdip_1 != NULL);
 
-  pdip_set_debug_level(pdip_1, 20);
-
-  av[0] = "/bin/sh";
-  av[1] = NULL;
-  rc = pdip_exec(pdip_1, 1, av);
+  rc = pdip_exec(pdip_1, 3, av);
   ck_assert_int_gt(rc, 1);
 
-  // Wait for a regex which will not be found
-  // ==> The prompt of the shell will go inside the outstanding data
-  data_sz = 0;
   timeout.tv_sec = 2;
   timeout.tv_usec = 0;
-  rc = pdip_recv(pdip_1, "^qwerty =$", &display, &display_sz, &data_sz, &timeout);
-  ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
-  ck_assert_uint_eq(data_sz, 0);
+  rc = pdip_recv(pdip_1, "^READY\n", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
 
-  rc = pdip_delete(pdip_1, NULL);
+  rc = pthread_create(&tid, NULL, ck_duplex_sender, &duplex);
   ck_assert_int_eq(rc, 0);
 
+  timeout.tv_sec = 5;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^A0100\n", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
 
-  // Delete multiple objects
+  rc = pdip_sig(pdip_1, SIGKILL);
+  ck_assert_int_eq(rc, 0);
 
-  pdip_1 = pdip_new(&cfg);
-  ck_assert(pdip_1 != NULL);
-  pdip_2 = pdip_new(&cfg);
-  ck_assert(pdip_2 != NULL);
-  pdip_3 = pdip_new(&cfg);
-  ck_assert(pdip_3 != NULL);
-  pdip_4 = pdip_new(&cfg);
-  ck_assert(pdip_4 != NULL);
+  rc = pdip_status(pdip_1, &status, 1);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(WIFSIGNALED(status));
 
-  rc = pdip_delete(pdip_4, NULL);
+  // The sender stops on the death of the program
+  rc = pthread_join(tid, &ret);
   ck_assert_int_eq(rc, 0);
+
   rc = pdip_delete(pdip_1, NULL);
   ck_assert_int_eq(rc, 0);
-  rc = pdip_delete(pdip_3, NULL);
-  ck_assert_int_eq(rc, 0);
-  rc = pdip_delete(pdip_2, NULL);
+
+  rc = stat(path, &st);
   ck_assert_int_eq(rc, 0);
+  ck_assert_int_gt(st.st_size, 0);
+  (void)unlink(path);
+
+  free(display);
 
 END_TEST
 
 
+
+
 // The unitary tests are run in separate processes
 // START_TEST is a "static" definition of a function
-START_TEST(test_pdip_fd)
+START_TEST(test_pdip_recv_pattern)
 
 int               rc;
 pdip_t            pdip_1;
-pdip_cfg_t        cfg;
-char             *av[2];
+pdip_pattern_t    prompt;
 char             *display;
 size_t            display_sz;
 size_t            data_sz;
+char             *av[2];
 struct timeval    timeout;
+pdip_cfg_t        cfg;
+int               i;
 
   display_sz = 0;
   display = (char *)0;
@@ -1124,15 +1267,9 @@ struct timeval    timeout;
   rc = pdip_configure(1, 0);
   ck_assert_int_eq(rc, 0);
 
-  rc = pdip_configure(1, 0);
-  ck_assert_int_eq(rc, 0);
+  prompt = pdip_pattern_new("^" CK_PDIP_PROMPT "$");
+  ck_assert(prompt != NULL);
 
-  //
-  // As the shell sends its prompt on the standard error,
-  // we need to redirect its standard error to the PDIP terminal
-  // as we will use the shell prompt as outstanding data for the
-  // following tests
-  //
   rc = pdip_cfg_init(&cfg);
   ck_assert_int_eq(rc, 0);
   cfg.flags = PDIP_FLAG_ERR_REDIRECT;
@@ -1142,45 +1279,67 @@ struct timeval    timeout;
   rc = setenv("PS1", CK_PDIP_PROMPT, 1);
   ck_assert_int_eq(rc, 0);
 
-  pdip_set_debug_level(pdip_1, 20);
-
   av[0] = "/bin/sh";
   av[1] = NULL;
   rc = pdip_exec(pdip_1, 1, av);
   ck_assert_int_gt(rc, 1);
 
-  // Wait for the prompt to make sure that the program is started
+  // The same precompiled pattern is used for several receptions
+  for (i = 0; i < 3; i ++)
+  {
+    // Wait for the prompt
+    data_sz = 0;
+    timeout.tv_sec = 2;
+    timeout.tv_usec = 0;
+    rc = pdip_recv_pattern(pdip_1, prompt, &display, &display_sz, &data_sz, &timeout);
+    ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+    ck_assert_uint_gt(data_sz, 0);
+
+    rc = pdip_send(pdip_1, "echo %d\n", i);
+    ck_assert_int_gt(rc, 0);
+  } // End for
+
+  // No pattern ==> Return the outstanding data (echo output)
   data_sz = 0;
-  timeout.tv_sec = 2;
+  timeout.tv_sec = 1;
   timeout.tv_usec = 0;
-  rc = pdip_recv(pdip_1, "^" CK_PDIP_PROMPT "$", &display, &display_sz, &data_sz, &timeout);
-  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  rc = pdip_recv_pattern(pdip_1, 0, &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_DATA);
   ck_assert_uint_gt(data_sz, 0);
 
-  rc = pdip_fd(pdip_1);
-  ck_assert_int_ge(rc, 0);
-
   rc = pdip_delete(pdip_1, NULL);
   ck_assert_int_eq(rc, 0);
 
+  // The pattern survives the PDIP object
+  rc = pdip_pattern_delete(prompt);
+  ck_assert_int_eq(rc, 0);
+
+  free(display);
+
 END_TEST
 
 
 
+
 // The unitary tests are run in separate processes
 // START_TEST is a "static" definition of a function
-START_TEST(test_pdip_term_settings)
+START_TEST(test_pdip_recv_until)
 
-pdip_t          pdip_1;
-char           *av[2];
-int             rc;
-char           *display;
-size_t          display_sz;
-size_t          data_sz;
-struct timeval  timeout;
-pdip_cfg_t      cfg;
-
-extern void pdip_term_settings(pdip_t ctx);
+int               rc;
+pdip_t            pdip_1;
+pdip_pattern_t    prompt, never;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+char             *av[2];
+struct timespec   deadline, t0, t1;
+struct timeval    timeout;
+struct rlimit     rlim;
+pdip_cfg_t        cfg;
+int               fds[FD_SETSIZE];
+int               nb_fds;
+double            elapsed;
+int               i;
 
   display_sz = 0;
   display = (char *)0;
@@ -1188,14 +1347,35 @@ extern void pdip_term_settings(pdip_t ctx);
   rc = pdip_configure(1, 0);
   ck_assert_int_eq(rc, 0);
 
+  // Make the PTY get a file descriptor beyond the limit of select()
+  nb_fds = 0;
+  rc = getrlimit(RLIMIT_NOFILE, &rlim);
+  ck_assert_int_eq(rc, 0);
+  if ((RLIM_INFINITY == rlim.rlim_max) || (rlim.rlim_max > (FD_SETSIZE + 64)))
+  {
+    rlim.rlim_cur = FD_SETSIZE + 64;
+    rc = setrlimit(RLIMIT_NOFILE, &rlim);
+    ck_assert_int_eq(rc, 0);
+
+    do
+    {
+      fds[nb_fds] = open("/dev/null", O_RDONLY);
+      ck_assert_int_ge(fds[nb_fds], 0);
+      nb_fds ++;
+    } while (fds[nb_fds - 1] < FD_SETSIZE);
+  }
+
+  prompt = pdip_pattern_new("^" CK_PDIP_PROMPT "$");
+  ck_assert(prompt != NULL);
+  never = pdip_pattern_new("NEVER_DISPLAYED");
+  ck_assert(never != NULL);
+
   rc = pdip_cfg_init(&cfg);
   ck_assert_int_eq(rc, 0);
   cfg.flags = PDIP_FLAG_ERR_REDIRECT;
   pdip_1 = pdip_new(&cfg);
   ck_assert(pdip_1 != NULL);
 
-  pdip_set_debug_level(pdip_1, 20);
-
   rc = setenv("PS1", CK_PDIP_PROMPT, 1);
   ck_assert_int_eq(rc, 0);
 
@@ -1204,19 +1384,80 @@ extern void pdip_term_settings(pdip_t ctx);
   rc = pdip_exec(pdip_1, 1, av);
   ck_assert_int_gt(rc, 1);
 
-  pdip_term_settings(pdip_1);
+  if (nb_fds)
+  {
+    ck_assert_int_ge(pdip_fd(pdip_1), FD_SETSIZE);
+  }
 
-  // Wait for the prompt to make sure that the program is started
-  data_sz = 0;
-  timeout.tv_sec = 2;
-  timeout.tv_usec = 0;
-  rc = pdip_recv(pdip_1, "^" CK_PDIP_PROMPT "$", &display, &display_sz, &data_sz, &timeout);
+  // Several steps of a dialogue share the same deadline
+  rc = clock_gettime(CLOCK_MONOTONIC, &deadline);
+  ck_assert_int_eq(rc, 0);
+  deadline.tv_sec += 5;
+
+  rc = pdip_recv_until(pdip_1, prompt, &display, &display_sz, &data_sz, &deadline);
   ck_assert_int_eq(rc, PDIP_RECV_FOUND);
-  ck_assert_uint_gt(data_sz, 0);
+
+  rc = pdip_send(pdip_1, "echo step1\n");
+  ck_assert_int_gt(rc, 0);
+
+  rc = pdip_recv_until(pdip_1, prompt, &display, &display_sz, &data_sz, &deadline);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert(strstr(display, "step1\n") != NULL);
+
+  // Data arriving regularly do not delay the deadline
+  rc = pdip_send(pdip_1, "while true; do echo tick; sleep 0.05; done\n");
+  ck_assert_int_gt(rc, 0);
+
+  rc = clock_gettime(CLOCK_MONOTONIC, &t0);
+  ck_assert_int_eq(rc, 0);
+  deadline = t0;
+  deadline.tv_nsec += 300000000;
+  if (deadline.tv_nsec >= 1000000000)
+  {
+    deadline.tv_sec += 1;
+    deadline.tv_nsec -= 1000000000;
+  }
+  rc = pdip_recv_until(pdip_1, never, &display, &display_sz, &data_sz, &deadline);
+  ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
+  rc = clock_gettime(CLOCK_MONOTONIC, &t1);
+  ck_assert_int_eq(rc, 0);
+  elapsed = (double)(t1.tv_sec - t0.tv_sec) + ((double)(t1.tv_nsec - t0.tv_nsec) / 1000000000.0);
+  ck_assert(elapsed >= 0.3);
+  ck_assert(elapsed < 1.0);
+
+  // A passed deadline merely looks at the available data
+  rc = pdip_recv_until(pdip_1, never, &display, &display_sz, &data_sz, &t0);
+  ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
+
+  // No pattern: the data are returned
+  deadline.tv_sec += 5;
+  rc = pdip_recv_until(pdip_1, NULL, &display, &display_sz, &data_sz, &deadline);
+  ck_assert_int_eq(rc, PDIP_RECV_DATA);
+  ck_assert(strstr(display, "tick") != NULL);
+
+  // The timeouts of the other services are updated with the remaining time
+  timeout.tv_sec = 0;
+  timeout.tv_usec = 200000;
+  rc = pdip_recv_pattern(pdip_1, never, &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
+  ck_assert_int_eq(timeout.tv_sec, 0);
+  ck_assert_int_eq(timeout.tv_usec, 0);
 
   rc = pdip_delete(pdip_1, NULL);
   ck_assert_int_eq(rc, 0);
 
+  rc = pdip_pattern_delete(prompt);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_pattern_delete(never);
+  ck_assert_int_eq(rc, 0);
+
+  for (i = 0; i < nb_fds; i ++)
+  {
+    (void)close(fds[i]);
+  } // End for
+
+  free(display);
+
 END_TEST
 
 
@@ -1224,70 +1465,118 @@ END_TEST
 
 // The unitary tests are run in separate processes
 // START_TEST is a "static" definition of a function
-START_TEST(test_pdip_status)
+START_TEST(test_pdip_pattern_match)
 
-pdip_t          pdip_1;
-char           *av[3];
-int             rc;
-char           *display;
-size_t          display_sz;
-size_t          data_sz;
-struct timeval  timeout;
-pdip_cfg_t      cfg;
-int             status;
+int               rc;
+pdip_pattern_t    lit, bol, eol, line, esc, regex;
+size_t            start, end;
 
-  display_sz = 0;
-  display = (char *)0;
+  // Literals
+  lit = pdip_pattern_new("ab");
+  ck_assert(lit != NULL);
+  bol = pdip_pattern_new("^ab");
+  ck_assert(bol != NULL);
+  eol = pdip_pattern_new("ab$");
+  ck_assert(eol != NULL);
+  line = pdip_pattern_new("^ab$");
+  ck_assert(line != NULL);
+  esc = pdip_pattern_new("^a\\.b\\$");
+  ck_assert(esc != NULL);
 
-  rc = pdip_configure(1, 0);
-  ck_assert_int_eq(rc, 0);
+  // Regular expression equivalent to "^ab$"
+  regex = pdip_pattern_new("^(ab)$");
+  ck_assert(regex != NULL);
 
+  rc = pdip_pattern_match(lit, "xxabab", &start, &end);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(start, 2);
+  ck_assert_uint_eq(end, 4);
 
-  // Wait for a living process in non blocking mode
+  rc = pdip_pattern_match(lit, "xxa\nb", &start, &end);
+  ck_assert_int_eq(rc, 1);
 
-  rc = pdip_cfg_init(&cfg);
+  rc = pdip_pattern_match(bol, "xab\nab", &start, &end);
   ck_assert_int_eq(rc, 0);
-  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
-  pdip_1 = pdip_new(&cfg);
-  ck_assert(pdip_1 != NULL);
+  ck_assert_uint_eq(start, 4);
+  ck_assert_uint_eq(end, 6);
 
-  pdip_set_debug_level(pdip_1, 20);
+  rc = pdip_pattern_match(bol, "xab xab", &start, &end);
+  ck_assert_int_eq(rc, 1);
 
-  rc = setenv("PS1", CK_PDIP_PROMPT, 1);
+  rc = pdip_pattern_match(eol, "abx ab\nx", &start, &end);
   ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(start, 4);
+  ck_assert_uint_eq(end, 6);
 
-  av[0] = "/bin/sh";
-  av[1] = NULL;
-  rc = pdip_exec(pdip_1, 1, av);
-  ck_assert_int_gt(rc, 1);
+  rc = pdip_pattern_match(line, "abc\nxab\nab", &start, &end);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(start, 8);
+  ck_assert_uint_eq(end, 10);
 
-  // Wait for the prompt to make sure that the program is started
-  data_sz = 0;
-  timeout.tv_sec = 2;
-  timeout.tv_usec = 0;
-  rc = pdip_recv(pdip_1, "^" CK_PDIP_PROMPT "$", &display, &display_sz, &data_sz, &timeout);
-  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
-  ck_assert_uint_gt(data_sz, 0);
+  rc = pdip_pattern_match(regex, "abc\nxab\nab", &start, &end);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(start, 8);
+  ck_assert_uint_eq(end, 10);
 
-  rc = pdip_status(pdip_1, &status, 0);
-  ck_assert_int_eq(rc, -1);
-  ck_assert_errno_eq(EAGAIN);
+  rc = pdip_pattern_match(esc, "a.b$\naxb$", &start, &end);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(start, 0);
+  ck_assert_uint_eq(end, 4);
 
-  rc = pdip_delete(pdip_1, NULL);
+  rc = pdip_pattern_match(esc, "axb$", 0, 0);
+  ck_assert_int_eq(rc, 1);
+
+  rc = pdip_pattern_delete(lit);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_pattern_delete(bol);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_pattern_delete(eol);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_pattern_delete(line);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_pattern_delete(esc);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_pattern_delete(regex);
   ck_assert_int_eq(rc, 0);
 
+END_TEST
 
-  //
-  // Wait a terminated object
-  //
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_regex_cache)
+
+int               rc;
+pdip_t            pdip_1;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+char             *av[2];
+struct timeval    timeout;
+pdip_cfg_t        cfg;
+unsigned long     hits, misses;
+int               i;
+
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
 
   rc = pdip_cfg_init(&cfg);
   ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(cfg.regex_cache_sz, 0);
   cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  cfg.regex_cache_sz = 2;
   pdip_1 = pdip_new(&cfg);
   ck_assert(pdip_1 != NULL);
 
-  pdip_set_debug_level(pdip_1, 20);
+  rc = pdip_regex_cache_stats(pdip_1, &hits, &misses);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(hits, 0);
+  ck_assert_uint_eq(misses, 0);
 
   rc = setenv("PS1", CK_PDIP_PROMPT, 1);
   ck_assert_int_eq(rc, 0);
@@ -1297,355 +1586,3044 @@ int             status;
   rc = pdip_exec(pdip_1, 1, av);
   ck_assert_int_gt(rc, 1);
 
-  // Wait for the prompt to make sure that the program is started
-  data_sz = 0;
+  // 1 miss followed by 2 hits
+  for (i = 0; i < 3; i ++)
+  {
+    data_sz = 0;
+    timeout.tv_sec = 2;
+    timeout.tv_usec = 0;
+    rc = pdip_recv(pdip_1, "^" CK_PDIP_PROMPT "$", &display, &display_sz, &data_sz, &timeout);
+    ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+
+    rc = pdip_send(pdip_1, "echo foo%d bar%d\n", i, i);
+    ck_assert_int_gt(rc, 0);
+  } // End for
+
+  rc = pdip_regex_cache_stats(pdip_1, &hits, &misses);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(hits, 2);
+  ck_assert_uint_eq(misses, 1);
+
+  // Two new regular expressions: the prompt is evicted (cache of 2 entries)
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^foo2", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "bar2", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
   timeout.tv_sec = 2;
   timeout.tv_usec = 0;
   rc = pdip_recv(pdip_1, "^" CK_PDIP_PROMPT "$", &display, &display_sz, &data_sz, &timeout);
   ck_assert_int_eq(rc, PDIP_RECV_FOUND);
-  ck_assert_uint_gt(data_sz, 0);
 
-  rc = pdip_sig(pdip_1, SIGKILL);
-  ck_assert_int_eq(rc, 0);
-  
-  rc = pdip_status(pdip_1, &status, 1);
+  rc = pdip_regex_cache_stats(pdip_1, &hits, &misses);
   ck_assert_int_eq(rc, 0);
-  ck_assert(WIFSIGNALED(status));
-  ck_assert_int_eq(WTERMSIG(status), SIGKILL);
+  ck_assert_uint_eq(hits, 2);
+  ck_assert_uint_eq(misses, 4);
 
-  rc = pdip_status(pdip_1, &status, 0);
-  ck_assert_int_eq(rc, 0);
-  ck_assert(WIFSIGNALED(status));
-  ck_assert_int_eq(WTERMSIG(status), SIGKILL);
+  // Bad regular expression
+  rc = pdip_recv(pdip_1, "a(b", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
 
-  rc = pdip_delete(pdip_1, NULL);
-  ck_assert_int_eq(rc, 0);  
+  // The cache is still usable
+  rc = pdip_send(pdip_1, "echo foo3 bar3\n");
+  ck_assert_int_gt(rc, 0);
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^" CK_PDIP_PROMPT "$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
 
+  rc = pdip_regex_cache_stats(pdip_1, &hits, &misses);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(hits, 3);
+  ck_assert_uint_eq(misses, 5);
 
-  // Wait for a process which terminates in blocking mode
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
 
+  // Cache disabled
   rc = pdip_cfg_init(&cfg);
   ck_assert_int_eq(rc, 0);
-  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT | PDIP_FLAG_NO_REGEX_CACHE;
   pdip_1 = pdip_new(&cfg);
   ck_assert(pdip_1 != NULL);
 
-  pdip_set_debug_level(pdip_1, 20);
-
-  av[0] = "/bin/sleep";
-  av[1] = "1";
-  av[2] = NULL;
-  rc = pdip_exec(pdip_1, 2, av);
+  rc = pdip_exec(pdip_1, 1, av);
   ck_assert_int_gt(rc, 1);
 
-  rc = pdip_status(pdip_1, &status, 1);
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^" CK_PDIP_PROMPT "$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+
+  rc = pdip_regex_cache_stats(pdip_1, &hits, &misses);
   ck_assert_int_eq(rc, 0);
-  ck_assert_int_eq(status, 0);
+  ck_assert_uint_eq(hits, 0);
+  ck_assert_uint_eq(misses, 0);
 
   rc = pdip_delete(pdip_1, NULL);
   ck_assert_int_eq(rc, 0);
 
-END_TEST
+  free(display);
 
+END_TEST
 
 
 
 
 // The unitary tests are run in separate processes
 // START_TEST is a "static" definition of a function
-START_TEST(test_pdip_set_debug_level)
-
-pdip_t          pdip_1;
-char           *av[3];
-int             rc;
-char           *display;
-size_t          display_sz;
-size_t          data_sz;
-struct timeval  timeout;
-pdip_cfg_t      cfg;
-
-  rc = pdip_configure(1, 0);
-  ck_assert_int_eq(rc, 0);
-
-  // Without object
-  rc = pdip_set_debug_level(0, 1);
-  ck_assert_int_eq(rc, 0);
-
+START_TEST(test_pdip_recv_incremental)
 
-  // With object
+int               rc;
+pdip_t            pdip_1;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+char             *av[4];
+struct timeval    timeout;
+pdip_cfg_t        cfg;
 
   display_sz = 0;
   display = (char *)0;
 
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
   rc = pdip_cfg_init(&cfg);
   ck_assert_int_eq(rc, 0);
   cfg.flags = PDIP_FLAG_ERR_REDIRECT;
   pdip_1 = pdip_new(&cfg);
   ck_assert(pdip_1 != NULL);
 
-  pdip_set_debug_level(pdip_1, 20);
+  // The data arrive in several chunks, the awaited lines being split
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "printf 'abc'; sleep 0.2; printf 'def\\nxxEND'; sleep 0.4; printf '_OF_DATA\\nEND_OF_DATA\\nfoo\\n'; sleep 5";
+  av[3] = NULL;
+  rc = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(rc, 1);
 
-  rc = setenv("PS1", CK_PDIP_PROMPT, 1);
+  // Timeout before the end of the line: the complete lines are not
+  // scanned again at the next call
+  timeout.tv_sec = 0;
+  timeout.tv_usec = 400000;
+  rc = pdip_recv(pdip_1, "^END_OF_DATA$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
+
+  // Another regular expression is looked for from the beginning of the data
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "xxEND_OF_DATA", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_str_eq(display, "abcdef\nxxEND_OF_DATA");
+
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^END_OF_DATA$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_str_eq(display, "\nEND_OF_DATA");
+
+  // Multi-line regular expression
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^[[:space:]]foo", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_str_eq(display, "\nfoo");
+
+  rc = pdip_delete(pdip_1, NULL);
   ck_assert_int_eq(rc, 0);
 
+  // GNU operator matching a newline: the match spans two reads
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
   av[0] = "/bin/sh";
-  av[1] = NULL;
-  rc = pdip_exec(pdip_1, 1, av);
+  av[1] = "-c";
+  av[2] = "printf 'xa\\n'; sleep 1; printf 'b\\n'; sleep 5";
+  av[3] = NULL;
+  rc = pdip_exec(pdip_1, 3, av);
   ck_assert_int_gt(rc, 1);
 
-  // Wait for the prompt to make sure that the program is started
-  data_sz = 0;
-  timeout.tv_sec = 2;
+  timeout.tv_sec = 3;
   timeout.tv_usec = 0;
-  rc = pdip_recv(pdip_1, "^" CK_PDIP_PROMPT "$", &display, &display_sz, &data_sz, &timeout);
+  rc = pdip_recv(pdip_1, "a\\Wb", &display, &display_sz, &data_sz, &timeout);
   ck_assert_int_eq(rc, PDIP_RECV_FOUND);
-  ck_assert_uint_gt(data_sz, 0);
+  ck_assert_str_eq(display, "xa\nb");
 
   rc = pdip_delete(pdip_1, NULL);
   ck_assert_int_eq(rc, 0);
 
+  free(display);
+
 END_TEST
 
 
 
+
 // The unitary tests are run in separate processes
 // START_TEST is a "static" definition of a function
-START_TEST(test_pdip_cpu_nb)
+START_TEST(test_pdip_recv_any)
 
-unsigned int rcu;
-int          rc;
-
-  // Get the number of CPUs
-  rc = sysconf(_SC_NPROCESSORS_ONLN);
-  ck_assert_int_gt(rc, 0);
+int               rc;
+pdip_t            pdip_1;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+char             *av[4];
+struct timeval    timeout;
+pdip_cfg_t        cfg;
+pdip_pattern_t    pat[3];
+unsigned int      index;
+size_t            offset;
+int               i;
 
-  rcu = pdip_cpu_nb();
-  ck_assert_int_gt(rcu, 0);
+  display_sz = 0;
+  display = (char *)0;
 
-  ck_assert_uint_eq(rc, rcu);
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  // Same scenario with and without the regex cache
+  for (i = 0; i < 2; i ++)
+  {
+    rc = pdip_cfg_init(&cfg);
+    ck_assert_int_eq(rc, 0);
+    cfg.flags = PDIP_FLAG_ERR_REDIRECT | (i ? PDIP_FLAG_NO_REGEX_CACHE : 0);
+    pdip_1 = pdip_new(&cfg);
+    ck_assert(pdip_1 != NULL);
+
+    av[0] = "/bin/sh";
+    av[1] = "-c";
+    av[2] = "printf 'login: foo\\nPassword: x\\nerror 42\\n$ aa\\n'; sleep 5";
+    av[3] = NULL;
+    rc = pdip_exec(pdip_1, 3, av);
+    ck_assert_int_gt(rc, 1);
+
+    // Literals
+    pat[0] = pdip_pattern_new("Password:");
+    ck_assert(pat[0] != NULL);
+    pat[1] = pdip_pattern_new("login:");
+    ck_assert(pat[1] != NULL);
+    timeout.tv_sec = 2;
+    timeout.tv_usec = 0;
+    rc = pdip_recv_any(pdip_1, pat, 2, &index, &offset, &display, &display_sz, &data_sz, &timeout);
+    ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+    ck_assert_uint_eq(index, 1);
+    ck_assert_uint_eq(offset, 0);
+    ck_assert_str_eq(display, "login:");
+    ck_assert_int_eq(pdip_pattern_delete(pat[0]), 0);
+    ck_assert_int_eq(pdip_pattern_delete(pat[1]), 0);
+
+    // Regular expressions: the earliest match is returned
+    pat[0] = pdip_pattern_new("^\\$ ");
+    ck_assert(pat[0] != NULL);
+    pat[1] = pdip_pattern_new("error [0-9]+");
+    ck_assert(pat[1] != NULL);
+    pat[2] = pdip_pattern_new("x$");
+    ck_assert(pat[2] != NULL);
+    timeout.tv_sec = 2;
+    timeout.tv_usec = 0;
+    rc = pdip_recv_any(pdip_1, pat, 3, &index, &offset, &display, &display_sz, &data_sz, &timeout);
+    ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+    ck_assert_uint_eq(index, 2);
+    ck_assert_uint_eq(offset, 15);
+    ck_assert_str_eq(display, " foo\nPassword: x");
+
+    rc = pdip_recv_any(pdip_1, pat, 2, &index, &offset, &display, &display_sz, &data_sz, &timeout);
+    ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+    ck_assert_uint_eq(index, 1);
+    ck_assert_uint_eq(offset, 1);
+    ck_assert_str_eq(display, "\nerror 42");
+    ck_assert_int_eq(pdip_pattern_delete(pat[0]), 0);
+    ck_assert_int_eq(pdip_pattern_delete(pat[1]), 0);
+    ck_assert_int_eq(pdip_pattern_delete(pat[2]), 0);
+
+    // Back-references
+    pat[0] = pdip_pattern_new("(a)\\1");
+    ck_assert(pat[0] != NULL);
+    pat[1] = pdip_pattern_new("zz");
+    ck_assert(pat[1] != NULL);
+    rc = pdip_recv_any(pdip_1, pat, 2, NULL, &offset, &display, &display_sz, &data_sz, &timeout);
+    ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+    ck_assert_uint_eq(offset, 3);
+    ck_assert_str_eq(display, "\n$ aa");
+
+    // Nothing else comes
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 200000;
+    index = 12;
+    rc = pdip_recv_any(pdip_1, pat, 2, &index, NULL, &display, &display_sz, &data_sz, &timeout);
+    ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
+    ck_assert_uint_eq(index, 12);
+    ck_assert_int_eq(pdip_pattern_delete(pat[0]), 0);
+    ck_assert_int_eq(pdip_pattern_delete(pat[1]), 0);
+
+    rc = pdip_delete(pdip_1, NULL);
+    ck_assert_int_eq(rc, 0);
+  } // End for
+
+  free(display);
 
 END_TEST
 
 
 
+
 // The unitary tests are run in separate processes
 // START_TEST is a "static" definition of a function
-START_TEST(test_pdip_cpu_alloc)
+START_TEST(test_pdip_alloc_stats)
 
-unsigned char *cpu;
-int            rc;
-pdip_t         pdip_1;
-pdip_cfg_t      cfg;
+int               rc;
+pdip_t            pdip_1;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+char             *av[4];
+struct timeval    timeout;
+pdip_pattern_t    prompt;
+unsigned long     allocs, allocs1;
+size_t            buf_sz;
+int               i, j;
+
+  display_sz = 0;
+  display = (char *)0;
 
   rc = pdip_configure(1, 0);
   ck_assert_int_eq(rc, 0);
 
-  cpu = pdip_cpu_alloc();
-  ck_assert_ptr_ne(cpu, 0);
+  pdip_1 = pdip_new((pdip_cfg_t *)0);
+  ck_assert(pdip_1 != NULL);
 
-  rc = pdip_cpu_free(cpu);
+  rc = pdip_alloc_stats(pdip_1, &allocs, &buf_sz);
   ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(allocs, 0);
+  ck_assert_uint_eq(buf_sz, 0);
 
+  // Two bursts of 300 prompts
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "for b in 1 2; do i=0; while [ $i -lt 300 ]; do echo \"line $i ..............................................................................\"; echo PROMPT; i=$((i+1)); done; sleep 1; done; sleep 5";
+  av[3] = NULL;
+  rc = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(rc, 1);
 
-  // Free an object with a CPU bitmap
+  prompt = pdip_pattern_new("^PROMPT");
+  ck_assert(prompt != NULL);
 
-  cpu = pdip_cpu_alloc();
-  ck_assert_ptr_ne(cpu, 0);
-  rc = pdip_cfg_init(&cfg);
+  allocs1 = 0;
+  for (j = 0; j < 2; j ++)
+  {
+    for (i = 0; i < 300; i ++)
+    {
+      timeout.tv_sec = 3;
+      timeout.tv_usec = 0;
+      rc = pdip_recv_pattern(pdip_1, prompt, &display, &display_sz, &data_sz, &timeout);
+      ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+    } // End for
+
+    rc = pdip_alloc_stats(pdip_1, &allocs, &buf_sz);
+    ck_assert_int_eq(rc, 0);
+    ck_assert_uint_gt(allocs, 0);
+    ck_assert_uint_gt(buf_sz, 0);
+
+    // The second burst reuses the buffers
+    if (j)
+    {
+      ck_assert_uint_eq(allocs, allocs1);
+    }
+
+    allocs1 = allocs;
+  } // End for
+
+  rc = pdip_pattern_delete(prompt);
   ck_assert_int_eq(rc, 0);
-  cfg.cpu = cpu;
-  pdip_1 = pdip_new(&cfg);
-  ck_assert(pdip_1 != NULL);
 
   rc = pdip_delete(pdip_1, NULL);
   ck_assert_int_eq(rc, 0);
 
-  rc = pdip_cpu_free(cpu);
-  ck_assert_int_eq(rc, 0);  
+  free(display);
 
 END_TEST
 
 
+
+
 // The unitary tests are run in separate processes
 // START_TEST is a "static" definition of a function
-START_TEST(test_pdip_cpu_zero)
+START_TEST(test_pdip_stats)
 
-unsigned char *cpu;
-int            rc;
-unsigned int   i;
+int               rc;
+pdip_cfg_t        cfg;
+pdip_t            pdip_1;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+char             *av[4];
+struct timeval    timeout;
+int               status;
+pdip_stats_t      stats, glob0, glob;
+unsigned long     allocs;
+size_t            buf_sz;
 
-  cpu = pdip_cpu_alloc();
-  ck_assert_ptr_ne(cpu, 0);
+  display_sz = 0;
+  display = (char *)0;
 
-  rc = pdip_cpu_zero(cpu);
+  rc = pdip_configure(1, 0);
   ck_assert_int_eq(rc, 0);
 
-  for (i = 0; i < pdip_cpu_nb(); i ++)
-  {
-    rc = pdip_cpu_isset(cpu, i);
-    ck_assert_int_eq(rc, 0);
-  } // End for
+  rc = pdip_stats((pdip_t)0, &glob0);
+  ck_assert_int_eq(rc, 0);
 
-  rc = pdip_cpu_free(cpu);
+  rc = pdip_cfg_init(&cfg);
   ck_assert_int_eq(rc, 0);
+  cfg.flags |= PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
 
-END_TEST
+  rc = pdip_stats(pdip_1, &stats);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(stats.read_calls, 0);
+  ck_assert_uint_eq(stats.write_calls, 0);
+  ck_assert_uint_eq(stats.match_calls, 0);
+  ck_assert_uint_eq(stats.replies, 0);
 
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "read l; echo \"got $l\"; sleep 10";
+  av[3] = NULL;
+  rc = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(rc, 1);
 
-// The unitary tests are run in separate processes
-// START_TEST is a "static" definition of a function
-START_TEST(test_pdip_cpu_set)
+  rc = pdip_send(pdip_1, "hello\n");
+  ck_assert_int_eq(rc, 6);
 
-unsigned char *cpu;
-int            rc;
-unsigned int   i;
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^got hello$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
 
-  cpu = pdip_cpu_alloc();
-  ck_assert_ptr_ne(cpu, 0);
+  // Echo of the input followed by the answer
+  rc = pdip_stats(pdip_1, &stats);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(stats.write_bytes, 6);
+  ck_assert_uint_ge(stats.write_calls, 1);
+  ck_assert_uint_ge(stats.read_bytes, 16);
+  ck_assert_uint_ge(stats.read_calls, 1);
+  ck_assert_uint_ge(stats.match_calls, 1);
+  ck_assert_uint_gt(stats.match_ns, 0);
+  ck_assert_uint_ge(stats.strdups, 4);
+  ck_assert_uint_gt(stats.buf_peak_sz, 0);
+  ck_assert_uint_gt(stats.buf_sz, 0);
+  ck_assert_uint_le(stats.buf_sz, stats.buf_peak_sz);
+  ck_assert_uint_eq(stats.recv_timeouts, 0);
+  ck_assert_uint_eq(stats.replies, 1);
+
+  // Subset of the counters
+  rc = pdip_alloc_stats(pdip_1, &allocs, &buf_sz);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(allocs, stats.allocs);
+  ck_assert_uint_eq(buf_sz, stats.buf_sz);
+  ck_assert_uint_gt(stats.reply_ns, 0);
+  ck_assert_uint_eq(stats.reply_max_ns, stats.reply_ns);
+
+  // A timeout is not a reply
+  timeout.tv_sec = 0;
+  timeout.tv_usec = 100000;
+  rc = pdip_recv(pdip_1, "^never$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
 
-  rc = pdip_cpu_zero(cpu);
+  rc = pdip_stats(pdip_1, &stats);
   ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(stats.recv_timeouts, 1);
+  ck_assert_uint_eq(stats.replies, 1);
 
-  for (i = 0; i < pdip_cpu_nb(); i ++)
-  {
-    rc = pdip_cpu_isset(cpu, i);
-    ck_assert_int_eq(rc, 0);
+  rc = pdip_sig(pdip_1, SIGTERM);
+  ck_assert_int_eq(rc, 0);
 
-    rc = pdip_cpu_set(cpu, i);
-    ck_assert_int_eq(rc, 0);
+  rc = pdip_status(pdip_1, &status, 1);
+  ck_assert_int_eq(rc, 0);
 
-    rc = pdip_cpu_isset(cpu, i);
-    ck_assert_int_eq(rc, 1);
-  } // End for
+  rc = pdip_stats(pdip_1, &stats);
+  ck_assert_int_eq(rc, 0);
 
-  rc = pdip_cpu_free(cpu);
+  // The counters of the library include those of the deleted objects
+  rc = pdip_delete(pdip_1, NULL);
   ck_assert_int_eq(rc, 0);
 
-END_TEST
+  rc = pdip_stats((pdip_t)0, &glob);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_ge(glob.read_bytes, glob0.read_bytes + stats.read_bytes);
+  ck_assert_uint_ge(glob.write_bytes, glob0.write_bytes + stats.write_bytes);
+  ck_assert_uint_ge(glob.replies, glob0.replies + 1);
+  ck_assert_uint_ge(glob.recv_timeouts, glob0.recv_timeouts + 1);
+  ck_assert_uint_ge(glob.reply_max_ns, stats.reply_max_ns);
 
+  // But not their freed buffer
+  ck_assert_uint_eq(glob.buf_sz, glob0.buf_sz);
 
-// The unitary tests are run in separate processes
-// START_TEST is a "static" definition of a function
-START_TEST(test_pdip_cpu_unset)
+  free(display);
 
-unsigned char *cpu;
-int            rc;
-unsigned int   i;
+END_TEST
 
-  cpu = pdip_cpu_alloc();
-  ck_assert_ptr_ne(cpu, 0);
 
-  rc = pdip_cpu_all(cpu);
-  ck_assert_int_eq(rc, 0);
 
-  for (i = 0; i < pdip_cpu_nb(); i ++)
-  {
-    rc = pdip_cpu_isset(cpu, i);
-    ck_assert_int_eq(rc, 1);
+// ----------------------------------------------------------------------------
+// Name   : test_pdip_log_size
+// Usage  : Size of the debug messages written into a stream
+// ----------------------------------------------------------------------------
+static long test_pdip_log_size(FILE *f)
+{
+  (void)fflush(f);
+  (void)fseek(f, 0, SEEK_END);
 
-    rc = pdip_cpu_unset(cpu, i);
-    ck_assert_int_eq(rc, 0);
+  return ftell(f);
+} // test_pdip_log_size
 
-    rc = pdip_cpu_isset(cpu, i);
-    ck_assert_int_eq(rc, 0);
-  } // End for
 
-  rc = pdip_cpu_free(cpu);
-  ck_assert_int_eq(rc, 0);
+// ----------------------------------------------------------------------------
+// Name   : ck_log_sig_thread
+// Usage  : Thread calling the signal handler before any other debug message
+// ----------------------------------------------------------------------------
+static void *ck_log_sig_thread(void *arg)
+{
+siginfo_t info;
 
-END_TEST
+  (void)arg;
 
+  // Process which is not controlled by any object
+  memset(&info, 0, sizeof(info));
+  info.si_pid = getpid();
 
+  return (void *)(long)pdip_signal_handler(SIGCHLD, &info);
+} // ck_log_sig_thread
 
-// The unitary tests are run in separate processes
-// START_TEST is a "static" definition of a function
-START_TEST(test_signal_hdl)
+
+START_TEST(test_pdip_filter)
 
 int               rc;
-pdip_t            pdip_1, pdip_2, pdip_3, pdip_4, pdip_5, pdip_6;
-char             *av[3];
-int               status;
+pdip_cfg_t        cfg;
+pdip_t            pdip_1;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+char             *av[4];
+struct timeval    timeout;
+static const char login[] = "\033[1;31mlo\000\000gin\033[0m: \033]0;title\007ok";
+
+  display_sz = 0;
+  display = (char *)0;
 
   rc = pdip_configure(1, 0);
   ck_assert_int_eq(rc, 0);
 
-  // Create multiple object with processes which dies
-  // to trigger the signal handler with a list of multiple living objects
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "printf '\\033[1;31mlo\\000\\000gin\\033[0m: \\033]0;title\\007ok\\r\\nPass\\001word:'; sleep 5";
+  av[3] = NULL;
 
-  pdip_1 = pdip_new(0);
+  // Without filtering, the control characters break the match
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  pdip_1 = pdip_new(&cfg);
   ck_assert(pdip_1 != NULL);
-  pdip_2 = pdip_new(0);
-  ck_assert(pdip_2 != NULL);
-  pdip_3 = pdip_new(0);
-  ck_assert(pdip_3 != NULL);
-  pdip_4 = pdip_new(0);
-  ck_assert(pdip_4 != NULL);
-  pdip_5 = pdip_new(0);
-  ck_assert(pdip_5 != NULL);
-  pdip_6 = pdip_new(0);
-  ck_assert(pdip_6 != NULL);
 
-  av[0] = "/bin/sleep";
-  av[1] = "1";
-  av[2] = NULL;
-  rc = pdip_exec(pdip_1, 2, av);
-  ck_assert_int_gt(rc, 1);
-  
-  av[0] = "/bin/sleep";
-  av[1] = "1";
-  av[2] = NULL;
-  rc = pdip_exec(pdip_2, 2, av);
+  rc = pdip_exec(pdip_1, 3, av);
   ck_assert_int_gt(rc, 1);
 
-  av[0] = "/bin/sleep";
-  av[1] = "2";
-  av[2] = NULL;
-  rc = pdip_exec(pdip_3, 2, av);
-  ck_assert_int_gt(rc, 1);
+  timeout.tv_sec = 0;
+  timeout.tv_usec = 500000;
+  rc = pdip_recv(pdip_1, "login: ok$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
 
-  av[0] = "/bin/sleep";
-  av[1] = "1";
-  av[2] = NULL;
-  rc = pdip_exec(pdip_4, 2, av);
-  ck_assert_int_gt(rc, 1);
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
 
-  av[0] = "/bin/sleep";
-  av[1] = "1";
-  av[2] = NULL;
-  rc = pdip_exec(pdip_5, 2, av);
-  ck_assert_int_gt(rc, 1);
+  // With filtering, the match is found and the data are returned as they
+  // were received
+  cfg.flags |= PDIP_FLAG_FILTER_CTRL;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
 
-  av[0] = "/bin/sleep";
-  av[1] = "1";
-  av[2] = NULL;
-  rc = pdip_exec(pdip_6, 2, av);
+  rc = pdip_exec(pdip_1, 3, av);
   ck_assert_int_gt(rc, 1);
 
-  rc = pdip_status(pdip_1, 0, 1);
-  ck_assert_int_eq(rc, 0);
-  rc = pdip_status(pdip_2, 0, 1);
-  ck_assert_int_eq(rc, 0);
-  rc = pdip_status(pdip_3, 0, 1);
-  ck_assert_int_eq(rc, 0);
-  rc = pdip_status(pdip_4, 0, 1);
-  ck_assert_int_eq(rc, 0);
-  rc = pdip_status(pdip_5, 0, 1);
-  ck_assert_int_eq(rc, 0);
-  rc = pdip_status(pdip_6, 0, 1);
-  ck_assert_int_eq(rc, 0);
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "login: ok$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_eq(data_sz, sizeof(login) - 1);
+  ck_assert(!memcmp(display, login, data_sz));
+
+  // The removed bytes following the match stay in the outstanding data
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^Password:", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_eq(data_sz, 12);
+  ck_assert(!memcmp(display, "\r\nPass\001word:", 12));
 
   rc = pdip_delete(pdip_1, NULL);
   ck_assert_int_eq(rc, 0);
-  rc = pdip_delete(pdip_2, NULL);
-  ck_assert_int_eq(rc, 0);
-  rc = pdip_delete(pdip_3, NULL);
-  ck_assert_int_eq(rc, 0);
-  rc = pdip_delete(pdip_4, NULL);
-  ck_assert_int_eq(rc, 0);
-  rc = pdip_delete(pdip_5, NULL);
-  ck_assert_int_eq(rc, 0);
-  rc = pdip_delete(pdip_6, NULL);
-  ck_assert_int_eq(rc, 0);
+
+  // The designations of character sets (e.g. "tput sgr0") are three bytes
+  // long: nothing is left before an anchored prompt
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  av[2] = "printf 'line\\n\\033(B\\033[m\\033)0PROMPT> '; sleep 5";
+  rc = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(rc, 1);
+
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^PROMPT> $", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_ge(data_sz, 17);
+  ck_assert(!memcmp(display + data_sz - 17, "\033(B\033[m\033)0PROMPT> ", 17));
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  free(display);
+
+END_TEST
+
+
+START_TEST(test_pdip_screen)
+
+int               rc;
+pdip_cfg_t        cfg;
+pdip_t            pdip_1;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+char             *av[4];
+struct timeval    timeout;
+pdip_pattern_t    pat;
+unsigned int      row, col;
+static const char screen[] = "xx\nac\n    \303\251t\303\251\n\n         Menu\n";
+
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+
+  // Both dimensions are needed
+  cfg.screen_rows = 24;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 == NULL);
+  ck_assert_int_eq(errno, EINVAL);
+
+  cfg.screen_cols = 80;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "printf 'garbage\\033[2J\\033[5;10HMenu\\033[1;1Hxx\\033[2;1Habc\\033[2;2H\\033[1P\\033[3;5H\\303\\251t\\303\\251\\033[10;1H'; stty size; sleep 5";
+  av[3] = NULL;
+  rc = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(rc, 1);
+
+  // The window of the terminal has the size of the screen
+  pat = pdip_pattern_new("^24 80$");
+  ck_assert(pat != NULL);
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv_screen(pdip_1, pat, &row, &col, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_eq(row, 9);
+  ck_assert_uint_eq(col, 0);
+  rc = pdip_pattern_delete(pat);
+  ck_assert_int_eq(rc, 0);
+
+  // The text already displayed is found when the whole screen is searched
+  pat = pdip_pattern_new("Menu");
+  ck_assert(pat != NULL);
+  rc = pdip_recv_screen_all(pdip_1, pat, &row, &col, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_eq(row, 4);
+  ck_assert_uint_eq(col, 9);
+  rc = pdip_pattern_delete(pat);
+  ck_assert_int_eq(rc, 0);
+
+  // The column is counted in characters
+  pat = pdip_pattern_new("t\303\251");
+  ck_assert(pat != NULL);
+  rc = pdip_recv_screen_all(pdip_1, pat, &row, &col, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_eq(row, 2);
+  ck_assert_uint_eq(col, 5);
+  rc = pdip_pattern_delete(pat);
+  ck_assert_int_eq(rc, 0);
+
+  // The erased text is not found
+  pat = pdip_pattern_new("garbage|abc");
+  ck_assert(pat != NULL);
+  timeout.tv_sec = 0;
+  timeout.tv_usec = 200000;
+  rc = pdip_recv_screen_all(pdip_1, pat, &row, &col, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
+  rc = pdip_pattern_delete(pat);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_screen_get(pdip_1, &display, &display_sz, &data_sz);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(data_sz, strlen(display));
+  ck_assert(!strncmp(display, screen, sizeof(screen) - 1));
+  ck_assert(!strncmp(display + sizeof(screen) - 1, "\n\n\n\n24 80\n", 10));
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  free(display);
+
+END_TEST
+
+
+START_TEST(test_pdip_screen_redraw)
+
+int               rc;
+pdip_cfg_t        cfg;
+pdip_t            pdip_1;
+char             *av[4];
+struct timeval    timeout;
+pdip_pattern_t    pat;
+unsigned int      row, col;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.screen_rows = 24;
+  cfg.screen_cols = 80;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  // The status is displayed and redrawn at the same place one second later
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "printf '\\033[2J\\033[3;1HStatus: ready\\033[1;1H'; sleep 1; printf '\\033[3;1HStatus: ready\\033[1;1H'; sleep 5";
+  av[3] = NULL;
+  rc = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(rc, 1);
+
+  pat = pdip_pattern_new("^Status: ready$");
+  ck_assert(pat != NULL);
+
+  timeout.tv_sec = 3;
+  timeout.tv_usec = 0;
+  rc = pdip_recv_screen(pdip_1, pat, &row, &col, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_eq(row, 2);
+  ck_assert_uint_eq(col, 0);
+  ck_assert_int_ge(timeout.tv_sec, 2);
+
+  // The whole screen is searched: the displayed status is found at once
+  timeout.tv_sec = 3;
+  timeout.tv_usec = 0;
+  rc = pdip_recv_screen_all(pdip_1, pat, &row, &col, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_eq(row, 2);
+  ck_assert_int_ge(timeout.tv_sec, 2);
+
+  // Only the modified rows are searched: the status is found upon its redraw
+  timeout.tv_sec = 3;
+  timeout.tv_usec = 0;
+  rc = pdip_recv_screen(pdip_1, pat, &row, &col, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_eq(row, 2);
+  ck_assert_uint_eq(col, 0);
+  ck_assert_int_le(timeout.tv_sec, 2);
+  ck_assert(((timeout.tv_sec * 1000000) + timeout.tv_usec) <= 2600000);
+
+  // No more redraw
+  timeout.tv_sec = 0;
+  timeout.tv_usec = 300000;
+  rc = pdip_recv_screen(pdip_1, pat, &row, &col, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
+
+  rc = pdip_pattern_delete(pat);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+START_TEST(test_pdip_log)
+
+int               rc;
+pdip_cfg_t        cfg;
+pdip_t            pdip_1;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+char             *av[4];
+struct timeval    timeout;
+FILE             *f;
+long              sz;
+char              line[256];
+char              prefix[64];
+int               found;
+int               i;
+FILE             *err;
+int               err_fd;
+pthread_t         tid;
+void             *ret;
+
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  f = tmpfile();
+  ck_assert(f != NULL);
+
+  // Deferred mode: nothing is printed before pdip_log_flush()
+  rc = pdip_configure_log(PDIP_LOG_DEFERRED, 0);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.dbg_output = f;
+  cfg.debug_level = 5;
+  cfg.flags |= PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "echo hello; sleep 10";
+  av[3] = NULL;
+  rc = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(rc, 1);
+
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^hello$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+
+  sz = test_pdip_log_size(f);
+  ck_assert_int_eq(sz, 0);
+
+  rc = pdip_log_flush();
+  ck_assert_int_eq(rc, 0);
+
+  sz = test_pdip_log_size(f);
+  ck_assert_int_gt(sz, 0);
+
+  // Same format as the synchronous mode
+  snprintf(prefix, sizeof(prefix), "PDIP(%d-", getpid());
+  rewind(f);
+  found = 0;
+  while (fgets(line, sizeof(line), f))
+  {
+    if (!strncmp(line, prefix, strlen(prefix)))
+    {
+      found ++;
+    }
+  } // End while
+  ck_assert_int_gt(found, 0);
+
+  // Asynchronous mode: the messages are printed by the background thread
+  rc = pdip_configure_log(PDIP_LOG_ASYNC, 4096);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_send(pdip_1, "\n");
+  ck_assert_int_eq(rc, 1);
+
+  for (i = 0; i < 100; i ++)
+  {
+    if (test_pdip_log_size(f) > sz)
+    {
+      break;
+    }
+    usleep(10000);
+  } // End for
+  ck_assert_int_gt(test_pdip_log_size(f), sz);
+
+  // Back to the synchronous mode
+  rc = pdip_configure_log(PDIP_LOG_SYNC, 0);
+  ck_assert_int_eq(rc, 0);
+
+  sz = test_pdip_log_size(f);
+  rc = pdip_sig(pdip_1, SIGTERM);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_int_gt(test_pdip_log_size(f), sz);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  // The signal handler does not allocate the ring of a thread: its messages
+  // are dropped and reported as lost
+  rc = pdip_configure_log(PDIP_LOG_DEFERRED, 0);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_set_debug_level(NULL, 3);
+  ck_assert_int_eq(rc, 0);
+
+  err = tmpfile();
+  ck_assert(err != NULL);
+  (void)fflush(stderr);
+  err_fd = dup(2);
+  ck_assert_int_ge(err_fd, 0);
+  rc = dup2(fileno(err), 2);
+  ck_assert_int_eq(rc, 2);
+
+  rc = pthread_create(&tid, NULL, ck_log_sig_thread, NULL);
+  ck_assert_int_eq(rc, 0);
+  rc = pthread_join(tid, &ret);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_int_eq((long)ret, PDIP_SIG_ERROR);
+
+  rc = pdip_log_flush();
+  ck_assert_int_eq(rc, 0);
+
+  (void)fflush(stderr);
+  rc = dup2(err_fd, 2);
+  ck_assert_int_eq(rc, 2);
+  close(err_fd);
+
+  rewind(err);
+  found = 0;
+  while (fgets(line, sizeof(line), err))
+  {
+    ck_assert(!strstr(line, "not linked to any PDIP object"));
+    if (strstr(line, "1 debug messages lost (signal handler"))
+    {
+      found ++;
+    }
+  } // End while
+  ck_assert_int_eq(found, 1);
+  fclose(err);
+
+  rc = pdip_set_debug_level(NULL, 0);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_configure_log(PDIP_LOG_SYNC, 0);
+  ck_assert_int_eq(rc, 0);
+
+  fclose(f);
+  free(display);
+
+END_TEST
+
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_buf_growth)
+
+int               rc;
+pdip_t            pdip_1;
+pdip_cfg_t        cfg;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+char             *av[4];
+struct timeval    timeout;
+unsigned long     allocs[2];
+size_t            buf_sz;
+unsigned int      policy;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  // About 256 KB of output before the awaited string
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "i=0; while [ $i -lt 4096 ]; do echo \"line $i ........................................................\"; i=$((i+1)); done; echo END; sleep 5";
+  av[3] = NULL;
+
+  // The geometric growth allocates far less often than the linear one
+  for (policy = 0; policy < 2; policy ++)
+  {
+    rc = pdip_cfg_init(&cfg);
+    ck_assert_int_eq(rc, 0);
+    cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+    cfg.buf_resize_increment = 512;
+    cfg.buf_growth = (policy ? PDIP_BUF_GROWTH_GEOMETRIC : PDIP_BUF_GROWTH_LINEAR);
+    pdip_1 = pdip_new(&cfg);
+    ck_assert(pdip_1 != NULL);
+
+    rc = pdip_exec(pdip_1, 3, av);
+    ck_assert_int_gt(rc, 1);
+
+    display_sz = 0;
+    display = (char *)0;
+    timeout.tv_sec = 5;
+    timeout.tv_usec = 0;
+    rc = pdip_recv(pdip_1, "^END", &display, &display_sz, &data_sz, &timeout);
+    ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+    ck_assert_uint_gt(data_sz, 4096 * 60);
+
+    rc = pdip_alloc_stats(pdip_1, &(allocs[policy]), &buf_sz);
+    ck_assert_int_eq(rc, 0);
+
+    rc = pdip_delete(pdip_1, NULL);
+    ck_assert_int_eq(rc, 0);
+
+    free(display);
+  } // End for
+
+  ck_assert_uint_lt(allocs[1] * 10, allocs[0]);
+
+  // The buffers can not exceed the maximum size
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  cfg.buf_max_sz = 16 * 1024;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  rc = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(rc, 1);
+
+  display_sz = 0;
+  display = (char *)0;
+  timeout.tv_sec = 5;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^END", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(ENOSPC);
+
+  rc = pdip_alloc_stats(pdip_1, (unsigned long *)0, &buf_sz);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_le(buf_sz, 16 * 1024);
+
+  // The kept data are still available
+  rc = pdip_flush(pdip_1, &display, &display_sz, &data_sz);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_gt(data_sz, 0);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  free(display);
+
+  // A buffer which can not grow by a whole increment without exceeding the
+  // maximum size is enlarged up to the maximum size
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.buf_resize_increment = 1024;
+  cfg.buf_max_sz = 1500;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  av[2] = "echo ready; sleep 5";
+  rc = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(rc, 1);
+
+  display_sz = 600;
+  display = (char *)malloc(display_sz);
+  ck_assert(display != NULL);
+  timeout.tv_sec = 5;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^ready", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_eq(display_sz, 1500);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  free(display);
+
+END_TEST
+
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_buf_overflow)
+
+int               rc;
+pdip_t            pdip_1;
+pdip_cfg_t        cfg;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+char             *av[4];
+struct timeval    timeout;
+size_t            buf_sz;
+unsigned int      policy;
+pdip_stats_t      stats;
+size_t            total;
+int               i;
+int               fd;
+struct stat       st;
+char              line[128];
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  // About 256 KB of output before the awaited string
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "i=0; while [ $i -lt 4096 ]; do echo \"line $i ........................................................\"; i=$((i+1)); done; echo END; sleep 5";
+  av[3] = NULL;
+
+  total = 0;
+  for (i = 0; i < 4096; i ++)
+  {
+    total += (size_t)snprintf(line, sizeof(line), "line %d ........................................................\n", i);
+  } // End for
+  total += 3;
+
+  // Distinct return code
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  cfg.buf_max_sz = 16 * 1024;
+  cfg.buf_overflow = PDIP_BUF_OVERFLOW_FAIL;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  rc = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(rc, 1);
+
+  display_sz = 0;
+  display = (char *)0;
+  timeout.tv_sec = 5;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^END", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_OVERFLOW);
+
+  // The kept data are still available
+  rc = pdip_flush(pdip_1, &display, &display_sz, &data_sz);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_gt(data_sz, 0);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  free(display);
+
+  // The oldest data are discarded or spilled: the match spanning two lines
+  // is found in the lookback window
+  for (policy = PDIP_BUF_OVERFLOW_DISCARD; policy <= PDIP_BUF_OVERFLOW_SPILL; policy ++)
+  {
+    rc = pdip_cfg_init(&cfg);
+    ck_assert_int_eq(rc, 0);
+    cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+    cfg.buf_max_sz = 16 * 1024;
+    cfg.buf_lookback = 4 * 1024;
+    cfg.buf_overflow = policy;
+    pdip_1 = pdip_new(&cfg);
+    ck_assert(pdip_1 != NULL);
+
+    rc = pdip_exec(pdip_1, 3, av);
+    ck_assert_int_gt(rc, 1);
+
+    display_sz = 0;
+    display = (char *)0;
+    timeout.tv_sec = 5;
+    timeout.tv_usec = 0;
+    rc = pdip_recv(pdip_1, "^line 4095 [.]+\nEND", &display, &display_sz, &data_sz, &timeout);
+    ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+    ck_assert_uint_lt(data_sz, 16 * 1024);
+
+    // The kept data begin with a line
+    ck_assert(!strncmp(display, "line ", 5));
+
+    rc = pdip_alloc_stats(pdip_1, (unsigned long *)0, &buf_sz);
+    ck_assert_int_eq(rc, 0);
+    ck_assert_uint_le(buf_sz, 16 * 1024);
+
+    rc = pdip_stats(pdip_1, &stats);
+    ck_assert_int_eq(rc, 0);
+    ck_assert_uint_eq(stats.overflow_bytes + data_sz, total);
+
+    fd = pdip_spill_fd(pdip_1);
+    if (PDIP_BUF_OVERFLOW_DISCARD == policy)
+    {
+      ck_assert_int_eq(fd, -1);
+      ck_assert_errno_eq(ENOENT);
+    }
+    else
+    {
+      // The spilled data precede the returned ones
+      ck_assert_int_ge(fd, 0);
+      rc = fstat(fd, &st);
+      ck_assert_int_eq(rc, 0);
+      ck_assert_uint_eq((size_t)(st.st_size), stats.overflow_bytes);
+      ck_assert_int_eq(pread(fd, line, 7, 0), 7);
+      ck_assert(!strncmp(line, "line 0 ", 7));
+    }
+
+    rc = pdip_delete(pdip_1, NULL);
+    ck_assert_int_eq(rc, 0);
+
+    free(display);
+  } // End for
+
+END_TEST
+
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_recv_nul)
+
+int               rc;
+pdip_t            pdip_1;
+pdip_cfg_t        cfg;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+char             *av[4];
+struct timeval    timeout;
+pdip_pattern_t    pat[2];
+unsigned int      idx;
+
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  // Lines padded with NUL bytes
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "printf 'abc\\000\\000def\\nONE\\000\\nTWO\\000 three\\nFOUR\\n'; sleep 5";
+  av[3] = NULL;
+  rc = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(rc, 1);
+
+  // Literal behind NUL bytes
+  timeout.tv_sec = 3;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^ONE", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_eq(data_sz, 12);
+  ck_assert_mem_eq(display, "abc\0\0def\nONE", 12);
+  ck_assert(display[data_sz] == '\0');
+
+  // Regular expression behind a NUL byte
+  timeout.tv_sec = 3;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "t[h]ree", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_eq(data_sz, 12);
+  ck_assert_mem_eq(display, "\0\nTWO\0 three", 12);
+
+  // Several literals behind NUL bytes
+  pat[0] = pdip_pattern_new("FIVE");
+  ck_assert(pat[0] != NULL);
+  pat[1] = pdip_pattern_new("^FOUR$");
+  ck_assert(pat[1] != NULL);
+  timeout.tv_sec = 3;
+  timeout.tv_usec = 0;
+  rc = pdip_recv_any(pdip_1, pat, 2, &idx, (size_t *)0, &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_eq(idx, 1);
+
+  rc = pdip_pattern_delete(pat[0]);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_pattern_delete(pat[1]);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  free(display);
+
+END_TEST
+
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_recv_view)
+
+int               rc;
+pdip_t            pdip_1;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+const char       *data;
+char             *av[2];
+struct timeval    timeout;
+pdip_cfg_t        cfg;
+pdip_pattern_t    prompt, foo;
+unsigned long     allocs, allocs1;
+int               i;
+
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  rc = setenv("PS1", CK_PDIP_PROMPT, 1);
+  ck_assert_int_eq(rc, 0);
+
+  av[0] = "/bin/sh";
+  av[1] = NULL;
+  rc = pdip_exec(pdip_1, 1, av);
+  ck_assert_int_gt(rc, 1);
+
+  prompt = pdip_pattern_new("^" CK_PDIP_PROMPT "$");
+  ck_assert(prompt != NULL);
+  foo = pdip_pattern_new("foo");
+  ck_assert(foo != NULL);
+
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv_view(pdip_1, prompt, &data, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_ge(data_sz, sizeof(CK_PDIP_PROMPT) - 1);
+  ck_assert(0 == memcmp(data + data_sz - (sizeof(CK_PDIP_PROMPT) - 1), CK_PDIP_PROMPT, sizeof(CK_PDIP_PROMPT) - 1));
+
+  // The other reception services are not allowed until the release
+  rc = pdip_recv_view(pdip_1, prompt, &data, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EBUSY);
+  rc = pdip_recv(pdip_1, 0, &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EBUSY);
+  rc = pdip_flush(pdip_1, &display, &display_sz, &data_sz);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EBUSY);
+
+  rc = pdip_release(pdip_1);
+  ck_assert_int_eq(rc, 0);
+
+  // Releasing twice is harmless
+  rc = pdip_release(pdip_1);
+  ck_assert_int_eq(rc, 0);
+
+  // The data behind the match stay in the object
+  rc = pdip_send(pdip_1, "echo foo bar\n");
+  ck_assert_int_gt(rc, 0);
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv_view(pdip_1, prompt, &data, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  rc = pdip_release(pdip_1);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_send(pdip_1, "echo 123foo456\n");
+  ck_assert_int_gt(rc, 0);
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv_view(pdip_1, foo, &data, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_ge(data_sz, 3);
+  ck_assert(0 == memcmp(data + data_sz - 3, "foo", 3));
+  rc = pdip_release(pdip_1);
+  ck_assert_int_eq(rc, 0);
+
+  // Mix with the copying services
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv_pattern(pdip_1, foo, &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_gt(data_sz, 6);
+  ck_assert_str_eq(display + data_sz - 6, "123foo");
+  rc = pdip_recv_pattern(pdip_1, prompt, &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+
+  // Without regular expression, the data are read directly
+  rc = pdip_send(pdip_1, "echo xyz\n");
+  ck_assert_int_gt(rc, 0);
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv_view(pdip_1, (pdip_pattern_t)0, &data, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_DATA);
+  ck_assert_uint_gt(data_sz, 0);
+  rc = pdip_release(pdip_1);
+  ck_assert_int_eq(rc, 0);
+
+  // Steady state: no allocation
+  allocs1 = 0;
+  for (i = 0; i < 100; i ++)
+  {
+    rc = pdip_send(pdip_1, "echo line%d\n", i);
+    ck_assert_int_gt(rc, 0);
+    timeout.tv_sec = 2;
+    timeout.tv_usec = 0;
+    rc = pdip_recv_view(pdip_1, prompt, &data, &data_sz, &timeout);
+    ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+    rc = pdip_release(pdip_1);
+    ck_assert_int_eq(rc, 0);
+
+    if (10 == i)
+    {
+      rc = pdip_alloc_stats(pdip_1, &allocs1, 0);
+      ck_assert_int_eq(rc, 0);
+    }
+  } // End for
+
+  rc = pdip_alloc_stats(pdip_1, &allocs, 0);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(allocs, allocs1);
+
+  rc = pdip_pattern_delete(prompt);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_pattern_delete(foo);
+  ck_assert_int_eq(rc, 0);
+
+  // A view may be held while the object is deleted
+  rc = pdip_send(pdip_1, "echo bye\n");
+  ck_assert_int_gt(rc, 0);
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv_view(pdip_1, 0, &data, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_DATA);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  free(display);
+
+END_TEST
+
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : ck_loop_session_t
+// Usage  : Dialogue driven by an event loop
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  pdip_pattern_t  prompt;
+  unsigned int    answers;  // Number of commands answered
+  unsigned int    timeouts;
+  int             status;   // Exit status (-1 while alive)
+  char            data[256];
+  size_t          data_sz;
+} ck_loop_session_t;
+
+#define CK_LOOP_SESSIONS  20
+#define CK_LOOP_COMMANDS  5
+
+static void ck_loop_on_match(
+                             pdip_loop_t  loop,
+                             pdip_t       ctx,
+                             const char  *data,
+                             size_t       data_sz,
+                             void        *user
+                            )
+{
+ck_loop_session_t *s = (ck_loop_session_t *)user;
+struct timeval     timeout;
+int                rc;
+
+  (void)data;
+  ck_assert_uint_gt(data_sz, 0);
+
+  rc = pdip_send(ctx, "command %u\n", s->answers);
+  ck_assert_int_gt(rc, 0);
+  s->answers ++;
+
+  if (s->answers < CK_LOOP_COMMANDS)
+  {
+    timeout.tv_sec = 5;
+    timeout.tv_usec = 0;
+    rc = pdip_loop_expect(loop, ctx, s->prompt, &timeout);
+    ck_assert_int_eq(rc, 0);
+  }
+} // ck_loop_on_match
+
+static void ck_loop_on_data(
+                            pdip_loop_t  loop,
+                            pdip_t       ctx,
+                            const char  *data,
+                            size_t       data_sz,
+                            void        *user
+                           )
+{
+ck_loop_session_t *s = (ck_loop_session_t *)user;
+
+  (void)loop;
+  (void)ctx;
+
+  ck_assert_uint_lt(s->data_sz + data_sz, sizeof(s->data));
+  memcpy(s->data + s->data_sz, data, data_sz);
+  s->data_sz += data_sz;
+} // ck_loop_on_data
+
+static void ck_loop_on_timeout(
+                               pdip_loop_t  loop,
+                               pdip_t       ctx,
+                               void        *user
+                              )
+{
+ck_loop_session_t *s = (ck_loop_session_t *)user;
+int                rc;
+
+  s->timeouts ++;
+
+  // The object is removed and deleted from the callback
+  rc = pdip_loop_remove(loop, ctx);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_delete(ctx, NULL);
+  ck_assert_int_eq(rc, 0);
+} // ck_loop_on_timeout
+
+static void ck_loop_on_death(
+                             pdip_loop_t  loop,
+                             pdip_t       ctx,
+                             int          status,
+                             void        *user
+                            )
+{
+ck_loop_session_t *s = (ck_loop_session_t *)user;
+
+  (void)loop;
+  (void)ctx;
+
+  s->status = status;
+} // ck_loop_on_death
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_loop)
+
+int                rc;
+pdip_loop_t        loop;
+pdip_t             pdip[CK_LOOP_SESSIONS + 2];
+ck_loop_session_t  session[CK_LOOP_SESSIONS + 2];
+pdip_loop_cb_t     cb;
+pdip_cfg_t         cfg;
+char              *av[4];
+struct timeval     timeout;
+pdip_pattern_t     prompt, never;
+unsigned int       i;
+char              *display = (char *)0;
+size_t             display_sz = 0;
+size_t             data_sz;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  loop = pdip_loop_new();
+  ck_assert(loop != NULL);
+
+  prompt = pdip_pattern_new("^PROMPT> $");
+  ck_assert(prompt != NULL);
+  never = pdip_pattern_new("NEVER");
+  ck_assert(never != NULL);
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+
+  memset(&cb, 0, sizeof(cb));
+  cb.on_match   = ck_loop_on_match;
+  cb.on_timeout = ck_loop_on_timeout;
+  cb.on_death   = ck_loop_on_death;
+
+  // Dialogues with interactive programs
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "i=0; while [ $i -lt 5 ]; do printf 'PROMPT> '; read l; echo \"got $l\"; i=$((i+1)); done; exit 3";
+  av[3] = NULL;
+  for (i = 0; i < CK_LOOP_SESSIONS; i ++)
+  {
+    memset(&(session[i]), 0, sizeof(session[i]));
+    session[i].prompt = prompt;
+    session[i].status = -1;
+
+    pdip[i] = pdip_new(&cfg);
+    ck_assert(pdip[i] != NULL);
+
+    rc = pdip_exec(pdip[i], 3, av);
+    ck_assert_int_gt(rc, 1);
+
+    rc = pdip_loop_add(loop, pdip[i], &cb, &(session[i]));
+    ck_assert_int_eq(rc, 0);
+
+    // Only one loop per object
+    rc = pdip_loop_add(loop, pdip[i], &cb, &(session[i]));
+    ck_assert_int_eq(rc, -1);
+    ck_assert_errno_eq(EBUSY);
+
+    timeout.tv_sec = 5;
+    timeout.tv_usec = 0;
+    rc = pdip_loop_expect(loop, pdip[i], prompt, &timeout);
+    ck_assert_int_eq(rc, 0);
+  } // End for
+
+  // Pattern never found
+  memset(&(session[i]), 0, sizeof(session[i]));
+  session[i].status = -1;
+  pdip[i] = pdip_new(&cfg);
+  ck_assert(pdip[i] != NULL);
+  av[2] = "sleep 10";
+  rc = pdip_exec(pdip[i], 3, av);
+  ck_assert_int_gt(rc, 1);
+  rc = pdip_loop_add(loop, pdip[i], &cb, &(session[i]));
+  ck_assert_int_eq(rc, 0);
+  timeout.tv_sec = 0;
+  timeout.tv_usec = 200000;
+  rc = pdip_loop_expect(loop, pdip[i], never, &timeout);
+  ck_assert_int_eq(rc, 0);
+
+  // The reception services are not available in the loop
+  rc = pdip_recv(pdip[i], "NEVER", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EBUSY);
+  rc = pdip_delete(pdip[i], NULL);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EBUSY);
+
+  // Data received without pattern
+  i ++;
+  memset(&(session[i]), 0, sizeof(session[i]));
+  session[i].status = -1;
+  pdip[i] = pdip_new(&cfg);
+  ck_assert(pdip[i] != NULL);
+  av[2] = "echo hello; sleep 1; echo world";
+  rc = pdip_exec(pdip[i], 3, av);
+  ck_assert_int_gt(rc, 1);
+  cb.on_data = ck_loop_on_data;
+  rc = pdip_loop_add(loop, pdip[i], &cb, &(session[i]));
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_loop_run(loop, NULL);
+  ck_assert_int_eq(rc, PDIP_LOOP_EMPTY);
+
+  for (i = 0; i < CK_LOOP_SESSIONS; i ++)
+  {
+    ck_assert_uint_eq(session[i].answers, CK_LOOP_COMMANDS);
+    ck_assert_uint_eq(session[i].timeouts, 0);
+    ck_assert(WIFEXITED(session[i].status));
+    ck_assert_int_eq(WEXITSTATUS(session[i].status), 3);
+
+    rc = pdip_delete(pdip[i], NULL);
+    ck_assert_int_eq(rc, 0);
+  } // End for
+
+  ck_assert_uint_eq(session[i].timeouts, 1);
+  ck_assert_int_eq(session[i].status, -1);
+
+  i ++;
+  ck_assert(WIFEXITED(session[i].status));
+  ck_assert_uint_eq(session[i].data_sz, 12);
+  ck_assert_mem_eq(session[i].data, "hello\nworld\n", 12);
+  rc = pdip_delete(pdip[i], NULL);
+  ck_assert_int_eq(rc, 0);
+
+  // Nothing to run
+  timeout.tv_sec = 0;
+  timeout.tv_usec = 1000;
+  rc = pdip_loop_run(loop, &timeout);
+  ck_assert_int_eq(rc, PDIP_LOOP_EMPTY);
+
+  rc = pdip_loop_delete(loop);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_pattern_delete(prompt);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_pattern_delete(never);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : ck_loop_send_t
+// Usage  : Big payload sent from a callback of an event loop
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  pdip_pattern_t  go;
+  pdip_pattern_t  done;
+  int             step;      // 0: "GO" awaited, 1: "DONE" awaited, 2: end
+  int             status;    // Exit status (-1 while alive)
+  char           *payload;
+  size_t          payload_sz;
+} ck_loop_send_t;
+
+static void ck_loop_send_on_match(
+                                  pdip_loop_t  loop,
+                                  pdip_t       ctx,
+                                  const char  *data,
+                                  size_t       data_sz,
+                                  void        *user
+                                 )
+{
+ck_loop_send_t *s = (ck_loop_send_t *)user;
+struct timeval  timeout;
+int             rc;
+
+  (void)data;
+  (void)data_sz;
+
+  if (0 == s->step)
+  {
+    // The process writes its output before reading its input: the payload
+    // does not fit in the PTY which is only drained by the loop
+    rc = pdip_send_raw(ctx, s->payload, s->payload_sz);
+    ck_assert_int_eq(rc, (int)(s->payload_sz));
+
+    timeout.tv_sec = 20;
+    timeout.tv_usec = 0;
+    rc = pdip_loop_expect(loop, ctx, s->done, &timeout);
+    ck_assert_int_eq(rc, 0);
+  }
+
+  s->step ++;
+} // ck_loop_send_on_match
+
+static void ck_loop_send_on_timeout(
+                                    pdip_loop_t  loop,
+                                    pdip_t       ctx,
+                                    void        *user
+                                   )
+{
+ck_loop_send_t *s = (ck_loop_send_t *)user;
+
+  (void)ctx;
+
+  s->step = -1;
+  (void)pdip_loop_stop(loop);
+} // ck_loop_send_on_timeout
+
+static void ck_loop_send_on_death(
+                                  pdip_loop_t  loop,
+                                  pdip_t       ctx,
+                                  int          status,
+                                  void        *user
+                                 )
+{
+ck_loop_send_t *s = (ck_loop_send_t *)user;
+
+  (void)loop;
+  (void)ctx;
+
+  s->status = status;
+} // ck_loop_send_on_death
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_loop_send)
+
+int                rc;
+pdip_loop_t        loop;
+pdip_t             pdip;
+ck_loop_send_t     s;
+pdip_loop_cb_t     cb;
+pdip_cfg_t         cfg;
+char              *av[4];
+struct timeval     timeout;
+unsigned int       i;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  loop = pdip_loop_new();
+  ck_assert(loop != NULL);
+
+  memset(&s, 0, sizeof(s));
+  s.status = -1;
+  s.go = pdip_pattern_new("^GO$");
+  ck_assert(s.go != NULL);
+  s.done = pdip_pattern_new("^DONE 2000$");
+  ck_assert(s.done != NULL);
+
+  // 2000 lines of 50 bytes
+  s.payload_sz = 2000 * 50;
+  s.payload = (char *)malloc(s.payload_sz);
+  ck_assert(s.payload != NULL);
+  for (i = 0; i < 2000; i ++)
+  {
+    memset(s.payload + (i * 50), 'a' + (i % 26), 49);
+    s.payload[(i * 50) + 49] = '\n';
+  } // End for
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  pdip = pdip_new(&cfg);
+  ck_assert(pdip != NULL);
+
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "printf 'GO\\n'; head -c 300000 /dev/zero | tr '\\0' x; echo; i=0; while [ $i -lt 2000 ]; do read l; i=$((i+1)); done; echo \"DONE $i\"";
+  av[3] = NULL;
+  rc = pdip_exec(pdip, 3, av);
+  ck_assert_int_gt(rc, 1);
+
+  memset(&cb, 0, sizeof(cb));
+  cb.on_match   = ck_loop_send_on_match;
+  cb.on_timeout = ck_loop_send_on_timeout;
+  cb.on_death   = ck_loop_send_on_death;
+  rc = pdip_loop_add(loop, pdip, &cb, &s);
+  ck_assert_int_eq(rc, 0);
+
+  timeout.tv_sec = 5;
+  timeout.tv_usec = 0;
+  rc = pdip_loop_expect(loop, pdip, s.go, &timeout);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_loop_run(loop, NULL);
+  ck_assert_int_eq(rc, PDIP_LOOP_EMPTY);
+  ck_assert_int_eq(s.step, 2);
+  ck_assert(WIFEXITED(s.status));
+  ck_assert_int_eq(WEXITSTATUS(s.status), 0);
+
+  rc = pdip_delete(pdip, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_loop_delete(loop);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_pattern_delete(s.go);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_pattern_delete(s.done);
+  ck_assert_int_eq(rc, 0);
+
+  free(s.payload);
+
+END_TEST
+
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : ck_loop_timer_t
+// Usage  : Timeout of an object of an event loop
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  unsigned int  *order;     // Order of the timeouts
+  unsigned int  *nb;        // Number of timeouts
+  unsigned int   id;
+  int            rearm;     // Pattern awaited again upon the first timeout
+  pdip_pattern_t never;
+} ck_loop_timer_t;
+
+static void ck_loop_timer_on_timeout(
+                                     pdip_loop_t  loop,
+                                     pdip_t       ctx,
+                                     void        *user
+                                    )
+{
+ck_loop_timer_t *t = (ck_loop_timer_t *)user;
+struct timeval   timeout;
+int              rc;
+
+  t->order[*(t->nb)] = t->id;
+  (*(t->nb)) ++;
+
+  if (t->rearm)
+  {
+    t->rearm = 0;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 800000;
+    rc = pdip_loop_expect(loop, ctx, t->never, &timeout);
+    ck_assert_int_eq(rc, 0);
+    return;
+  }
+
+  rc = pdip_loop_remove(loop, ctx);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_delete(ctx, NULL);
+  ck_assert_int_eq(rc, 0);
+} // ck_loop_timer_on_timeout
+
+
+#define CK_LOOP_TIMERS  8
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_loop_timers)
+
+// Timeouts in ms, in a scrambled order (0 for a cancelled wait)
+static const unsigned int  ms[CK_LOOP_TIMERS] = { 700, 100, 0, 400, 200, 600, 300, 500 };
+static const unsigned int  expected[] = { 1, 4, 6, 3, 7, 5, 0, 1 };
+int                        rc;
+pdip_loop_t                loop;
+pdip_t                     pdip[CK_LOOP_TIMERS];
+ck_loop_timer_t            t[CK_LOOP_TIMERS];
+unsigned int               order[CK_LOOP_TIMERS + 1];
+unsigned int               nb = 0;
+pdip_loop_cb_t             cb;
+pdip_cfg_t                 cfg;
+char                      *av[4];
+struct timeval             timeout;
+pdip_pattern_t             never;
+unsigned int               i;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  loop = pdip_loop_new();
+  ck_assert(loop != NULL);
+
+  never = pdip_pattern_new("NEVER");
+  ck_assert(never != NULL);
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+
+  memset(&cb, 0, sizeof(cb));
+  cb.on_timeout = ck_loop_timer_on_timeout;
+
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "sleep 10";
+  av[3] = NULL;
+  for (i = 0; i < CK_LOOP_TIMERS; i ++)
+  {
+    t[i].order = order;
+    t[i].nb    = &nb;
+    t[i].id    = i;
+    t[i].rearm = (1 == i);
+    t[i].never = never;
+
+    pdip[i] = pdip_new(&cfg);
+    ck_assert(pdip[i] != NULL);
+
+    rc = pdip_exec(pdip[i], 3, av);
+    ck_assert_int_gt(rc, 1);
+  } // End for
+
+  // The deadlines are set at the same time
+  for (i = 0; i < CK_LOOP_TIMERS; i ++)
+  {
+    rc = pdip_loop_add(loop, pdip[i], &cb, &(t[i]));
+    ck_assert_int_eq(rc, 0);
+
+    timeout.tv_sec = 0;
+    timeout.tv_usec = (ms[i] ? ms[i] : 100) * 1000;
+    rc = pdip_loop_expect(loop, pdip[i], never, &timeout);
+    ck_assert_int_eq(rc, 0);
+
+    // Cancelled wait
+    if (!ms[i])
+    {
+      rc = pdip_loop_expect(loop, pdip[i], NULL, NULL);
+      ck_assert_int_eq(rc, 0);
+    }
+  } // End for
+
+  // The timeouts are reported in the order of their deadlines, the re-armed
+  // one (100 + 800 ms) coming last
+  timeout.tv_sec = 1;
+  timeout.tv_usec = 500000;
+  rc = pdip_loop_run(loop, &timeout);
+  ck_assert_int_eq(rc, PDIP_LOOP_TIMEOUT);
+  ck_assert_uint_eq(nb, CK_LOOP_TIMERS);
+  for (i = 0; i < nb; i ++)
+  {
+    ck_assert_uint_eq(order[i], expected[i]);
+  } // End for
+
+  // Only the object whose wait was cancelled is left
+  rc = pdip_loop_remove(loop, pdip[2]);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_delete(pdip[2], NULL);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_loop_delete(loop);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_pattern_delete(never);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : ck_output_t
+// Usage  : Data passed to the output callback
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  char          data[256];
+  size_t        data_sz;
+  unsigned int  calls;
+  char          lines[8][32];  // Data of the first calls
+} ck_output_t;
+
+static void ck_output_cb(
+                         pdip_t      ctx,
+                         const char *data,
+                         size_t      len,
+                         void       *user
+                        )
+{
+ck_output_t *o = (ck_output_t *)user;
+
+  ck_assert(ctx != NULL);
+  ck_assert_uint_gt(len, 0);
+
+  ck_assert_uint_lt(o->data_sz + len, sizeof(o->data));
+  memcpy(o->data + o->data_sz, data, len);
+  o->data_sz += len;
+
+  if (o->calls < 8)
+  {
+    ck_assert_uint_lt(len, sizeof(o->lines[0]));
+    memcpy(o->lines[o->calls], data, len);
+  }
+  o->calls ++;
+} // ck_output_cb
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_output)
+
+int             rc;
+pdip_t          pdip;
+pdip_cfg_t      cfg;
+char           *av[4];
+char           *display = (char *)0;
+size_t          display_sz = 0;
+size_t          data_sz;
+struct timeval  timeout;
+ck_output_t     out;
+pdip_loop_t     loop;
+pdip_loop_cb_t  cb;
+int             status;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(NULL == cfg.on_output);
+  cfg.on_output = ck_output_cb;
+  cfg.on_output_user = &out;
+
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "printf 'abc\ndef\nPROMPT> '; read l; printf 'gh'; sleep 0.2; printf 'i\nend'";
+  av[3] = NULL;
+
+  // The data are passed as they are read while the pattern matching goes
+  // on with the same data
+  memset(&out, 0, sizeof(out));
+  pdip = pdip_new(&cfg);
+  ck_assert(pdip != NULL);
+  rc = pdip_exec(pdip, 3, av);
+  ck_assert_int_gt(rc, 1);
+  timeout.tv_sec = 5;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip, "^PROMPT> $", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_eq(data_sz, 16);
+  ck_assert_str_eq(display, "abc\ndef\nPROMPT> ");
+  ck_assert_uint_eq(out.data_sz, 16);
+  ck_assert_mem_eq(out.data, "abc\ndef\nPROMPT> ", 16);
+  rc = pdip_send(pdip, "x\n");
+  ck_assert_int_eq(rc, 2);
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  (void)pdip_recv(pdip, "NEVER", &display, &display_sz, &data_sz, &timeout);
+  rc = pdip_status(pdip, &status, 1);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(out.data_sz, 25);
+  ck_assert_mem_eq(out.data, "abc\ndef\nPROMPT> x\nghi\nend", 25);
+  rc = pdip_delete(pdip, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  // Line by line: the incomplete lines are passed once completed or at
+  // the end of the data
+  memset(&out, 0, sizeof(out));
+  cfg.flags = PDIP_FLAG_OUTPUT_LINES;
+  pdip = pdip_new(&cfg);
+  ck_assert(pdip != NULL);
+  rc = pdip_exec(pdip, 3, av);
+  ck_assert_int_gt(rc, 1);
+  timeout.tv_sec = 5;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip, "^PROMPT> $", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_eq(out.calls, 2);
+  ck_assert_str_eq(out.lines[0], "abc\n");
+  ck_assert_str_eq(out.lines[1], "def\n");
+  rc = pdip_send(pdip, "x\n");
+  ck_assert_int_eq(rc, 2);
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  (void)pdip_recv(pdip, "NEVER", &display, &display_sz, &data_sz, &timeout);
+  rc = pdip_status(pdip, &status, 1);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(out.calls, 5);
+  ck_assert_str_eq(out.lines[2], "PROMPT> x\n");
+  ck_assert_str_eq(out.lines[3], "ghi\n");
+  ck_assert_str_eq(out.lines[4], "end");
+  rc = pdip_delete(pdip, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  // In an event loop, the data are not kept when no pattern is awaited
+  memset(&out, 0, sizeof(out));
+  cfg.flags = 0;
+  pdip = pdip_new(&cfg);
+  ck_assert(pdip != NULL);
+  av[2] = "echo hello; sleep 0.2; echo world";
+  rc = pdip_exec(pdip, 3, av);
+  ck_assert_int_gt(rc, 1);
+  loop = pdip_loop_new();
+  ck_assert(loop != NULL);
+  memset(&cb, 0, sizeof(cb));
+  rc = pdip_loop_add(loop, pdip, &cb, NULL);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_loop_run(loop, NULL);
+  ck_assert_int_eq(rc, PDIP_LOOP_EMPTY);
+  ck_assert_uint_eq(out.data_sz, 12);
+  ck_assert_mem_eq(out.data, "hello\nworld\n", 12);
+  rc = pdip_flush(pdip, &display, &display_sz, &data_sz);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(data_sz, 0);
+  rc = pdip_loop_delete(loop);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_delete(pdip, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  free(display);
+
+END_TEST
+
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_flush)
+
+int               rc;
+pdip_t            pdip_1;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+char             *av[2];
+struct timeval    timeout;
+pdip_cfg_t        cfg;
+
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  //
+  // Receive outstanding data
+  //
+
+  //
+  // As the shell sends its prompt on the standard error,
+  // we need to redirect its standard error to the PDIP terminal
+  // as we will use the shell prompt as outstanding data for the
+  // following tests
+  //
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  pdip_set_debug_level(pdip_1, 20);
+
+  av[0] = "/bin/sh";
+  av[1] = NULL;
+  rc = pdip_exec(pdip_1, 1, av);
+  ck_assert_int_gt(rc, 1);
+
+  // Wait for a regex which will not be found
+  // ==> The prompt of the shell will go inside the outstanding data
+  data_sz = 0;
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^qwerty =$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
+  ck_assert_uint_eq(data_sz, 0);
+
+  // Flush outstanding data
+  data_sz = 0;
+  rc = pdip_flush(pdip_1, &display, &display_sz, &data_sz);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_gt(data_sz, 0);
+
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+
+  //
+  // Receive outstanding data with allocated receiving buffer
+  //
+
+  //
+  // As the shell sends its prompt on the standard error,
+  // we need to redirect its standard error to the PDIP terminal
+  // as we will use the shell prompt as outstanding data for the
+  // following tests
+  //
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  pdip_set_debug_level(pdip_1, 20);
+
+  av[0] = "/bin/sh";
+  av[1] = NULL;
+  rc = pdip_exec(pdip_1, 1, av);
+  ck_assert_int_gt(rc, 1);
+
+  // Wait for a regex which will not be found
+  // ==> The prompt of the shell will go inside the outstanding data
+  data_sz = 0;
+  ck_assert_ptr_ne(display, 0);
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^qwerty =$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
+  ck_assert_uint_eq(data_sz, 0);
+
+  // Flush outstanding data
+  display_sz = 20;
+  data_sz = 0;
+  display = (char *)malloc(display_sz);
+  rc = pdip_flush(pdip_1, &display, &display_sz, &data_sz);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_gt(data_sz, 0);
+  ck_assert_uint_gt(display_sz, 0);
+  free(display);
+
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_delete)
+
+int               rc;
+pdip_t            pdip_1, pdip_2, pdip_3, pdip_4;
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+char             *av[2];
+struct timeval    timeout;
+pdip_cfg_t        cfg;
+int               status;
+
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+
+  //
+  // Delete object without controlled program
+  //
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  pdip_set_debug_level(pdip_1, 20);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+
+  //
+  // Delete object with controlled
+  //
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  pdip_set_debug_level(pdip_1, 20);
+
+  rc = setenv("PS1", CK_PDIP_PROMPT, 1);
+  ck_assert_int_eq(rc, 0);
+
+  av[0] = "/bin/sh";
+  av[1] = NULL;
+  rc = pdip_exec(pdip_1, 1, av);
+  ck_assert_int_gt(rc, 1);
+
+  // Wait for the prompt to make sure that the program is started
+  data_sz = 0;
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^" CK_PDIP_PROMPT "$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_gt(data_sz, 0);
+
+  rc = pdip_delete(pdip_1, &status);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(WIFSIGNALED(status));
+  ck_assert_int_eq(WTERMSIG(status), SIGKILL);
+
+
+  //
+  // Delete object with outstanding data
+  //
+
+  //
+  // As the shell sends its prompt on the standard error,
+  // we need to redirect its standard error to the PDIP terminal
+  // as we will use the shell prompt as outstanding data for the
+  // following tests
+  //
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  pdip_set_debug_level(pdip_1, 20);
+
+  av[0] = "/bin/sh";
+  av[1] = NULL;
+  rc = pdip_exec(pdip_1, 1, av);
+  ck_assert_int_gt(rc, 1);
+
+  // Wait for a regex which will not be found
+  // ==> The prompt of the shell will go inside the outstanding data
+  data_sz = 0;
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^qwerty =$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_TIMEOUT);
+  ck_assert_uint_eq(data_sz, 0);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+
+  // Delete multiple objects
+
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+  pdip_2 = pdip_new(&cfg);
+  ck_assert(pdip_2 != NULL);
+  pdip_3 = pdip_new(&cfg);
+  ck_assert(pdip_3 != NULL);
+  pdip_4 = pdip_new(&cfg);
+  ck_assert(pdip_4 != NULL);
+
+  rc = pdip_delete(pdip_4, NULL);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_delete(pdip_3, NULL);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_delete(pdip_2, NULL);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_fd)
+
+int               rc;
+pdip_t            pdip_1;
+pdip_cfg_t        cfg;
+char             *av[2];
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+struct timeval    timeout;
+
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  //
+  // As the shell sends its prompt on the standard error,
+  // we need to redirect its standard error to the PDIP terminal
+  // as we will use the shell prompt as outstanding data for the
+  // following tests
+  //
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  rc = setenv("PS1", CK_PDIP_PROMPT, 1);
+  ck_assert_int_eq(rc, 0);
+
+  pdip_set_debug_level(pdip_1, 20);
+
+  av[0] = "/bin/sh";
+  av[1] = NULL;
+  rc = pdip_exec(pdip_1, 1, av);
+  ck_assert_int_gt(rc, 1);
+
+  // Wait for the prompt to make sure that the program is started
+  data_sz = 0;
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^" CK_PDIP_PROMPT "$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_gt(data_sz, 0);
+
+  rc = pdip_fd(pdip_1);
+  ck_assert_int_ge(rc, 0);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_pidfd)
+
+int                rc;
+pdip_t             pdip_1;
+pdip_cfg_t         cfg;
+char              *av[4];
+pid_t              pid;
+int                fd, status;
+struct pollfd      pfd;
+struct sigaction   action;
+siginfo_t          info;
+pdip_loop_t        loop;
+pdip_loop_cb_t     cb;
+ck_loop_session_t  session;
+
+  // The internal signal handler is replaced by the process file descriptors
+  rc = pdip_configure(PDIP_SIG_HDL_INTERNAL, 0);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_configure(PDIP_SIG_HDL_PIDFD, 0);
+  ck_assert_int_eq(rc, 0);
+  rc = sigaction(SIGCHLD, NULL, &action);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(SIG_DFL == action.sa_handler);
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  // No process yet
+  rc = pdip_pidfd(pdip_1);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EPERM);
+
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "read l; exit 3";
+  av[3] = NULL;
+  pid = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(pid, 1);
+
+  fd = pdip_pidfd(pdip_1);
+  ck_assert_int_ge(fd, 0);
+
+  // The process is alive
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  rc = poll(&pfd, 1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  // The signal handler is not involved
+  memset(&info, 0, sizeof(info));
+  info.si_pid = pid;
+  rc = pdip_signal_handler(SIGCHLD, &info);
+  ck_assert_int_eq(rc, PDIP_SIG_UNKNOWN);
+
+  // The death is an event on the process file descriptor
+  rc = pdip_send(pdip_1, "bye\n");
+  ck_assert_int_eq(rc, 4);
+  rc = poll(&pfd, 1, 5000);
+  ck_assert_int_eq(rc, 1);
+  ck_assert(pfd.revents & POLLIN);
+
+  rc = pdip_status(pdip_1, &status, 0);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(WIFEXITED(status));
+  ck_assert_int_eq(WEXITSTATUS(status), 3);
+
+  // The process is reaped
+  rc = pdip_pidfd(pdip_1);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EPERM);
+
+  // The event loop waits for the death on the process file descriptor
+  loop = pdip_loop_new();
+  ck_assert(loop != NULL);
+  memset(&session, 0, sizeof(session));
+  session.status = -1;
+  memset(&cb, 0, sizeof(cb));
+  cb.on_data  = ck_loop_on_data;
+  cb.on_death = ck_loop_on_death;
+  av[2] = "echo hello; exit 4";
+  pid = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(pid, 1);
+  rc = pdip_loop_add(loop, pdip_1, &cb, &session);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_loop_run(loop, NULL);
+  ck_assert_int_eq(rc, PDIP_LOOP_EMPTY);
+  ck_assert(WIFEXITED(session.status));
+  ck_assert_int_eq(WEXITSTATUS(session.status), 4);
+  ck_assert_uint_eq(session.data_sz, 6);
+  ck_assert_mem_eq(session.data, "hello\n", 6);
+  rc = pdip_loop_delete(loop);
+  ck_assert_int_eq(rc, 0);
+
+  // No process file descriptor for the processes launched in the other modes
+  rc = pdip_configure(PDIP_SIG_HDL_EXTERNAL, 0);
+  ck_assert_int_eq(rc, 0);
+  av[2] = "read l";
+  pid = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(pid, 1);
+  rc = pdip_pidfd(pdip_1);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(ENOENT);
+
+  rc = pdip_send(pdip_1, "bye\n");
+  ck_assert_int_eq(rc, 4);
+  rc = pdip_status(pdip_1, &status, 1);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(WIFEXITED(status));
+  ck_assert_int_eq(WEXITSTATUS(status), 0);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_term_settings)
+
+pdip_t          pdip_1;
+char           *av[2];
+int             rc;
+char           *display;
+size_t          display_sz;
+size_t          data_sz;
+struct timeval  timeout;
+pdip_cfg_t      cfg;
+
+extern void pdip_term_settings(pdip_t ctx);
+
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  pdip_set_debug_level(pdip_1, 20);
+
+  rc = setenv("PS1", CK_PDIP_PROMPT, 1);
+  ck_assert_int_eq(rc, 0);
+
+  av[0] = "/bin/sh";
+  av[1] = NULL;
+  rc = pdip_exec(pdip_1, 1, av);
+  ck_assert_int_gt(rc, 1);
+
+  pdip_term_settings(pdip_1);
+
+  // Wait for the prompt to make sure that the program is started
+  data_sz = 0;
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^" CK_PDIP_PROMPT "$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_gt(data_sz, 0);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_status)
+
+pdip_t          pdip_1;
+char           *av[3];
+int             rc;
+char           *display;
+size_t          display_sz;
+size_t          data_sz;
+struct timeval  timeout;
+pdip_cfg_t      cfg;
+int             status;
+
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+
+  // Wait for a living process in non blocking mode
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  pdip_set_debug_level(pdip_1, 20);
+
+  rc = setenv("PS1", CK_PDIP_PROMPT, 1);
+  ck_assert_int_eq(rc, 0);
+
+  av[0] = "/bin/sh";
+  av[1] = NULL;
+  rc = pdip_exec(pdip_1, 1, av);
+  ck_assert_int_gt(rc, 1);
+
+  // Wait for the prompt to make sure that the program is started
+  data_sz = 0;
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^" CK_PDIP_PROMPT "$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_gt(data_sz, 0);
+
+  rc = pdip_status(pdip_1, &status, 0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EAGAIN);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+
+  //
+  // Wait a terminated object
+  //
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  pdip_set_debug_level(pdip_1, 20);
+
+  rc = setenv("PS1", CK_PDIP_PROMPT, 1);
+  ck_assert_int_eq(rc, 0);
+
+  av[0] = "/bin/sh";
+  av[1] = NULL;
+  rc = pdip_exec(pdip_1, 1, av);
+  ck_assert_int_gt(rc, 1);
+
+  // Wait for the prompt to make sure that the program is started
+  data_sz = 0;
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^" CK_PDIP_PROMPT "$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_gt(data_sz, 0);
+
+  rc = pdip_sig(pdip_1, SIGKILL);
+  ck_assert_int_eq(rc, 0);
+  
+  rc = pdip_status(pdip_1, &status, 1);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(WIFSIGNALED(status));
+  ck_assert_int_eq(WTERMSIG(status), SIGKILL);
+
+  rc = pdip_status(pdip_1, &status, 0);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(WIFSIGNALED(status));
+  ck_assert_int_eq(WTERMSIG(status), SIGKILL);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);  
+
+
+  // Wait for a process which terminates in blocking mode
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  pdip_set_debug_level(pdip_1, 20);
+
+  av[0] = "/bin/sleep";
+  av[1] = "1";
+  av[2] = NULL;
+  rc = pdip_exec(pdip_1, 2, av);
+  ck_assert_int_gt(rc, 1);
+
+  rc = pdip_status(pdip_1, &status, 1);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_int_eq(status, 0);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_set_debug_level)
+
+pdip_t          pdip_1;
+char           *av[3];
+int             rc;
+char           *display;
+size_t          display_sz;
+size_t          data_sz;
+struct timeval  timeout;
+pdip_cfg_t      cfg;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  // Without object
+  rc = pdip_set_debug_level(0, 1);
+  ck_assert_int_eq(rc, 0);
+
+
+  // With object
+
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.flags = PDIP_FLAG_ERR_REDIRECT;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  pdip_set_debug_level(pdip_1, 20);
+
+  rc = setenv("PS1", CK_PDIP_PROMPT, 1);
+  ck_assert_int_eq(rc, 0);
+
+  av[0] = "/bin/sh";
+  av[1] = NULL;
+  rc = pdip_exec(pdip_1, 1, av);
+  ck_assert_int_gt(rc, 1);
+
+  // Wait for the prompt to make sure that the program is started
+  data_sz = 0;
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^" CK_PDIP_PROMPT "$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_gt(data_sz, 0);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_cpu_nb)
+
+unsigned int rcu;
+int          rc;
+
+  // Get the number of CPUs
+  rc = sysconf(_SC_NPROCESSORS_ONLN);
+  ck_assert_int_gt(rc, 0);
+
+  rcu = pdip_cpu_nb();
+  ck_assert_int_gt(rcu, 0);
+
+  ck_assert_uint_eq(rc, rcu);
+
+END_TEST
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_cpu_alloc)
+
+unsigned char *cpu;
+int            rc;
+pdip_t         pdip_1;
+pdip_cfg_t      cfg;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  cpu = pdip_cpu_alloc();
+  ck_assert_ptr_ne(cpu, 0);
+
+  rc = pdip_cpu_free(cpu);
+  ck_assert_int_eq(rc, 0);
+
+
+  // Free an object with a CPU bitmap
+
+  cpu = pdip_cpu_alloc();
+  ck_assert_ptr_ne(cpu, 0);
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.cpu = cpu;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_cpu_free(cpu);
+  ck_assert_int_eq(rc, 0);  
+
+END_TEST
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_cpu_zero)
+
+unsigned char *cpu;
+int            rc;
+unsigned int   i;
+
+  cpu = pdip_cpu_alloc();
+  ck_assert_ptr_ne(cpu, 0);
+
+  rc = pdip_cpu_zero(cpu);
+  ck_assert_int_eq(rc, 0);
+
+  for (i = 0; i < pdip_cpu_nb(); i ++)
+  {
+    rc = pdip_cpu_isset(cpu, i);
+    ck_assert_int_eq(rc, 0);
+  } // End for
+
+  rc = pdip_cpu_free(cpu);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_cpu_set)
+
+unsigned char *cpu;
+int            rc;
+unsigned int   i;
+
+  cpu = pdip_cpu_alloc();
+  ck_assert_ptr_ne(cpu, 0);
+
+  rc = pdip_cpu_zero(cpu);
+  ck_assert_int_eq(rc, 0);
+
+  for (i = 0; i < pdip_cpu_nb(); i ++)
+  {
+    rc = pdip_cpu_isset(cpu, i);
+    ck_assert_int_eq(rc, 0);
+
+    rc = pdip_cpu_set(cpu, i);
+    ck_assert_int_eq(rc, 0);
+
+    rc = pdip_cpu_isset(cpu, i);
+    ck_assert_int_eq(rc, 1);
+  } // End for
+
+  rc = pdip_cpu_free(cpu);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_cpu_unset)
+
+unsigned char *cpu;
+int            rc;
+unsigned int   i;
+
+  cpu = pdip_cpu_alloc();
+  ck_assert_ptr_ne(cpu, 0);
+
+  rc = pdip_cpu_all(cpu);
+  ck_assert_int_eq(rc, 0);
+
+  for (i = 0; i < pdip_cpu_nb(); i ++)
+  {
+    rc = pdip_cpu_isset(cpu, i);
+    ck_assert_int_eq(rc, 1);
+
+    rc = pdip_cpu_unset(cpu, i);
+    ck_assert_int_eq(rc, 0);
+
+    rc = pdip_cpu_isset(cpu, i);
+    ck_assert_int_eq(rc, 0);
+  } // End for
+
+  rc = pdip_cpu_free(cpu);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_signal_hdl)
+
+int               rc;
+pdip_t            pdip_1, pdip_2, pdip_3, pdip_4, pdip_5, pdip_6;
+char             *av[3];
+int               status;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  // Create multiple object with processes which dies
+  // to trigger the signal handler with a list of multiple living objects
+
+  pdip_1 = pdip_new(0);
+  ck_assert(pdip_1 != NULL);
+  pdip_2 = pdip_new(0);
+  ck_assert(pdip_2 != NULL);
+  pdip_3 = pdip_new(0);
+  ck_assert(pdip_3 != NULL);
+  pdip_4 = pdip_new(0);
+  ck_assert(pdip_4 != NULL);
+  pdip_5 = pdip_new(0);
+  ck_assert(pdip_5 != NULL);
+  pdip_6 = pdip_new(0);
+  ck_assert(pdip_6 != NULL);
+
+  av[0] = "/bin/sleep";
+  av[1] = "1";
+  av[2] = NULL;
+  rc = pdip_exec(pdip_1, 2, av);
+  ck_assert_int_gt(rc, 1);
+  
+  av[0] = "/bin/sleep";
+  av[1] = "1";
+  av[2] = NULL;
+  rc = pdip_exec(pdip_2, 2, av);
+  ck_assert_int_gt(rc, 1);
+
+  av[0] = "/bin/sleep";
+  av[1] = "2";
+  av[2] = NULL;
+  rc = pdip_exec(pdip_3, 2, av);
+  ck_assert_int_gt(rc, 1);
+
+  av[0] = "/bin/sleep";
+  av[1] = "1";
+  av[2] = NULL;
+  rc = pdip_exec(pdip_4, 2, av);
+  ck_assert_int_gt(rc, 1);
+
+  av[0] = "/bin/sleep";
+  av[1] = "1";
+  av[2] = NULL;
+  rc = pdip_exec(pdip_5, 2, av);
+  ck_assert_int_gt(rc, 1);
+
+  av[0] = "/bin/sleep";
+  av[1] = "1";
+  av[2] = NULL;
+  rc = pdip_exec(pdip_6, 2, av);
+  ck_assert_int_gt(rc, 1);
+
+  rc = pdip_status(pdip_1, 0, 1);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_status(pdip_2, 0, 1);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_status(pdip_3, 0, 1);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_status(pdip_4, 0, 1);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_status(pdip_5, 0, 1);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_status(pdip_6, 0, 1);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_delete(pdip_2, NULL);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_delete(pdip_3, NULL);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_delete(pdip_4, NULL);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_delete(pdip_5, NULL);
+  ck_assert_int_eq(rc, 0);
+  rc = pdip_delete(pdip_6, NULL);
+  ck_assert_int_eq(rc, 0);
 
 
   // Create a process which dies prematurely
@@ -1653,50 +4631,830 @@ int               status;
   pdip_1 = pdip_new(0);
   ck_assert(pdip_1 != NULL);
 
-  pdip_set_debug_level(pdip_1, 20);
+  pdip_set_debug_level(pdip_1, 20);
+
+  av[0] = "/qwerty/not_exist/azerty";
+  av[1] = "2";
+  av[2] = NULL;
+  rc = pdip_exec(pdip_1, 2, av);
+  ck_assert_int_gt(rc, 1);
+
+  // Wait for the end of the process
+  rc = pdip_status(pdip_1, &status, 1);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(WIFEXITED(status));
+  // PDIP child exit(1) if exec() failed
+  ck_assert_int_eq(WEXITSTATUS(status), 1);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : CK_SIGCHLD_xxx
+// Usage  : Parameters of the stress test of the signal handler
+// ----------------------------------------------------------------------------
+#define CK_SIGCHLD_THREADS   2    // Threads creating children concurrently
+#define CK_SIGCHLD_CHILDREN  2500 // Children per thread and per phase
+#define CK_SIGCHLD_BATCH     25   // Children alive at the same time per thread
+#define CK_SIGCHLD_LIVING    100  // Long living children
+
+
+// ----------------------------------------------------------------------------
+// Name   : ck_sigchld_thread
+// Usage  : Create short-lived children by batches and check that the
+//          signal handler attributes them to their object until they are
+//          reaped. If 'arg' is not NULL, the thread plays the role of the
+//          signal handler (the SIGCHLD are not caught)
+// ----------------------------------------------------------------------------
+static void *ck_sigchld_thread(void *arg)
+{
+int        rc;
+pdip_t     pdip[CK_SIGCHLD_BATCH];
+pid_t      pid[CK_SIGCHLD_BATCH];
+char      *av[2];
+int        status;
+siginfo_t  info;
+int        i, j;
+
+  (void)arg;
+
+  av[0] = "/bin/true";
+  av[1] = NULL;
+
+  memset(&info, 0, sizeof(info));
+
+  for (i = 0; i < CK_SIGCHLD_CHILDREN; i += CK_SIGCHLD_BATCH)
+  {
+    for (j = 0; j < CK_SIGCHLD_BATCH; j ++)
+    {
+      pdip[j] = pdip_new(0);
+      ck_assert(pdip[j] != NULL);
+
+      pid[j] = pdip_exec(pdip[j], 1, av);
+      ck_assert_int_gt(pid[j], 1);
+    } // End for
+
+    for (j = 0; j < CK_SIGCHLD_BATCH; j ++)
+    {
+      // The process is known by the signal handler until it is reaped
+      info.si_pid = pid[j];
+      if (arg)
+      {
+        rc = pdip_signal_handler(SIGCHLD, &info);
+        ck_assert_int_eq(rc, PDIP_SIG_HANDLED);
+      }
+
+      rc = pdip_status(pdip[j], &status, 1);
+      ck_assert_int_eq(rc, 0);
+      ck_assert(WIFEXITED(status));
+      ck_assert_int_eq(WEXITSTATUS(status), 0);
+
+      rc = pdip_signal_handler(SIGCHLD, &info);
+      ck_assert_int_eq(rc, PDIP_SIG_ERROR);
+
+      rc = pdip_delete(pdip[j], NULL);
+      ck_assert_int_eq(rc, 0);
+    } // End for
+  } // End for
+
+  return NULL;
+} // ck_sigchld_thread
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_sigchld_stress)
+
+int               rc;
+pdip_t            living[CK_SIGCHLD_LIVING];
+pid_t             pid[CK_SIGCHLD_LIVING];
+pthread_t         tid[CK_SIGCHLD_THREADS];
+char             *av[3];
+siginfo_t         info;
+int               i, phase;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  // Long living children populate the table of the signal handler
+  av[0] = "/bin/sleep";
+  av[1] = "60";
+  av[2] = NULL;
+  for (i = 0; i < CK_SIGCHLD_LIVING; i ++)
+  {
+    living[i] = pdip_new(0);
+    ck_assert(living[i] != NULL);
+
+    pid[i] = pdip_exec(living[i], 2, av);
+    ck_assert_int_gt(pid[i], 1);
+  } // End for
+
+  // Short-lived children created and reaped concurrently: first with the
+  // internal signal handler, then with the threads playing its role
+  for (phase = 0; phase < 2; phase ++)
+  {
+    if (phase)
+    {
+      (void)signal(SIGCHLD, SIG_DFL);
+    }
+
+    for (i = 0; i < CK_SIGCHLD_THREADS; i ++)
+    {
+      rc = pthread_create(&(tid[i]), NULL, ck_sigchld_thread, (phase ? &phase : NULL));
+      ck_assert_int_eq(rc, 0);
+    } // End for
+
+    for (i = 0; i < CK_SIGCHLD_THREADS; i ++)
+    {
+      rc = pthread_join(tid[i], NULL);
+      ck_assert_int_eq(rc, 0);
+    } // End for
+  } // End for
+
+  // The long living children are attributed to their object until they are
+  // reaped
+  memset(&info, 0, sizeof(info));
+  for (i = 0; i < CK_SIGCHLD_LIVING; i ++)
+  {
+    rc = pdip_sig(living[i], SIGKILL);
+    ck_assert_int_eq(rc, 0);
+
+    info.si_pid = pid[i];
+    rc = pdip_signal_handler(SIGCHLD, &info);
+    ck_assert_int_eq(rc, PDIP_SIG_HANDLED);
+  } // End for
+
+  // Unknown process
+  info.si_pid = getpid();
+  rc = pdip_signal_handler(SIGCHLD, &info);
+  ck_assert_int_eq(rc, PDIP_SIG_ERROR);
+
+  for (i = 0; i < CK_SIGCHLD_LIVING; i ++)
+  {
+    rc = pdip_delete(living[i], NULL);
+    ck_assert_int_eq(rc, 0);
+  } // End for
+
+END_TEST
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_cpu_all)
+
+unsigned char *cpu;
+int            rc;
+unsigned int   i;
+
+  cpu = pdip_cpu_alloc();
+  ck_assert_ptr_ne(cpu, 0);
+
+  rc = pdip_cpu_all(cpu);
+  ck_assert_int_eq(rc, 0);
+
+  for (i = 0; i < pdip_cpu_nb(); i ++)
+  {
+    rc = pdip_cpu_isset(cpu, i);
+    ck_assert_int_eq(rc, 1);
+  } // End for
+
+  rc = pdip_cpu_free(cpu);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_new)
+
+unsigned char *cpu;
+int            rc;
+pdip_cfg_t     cfg;
+pdip_t         pdip_1;
+FILE          *out;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  // Create an object with default config
+
+  pdip_1 = pdip_new((pdip_cfg_t *)0);
+  ck_assert(pdip_1 != NULL);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);   
+
+  // Create an object with a config set with default values
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);   
+
+  // Create an object with all the fields configured by the user
+
+  cpu = pdip_cpu_alloc();
+  ck_assert_ptr_ne(cpu, 0);
+  rc = pdip_cpu_set(cpu, 0);
+  ck_assert_int_eq(rc, 0);
+
+  out = fopen("/dev/null", "r+");
+  ck_assert_ptr_ne(out, 0);
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.dbg_output            = out;
+  cfg.err_output            = out;
+  cfg.debug_level           = 10;
+  cfg.flags                |= (PDIP_FLAG_ERR_REDIRECT | PDIP_FLAG_RECV_ON_THE_FLOW);
+  cfg.cpu                   = cpu;
+  cfg.buf_resize_increment  = 512;
+  cfg.buf_growth            = PDIP_BUF_GROWTH_LINEAR;
+  cfg.buf_growth_factor     = 3;
+  cfg.buf_max_sz            = 1024 * 1024;
+
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);   
+
+  rc = fclose(out);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_exec)
+
+int             rc;
+pdip_cfg_t      cfg;
+pdip_t          pdip_1;
+char           *av[4];
+unsigned char  *cpu;
+int             status;
+char           *display;
+size_t          display_sz;
+size_t          data_sz;
+struct timeval  timeout;
+
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+  
+  // Execute a program on an object for which the current controlled
+  // process is dead but not freed
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  av[0] = "/bin/sleep";
+  av[1] = "1";
+  av[2] = NULL;
+  rc = pdip_exec(pdip_1, 2, av);
+  ck_assert_int_gt(rc, 1);
 
-  av[0] = "/qwerty/not_exist/azerty";
-  av[1] = "2";
+  // Wait for the end of the process
+  rc = pdip_status(pdip_1, 0, 1);
+  ck_assert_int_eq(rc, 0);
+
+  av[0] = "/bin/sleep";
+  av[1] = "1";
   av[2] = NULL;
   rc = pdip_exec(pdip_1, 2, av);
   ck_assert_int_gt(rc, 1);
 
   // Wait for the end of the process
+  rc = pdip_status(pdip_1, 0, 1);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  //
+  // Execute a process with a process affinity without any processors
+  //
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cpu = pdip_cpu_alloc();
+  cfg.cpu = cpu;
+
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  av[0] = "/bin/sleep";
+  av[1] = "1";
+  av[2] = NULL;
+  rc = pdip_exec(pdip_1, 2, av);
+  ck_assert_int_gt(rc, 1);
+  
+  rc = pdip_status(pdip_1, &status, 1);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(WIFEXITED(status));
+  ck_assert_int_eq(WEXITSTATUS(status), 0);
+  
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_cpu_free(cpu);
+  ck_assert_int_eq(rc, 0);
+
+
+  //
+  // Execute a process with a process affinity with at least one processor
+  //
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cpu = pdip_cpu_alloc();
+  rc = pdip_cpu_set(cpu, 0);
+  ck_assert_int_eq(rc, 0);
+  cfg.cpu = cpu;
+
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  pdip_set_debug_level(pdip_1, 20);
+
+  av[0] = "test/myaffinity";
+  av[1] = NULL;
+  rc = pdip_exec(pdip_1, 1, av);
+  ck_assert_int_gt(rc, 1);
+
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^CPU: 0", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_gt(data_sz, 0);
+  ck_assert_uint_gt(display_sz, 0);
+
+  free(display);
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_status(pdip_1, &status, 1);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(WIFEXITED(status));
+  ck_assert_int_eq(WEXITSTATUS(status), 0);
+  
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_cpu_free(cpu);
+  ck_assert_int_eq(rc, 0);
+
+
+  //
+  // Execute a process with a process affinity with all the processors
+  //
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cpu = pdip_cpu_alloc();
+  rc = pdip_cpu_all(cpu);
+  ck_assert_int_eq(rc, 0);
+  cfg.cpu = cpu;
+
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  pdip_set_debug_level(pdip_1, 20);
+
+  av[0] = "test/myaffinity";
+  av[1] = NULL;
+  rc = pdip_exec(pdip_1, 1, av);
+  ck_assert_int_gt(rc, 1);
+
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^CPU: 0", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  ck_assert_uint_gt(data_sz, 0);
+  ck_assert_uint_gt(display_sz, 0);
+
+  free(display);
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_status(pdip_1, &status, 1);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(WIFEXITED(status));
+  ck_assert_int_eq(WEXITSTATUS(status), 0);
+  
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_cpu_free(cpu);
+  ck_assert_int_eq(rc, 0);
+
+
+  //
+  // Execute the processes with clone(CLONE_VM|CLONE_VFORK)
+  //
+
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cpu = pdip_cpu_alloc();
+  rc = pdip_cpu_set(cpu, 0);
+  ck_assert_int_eq(rc, 0);
+  cfg.cpu = cpu;
+  cfg.flags |= PDIP_FLAG_ERR_REDIRECT;
+  cfg.spawn = PDIP_SPAWN_VFORK;
+
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  rc = pdip_cpu_free(cpu);
+  ck_assert_int_eq(rc, 0);
+
+  // Affinity
+  av[0] = "test/myaffinity";
+  av[1] = NULL;
+  rc = pdip_exec(pdip_1, 1, av);
+  ck_assert_int_gt(rc, 1);
+
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^CPU: 0", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+
+  rc = pdip_status(pdip_1, &status, 1);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(WIFEXITED(status));
+  ck_assert_int_eq(WEXITSTATUS(status), 0);
+
+  // The PTY is the controlling terminal of the process: CTRL-C interrupts it
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "read l; echo \"got $l\"; sleep 10";
+  av[3] = NULL;
+  rc = pdip_exec(pdip_1, 3, av);
+  ck_assert_int_gt(rc, 1);
+
+  rc = pdip_send(pdip_1, "hello\n");
+  ck_assert_int_eq(rc, 6);
+
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip_1, "^got hello$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+
+  rc = pdip_send(pdip_1, "\003");
+  ck_assert_int_eq(rc, 1);
+
+  rc = pdip_status(pdip_1, &status, 1);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(WIFSIGNALED(status));
+  ck_assert_int_eq(WTERMSIG(status), SIGINT);
+
+  // The failure of execvp() is reported by the exit status
+  av[0] = "/nonexistent/program";
+  av[1] = NULL;
+  rc = pdip_exec(pdip_1, 1, av);
+  ck_assert_int_gt(rc, 1);
+
   rc = pdip_status(pdip_1, &status, 1);
   ck_assert_int_eq(rc, 0);
   ck_assert(WIFEXITED(status));
-  // PDIP child exit(1) if exec() failed
   ck_assert_int_eq(WEXITSTATUS(status), 1);
 
-  rc = pdip_delete(pdip_1, NULL);
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  free(display);
+
+END_TEST
+
+
+
+
+// Number of open file descriptors of the current process
+static unsigned int ck_nb_fds(void)
+{
+DIR           *dir;
+unsigned int   nb = 0;
+
+  dir = opendir("/proc/self/fd");
+  ck_assert(dir != NULL);
+  while (readdir(dir))
+  {
+    nb ++;
+  }
+  closedir(dir);
+
+  return nb;
+} // ck_nb_fds
+
+
+// ----------------------------------------------------------------------------
+// Name   : ck_pty_pool_thread
+// Usage  : Disable and enable the pool of PTY concurrently with the other
+//          threads. The last call enables it
+// ----------------------------------------------------------------------------
+static void *ck_pty_pool_thread(void *arg)
+{
+int i;
+int rc;
+
+  (void)arg;
+
+  for (i = 0; i < 100; i ++)
+  {
+    rc = pdip_configure_pty_pool((i & 1) ? 2 : 0);
+    ck_assert_int_eq(rc, 0);
+  } // End for
+
+  return NULL;
+} // ck_pty_pool_thread
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_pty_pool)
+
+int             rc;
+pdip_cfg_t      cfg;
+pdip_t          pdip;
+char           *av[4];
+unsigned int    nb_fds, i;
+int             status;
+char           *display;
+size_t          display_sz;
+size_t          data_sz;
+struct timeval  timeout;
+pthread_t       tid[4];
+
+  display_sz = 0;
+  display = (char *)0;
+
+  rc = pdip_configure(1, 0);
+  ck_assert_int_eq(rc, 0);
+
+  nb_fds = ck_nb_fds();
+
+  // The background thread opens 4 PTY (master and slave sides)
+  rc = pdip_configure_pty_pool(4);
+  ck_assert_int_eq(rc, 0);
+  for (i = 0; (i < 200) && (ck_nb_fds() != nb_fds + 8); i ++)
+  {
+    usleep(10000);
+  }
+  ck_assert_uint_eq(ck_nb_fds(), nb_fds + 8);
+
+  // The processes run on the PTY of the pool: LF is not mapped to CR/LF
+  for (i = 0; i < 10; i ++)
+  {
+    rc = pdip_cfg_init(&cfg);
+    ck_assert_int_eq(rc, 0);
+    cfg.flags |= PDIP_FLAG_ERR_REDIRECT;
+    cfg.spawn = (i & 1 ? PDIP_SPAWN_VFORK : PDIP_SPAWN_FORK);
+    pdip = pdip_new(&cfg);
+    ck_assert(pdip != NULL);
+
+    av[0] = "/bin/sh";
+    av[1] = "-c";
+    av[2] = "echo a; echo b";
+    av[3] = NULL;
+    rc = pdip_exec(pdip, 3, av);
+    ck_assert_int_gt(rc, 1);
+
+    timeout.tv_sec = 2;
+    timeout.tv_usec = 0;
+    rc = pdip_recv(pdip, "^a$", &display, &display_sz, &data_sz, &timeout);
+    ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+    rc = pdip_recv(pdip, "^b$", &display, &display_sz, &data_sz, &timeout);
+    ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+
+    rc = pdip_status(pdip, &status, 1);
+    ck_assert_int_eq(rc, 0);
+    ck_assert(WIFEXITED(status));
+    ck_assert_int_eq(WEXITSTATUS(status), 0);
+
+    rc = pdip_delete(pdip, NULL);
+    ck_assert_int_eq(rc, 0);
+  } // End for
+
+  // Shrink the pool
+  rc = pdip_configure_pty_pool(1);
+  ck_assert_int_eq(rc, 0);
+  for (i = 0; (i < 200) && (ck_nb_fds() != nb_fds + 2); i ++)
+  {
+    usleep(10000);
+  }
+  ck_assert_uint_eq(ck_nb_fds(), nb_fds + 2);
+
+  // Deactivate the pool: the PTY are closed
+  rc = pdip_configure_pty_pool(0);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(ck_nb_fds(), nb_fds);
+
+  // Concurrent configurations: the last ones enable the pool which is
+  // refilled by a running thread
+  for (i = 0; i < 4; i ++)
+  {
+    rc = pthread_create(&(tid[i]), NULL, ck_pty_pool_thread, NULL);
+    ck_assert_int_eq(rc, 0);
+  } // End for
+  for (i = 0; i < 4; i ++)
+  {
+    rc = pthread_join(tid[i], NULL);
+    ck_assert_int_eq(rc, 0);
+  } // End for
+  for (i = 0; (i < 200) && (ck_nb_fds() != nb_fds + 4); i ++)
+  {
+    usleep(10000);
+  }
+  ck_assert_uint_eq(ck_nb_fds(), nb_fds + 4);
+
+  rc = pdip_configure_pty_pool(0);
   ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(ck_nb_fds(), nb_fds);
+
+  free(display);
 
 END_TEST
 
 
 
+
+// Read the events of the last session recorded into a file: the types are
+// stored into 'types' and the data of the events are concatenated
+// into 'data'
+static unsigned int ck_rec_read(
+                                const char    *path,
+                                unsigned char *types,
+                                unsigned int   max,
+                                char          *data,
+                                size_t         data_sz
+                               )
+{
+FILE             *f;
+pdip_rec_hdr_t    hdr;
+pdip_rec_event_t  ev;
+unsigned int      nb = 0;
+size_t            len = 0;
+size_t            rc;
+int               c;
+
+  f = fopen(path, "r");
+  ck_assert(f != NULL);
+
+  while (1 == fread(&ev, sizeof(ev), 1, f))
+  {
+    // Zeros left by a crash up to the end of the file
+    if (PDIP_REC_PAD == ev.type)
+    {
+      while (0 == (c = getc(f)))
+      {
+      } // End while
+      ck_assert_int_eq(c, EOF);
+      break;
+    }
+
+    // New session
+    if (!memcmp(&ev, PDIP_REC_MAGIC, sizeof(PDIP_REC_MAGIC)))
+    {
+      memcpy(&hdr, &ev, sizeof(ev));
+      rc = fread((char *)&hdr + sizeof(ev), sizeof(hdr) - sizeof(ev), 1, f);
+      ck_assert_uint_eq(rc, 1);
+      ck_assert_uint_eq(hdr.version, PDIP_REC_VERSION);
+      nb = 0;
+      len = 0;
+      continue;
+    }
+
+    ck_assert_uint_lt(nb, max);
+    types[nb ++] = ev.type;
+    ck_assert_uint_le(len + ev.len, data_sz);
+    rc = fread(data + len, 1, ev.len, f);
+    ck_assert_uint_eq(rc, ev.len);
+    len += ev.len;
+  } // End while
+
+  fclose(f);
+
+  return nb;
+} // ck_rec_read
+
+
 // The unitary tests are run in separate processes
 // START_TEST is a "static" definition of a function
-START_TEST(test_pdip_cpu_all)
+START_TEST(test_pdip_record)
 
-unsigned char *cpu;
-int            rc;
-unsigned int   i;
+int             rc;
+pdip_cfg_t      cfg;
+pdip_t          pdip;
+char           *av[4];
+int             status;
+char           *display;
+size_t          display_sz;
+size_t          data_sz;
+struct timeval  timeout;
+char            path[64];
+unsigned char   types[32];
+char            data[1024];
+unsigned int    nb, i, mode;
+int32_t         val;
 
-  cpu = pdip_cpu_alloc();
-  ck_assert_ptr_ne(cpu, 0);
+  display_sz = 0;
+  display = (char *)0;
 
-  rc = pdip_cpu_all(cpu);
+  rc = pdip_configure(1, 0);
   ck_assert_int_eq(rc, 0);
 
-  for (i = 0; i < pdip_cpu_nb(); i ++)
+  // Buffered and mapped recordings
+  for (mode = 0; mode < 2; mode ++)
   {
-    rc = pdip_cpu_isset(cpu, i);
-    ck_assert_int_eq(rc, 1);
+    snprintf(path, sizeof(path), "/tmp/pdip_rec_%d", getpid());
+    (void)unlink(path);
+
+    // Two sessions appended to the file: the last one is checked
+    for (i = 0; i < 2; i ++)
+    {
+      rc = pdip_cfg_init(&cfg);
+      ck_assert_int_eq(rc, 0);
+      cfg.flags |= PDIP_FLAG_ERR_REDIRECT | (mode ? PDIP_FLAG_RECORD_MMAP : 0);
+      cfg.record = path;
+      pdip = pdip_new(&cfg);
+      ck_assert(pdip != NULL);
+
+      av[0] = "/bin/sh";
+      av[1] = "-c";
+      av[2] = "read l; echo \"got $l\"; sleep 10";
+      av[3] = NULL;
+      rc = pdip_exec(pdip, 3, av);
+      ck_assert_int_gt(rc, 1);
+
+      rc = pdip_send(pdip, "hello\n");
+      ck_assert_int_eq(rc, 6);
+
+      timeout.tv_sec = 2;
+      timeout.tv_usec = 0;
+      rc = pdip_recv(pdip, "^got hello$", &display, &display_sz, &data_sz, &timeout);
+      ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+
+      rc = pdip_sig(pdip, SIGTERM);
+      ck_assert_int_eq(rc, 0);
+
+      rc = pdip_status(pdip, &status, 1);
+      ck_assert_int_eq(rc, 0);
+      ck_assert(WIFSIGNALED(status));
+
+      rc = pdip_delete(pdip, NULL);
+      ck_assert_int_eq(rc, 0);
+    } // End for
+
+    // EXEC, SEND, RECV (one or more), SIGNAL, EXIT
+    nb = ck_rec_read(path, types, 32, data, sizeof(data));
+    ck_assert_uint_ge(nb, 5);
+    ck_assert_uint_eq(types[0], PDIP_REC_EXEC);
+    ck_assert_uint_eq(types[1], PDIP_REC_SEND);
+    for (i = 2; i < nb - 2; i ++)
+    {
+      ck_assert_uint_eq(types[i], PDIP_REC_RECV);
+    }
+    ck_assert_uint_eq(types[nb - 2], PDIP_REC_SIGNAL);
+    ck_assert_uint_eq(types[nb - 1], PDIP_REC_EXIT);
+
+    // pid + parameters of EXEC, sent and received (echo) data, signal and
+    // status
+    memcpy(&val, data, sizeof(val));
+    ck_assert_int_gt(val, 1);
+    i = sizeof(val);
+    ck_assert_str_eq(data + i, "/bin/sh");
+    i += strlen("/bin/sh") + 1 + strlen("-c") + 1 + strlen(av[2]) + 1;
+    ck_assert_mem_eq(data + i, "hello\nhello\ngot hello\n", 22);
+    i += 22;
+    memcpy(&val, data + i, sizeof(val));
+    ck_assert_int_eq(val, SIGTERM);
+    i += sizeof(val);
+    memcpy(&val, data + i, sizeof(val));
+    ck_assert(WIFSIGNALED(val));
+    ck_assert_int_eq(WTERMSIG(val), SIGTERM);
+
+    (void)unlink(path);
   } // End for
 
-  rc = pdip_cpu_free(cpu);
-  ck_assert_int_eq(rc, 0);
+  free(display);
 
 END_TEST
 
@@ -1705,236 +5463,295 @@ END_TEST
 
 // The unitary tests are run in separate processes
 // START_TEST is a "static" definition of a function
-START_TEST(test_pdip_new)
+START_TEST(test_pdip_record_crash)
 
-unsigned char *cpu;
-int            rc;
-pdip_cfg_t     cfg;
-pdip_t         pdip_1;
-FILE          *out;
+int             rc;
+pdip_cfg_t      cfg;
+pdip_t          pdip;
+char           *av[4];
+int             status;
+char           *display;
+size_t          display_sz;
+size_t          data_sz;
+struct timeval  timeout;
+char            path[64];
+char            cmd[128];
+unsigned char   types[32];
+char            data[1024];
+unsigned int    nb;
+pid_t           pid;
+struct stat     st;
+
+  display_sz = 0;
+  display = (char *)0;
 
   rc = pdip_configure(1, 0);
   ck_assert_int_eq(rc, 0);
 
-  // Create an object with default config
+  snprintf(path, sizeof(path), "/tmp/pdip_crash_%d", getpid());
+  (void)unlink(path);
 
-  pdip_1 = pdip_new((pdip_cfg_t *)0);
-  ck_assert(pdip_1 != NULL);
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[3] = NULL;
 
-  rc = pdip_delete(pdip_1, NULL);
-  ck_assert_int_eq(rc, 0);   
+  // A process records a mapped session and dies without pdip_delete()
+  pid = fork();
+  ck_assert_int_ge(pid, 0);
+  if (0 == pid)
+  {
+    rc = pdip_cfg_init(&cfg);
+    ck_assert_int_eq(rc, 0);
+    cfg.flags |= PDIP_FLAG_ERR_REDIRECT | PDIP_FLAG_RECORD_MMAP;
+    cfg.record = path;
+    pdip = pdip_new(&cfg);
+    ck_assert(pdip != NULL);
 
-  // Create an object with a config set with default values
+    av[2] = "echo ready; sleep 10";
+    rc = pdip_exec(pdip, 3, av);
+    ck_assert_int_gt(rc, 1);
 
-  rc = pdip_cfg_init(&cfg);
-  ck_assert_int_eq(rc, 0);
-  pdip_1 = pdip_new(&cfg);
-  ck_assert(pdip_1 != NULL);
+    timeout.tv_sec = 2;
+    timeout.tv_usec = 0;
+    rc = pdip_recv(pdip, "^ready$", &display, &display_sz, &data_sz, &timeout);
+    ck_assert_int_eq(rc, PDIP_RECV_FOUND);
 
-  rc = pdip_delete(pdip_1, NULL);
-  ck_assert_int_eq(rc, 0);   
+    _exit(0);
+  }
 
-  // Create an object with all the fields configured by the user
+  rc = waitpid(pid, &status, 0);
+  ck_assert_int_eq(rc, pid);
+  ck_assert(WIFEXITED(status));
+  ck_assert_int_eq(WEXITSTATUS(status), 0);
 
-  cpu = pdip_cpu_alloc();
-  ck_assert_ptr_ne(cpu, 0);
-  rc = pdip_cpu_set(cpu, 0);
+  // The file ends with the zeros of the mapped window
+  rc = stat(path, &st);
   ck_assert_int_eq(rc, 0);
+  ck_assert_int_ge(st.st_size, 1024 * 1024);
 
-  out = fopen("/dev/null", "r+");
-  ck_assert_ptr_ne(out, 0);
+  nb = ck_rec_read(path, types, 32, data, sizeof(data));
+  ck_assert_uint_ge(nb, 2);
+  ck_assert_uint_eq(types[0], PDIP_REC_EXEC);
+  ck_assert_uint_eq(types[nb - 1], PDIP_REC_RECV);
+
+  snprintf(cmd, sizeof(cmd), "test/precdump %s | grep -q '^=== Session interrupted$'", path);
+  rc = system(cmd);
+  ck_assert_int_eq(rc, 0);
+  snprintf(cmd, sizeof(cmd), "test/precdump %s | grep -q UNKNOWN", path);
+  rc = system(cmd);
+  ck_assert_int_ne(rc, 0);
 
+  // The next session replaces the zeros
   rc = pdip_cfg_init(&cfg);
   ck_assert_int_eq(rc, 0);
-  cfg.dbg_output            = out;
-  cfg.err_output            = out;
-  cfg.debug_level           = 10;
-  cfg.flags                |= (PDIP_FLAG_ERR_REDIRECT | PDIP_FLAG_RECV_ON_THE_FLOW);
-  cfg.cpu                   = cpu;
-  cfg.buf_resize_increment  = 512;
+  cfg.flags |= PDIP_FLAG_ERR_REDIRECT | PDIP_FLAG_RECORD_MMAP;
+  cfg.record = path;
+  pdip = pdip_new(&cfg);
+  ck_assert(pdip != NULL);
 
-  pdip_1 = pdip_new(&cfg);
-  ck_assert(pdip_1 != NULL);
+  av[2] = "echo done";
+  rc = pdip_exec(pdip, 3, av);
+  ck_assert_int_gt(rc, 1);
 
-  rc = pdip_delete(pdip_1, NULL);
-  ck_assert_int_eq(rc, 0);   
+  rc = pdip_status(pdip, &status, 1);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(WIFEXITED(status));
 
-  rc = fclose(out);
+  rc = pdip_delete(pdip, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  rc = stat(path, &st);
   ck_assert_int_eq(rc, 0);
+  ck_assert_int_lt(st.st_size, 4096);
+
+  nb = ck_rec_read(path, types, 32, data, sizeof(data));
+  ck_assert_uint_ge(nb, 2);
+  ck_assert_uint_eq(types[0], PDIP_REC_EXEC);
+  ck_assert_uint_eq(types[nb - 1], PDIP_REC_EXIT);
+
+  // Both sessions are printed
+  snprintf(cmd, sizeof(cmd), "test/precdump %s | grep -c '^=== Session started' | grep -q '^2$'", path);
+  rc = system(cmd);
+  ck_assert_int_eq(rc, 0);
+
+  (void)unlink(path);
+
+  free(display);
 
 END_TEST
 
 
 
+
 // The unitary tests are run in separate processes
 // START_TEST is a "static" definition of a function
-START_TEST(test_pdip_exec)
+START_TEST(test_pdip_replay)
 
 int             rc;
 pdip_cfg_t      cfg;
-pdip_t          pdip_1;
-char           *av[3];
-unsigned char  *cpu;
+pdip_t          pdip;
+char           *av[6];
 int             status;
 char           *display;
 size_t          display_sz;
 size_t          data_sz;
 struct timeval  timeout;
+char            path[64];
 
   display_sz = 0;
   display = (char *)0;
 
   rc = pdip_configure(1, 0);
   ck_assert_int_eq(rc, 0);
-  
-  // Execute a program on an object for which the current controlled
-  // process is dead but not freed
+
+  snprintf(path, sizeof(path), "/tmp/pdip_replay_%d", getpid());
+  (void)unlink(path);
+
+  //
+  // Record two executions: a dialogue ending with an exit code and a
+  // program killed by a signal
+  //
 
   rc = pdip_cfg_init(&cfg);
   ck_assert_int_eq(rc, 0);
-  pdip_1 = pdip_new(&cfg);
-  ck_assert(pdip_1 != NULL);
+  cfg.flags |= PDIP_FLAG_ERR_REDIRECT;
+  cfg.record = path;
+  pdip = pdip_new(&cfg);
+  ck_assert(pdip != NULL);
 
-  av[0] = "/bin/sleep";
-  av[1] = "1";
-  av[2] = NULL;
-  rc = pdip_exec(pdip_1, 2, av);
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = "printf 'name? '; read l; echo \"got $l\"; exit 3";
+  av[3] = NULL;
+  rc = pdip_exec(pdip, 3, av);
   ck_assert_int_gt(rc, 1);
 
-  // Wait for the end of the process
-  rc = pdip_status(pdip_1, 0, 1);
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip, "name\\? ", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+
+  rc = pdip_send(pdip, "hello\n");
+  ck_assert_int_eq(rc, 6);
+
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip, "^got hello$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+
+  rc = pdip_status(pdip, &status, 1);
   ck_assert_int_eq(rc, 0);
+  ck_assert(WIFEXITED(status));
+  ck_assert_int_eq(WEXITSTATUS(status), 3);
 
-  av[0] = "/bin/sleep";
-  av[1] = "1";
-  av[2] = NULL;
-  rc = pdip_exec(pdip_1, 2, av);
+  av[2] = "echo ready; sleep 10";
+  rc = pdip_exec(pdip, 3, av);
   ck_assert_int_gt(rc, 1);
 
-  // Wait for the end of the process
-  rc = pdip_status(pdip_1, 0, 1);
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip, "^ready$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+
+  rc = pdip_sig(pdip, SIGTERM);
   ck_assert_int_eq(rc, 0);
 
-  rc = pdip_delete(pdip_1, NULL);
+  rc = pdip_status(pdip, &status, 1);
+  ck_assert_int_eq(rc, 0);
+  ck_assert(WIFSIGNALED(status));
+
+  rc = pdip_delete(pdip, NULL);
   ck_assert_int_eq(rc, 0);
 
   //
-  // Execute a process with a process affinity without any processors
+  // Replay of the dialogue without delays
   //
 
   rc = pdip_cfg_init(&cfg);
   ck_assert_int_eq(rc, 0);
-  cpu = pdip_cpu_alloc();
-  cfg.cpu = cpu;
-
-  pdip_1 = pdip_new(&cfg);
-  ck_assert(pdip_1 != NULL);
+  cfg.flags |= PDIP_FLAG_ERR_REDIRECT;
+  pdip = pdip_new(&cfg);
+  ck_assert(pdip != NULL);
 
-  av[0] = "/bin/sleep";
-  av[1] = "1";
-  av[2] = NULL;
-  rc = pdip_exec(pdip_1, 2, av);
+  av[0] = "test/preplay";
+  av[1] = "-s";
+  av[2] = "0";
+  av[3] = path;
+  av[4] = NULL;
+  rc = pdip_exec(pdip, 4, av);
   ck_assert_int_gt(rc, 1);
-  
-  rc = pdip_status(pdip_1, &status, 1);
-  ck_assert_int_eq(rc, 0);
-  ck_assert(WIFEXITED(status));
-  ck_assert_int_eq(WEXITSTATUS(status), 0);
-  
-  rc = pdip_delete(pdip_1, NULL);
-  ck_assert_int_eq(rc, 0);
 
-  rc = pdip_cpu_free(cpu);
-  ck_assert_int_eq(rc, 0);
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip, "name\\? ", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
 
+  rc = pdip_send(pdip, "hello\n");
+  ck_assert_int_eq(rc, 6);
 
-  //
-  // Execute a process with a process affinity with at least one processor
-  //
+  // The echo is part of the recording
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  rc = pdip_recv(pdip, "^hello$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
+  rc = pdip_recv(pdip, "^got hello$", &display, &display_sz, &data_sz, &timeout);
+  ck_assert_int_eq(rc, PDIP_RECV_FOUND);
 
-  rc = pdip_cfg_init(&cfg);
-  ck_assert_int_eq(rc, 0);
-  cpu = pdip_cpu_alloc();
-  rc = pdip_cpu_set(cpu, 0);
+  rc = pdip_status(pdip, &status, 1);
   ck_assert_int_eq(rc, 0);
-  cfg.cpu = cpu;
-
-  pdip_1 = pdip_new(&cfg);
-  ck_assert(pdip_1 != NULL);
+  ck_assert(WIFEXITED(status));
+  ck_assert_int_eq(WEXITSTATUS(status), 3);
 
-  pdip_set_debug_level(pdip_1, 20);
+  //
+  // Unexpected input
+  //
 
-  av[0] = "test/myaffinity";
-  av[1] = NULL;
-  rc = pdip_exec(pdip_1, 1, av);
+  rc = pdip_exec(pdip, 4, av);
   ck_assert_int_gt(rc, 1);
 
   timeout.tv_sec = 2;
   timeout.tv_usec = 0;
-  rc = pdip_recv(pdip_1, "^CPU: 0", &display, &display_sz, &data_sz, &timeout);
+  rc = pdip_recv(pdip, "name\\? ", &display, &display_sz, &data_sz, &timeout);
   ck_assert_int_eq(rc, PDIP_RECV_FOUND);
-  ck_assert_uint_gt(data_sz, 0);
-  ck_assert_uint_gt(display_sz, 0);
 
-  free(display);
-  display_sz = 0;
-  display = (char *)0;
+  rc = pdip_send(pdip, "bye\n");
+  ck_assert_int_eq(rc, 4);
 
-  rc = pdip_status(pdip_1, &status, 1);
+  rc = pdip_status(pdip, &status, 1);
   ck_assert_int_eq(rc, 0);
   ck_assert(WIFEXITED(status));
-  ck_assert_int_eq(WEXITSTATUS(status), 0);
-  
-  rc = pdip_delete(pdip_1, NULL);
-  ck_assert_int_eq(rc, 0);
-
-  rc = pdip_cpu_free(cpu);
-  ck_assert_int_eq(rc, 0);
-
+  ck_assert_int_eq(WEXITSTATUS(status), 2);
 
   //
-  // Execute a process with a process affinity with all the processors
+  // Replay of the second execution with the original delays: the program
+  // waits for the recorded signal
   //
 
-  rc = pdip_cfg_init(&cfg);
-  ck_assert_int_eq(rc, 0);
-  cpu = pdip_cpu_alloc();
-  rc = pdip_cpu_all(cpu);
-  ck_assert_int_eq(rc, 0);
-  cfg.cpu = cpu;
-
-  pdip_1 = pdip_new(&cfg);
-  ck_assert(pdip_1 != NULL);
-
-  pdip_set_debug_level(pdip_1, 20);
-
-  av[0] = "test/myaffinity";
-  av[1] = NULL;
-  rc = pdip_exec(pdip_1, 1, av);
+  av[1] = "-n";
+  av[2] = "2";
+  rc = pdip_exec(pdip, 4, av);
   ck_assert_int_gt(rc, 1);
 
   timeout.tv_sec = 2;
   timeout.tv_usec = 0;
-  rc = pdip_recv(pdip_1, "^CPU: 0", &display, &display_sz, &data_sz, &timeout);
+  rc = pdip_recv(pdip, "^ready$", &display, &display_sz, &data_sz, &timeout);
   ck_assert_int_eq(rc, PDIP_RECV_FOUND);
-  ck_assert_uint_gt(data_sz, 0);
-  ck_assert_uint_gt(display_sz, 0);
-
-  free(display);
-  display_sz = 0;
-  display = (char *)0;
 
-  rc = pdip_status(pdip_1, &status, 1);
+  rc = pdip_sig(pdip, SIGTERM);
   ck_assert_int_eq(rc, 0);
-  ck_assert(WIFEXITED(status));
-  ck_assert_int_eq(WEXITSTATUS(status), 0);
-  
-  rc = pdip_delete(pdip_1, NULL);
+
+  rc = pdip_status(pdip, &status, 1);
   ck_assert_int_eq(rc, 0);
+  ck_assert(WIFSIGNALED(status));
+  ck_assert_int_eq(WTERMSIG(status), SIGTERM);
 
-  rc = pdip_cpu_free(cpu);
+  rc = pdip_delete(pdip, NULL);
   ck_assert_int_eq(rc, 0);
 
+  (void)unlink(path);
+
+  free(display);
+
 END_TEST
 
 
@@ -2263,9 +6080,33 @@ TCase *tc_api;
   tcase_add_test(tc_api, test_pdip_recv);
   //tcase_add_test_raise_signal(tc_api, test_pdip_recv, SIGALRM);
   tcase_add_test(tc_api, test_pdip_send);
+  tcase_add_test(tc_api, test_pdip_send_raw);
+  tcase_add_test(tc_api, test_pdip_duplex);
+  tcase_add_test(tc_api, test_pdip_duplex_record);
+  tcase_add_test(tc_api, test_pdip_recv_pattern);
+  tcase_add_test(tc_api, test_pdip_recv_until);
+  tcase_add_test(tc_api, test_pdip_pattern_match);
+  tcase_add_test(tc_api, test_pdip_regex_cache);
+  tcase_add_test(tc_api, test_pdip_recv_incremental);
+  tcase_add_test(tc_api, test_pdip_recv_any);
+  tcase_add_test(tc_api, test_pdip_alloc_stats);
+  tcase_add_test(tc_api, test_pdip_stats);
+  tcase_add_test(tc_api, test_pdip_log);
+  tcase_add_test(tc_api, test_pdip_filter);
+  tcase_add_test(tc_api, test_pdip_screen);
+  tcase_add_test(tc_api, test_pdip_screen_redraw);
+  tcase_add_test(tc_api, test_pdip_buf_growth);
+  tcase_add_test(tc_api, test_pdip_buf_overflow);
+  tcase_add_test(tc_api, test_pdip_recv_nul);
+  tcase_add_test(tc_api, test_pdip_recv_view);
+  tcase_add_test(tc_api, test_pdip_loop);
+  tcase_add_test(tc_api, test_pdip_loop_send);
+  tcase_add_test(tc_api, test_pdip_loop_timers);
+  tcase_add_test(tc_api, test_pdip_output);
   tcase_add_test(tc_api, test_pdip_flush);
   tcase_add_test(tc_api, test_pdip_delete);
   tcase_add_test(tc_api, test_pdip_fd);
+  tcase_add_test(tc_api, test_pdip_pidfd);
   tcase_add_test(tc_api, test_pdip_term_settings);
   tcase_add_test(tc_api, test_pdip_status);
   tcase_add_test(tc_api, test_pdip_set_debug_level);
@@ -2276,8 +6117,13 @@ TCase *tc_api;
   tcase_add_test(tc_api, test_pdip_cpu_set);
   tcase_add_test(tc_api, test_pdip_cpu_unset);
   tcase_add_test(tc_api, test_signal_hdl);
+  tcase_add_test(tc_api, test_pdip_sigchld_stress);
   tcase_add_test(tc_api, test_pdip_new);
   tcase_add_test(tc_api, test_pdip_exec);
+  tcase_add_test(tc_api, test_pdip_pty_pool);
+  tcase_add_test(tc_api, test_pdip_record);
+  tcase_add_test(tc_api, test_pdip_record_crash);
+  tcase_add_test(tc_api, test_pdip_replay);
   tcase_add_test(tc_api, test_pdip_sig);
   tcase_add_test(tc_api, test_pdip_dump);
   tcase_add_test(tc_api, test_man);
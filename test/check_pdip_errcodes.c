@@ -21,6 +21,7 @@
 #include <unistd.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "check_all.h"
 #include "check_pdip.h"
@@ -72,19 +73,74 @@ END_TEST
 // START_TEST is a "static" definition of a function
 START_TEST(test_pdip_new_err)
 
-int    rc;
-pdip_t pdip_1;
+int        rc;
+pdip_t     pdip_1;
+pdip_cfg_t cfg;
 
   printf("%s: %d\n", __FUNCTION__, getpid());
 
-  // No error branches in pdip_new() except the memory allocation pbs
-
   pdip_1 = pdip_new((pdip_cfg_t *)0);
   ck_assert(pdip_1 != NULL);
 
   rc = pdip_delete(pdip_1, NULL);
   ck_assert_int_eq(rc, 0);
 
+  // Unknown growth policy
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.buf_growth = 42;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 == NULL);
+  ck_assert_errno_eq(EINVAL);
+
+  // Unknown spawning method
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.spawn = 42;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 == NULL);
+  ck_assert_errno_eq(EINVAL);
+
+  // Recording file which can't be opened
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.record = "/non_existent_dir/pdip.rec";
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 == NULL);
+  ck_assert_errno_eq(ENOENT);
+
+  // Maximum size of the buffers lower than the resize increment
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.buf_resize_increment = 512;
+  cfg.buf_max_sz = 512;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 == NULL);
+  ck_assert_errno_eq(EINVAL);
+
+  // Unknown overflow policy
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.buf_max_sz = 4096;
+  cfg.buf_overflow = PDIP_BUF_OVERFLOW_SPILL + 1;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 == NULL);
+  ck_assert_errno_eq(EINVAL);
+
+  // Oldest data removed from an unbounded buffer
+  cfg.buf_max_sz = 0;
+  cfg.buf_overflow = PDIP_BUF_OVERFLOW_DISCARD;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 == NULL);
+  ck_assert_errno_eq(EINVAL);
+
+  // Lookback window as big as the buffers
+  cfg.buf_max_sz = 4096;
+  cfg.buf_lookback = 4096;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 == NULL);
+  ck_assert_errno_eq(EINVAL);
+
 END_TEST
 
 
@@ -234,6 +290,7 @@ size_t            display_sz;
 size_t            data_sz;
 struct timeval    timeout;
 pdip_cfg_t        cfg;
+struct iovec      iov[1];
 
   display_sz = 0;
   display = (char *)0;
@@ -248,6 +305,32 @@ pdip_cfg_t        cfg;
   ck_assert_int_eq(rc, -1);
   ck_assert_errno_eq(EINVAL);
 
+  rc = pdip_send_raw(NULL, "toto", 4);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_send_raw((pdip_t)0x1, NULL, 4);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_sendv(NULL, iov, 1);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_sendv((pdip_t)0x1, NULL, 1);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_sendv((pdip_t)0x1, iov, -1);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  iov[0].iov_base = NULL;
+  iov[0].iov_len  = 4;
+  rc = pdip_sendv((pdip_t)0x1, iov, 1);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
 
   // Register SIGCHLD signal handler
   action.sa_sigaction = tpdip_sigchld_hdl;
@@ -283,11 +366,22 @@ pdip_cfg_t        cfg;
   ck_assert_int_eq(rc, -1);
   ck_assert_errno_eq(EPERM);
 
+  rc = pdip_send_raw(pdip_1, "toto", 4);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EPERM);
+
+  iov[0].iov_base = "toto";
+  iov[0].iov_len  = 4;
+  rc = pdip_sendv(pdip_1, iov, 1);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EPERM);
+
   rc = pdip_delete(pdip_1, NULL);
   ck_assert_int_eq(rc, 0);
 
   //
-  // Format too big for internal buffers
+  // Format bigger than the internal stack buffer: formatted in a
+  // dynamic buffer
   //
 #define CK_PDIP_BUF_SIZE 5000
   buf = (char *)malloc(CK_PDIP_BUF_SIZE);
@@ -323,8 +417,7 @@ pdip_cfg_t        cfg;
   ck_assert_uint_gt(data_sz, 0);
 
   rc = pdip_send(pdip_1, "Format too long: '%s'\n", buf);
-  ck_assert_int_eq(rc, -1);
-  ck_assert_errno_eq(ENOSPC);
+  ck_assert_int_eq(rc, (int)(sizeof("Format too long: ''\n") - 1 + CK_PDIP_BUF_SIZE - 1));
 
   free(buf);
   free(display);
@@ -547,6 +640,301 @@ char             *av[2];
 END_TEST
 
 
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_pattern_err)
+
+int               rc;
+pdip_t            pdip_1;
+pdip_pattern_t    pattern;
+pdip_pattern_t    patterns[2];
+char             *display;
+size_t            display_sz;
+size_t            data_sz;
+const char       *data;
+struct timespec   deadline;
+pdip_cfg_t        cfg;
+unsigned int      row, col;
+
+  pattern = pdip_pattern_new(0);
+  ck_assert(pattern == NULL);
+  ck_assert_errno_eq(EINVAL);
+
+  // Bad regular expression
+  pattern = pdip_pattern_new("a(b");
+  ck_assert(pattern == NULL);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_pattern_delete(0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  pattern = pdip_pattern_new("^prompt$");
+  ck_assert(pattern != NULL);
+
+  rc = pdip_pattern_match(0, "prompt", 0, 0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_pattern_match(pattern, 0, 0, 0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_recv_pattern(0, pattern, 0, 0, 0, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  pdip_1 = pdip_new((pdip_cfg_t *)0);
+  ck_assert(pdip_1 != NULL);
+
+  display_sz = 10;
+  display = (char *)0;
+  rc = pdip_recv_pattern(pdip_1, pattern, &display, &display_sz, &data_sz, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  // No program running
+  display_sz = 0;
+  display = (char *)0;
+  rc = pdip_recv_pattern(pdip_1, pattern, &display, &display_sz, &data_sz, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EPERM);
+
+  rc = pdip_recv_until(0, pattern, &display, &display_sz, &data_sz, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  // Bad deadline
+  deadline.tv_sec = 0;
+  deadline.tv_nsec = 1000000000;
+  rc = pdip_recv_until(pdip_1, pattern, &display, &display_sz, &data_sz, &deadline);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  // No program running
+  deadline.tv_nsec = 0;
+  rc = pdip_recv_until(pdip_1, pattern, &display, &display_sz, &data_sz, &deadline);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EPERM);
+
+  // Bad list of patterns
+  patterns[0] = pattern;
+  patterns[1] = 0;
+  rc = pdip_recv_any(pdip_1, 0, 1, 0, 0, &display, &display_sz, &data_sz, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_recv_any(pdip_1, patterns, 0, 0, 0, &display, &display_sz, &data_sz, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_recv_any(pdip_1, patterns, 2, 0, 0, &display, &display_sz, &data_sz, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_recv_any(0, patterns, 1, 0, 0, &display, &display_sz, &data_sz, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  // No program running
+  rc = pdip_recv_any(pdip_1, patterns, 1, 0, 0, &display, &display_sz, &data_sz, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EPERM);
+
+  rc = pdip_recv_view(0, pattern, &data, &data_sz, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_recv_view(pdip_1, pattern, 0, &data_sz, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_recv_view(pdip_1, pattern, &data, 0, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  // No program running
+  rc = pdip_recv_view(pdip_1, pattern, &data, &data_sz, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EPERM);
+
+  rc = pdip_release(0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  // Nothing to release
+  rc = pdip_release(pdip_1);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_recv_screen(0, pattern, &row, &col, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_recv_screen(pdip_1, 0, &row, &col, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_recv_screen_all(0, pattern, &row, &col, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  // No virtual screen
+  rc = pdip_recv_screen(pdip_1, pattern, &row, &col, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_screen_get(pdip_1, &display, &display_sz, &data_sz);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_screen_get(0, &display, &display_sz, &data_sz);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  // Bad dimensions of the virtual screen
+  rc = pdip_cfg_init(&cfg);
+  ck_assert_int_eq(rc, 0);
+  cfg.screen_cols = 80;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 == NULL);
+  ck_assert_errno_eq(EINVAL);
+
+  cfg.screen_rows = 70000;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 == NULL);
+  ck_assert_errno_eq(EINVAL);
+
+  cfg.screen_rows = 2;
+  cfg.screen_cols = 3;
+  pdip_1 = pdip_new(&cfg);
+  ck_assert(pdip_1 != NULL);
+
+  // No program running
+  rc = pdip_recv_screen(pdip_1, pattern, &row, &col, 0);
+  ck_assert_int_eq(rc, PDIP_RECV_ERROR);
+  ck_assert_errno_eq(EPERM);
+
+  // The blank screen is available
+  rc = pdip_screen_get(pdip_1, &display, &display_sz, &data_sz);
+  ck_assert_int_eq(rc, 0);
+  ck_assert_uint_eq(data_sz, 2);
+  ck_assert_str_eq(display, "\n\n");
+  free(display);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_pattern_delete(pattern);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_regex_cache_stats_err)
+
+int               rc;
+unsigned long     hits, misses;
+
+  rc = pdip_regex_cache_stats(0, &hits, &misses);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_alloc_stats(0, &hits, 0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_stats(0, (pdip_stats_t *)0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_configure_log(-1, 0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_configure_log(PDIP_LOG_DEFERRED + 1, 0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+END_TEST
+
+
+// The unitary tests are run in separate processes
+// START_TEST is a "static" definition of a function
+START_TEST(test_pdip_loop_err)
+
+int               rc;
+pdip_loop_t       loop;
+pdip_t            pdip_1;
+pdip_loop_cb_t    cb;
+
+  memset(&cb, 0, sizeof(cb));
+
+  rc = pdip_loop_delete(0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_loop_run(0, 0);
+  ck_assert_int_eq(rc, PDIP_LOOP_ERROR);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_loop_stop(0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  loop = pdip_loop_new();
+  ck_assert(loop != NULL);
+
+  pdip_1 = pdip_new((pdip_cfg_t *)0);
+  ck_assert(pdip_1 != NULL);
+
+  rc = pdip_loop_add(0, pdip_1, &cb, 0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_loop_add(loop, 0, &cb, 0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_loop_add(loop, pdip_1, 0, 0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  // No controlled program
+  rc = pdip_loop_add(loop, pdip_1, &cb, 0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EPERM);
+
+  // Object not registered
+  rc = pdip_loop_remove(loop, pdip_1);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(ENOENT);
+
+  rc = pdip_loop_expect(loop, pdip_1, 0, 0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(ENOENT);
+
+  rc = pdip_loop_remove(0, pdip_1);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_loop_expect(loop, 0, 0, 0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_delete(pdip_1, NULL);
+  ck_assert_int_eq(rc, 0);
+
+  rc = pdip_loop_delete(loop);
+  ck_assert_int_eq(rc, 0);
+
+END_TEST
+
+
 // The unitary tests are run in separate processes
 // START_TEST is a "static" definition of a function
 START_TEST(test_pdip_fd_err)
@@ -565,6 +953,23 @@ pdip_t            pdip_1;
   ck_assert_int_eq(rc, -1);
   ck_assert_errno_eq(EPERM);
 
+  rc = pdip_pidfd(0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_spill_fd(0);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EINVAL);
+
+  rc = pdip_pidfd(pdip_1);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(EPERM);
+
+  // Nothing spilled
+  rc = pdip_spill_fd(pdip_1);
+  ck_assert_int_eq(rc, -1);
+  ck_assert_errno_eq(ENOENT);
+
 END_TEST
 
 
@@ -724,6 +1129,9 @@ TCase *tc_err_code;
   tcase_add_test(tc_err_code, test_pdip_status_err);
   //tcase_add_test(tc_err_code, test_pdip_recv_err);
   tcase_add_test_raise_signal(tc_err_code, test_pdip_recv_err, SIGTERM);
+  tcase_add_test(tc_err_code, test_pdip_pattern_err);
+  tcase_add_test(tc_err_code, test_pdip_regex_cache_stats_err);
+  tcase_add_test(tc_err_code, test_pdip_loop_err);
   tcase_add_test(tc_err_code, test_pdip_fd_err);
   tcase_add_test(tc_err_code, test_pdip_term_settings_err);
   tcase_add_test(tc_err_code, test_pdip_cpu_free_err);
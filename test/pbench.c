@@ -0,0 +1,1441 @@
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// File        : pbench.c
+// Description : Benchmarks of the PDIP library
+//
+// License     :
+//
+//  Copyright (C) 2007-2018 Rachid Koucha <rachid dot koucha at gmail dot com>
+//
+//  This program is free and destined to help people using PDIP/ISYS/RSYS
+//  libraries
+//
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <libgen.h>
+
+#include "../pdip.h"
+#include "../pdip_ctrl.h"
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : PBENCH_PROMPT
+// Usage  : Prompt displayed by the controlled programs
+// ----------------------------------------------------------------------------
+#define PBENCH_PROMPT "PBENCH> "
+
+
+// ----------------------------------------------------------------------------
+// Name   : PBENCH_TRAILER
+// Usage  : Line displayed by the controlled programs after their data
+// ----------------------------------------------------------------------------
+#define PBENCH_TRAILER "PBENCH_END"
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_dir
+// Usage  : Directory of the benchmark program (where the helper programs
+//          like pdata are located)
+// ----------------------------------------------------------------------------
+static char *pbench_dir;
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_now
+// Usage  : Current time in seconds (monotonic clock)
+// Return : Time
+// ----------------------------------------------------------------------------
+static double pbench_now(void)
+{
+struct timespec ts;
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (double)(ts.tv_sec) + ((double)(ts.tv_nsec) / 1000000000.0);
+} // pbench_now
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_spawn
+// Usage  : Run a shell command line under the control of a PDIP object
+// Return : PDIP object, if OK
+//          0, if error
+// ----------------------------------------------------------------------------
+static pdip_t pbench_spawn(
+                           char       *cmdline,
+                           pdip_cfg_t *cfg
+                          )
+{
+pdip_t  pdip;
+char   *av[4];
+int     rc;
+
+  pdip = pdip_new(cfg);
+  if (!pdip)
+  {
+    fprintf(stderr, "pdip_new(): '%m' (%d)\n", errno);
+    return (pdip_t)0;
+  }
+
+  av[0] = "/bin/sh";
+  av[1] = "-c";
+  av[2] = cmdline;
+  av[3] = (char *)0;
+  rc = pdip_exec(pdip, 3, av);
+  if (rc < 0)
+  {
+    fprintf(stderr, "pdip_exec(%s): '%m' (%d)\n", cmdline, errno);
+    (void)pdip_delete(pdip, 0);
+    return (pdip_t)0;
+  }
+
+  return pdip;
+} // pbench_spawn
+
+
+// ----------------------------------------------------------------------------
+// Name   : PBENCH_RECV_xxx
+// Usage  : Reception modes
+// ----------------------------------------------------------------------------
+#define PBENCH_RECV_COMPILE  0  // pdip_recv() without regex cache
+#define PBENCH_RECV_CACHE    1  // pdip_recv() with the regex cache
+#define PBENCH_RECV_PATTERN  2  // pdip_recv_pattern()
+#define PBENCH_RECV_VIEW     3  // pdip_recv_view()
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_recv
+// Usage  : Receive 'nb' prompts from a program which displays them in a
+//          burst, with a regular expression compiled at each call, cached
+//          by the library or precompiled by the application
+// Return : Number of calls per second, if OK
+//          -1, if error
+// ----------------------------------------------------------------------------
+static double pbench_recv(
+                          unsigned int nb,
+                          int          mode
+                         )
+{
+pdip_t          pdip;
+pdip_cfg_t      cfg;
+pdip_pattern_t  pattern = (pdip_pattern_t)0;
+char            cmdline[256];
+char           *display = (char *)0;
+size_t          display_sz = 0;
+size_t          data_sz;
+const char     *data;
+struct timeval  to;
+unsigned int    i;
+int             rc;
+double          t0, t1;
+unsigned long   hits, misses;
+unsigned long   allocs;
+size_t          buf_sz;
+
+  snprintf(cmdline, sizeof(cmdline), "yes '%s' | head -n %u", PBENCH_PROMPT, nb);
+
+  (void)pdip_cfg_init(&cfg);
+  if (PBENCH_RECV_COMPILE == mode)
+  {
+    cfg.flags |= PDIP_FLAG_NO_REGEX_CACHE;
+  }
+
+  pdip = pbench_spawn(cmdline, &cfg);
+  if (!pdip)
+  {
+    return -1;
+  }
+
+  if ((PBENCH_RECV_PATTERN == mode) || (PBENCH_RECV_VIEW == mode))
+  {
+    pattern = pdip_pattern_new("^" PBENCH_PROMPT "$");
+    if (!pattern)
+    {
+      fprintf(stderr, "pdip_pattern_new(): '%m' (%d)\n", errno);
+      (void)pdip_delete(pdip, 0);
+      return -1;
+    }
+  }
+
+  t0 = pbench_now();
+
+  for (i = 0; i < nb; i ++)
+  {
+    to.tv_sec = 5;
+    to.tv_usec = 0;
+    if (PBENCH_RECV_PATTERN == mode)
+    {
+      rc = pdip_recv_pattern(pdip, pattern, &display, &display_sz, &data_sz, &to);
+    }
+    else if (PBENCH_RECV_VIEW == mode)
+    {
+      rc = pdip_recv_view(pdip, pattern, &data, &data_sz, &to);
+      (void)pdip_release(pdip);
+    }
+    else
+    {
+      rc = pdip_recv(pdip, "^" PBENCH_PROMPT "$", &display, &display_sz, &data_sz, &to);
+    }
+
+    if (PDIP_RECV_FOUND != rc)
+    {
+      fprintf(stderr, "Prompt#%u not received (rc=%d)\n", i, rc);
+      break;
+    }
+  } // End for
+
+  t1 = pbench_now();
+
+  if (PBENCH_RECV_CACHE == mode)
+  {
+    (void)pdip_regex_cache_stats(pdip, &hits, &misses);
+    printf("  regex cache         : %lu hits, %lu misses\n", hits, misses);
+  }
+
+  if ((PBENCH_RECV_PATTERN == mode) || (PBENCH_RECV_VIEW == mode))
+  {
+    (void)pdip_alloc_stats(pdip, &allocs, &buf_sz);
+    printf("  buffer allocations  : %lu for %u calls (outstanding buffer: %zu bytes)\n", allocs, nb, buf_sz);
+  }
+
+  if (pattern)
+  {
+    (void)pdip_pattern_delete(pattern);
+  }
+  (void)pdip_delete(pdip, 0);
+  free(display);
+
+  if (i != nb)
+  {
+    return -1;
+  }
+
+  return (double)nb / (t1 - t0);
+} // pbench_recv
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_test_recv
+// Usage  : Compare pdip_recv() (with and without regex cache),
+//          pdip_recv_pattern() and pdip_recv_view() on a prompt-heavy workload
+// Return : 0, if OK
+//          1, if error
+// ----------------------------------------------------------------------------
+static int pbench_test_recv(unsigned int nb)
+{
+double rate_str, rate_cache, rate_pat, rate_view;
+
+  printf("recv: %u prompts\n", nb);
+
+  rate_str = pbench_recv(nb, PBENCH_RECV_COMPILE);
+  rate_cache = pbench_recv(nb, PBENCH_RECV_CACHE);
+  rate_pat = pbench_recv(nb, PBENCH_RECV_PATTERN);
+  rate_view = pbench_recv(nb, PBENCH_RECV_VIEW);
+  if ((rate_str < 0) || (rate_cache < 0) || (rate_pat < 0) || (rate_view < 0))
+  {
+    return 1;
+  }
+
+  printf("  pdip_recv()         : %12.0f calls/s (no regex cache)\n", rate_str);
+  printf("  pdip_recv()         : %12.0f calls/s (x%.2f)\n", rate_cache, rate_cache / rate_str);
+  printf("  pdip_recv_pattern() : %12.0f calls/s (x%.2f)\n", rate_pat, rate_pat / rate_str);
+  printf("  pdip_recv_view()    : %12.0f calls/s (x%.2f)\n", rate_view, rate_view / rate_str);
+
+  return 0;
+} // pbench_test_recv
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_stream_cmd
+// Usage  : Receive the data displayed by a command line before the awaited
+//          trailer. If 'allocs' is not NULL, it is set with the number of
+//          allocations of reception buffers
+// Return : Throughput in MB/s, if OK
+//          -1, if error
+// ----------------------------------------------------------------------------
+static double pbench_stream_cmd(
+                                char          *cmdline,
+                                const char    *regular_expr,
+                                pdip_cfg_t    *cfg,
+                                unsigned long *allocs
+                               )
+{
+pdip_t          pdip;
+pdip_pattern_t  pattern;
+char           *display = (char *)0;
+size_t          display_sz = 0;
+size_t          data_sz;
+size_t          total;
+struct timeval  to;
+int             rc;
+double          t0, t1;
+
+  pdip = pbench_spawn(cmdline, cfg);
+  if (!pdip)
+  {
+    return -1;
+  }
+
+  pattern = pdip_pattern_new(regular_expr);
+  if (!pattern)
+  {
+    fprintf(stderr, "pdip_pattern_new(): '%m' (%d)\n", errno);
+    (void)pdip_delete(pdip, 0);
+    return -1;
+  }
+
+  t0 = pbench_now();
+
+  to.tv_sec = 600;
+  to.tv_usec = 0;
+  rc = pdip_recv_pattern(pdip, pattern, &display, &display_sz, &data_sz, &to);
+
+  t1 = pbench_now();
+
+  total = data_sz;
+
+  if (allocs)
+  {
+    (void)pdip_alloc_stats(pdip, allocs, (size_t *)0);
+  }
+
+  (void)pdip_pattern_delete(pattern);
+  (void)pdip_delete(pdip, 0);
+  free(display);
+
+  if (PDIP_RECV_FOUND != rc)
+  {
+    fprintf(stderr, "Trailer not received (rc=%d)\n", rc);
+    return -1;
+  }
+
+  return ((double)total / (1024.0 * 1024.0)) / (t1 - t0);
+} // pbench_stream_cmd
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_stream
+// Usage  : Receive 'mb' megabytes of lines displayed by pdata before the
+//          awaited trailer. If 'allocs' is not NULL, it is set with the
+//          number of allocations of reception buffers
+// Return : Throughput in MB/s, if OK
+//          -1, if error
+// ----------------------------------------------------------------------------
+static double pbench_stream(
+                            unsigned int   mb,
+                            const char    *regular_expr,
+                            pdip_cfg_t    *cfg,
+                            unsigned long *allocs
+                           )
+{
+char cmdline[256];
+
+  // Lines of 100 bytes (99 characters + newline)
+  snprintf(cmdline, sizeof(cmdline), "%s/pdata -b 99 -l %u -T %s", pbench_dir, mb * 10486, PBENCH_TRAILER);
+
+  return pbench_stream_cmd(cmdline, regular_expr, cfg, allocs);
+} // pbench_stream
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_test_replay
+// Usage  : Compare the reception of the data displayed by pdata with the
+//          reception of the same data replayed by preplay from a recording
+//          (without delays)
+// Return : 0, if OK
+//          1, if error
+// ----------------------------------------------------------------------------
+static int pbench_test_replay(unsigned int mb)
+{
+pdip_cfg_t  cfg;
+char        path[256];
+char        cmdline[512];
+double      rate_live, rate_replay;
+
+  printf("replay: %u MB before the trailer\n", mb);
+
+  snprintf(path, sizeof(path), "/tmp/pbench_%d.rec", getpid());
+  (void)unlink(path);
+
+  (void)pdip_cfg_init(&cfg);
+  cfg.record = path;
+  rate_live = pbench_stream(mb, "^" PBENCH_TRAILER "$", &cfg, (unsigned long *)0);
+
+  snprintf(cmdline, sizeof(cmdline), "exec %s/preplay -s 0 %s", pbench_dir, path);
+  rate_replay = pbench_stream_cmd(cmdline, "^" PBENCH_TRAILER "$", (pdip_cfg_t *)0, (unsigned long *)0);
+  (void)unlink(path);
+
+  if ((rate_live < 0) || (rate_replay < 0))
+  {
+    return 1;
+  }
+
+  printf("  pdata (recorded)    : %12.1f MB/s\n", rate_live);
+  printf("  preplay -s 0        : %12.1f MB/s (x%.2f)\n", rate_replay, rate_replay / rate_live);
+
+  return 0;
+} // pbench_test_replay
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_test_stream
+// Usage  : Measure the cost of a pdip_recv() preceded by a huge amount of
+//          data. The single-line regular expression is scanned incrementally
+//          whereas the multi-line one is rescanned from the beginning of the
+//          outstanding data at each read (smaller amount of data as the cost
+//          is quadratic)
+// Return : 0, if OK
+//          1, if error
+// ----------------------------------------------------------------------------
+static int pbench_test_stream(unsigned int mb)
+{
+double       rate_sl, rate_ml;
+unsigned int mb_ml;
+
+  mb_ml = (mb < 2 ? mb : 2);
+
+  printf("stream: %u MB before the trailer\n", mb);
+
+  rate_sl = pbench_stream(mb, "^" PBENCH_TRAILER "$", (pdip_cfg_t *)0, (unsigned long *)0);
+  rate_ml = pbench_stream(mb_ml, "^" PBENCH_TRAILER "[[:space:]]*$", (pdip_cfg_t *)0, (unsigned long *)0);
+  if ((rate_sl < 0) || (rate_ml < 0))
+  {
+    return 1;
+  }
+
+  printf("  single-line regex   : %12.1f MB/s (%u MB)\n", rate_sl, mb);
+  printf("  multi-line regex    : %12.1f MB/s (%u MB)\n", rate_ml, mb_ml);
+
+  return 0;
+} // pbench_test_stream
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_span
+// Usage  : Go through a buffer in memory as PDIP_FLAG_FILTER_CTRL does: the
+//          next byte to remove is looked for with the SIMD kernel or with the
+//          scalar loop
+// Return : Throughput in MB/s
+// ----------------------------------------------------------------------------
+static double pbench_span(
+                          const char *buf,
+                          size_t      len,
+                          int         scalar
+                         )
+{
+static volatile size_t  removed;
+size_t                  pos, n;
+unsigned int            i, nb;
+double                  t0, t1;
+
+  nb = 8;
+
+  t0 = pbench_now();
+
+  for (i = 0; i < nb; i ++)
+  {
+    for (pos = 0; pos < len; pos += n + 1)
+    {
+      n = (scalar ? pdip_ctrl_span_scalar(buf + pos, len - pos) : pdip_ctrl_span(buf + pos, len - pos));
+      removed ++;
+    } // End for
+  } // End for
+
+  t1 = pbench_now();
+
+  return ((double)nb * (double)len / (1024.0 * 1024.0)) / (t1 - t0);
+} // pbench_span
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_span_buf
+// Usage  : Fill a buffer of 'mb' megabytes with copies of a line
+// Return : Address of the buffer, if OK
+//          NULL, if error
+// ----------------------------------------------------------------------------
+static char *pbench_span_buf(
+                             unsigned int  mb,
+                             const char   *line,
+                             size_t       *len
+                            )
+{
+char   *buf;
+size_t  l, off;
+
+  *len = (size_t)mb * 1024 * 1024;
+  buf = (char *)malloc(*len);
+  if (!buf)
+  {
+    fprintf(stderr, "malloc(%zu): '%m' (%d)\n", *len, errno);
+    return (char *)0;
+  }
+
+  l = strlen(line);
+  for (off = 0; off < *len; off += l)
+  {
+    memcpy(buf + off, line, (l < (*len - off) ? l : *len - off));
+  } // End for
+
+  return buf;
+} // pbench_span_buf
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_test_filter
+// Usage  : Compare the SIMD kernel of PDIP_FLAG_FILTER_CTRL with the scalar
+//          loop on the same buffers in memory, then measure the cost of the
+//          flag on a pdip_recv() preceded by a huge amount of plain and
+//          colored lines (bound by the throughput of the PTY)
+// Return : 0, if OK
+//          1, if error
+// ----------------------------------------------------------------------------
+static int pbench_test_filter(unsigned int mb)
+{
+pdip_cfg_t  cfg;
+char        cmdline[512];
+double      rate_plain, rate_plain_f, rate_color, rate_color_f;
+double      rate_scalar, rate_simd;
+char       *buf;
+size_t      len;
+int         color;
+
+  printf("filter: %u MB before the trailer\n", mb);
+
+  // Lines of 100 bytes without and with two color escape sequences
+  for (color = 0; color < 2; color ++)
+  {
+    buf = pbench_span_buf(mb, (color ? "\033[1;32m[ OK ]\033[0m Started the service which prints a long line of text on the terminal..\n"
+                                     : "[ OK ] Started the service which prints a long line of text on the terminal.............\n"), &len);
+    if (!buf)
+    {
+      return 1;
+    }
+
+    rate_scalar = pbench_span(buf, len, 1);
+    rate_simd = pbench_span(buf, len, 0);
+    free(buf);
+
+    printf("  %s lines kernel  : %12.1f MB/s scalar, %12.1f MB/s SIMD (x%.2f)\n",
+           (color ? "color" : "plain"), rate_scalar, rate_simd, rate_simd / rate_scalar);
+  } // End for
+
+  (void)pdip_cfg_init(&cfg);
+  cfg.flags |= PDIP_FLAG_FILTER_CTRL;
+
+  rate_plain = pbench_stream(mb, "^" PBENCH_TRAILER "$", (pdip_cfg_t *)0, (unsigned long *)0);
+  rate_plain_f = pbench_stream(mb, "^" PBENCH_TRAILER "$", &cfg, (unsigned long *)0);
+
+  // Lines of 100 bytes with two color escape sequences
+  snprintf(cmdline, sizeof(cmdline),
+           "stty -echo; yes '\033[1;32m[ OK ]\033[0m %s' | head -n %u; echo %s",
+           "Started the service which prints a long line of text on the terminal..",
+           mb * 10486, PBENCH_TRAILER);
+  rate_color = pbench_stream_cmd(cmdline, "^" PBENCH_TRAILER "$", (pdip_cfg_t *)0, (unsigned long *)0);
+  rate_color_f = pbench_stream_cmd(cmdline, "^" PBENCH_TRAILER "$", &cfg, (unsigned long *)0);
+
+  if ((rate_plain < 0) || (rate_plain_f < 0) || (rate_color < 0) || (rate_color_f < 0))
+  {
+    return 1;
+  }
+
+  printf("  plain lines         : %12.1f MB/s\n", rate_plain);
+  printf("  plain lines filtered: %12.1f MB/s (x%.2f)\n", rate_plain_f, rate_plain_f / rate_plain);
+  printf("  color lines         : %12.1f MB/s\n", rate_color);
+  printf("  color lines filtered: %12.1f MB/s (x%.2f)\n", rate_color_f, rate_color_f / rate_color);
+
+  return 0;
+} // pbench_test_filter
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_test_growth
+// Usage  : Compare the growth policies of the reception buffers on a
+//          pdip_recv() preceded by a huge amount of data
+// Return : 0, if OK
+//          1, if error
+// ----------------------------------------------------------------------------
+static int pbench_test_growth(unsigned int mb)
+{
+pdip_cfg_t     cfg;
+double         rate_lin, rate_geo;
+unsigned long  allocs_lin, allocs_geo;
+
+  printf("growth: %u MB before the trailer\n", mb);
+
+  (void)pdip_cfg_init(&cfg);
+  cfg.buf_growth = PDIP_BUF_GROWTH_LINEAR;
+  rate_lin = pbench_stream(mb, "^" PBENCH_TRAILER "$", &cfg, &allocs_lin);
+
+  (void)pdip_cfg_init(&cfg);
+  cfg.buf_growth = PDIP_BUF_GROWTH_GEOMETRIC;
+  rate_geo = pbench_stream(mb, "^" PBENCH_TRAILER "$", &cfg, &allocs_geo);
+  if ((rate_lin < 0) || (rate_geo < 0))
+  {
+    return 1;
+  }
+
+  printf("  linear              : %12.1f MB/s, %8lu allocations\n", rate_lin, allocs_lin);
+  printf("  geometric           : %12.1f MB/s, %8lu allocations (x%.2f)\n", rate_geo, allocs_geo, rate_geo / rate_lin);
+
+  return 0;
+} // pbench_test_growth
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_match
+// Usage  : Look for a regular expression at the end of a buffer of 'mb'
+//          megabytes with pdip_pattern_match()
+// Return : Throughput in MB/s, if OK
+//          -1, if error
+// ----------------------------------------------------------------------------
+static double pbench_match(
+                           const char   *buf,
+                           size_t        len,
+                           const char   *regular_expr
+                          )
+{
+pdip_pattern_t  pattern;
+unsigned int    i, nb;
+size_t          start, end;
+double          t0, t1;
+
+  pattern = pdip_pattern_new(regular_expr);
+  if (!pattern)
+  {
+    fprintf(stderr, "pdip_pattern_new(): '%m' (%d)\n", errno);
+    return -1;
+  }
+
+  nb = 4;
+
+  t0 = pbench_now();
+
+  for (i = 0; i < nb; i ++)
+  {
+    if (0 != pdip_pattern_match(pattern, buf, &start, &end))
+    {
+      fprintf(stderr, "<%s> not found\n", regular_expr);
+      break;
+    }
+  } // End for
+
+  t1 = pbench_now();
+
+  (void)pdip_pattern_delete(pattern);
+
+  if (i != nb)
+  {
+    return -1;
+  }
+
+  return ((double)nb * (double)len / (1024.0 * 1024.0)) / (t1 - t0);
+} // pbench_match
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_test_match
+// Usage  : Compare the literal search and regexec() on the same anchored
+//          literal (the parenthesis force the use of regexec())
+// Return : 0, if OK
+//          1, if error
+// ----------------------------------------------------------------------------
+static int pbench_test_match(unsigned int mb)
+{
+char   *buf;
+size_t  len, i;
+double  rate_lit, rate_regex;
+
+  // Lines of 100 bytes followed by the trailer
+  len = (size_t)mb * 1024 * 1024;
+  buf = (char *)malloc(len + sizeof(PBENCH_TRAILER) + 1);
+  if (!buf)
+  {
+    fprintf(stderr, "malloc(%zu): '%m' (%d)\n", len, errno);
+    return 1;
+  }
+
+  for (i = 0; i < len; i ++)
+  {
+    buf[i] = ((i % 100) == 99) ? '\n' : ('a' + (i % 26));
+  } // End for
+  buf[len - 1] = '\n';
+  strcpy(buf + len, PBENCH_TRAILER "\n");
+
+  printf("match: %u MB scanned\n", mb);
+
+  rate_lit = pbench_match(buf, len, "^" PBENCH_TRAILER "$");
+  rate_regex = pbench_match(buf, len, "^(" PBENCH_TRAILER ")$");
+
+  free(buf);
+
+  if ((rate_lit < 0) || (rate_regex < 0))
+  {
+    return 1;
+  }
+
+  printf("  regexec()           : %12.1f MB/s\n", rate_regex);
+  printf("  literal search      : %12.1f MB/s (x%.2f)\n", rate_lit, rate_lit / rate_regex);
+
+  return 0;
+} // pbench_test_match
+
+
+// ----------------------------------------------------------------------------
+// Name   : PBENCH_LOOP_ROUNDS
+// Usage  : Number of request/answer exchanges per session in the loop test
+// ----------------------------------------------------------------------------
+#define PBENCH_LOOP_ROUNDS 20
+
+
+// ----------------------------------------------------------------------------
+// Name   : PBENCH_LOOP_CMD
+// Usage  : Shell command line answering "PONG" to each line after a delay
+//          (e.g. remote server)
+// ----------------------------------------------------------------------------
+#define PBENCH_LOOP_CMD "stty -echo; echo READY; while read l; do sleep 0.01; echo PONG; done"
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_loop_session_t
+// Usage  : Session driven by the event loop
+// ----------------------------------------------------------------------------
+typedef struct
+{
+  pdip_t          pdip;
+  pdip_pattern_t  pattern;
+  unsigned int    rounds;
+  int             err;
+} pbench_loop_session_t;
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_loop_on_match
+// Usage  : Answer received: send the next request
+// ----------------------------------------------------------------------------
+static void pbench_loop_on_match(
+                                 pdip_loop_t  loop,
+                                 pdip_t       pdip,
+                                 const char  *data,
+                                 size_t       data_sz,
+                                 void        *user
+                                )
+{
+pbench_loop_session_t *s = (pbench_loop_session_t *)user;
+struct timeval         to;
+
+  (void)data;
+  (void)data_sz;
+
+  if (s->rounds ++ == PBENCH_LOOP_ROUNDS)
+  {
+    (void)pdip_loop_remove(loop, pdip);
+    return;
+  }
+
+  to.tv_sec = 5;
+  to.tv_usec = 0;
+  if ((pdip_send(pdip, "ping\n") < 0) ||
+      (pdip_loop_expect(loop, pdip, s->pattern, &to) != 0))
+  {
+    s->err = 1;
+    (void)pdip_loop_remove(loop, pdip);
+  }
+} // pbench_loop_on_match
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_loop_on_timeout/pbench_loop_on_error
+// Usage  : Timeout or error on a session
+// ----------------------------------------------------------------------------
+static void pbench_loop_on_timeout(
+                                   pdip_loop_t  loop,
+                                   pdip_t       pdip,
+                                   void        *user
+                                  )
+{
+pbench_loop_session_t *s = (pbench_loop_session_t *)user;
+
+  s->err = 1;
+  (void)pdip_loop_remove(loop, pdip);
+} // pbench_loop_on_timeout
+
+static void pbench_loop_on_error(
+                                 pdip_loop_t  loop,
+                                 pdip_t       pdip,
+                                 int          err,
+                                 void        *user
+                                )
+{
+  (void)err;
+  pbench_loop_on_timeout(loop, pdip, user);
+} // pbench_loop_on_error
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_loop
+// Usage  : Make 'nb' sessions exchange PBENCH_LOOP_ROUNDS requests/answers
+//          either one after the other with pdip_recv_pattern() or
+//          concurrently from an event loop
+// Return : Number of exchanges per second, if OK
+//          -1, if error
+// ----------------------------------------------------------------------------
+static double pbench_loop(
+                          unsigned int nb,
+                          int          use_loop
+                         )
+{
+pbench_loop_session_t *s;
+pdip_pattern_t         ready, pong;
+pdip_loop_t            loop = (pdip_loop_t)0;
+pdip_loop_cb_t         cb;
+char                  *display = (char *)0;
+size_t                 display_sz = 0;
+size_t                 data_sz;
+struct timeval         to;
+unsigned int           i, r;
+int                    rc;
+int                    err;
+double                 t0 = 0, t1 = 0;
+
+  s = (pbench_loop_session_t *)calloc(nb, sizeof(pbench_loop_session_t));
+  ready = pdip_pattern_new("^READY$");
+  pong = pdip_pattern_new("^PONG$");
+  if (!s || !ready || !pong)
+  {
+    fprintf(stderr, "Allocation failure: '%m' (%d)\n", errno);
+    err = 1;
+    goto end;
+  }
+
+  // Launch the sessions and wait until they are ready
+  err = 0;
+  for (i = 0; i < nb; i ++)
+  {
+    s[i].pattern = pong;
+    s[i].pdip = pbench_spawn(PBENCH_LOOP_CMD, (pdip_cfg_t *)0);
+    if (!(s[i].pdip))
+    {
+      err = 1;
+      goto end;
+    }
+  } // End for
+  for (i = 0; i < nb; i ++)
+  {
+    to.tv_sec = 5;
+    to.tv_usec = 0;
+    rc = pdip_recv_pattern(s[i].pdip, ready, &display, &display_sz, &data_sz, &to);
+    if (PDIP_RECV_FOUND != rc)
+    {
+      fprintf(stderr, "Session#%u not ready (rc=%d)\n", i, rc);
+      err = 1;
+      goto end;
+    }
+  } // End for
+
+  t0 = pbench_now();
+
+  if (use_loop)
+  {
+    loop = pdip_loop_new();
+    if (!loop)
+    {
+      fprintf(stderr, "pdip_loop_new(): '%m' (%d)\n", errno);
+      err = 1;
+      goto end;
+    }
+
+    memset(&cb, 0, sizeof(cb));
+    cb.on_match = pbench_loop_on_match;
+    cb.on_timeout = pbench_loop_on_timeout;
+    cb.on_error = pbench_loop_on_error;
+
+    for (i = 0; i < nb; i ++)
+    {
+      to.tv_sec = 5;
+      to.tv_usec = 0;
+      if ((pdip_loop_add(loop, s[i].pdip, &cb, &(s[i])) != 0) ||
+          (pdip_send(s[i].pdip, "ping\n") < 0)                ||
+          (pdip_loop_expect(loop, s[i].pdip, pong, &to) != 0))
+      {
+        fprintf(stderr, "Session#%u not started: '%m' (%d)\n", i, errno);
+        err = 1;
+        goto end;
+      }
+    } // End for
+
+    rc = pdip_loop_run(loop, (struct timeval *)0);
+    if (PDIP_LOOP_EMPTY != rc)
+    {
+      fprintf(stderr, "pdip_loop_run(): rc=%d\n", rc);
+      err = 1;
+    }
+
+    for (i = 0; i < nb; i ++)
+    {
+      err |= s[i].err;
+    } // End for
+  }
+  else
+  {
+    for (i = 0; (0 == err) && (i < nb); i ++)
+    {
+      for (r = 0; r < PBENCH_LOOP_ROUNDS; r ++)
+      {
+        to.tv_sec = 5;
+        to.tv_usec = 0;
+        if ((pdip_send(s[i].pdip, "ping\n") < 0) ||
+            (pdip_recv_pattern(s[i].pdip, pong, &display, &display_sz, &data_sz, &to) != PDIP_RECV_FOUND))
+        {
+          fprintf(stderr, "Session#%u: exchange#%u failed\n", i, r);
+          err = 1;
+          break;
+        }
+      } // End for
+    } // End for
+  }
+
+  t1 = pbench_now();
+
+end:
+
+  if (loop)
+  {
+    (void)pdip_loop_delete(loop);
+  }
+
+  if (s)
+  {
+    for (i = 0; i < nb; i ++)
+    {
+      if (s[i].pdip)
+      {
+        // End of file to terminate the session
+        (void)pdip_send(s[i].pdip, "\004");
+        (void)pdip_status(s[i].pdip, &rc, 1);
+        (void)pdip_delete(s[i].pdip, 0);
+      }
+    } // End for
+    free(s);
+  }
+
+  if (ready)
+  {
+    (void)pdip_pattern_delete(ready);
+  }
+  if (pong)
+  {
+    (void)pdip_pattern_delete(pong);
+  }
+  free(display);
+
+  if (err)
+  {
+    return -1;
+  }
+
+  return ((double)nb * PBENCH_LOOP_ROUNDS) / (t1 - t0);
+} // pbench_loop
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_test_loop
+// Usage  : Compare the sessions driven one after the other with the blocking
+//          services and the sessions driven concurrently by an event loop
+// Return : 0, if OK
+//          1, if error
+// ----------------------------------------------------------------------------
+static int pbench_test_loop(unsigned int nb)
+{
+double rate_seq, rate_loop;
+
+  printf("loop: %u sessions x %u exchanges\n", nb, PBENCH_LOOP_ROUNDS);
+
+  rate_seq = pbench_loop(nb, 0);
+  rate_loop = pbench_loop(nb, 1);
+  if ((rate_seq < 0) || (rate_loop < 0))
+  {
+    return 1;
+  }
+
+  printf("  pdip_recv_pattern() : %12.0f exchanges/s (one session after the other)\n", rate_seq);
+  printf("  pdip_loop_run()     : %12.0f exchanges/s (x%.2f)\n", rate_loop, rate_loop / rate_seq);
+
+  return 0;
+} // pbench_test_loop
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_send
+// Usage  : Send 'nb' short lines to a program which discards them in the
+//          given supervision mode of the controlled processes with the
+//          configuration 'cfg' (NULL for the default one)
+// Return : Number of calls per second, if OK
+//          -1, if error
+// ----------------------------------------------------------------------------
+static double pbench_send(
+                          unsigned int  nb,
+                          int           sig_hdl,
+                          pdip_cfg_t   *cfg
+                         )
+{
+pdip_t        pdip;
+unsigned int  i;
+double        t0, t1;
+int           rc;
+int           err = 0;
+
+  rc = pdip_configure(sig_hdl, 0);
+  if (rc != 0)
+  {
+    fprintf(stderr, "pdip_configure(%d): '%m' (%d)\n", sig_hdl, errno);
+    return -1;
+  }
+
+  pdip = pbench_spawn("stty -echo; cat > /dev/null", cfg);
+  if (!pdip)
+  {
+    return -1;
+  }
+
+  t0 = pbench_now();
+  for (i = 0; i < nb; i ++)
+  {
+    rc = pdip_send(pdip, "x\n");
+    if (rc != 2)
+    {
+      fprintf(stderr, "pdip_send(): rc=%d, '%m' (%d)\n", rc, errno);
+      err = 1;
+      break;
+    }
+  } // End for
+  t1 = pbench_now();
+
+  (void)pdip_send(pdip, "\004");
+  (void)pdip_status(pdip, &rc, 1);
+  (void)pdip_delete(pdip, 0);
+
+  if (err)
+  {
+    return -1;
+  }
+
+  return (double)nb / (t1 - t0);
+} // pbench_send
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_test_send
+// Usage  : Compare the cost of pdip_send() when the processes are supervised
+//          through SIGCHLD (signals masked around the accesses to the
+//          objects) and through process file descriptors
+// Return : 0, if OK
+//          1, if error
+// ----------------------------------------------------------------------------
+static int pbench_test_send(unsigned int nb)
+{
+double rate_sig, rate_pidfd;
+
+  printf("send: %u lines\n", nb);
+
+  rate_sig = pbench_send(nb, PDIP_SIG_HDL_INTERNAL, (pdip_cfg_t *)0);
+  rate_pidfd = pbench_send(nb, PDIP_SIG_HDL_PIDFD, (pdip_cfg_t *)0);
+  if ((rate_sig < 0) || (rate_pidfd < 0))
+  {
+    return 1;
+  }
+
+  printf("  PDIP_SIG_HDL_INTERNAL : %12.0f calls/s\n", rate_sig);
+  printf("  PDIP_SIG_HDL_PIDFD    : %12.0f calls/s (x%.2f)\n", rate_pidfd, rate_pidfd / rate_sig);
+
+  // Back to the default mode of the benchmarks
+  return (0 == pdip_configure(PDIP_SIG_HDL_INTERNAL, 0) ? 0 : 1);
+} // pbench_test_send
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_test_record
+// Usage  : Measure the cost of the recording of the sessions on pdip_send()
+//          (one event per call) with a buffer and with a memory mapping of
+//          the file
+// Return : 0, if OK
+//          1, if error
+// ----------------------------------------------------------------------------
+static int pbench_test_record(unsigned int nb)
+{
+pdip_cfg_t  cfg;
+char        path[256];
+double      rate_none, rate_buf, rate_mmap;
+struct stat st;
+
+  printf("record: %u lines\n", nb);
+
+  snprintf(path, sizeof(path), "/tmp/pbench_%d.rec", getpid());
+
+  rate_none = pbench_send(nb, PDIP_SIG_HDL_INTERNAL, (pdip_cfg_t *)0);
+
+  (void)pdip_cfg_init(&cfg);
+  cfg.record = path;
+  rate_buf = pbench_send(nb, PDIP_SIG_HDL_INTERNAL, &cfg);
+  (void)unlink(path);
+
+  (void)pdip_cfg_init(&cfg);
+  cfg.record = path;
+  cfg.flags |= PDIP_FLAG_RECORD_MMAP;
+  rate_mmap = pbench_send(nb, PDIP_SIG_HDL_INTERNAL, &cfg);
+  if (0 != stat(path, &st))
+  {
+    st.st_size = 0;
+  }
+  (void)unlink(path);
+
+  if ((rate_none < 0) || (rate_buf < 0) || (rate_mmap < 0))
+  {
+    return 1;
+  }
+
+  printf("  no recording        : %12.0f calls/s\n", rate_none);
+  printf("  buffered recording  : %12.0f calls/s (x%.2f)\n", rate_buf, rate_buf / rate_none);
+  printf("  mmap recording      : %12.0f calls/s (x%.2f), %lu bytes recorded\n", rate_mmap, rate_mmap / rate_none, (unsigned long)st.st_size);
+
+  return 0;
+} // pbench_test_record
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_test_log
+// Usage  : Measure the cost of the debug messages on pdip_send() when they
+//          are printed by the calling thread and by the background thread
+// Return : 0, if OK
+//          1, if error
+// ----------------------------------------------------------------------------
+static int pbench_test_log(unsigned int nb)
+{
+pdip_cfg_t  cfg;
+FILE       *f;
+double      rate_none, rate_sync, rate_async;
+
+  printf("log: %u lines\n", nb);
+
+  f = fopen("/dev/null", "w");
+  if (!f)
+  {
+    fprintf(stderr, "fopen(/dev/null): '%m' (%d)\n", errno);
+    return 1;
+  }
+
+  rate_none = pbench_send(nb, PDIP_SIG_HDL_INTERNAL, (pdip_cfg_t *)0);
+
+  (void)pdip_cfg_init(&cfg);
+  cfg.dbg_output = f;
+  cfg.debug_level = 10;
+  rate_sync = pbench_send(nb, PDIP_SIG_HDL_INTERNAL, &cfg);
+
+  (void)pdip_configure_log(PDIP_LOG_ASYNC, 1024 * 1024);
+  rate_async = pbench_send(nb, PDIP_SIG_HDL_INTERNAL, &cfg);
+  (void)pdip_configure_log(PDIP_LOG_SYNC, 0);
+
+  fclose(f);
+
+  if ((rate_none < 0) || (rate_sync < 0) || (rate_async < 0))
+  {
+    return 1;
+  }
+
+  printf("  no debug            : %12.0f calls/s\n", rate_none);
+  printf("  PDIP_LOG_SYNC       : %12.0f calls/s (x%.2f)\n", rate_sync, rate_sync / rate_none);
+  printf("  PDIP_LOG_ASYNC      : %12.0f calls/s (x%.2f)\n", rate_async, rate_async / rate_none);
+
+  return 0;
+} // pbench_test_log
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_exec
+// Usage  : Run 'nb' times a program which exits immediately with the given
+//          spawning method
+// Return : Average duration of pdip_exec() in microseconds, if OK
+//          -1, if error
+// ----------------------------------------------------------------------------
+static double pbench_exec(
+                          unsigned int nb,
+                          unsigned int spawn
+                         )
+{
+pdip_t        pdip;
+pdip_cfg_t    cfg;
+char         *av[2];
+unsigned int  i;
+double        t0, t;
+int           rc;
+
+  (void)pdip_cfg_init(&cfg);
+  cfg.spawn = spawn;
+  pdip = pdip_new(&cfg);
+  if (!pdip)
+  {
+    fprintf(stderr, "pdip_new(): '%m' (%d)\n", errno);
+    return -1;
+  }
+
+  av[0] = "/bin/true";
+  av[1] = (char *)0;
+
+  t = 0;
+  for (i = 0; i < nb; i ++)
+  {
+    t0 = pbench_now();
+    rc = pdip_exec(pdip, 1, av);
+    t += pbench_now() - t0;
+    if (rc < 0)
+    {
+      fprintf(stderr, "pdip_exec(): '%m' (%d)\n", errno);
+      (void)pdip_delete(pdip, 0);
+      return -1;
+    }
+
+    (void)pdip_status(pdip, &rc, 1);
+  } // End for
+
+  (void)pdip_delete(pdip, 0);
+
+  return (t * 1000000.0) / nb;
+} // pbench_exec
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_test_exec
+// Usage  : Compare the latency of pdip_exec() with fork() and
+//          clone(CLONE_VM|CLONE_VFORK) as the resident memory of the main
+//          program grows
+// Return : 0, if OK
+//          1, if error
+// ----------------------------------------------------------------------------
+static int pbench_test_exec(unsigned int nb)
+{
+static const size_t  rss_mb[] = { 0, 64, 256, 1024 };
+unsigned int         i;
+char                *mem = (char *)0;
+double               t_fork, t_vfork;
+
+  printf("exec: %u executions\n", nb);
+
+  for (i = 0; i < sizeof(rss_mb) / sizeof(rss_mb[0]); i ++)
+  {
+    // Resident memory (the pages are touched)
+    free(mem);
+    mem = (char *)0;
+    if (rss_mb[i])
+    {
+      mem = (char *)malloc(rss_mb[i] * 1024 * 1024);
+      if (!mem)
+      {
+        fprintf(stderr, "malloc(%zu MB): '%m' (%d)\n", rss_mb[i], errno);
+        return 1;
+      }
+      memset(mem, 1, rss_mb[i] * 1024 * 1024);
+    }
+
+    t_fork = pbench_exec(nb, PDIP_SPAWN_FORK);
+    t_vfork = pbench_exec(nb, PDIP_SPAWN_VFORK);
+    if ((t_fork < 0) || (t_vfork < 0))
+    {
+      free(mem);
+      return 1;
+    }
+
+    printf("  RSS +%5zu MB: PDIP_SPAWN_FORK %9.1f us, PDIP_SPAWN_VFORK %9.1f us (x%.2f)\n",
+           rss_mb[i], t_fork, t_vfork, t_fork / t_vfork);
+  } // End for
+
+  free(mem);
+
+  return 0;
+} // pbench_test_exec
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_test_pty
+// Usage  : Compare the latency of pdip_exec() when the PTY are opened on the
+//          fly and when they are drawn from the pool
+// Return : 0, if OK
+//          1, if error
+// ----------------------------------------------------------------------------
+static int pbench_test_pty(unsigned int nb)
+{
+double t_open, t_pool;
+
+  printf("pty: %u executions\n", nb);
+
+  t_open = pbench_exec(nb, PDIP_SPAWN_VFORK);
+
+  if (0 != pdip_configure_pty_pool(4))
+  {
+    fprintf(stderr, "pdip_configure_pty_pool(): '%m' (%d)\n", errno);
+    return 1;
+  }
+  t_pool = pbench_exec(nb, PDIP_SPAWN_VFORK);
+  (void)pdip_configure_pty_pool(0);
+
+  if ((t_open < 0) || (t_pool < 0))
+  {
+    return 1;
+  }
+
+  printf("  PTY opened by pdip_exec() : %9.1f us\n", t_open);
+  printf("  PTY pool                  : %9.1f us (x%.2f)\n", t_pool, t_open / t_pool);
+
+  return 0;
+} // pbench_test_pty
+
+
+// ----------------------------------------------------------------------------
+// Name   : pbench_help
+// Usage  : Display the help
+// ----------------------------------------------------------------------------
+static void pbench_help(const char *prog)
+{
+  fprintf(stderr,
+          "Usage: %s [-n nb] [-d level] test...\n"
+          "\n"
+          "  -n nb    : Number of iterations (megabytes for stream/growth/match/replay tests,\n"
+          "             sessions for loop test)\n"
+          "  -d level : PDIP debug level\n"
+          "\n"
+          "Tests:\n"
+          "  recv     : pdip_recv() (with/without regex cache) versus pdip_recv_pattern()/pdip_recv_view()\n"
+          "  stream   : pdip_recv() of a trailer preceded by a huge amount of data\n"
+          "  growth   : Linear versus geometric growth of the reception buffers\n"
+          "  match    : Literal search versus regexec() on an anchored literal\n"
+          "  loop     : Sessions driven one after the other versus by an event loop\n"
+          "  send     : pdip_send() with SIGCHLD handler versus process file descriptors\n"
+          "  exec     : pdip_exec() with fork() versus clone(CLONE_VM|CLONE_VFORK) as the RSS grows\n"
+          "  pty      : pdip_exec() with PTY opened on the fly versus drawn from a pool\n"
+          "  record   : pdip_send() without recording versus with buffered/mmap recording\n"
+          "  filter   : scalar versus SIMD filter kernel in memory, pdip_recv() without versus with PDIP_FLAG_FILTER_CTRL on plain/colored lines\n"
+          "  log      : pdip_send() without debug versus with synchronous/asynchronous debug messages\n"
+          "  replay   : Reception of the data of pdata versus the same data replayed by preplay\n"
+          ,
+          prog);
+} // pbench_help
+
+
+int main(int ac, char *av[])
+{
+int          opt;
+unsigned int nb;
+int          rc;
+int          i;
+
+  nb = 0;
+
+  while ((opt = getopt(ac, av, "n:d:h")) != EOF)
+  {
+    switch(opt)
+    {
+      case 'n' : // Number of iterations
+      {
+        nb = (unsigned int)atoi(optarg);
+      }
+      break;
+
+      case 'd' : // Debug level
+      {
+        (void)pdip_set_debug_level(0, atoi(optarg));
+      }
+      break;
+
+      case 'h' :
+      default:
+      {
+        pbench_help(av[0]);
+        return 1;
+      }
+    } // End switch
+  } // End while
+
+  if (optind >= ac)
+  {
+    pbench_help(av[0]);
+    return 1;
+  }
+
+  rc = pdip_configure(1, 0);
+  if (rc != 0)
+  {
+    fprintf(stderr, "pdip_configure(): '%m' (%d)\n", errno);
+    return 1;
+  }
+
+  pbench_dir = dirname(strdup(av[0]));
+
+  rc = 0;
+  for (i = optind; (0 == rc) && (i < ac); i ++)
+  {
+    if (!strcmp(av[i], "recv"))
+    {
+      rc = pbench_test_recv(nb ? nb : 100000);
+    }
+    else if (!strcmp(av[i], "stream"))
+    {
+      rc = pbench_test_stream(nb ? nb : 100);
+    }
+    else if (!strcmp(av[i], "growth"))
+    {
+      rc = pbench_test_growth(nb ? nb : 20);
+    }
+    else if (!strcmp(av[i], "match"))
+    {
+      rc = pbench_test_match(nb ? nb : 64);
+    }
+    else if (!strcmp(av[i], "loop"))
+    {
+      rc = pbench_test_loop(nb ? nb : 50);
+    }
+    else if (!strcmp(av[i], "send"))
+    {
+      rc = pbench_test_send(nb ? nb : 200000);
+    }
+    else if (!strcmp(av[i], "replay"))
+    {
+      rc = pbench_test_replay(nb ? nb : 20);
+    }
+    else if (!strcmp(av[i], "record"))
+    {
+      rc = pbench_test_record(nb ? nb : 200000);
+    }
+    else if (!strcmp(av[i], "filter"))
+    {
+      rc = pbench_test_filter(nb ? nb : 50);
+    }
+    else if (!strcmp(av[i], "log"))
+    {
+      rc = pbench_test_log(nb ? nb : 200000);
+    }
+    else if (!strcmp(av[i], "exec"))
+    {
+      rc = pbench_test_exec(nb ? nb : 200);
+    }
+    else if (!strcmp(av[i], "pty"))
+    {
+      rc = pbench_test_pty(nb ? nb : 1000);
+    }
+    else
+    {
+      fprintf(stderr, "Unknown test '%s'\n", av[i]);
+      rc = 1;
+    }
+  } // End for
+
+  return rc;
+
+} // main
@@ -36,6 +36,7 @@ char         *interactive;
 char          str[2048];
 char         *banner;
 char         *trailer;
+char         *line;
 
   forever = 0;
   nb = 0;
@@ -114,17 +115,26 @@ char         *trailer;
     return 0;
   } // End if interactive mode
 
-  for (j = 0; j < (unsigned)lines; j ++)
+  // The line is built once for all
+  line = (char *)malloc(nb + 1);
+  if (!line)
   {
-    for (i = 0; i < (unsigned)nb; i ++)
-    {
-      printf("%c", 'a' + (i % 26));
-    } // End for
+    return 1;
+  }
 
-    printf("\n");
+  for (i = 0; i < (unsigned)nb; i ++)
+  {
+    line[i] = 'a' + (i % 26);
+  } // End for
+  line[nb] = '\n';
 
+  for (j = 0; j < (unsigned)lines; j ++)
+  {
+    fwrite(line, 1, nb + 1, stdout);
   } // End for
 
+  free(line);
+
   if (trailer)
   {
     printf("%s\n", trailer);
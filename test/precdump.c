@@ -0,0 +1,401 @@
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// File        : precdump.c
+// Description : Print the sessions recorded by PDIP objects as text
+//
+// License     :
+//
+//  Copyright (C) 2007-2018 Rachid Koucha <rachid dot koucha at gmail dot com>
+//
+//  This program is free and destined to help people using PDIP/ISYS/RSYS
+//  libraries
+//
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include "../pdip.h"
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : precdump_str
+// Usage  : Print data as a C string (the non printable characters are
+//          escaped). At most 'max' bytes are printed if 'max' is not 0
+// ----------------------------------------------------------------------------
+static void precdump_str(
+                         const unsigned char *data,
+                         size_t               len,
+                         size_t               max
+                        )
+{
+size_t i, l;
+
+  l = ((max && (len > max)) ? max : len);
+
+  putchar('"');
+  for (i = 0; i < l; i ++)
+  {
+    switch(data[i])
+    {
+      case '\n' : fputs("\\n", stdout); break;
+      case '\r' : fputs("\\r", stdout); break;
+      case '\t' : fputs("\\t", stdout); break;
+      case '\\' : fputs("\\\\", stdout); break;
+      case '"'  : fputs("\\\"", stdout); break;
+      default:
+      {
+        if ((data[i] < ' ') || (data[i] >= 0x7F))
+        {
+          printf("\\x%02x", data[i]);
+        }
+        else
+        {
+          putchar(data[i]);
+        }
+      }
+    } // End switch
+  } // End for
+  putchar('"');
+
+  if (l != len)
+  {
+    printf("...");
+  }
+} // precdump_str
+
+
+// ----------------------------------------------------------------------------
+// Name   : precdump_int
+// Usage  : Get the integer stored in the data of an event
+// Return : 0, if OK
+//          -1, if the event is malformed
+// ----------------------------------------------------------------------------
+static int precdump_int(
+                        const unsigned char *data,
+                        size_t               len,
+                        int32_t             *val
+                       )
+{
+  if (len < sizeof(int32_t))
+  {
+    return -1;
+  }
+
+  memcpy(val, data, sizeof(int32_t));
+
+  return 0;
+} // precdump_int
+
+
+// ----------------------------------------------------------------------------
+// Name   : precdump_event
+// Usage  : Print an event
+// ----------------------------------------------------------------------------
+static void precdump_event(
+                           const pdip_rec_event_t *ev,
+                           const unsigned char    *data,
+                           size_t                  max
+                          )
+{
+int32_t val;
+size_t  off;
+
+  printf("[%6lu.%09lu] ", (unsigned long)(ev->ts / 1000000000), (unsigned long)(ev->ts % 1000000000));
+
+  switch(ev->type)
+  {
+    case PDIP_REC_EXEC :
+    {
+      if (0 != precdump_int(data, ev->len, &val))
+      {
+        printf("EXEC   <malformed>\n");
+        break;
+      }
+
+      printf("EXEC   pid %d:", val);
+      for (off = sizeof(int32_t); off < ev->len; off += strlen((const char *)data + off) + 1)
+      {
+        printf(" ");
+        precdump_str(data + off, strnlen((const char *)data + off, ev->len - off), 0);
+      } // End for
+      printf("\n");
+    }
+    break;
+
+    case PDIP_REC_SEND :
+    case PDIP_REC_RECV :
+    {
+      printf("%s   %u: ", (PDIP_REC_SEND == ev->type ? "SEND" : "RECV"), ev->len);
+      precdump_str(data, ev->len, max);
+      printf("\n");
+    }
+    break;
+
+    case PDIP_REC_SIGNAL :
+    {
+      if (0 != precdump_int(data, ev->len, &val))
+      {
+        printf("SIGNAL <malformed>\n");
+        break;
+      }
+
+      printf("SIGNAL %d (%s)\n", val, strsignal(val));
+    }
+    break;
+
+    case PDIP_REC_EXIT :
+    {
+      if (0 != precdump_int(data, ev->len, &val))
+      {
+        printf("EXIT   <malformed>\n");
+        break;
+      }
+
+      if (WIFEXITED(val))
+      {
+        printf("EXIT   status %d\n", WEXITSTATUS(val));
+      }
+      else if (WIFSIGNALED(val))
+      {
+        printf("EXIT   signal %d (%s)\n", WTERMSIG(val), strsignal(WTERMSIG(val)));
+      }
+      else
+      {
+        printf("EXIT   0x%x\n", val);
+      }
+    }
+    break;
+
+    default :
+    {
+      printf("UNKNOWN type %u, %u bytes\n", ev->type, ev->len);
+    }
+    break;
+  } // End switch
+} // precdump_event
+
+
+// ----------------------------------------------------------------------------
+// Name   : precdump_pad
+// Usage  : Skip the zeros left by a crash at the end of a mapped recording
+//          (PDIP_REC_PAD). 'ev' contains the first bytes of the padding and
+//          receives the beginning of the following session, if any
+// Return : 1, if a session follows
+//          0, if end of file
+//          -1, if error
+// ----------------------------------------------------------------------------
+static int precdump_pad(
+                        FILE             *f,
+                        pdip_rec_event_t *ev
+                       )
+{
+unsigned char *p = (unsigned char *)ev;
+size_t         i;
+int            c;
+
+  // The following session may begin in the bytes already read
+  for (i = 0; (i < sizeof(*ev)) && !(p[i]); i ++)
+  {
+  } // End for
+
+  if (i < sizeof(*ev))
+  {
+    memmove(p, p + i, sizeof(*ev) - i);
+    i = sizeof(*ev) - i;
+  }
+  else
+  {
+    while (0 == (c = getc(f)))
+    {
+    } // End while
+
+    if (EOF == c)
+    {
+      return 0;
+    }
+
+    p[0] = (unsigned char)c;
+    i = 1;
+  }
+
+  if ((1 != fread(p + i, sizeof(*ev) - i, 1, f)) ||
+      memcmp(p, PDIP_REC_MAGIC, sizeof(PDIP_REC_MAGIC)))
+  {
+    fprintf(stderr, "Bad padding\n");
+    return -1;
+  }
+
+  return 1;
+} // precdump_pad
+
+
+// ----------------------------------------------------------------------------
+// Name   : precdump_file
+// Usage  : Print the sessions recorded into a file
+// Return : 0, if OK
+//          1, if error
+// ----------------------------------------------------------------------------
+static int precdump_file(
+                         FILE   *f,
+                         size_t  max
+                        )
+{
+union
+{
+  pdip_rec_hdr_t   hdr;
+  pdip_rec_event_t ev;
+}                 u;
+unsigned char    *data = (unsigned char *)0;
+size_t            data_sz = 0;
+time_t            t;
+struct tm         tm;
+char              date[64];
+int               rc;
+
+  // A file begins with the header of a session
+  if (1 != fread(&(u.ev), sizeof(u.ev), 1, f))
+  {
+    fprintf(stderr, "Empty recording\n");
+    return 1;
+  }
+
+  for (;;)
+  {
+    // Zeros left by a crash at the end of the session
+    if (PDIP_REC_PAD == u.ev.type)
+    {
+      printf("=== Session interrupted\n");
+
+      rc = precdump_pad(f, &(u.ev));
+      if (rc <= 0)
+      {
+        free(data);
+        return (rc < 0 ? 1 : 0);
+      }
+    }
+
+    // Header of a new session (the magic can't begin an event)
+    if (!memcmp(u.hdr.magic, PDIP_REC_MAGIC, sizeof(u.hdr.magic)))
+    {
+      if (1 != fread((char *)&(u.hdr) + sizeof(u.ev), sizeof(u.hdr) - sizeof(u.ev), 1, f))
+      {
+        fprintf(stderr, "Truncated session header\n");
+        free(data);
+        return 1;
+      }
+
+      if (PDIP_REC_VERSION != u.hdr.version)
+      {
+        fprintf(stderr, "Unsupported version %u\n", u.hdr.version);
+        free(data);
+        return 1;
+      }
+
+      t = (time_t)(u.hdr.start / 1000000000);
+      (void)localtime_r(&t, &tm);
+      (void)strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+      printf("=== Session started on %s.%09lu\n", date, (unsigned long)(u.hdr.start % 1000000000));
+    }
+    else
+    {
+      if (u.ev.len > data_sz)
+      {
+        free(data);
+        data_sz = u.ev.len;
+        data = (unsigned char *)malloc(data_sz);
+        if (!data)
+        {
+          fprintf(stderr, "malloc(%zu): '%m' (%d)\n", data_sz, errno);
+          return 1;
+        }
+      }
+
+      if (u.ev.len && (1 != fread(data, u.ev.len, 1, f)))
+      {
+        fprintf(stderr, "Truncated event\n");
+        free(data);
+        return 1;
+      }
+
+      precdump_event(&(u.ev), data, max);
+    }
+
+    if (1 != fread(&(u.ev), sizeof(u.ev), 1, f))
+    {
+      break;
+    }
+  } // End for
+
+  free(data);
+
+  return 0;
+} // precdump_file
+
+
+int main(int ac, char *av[])
+{
+int     opt;
+size_t  max;
+FILE   *f;
+int     rc;
+int     i;
+
+  max = 0;
+
+  while ((opt = getopt(ac, av, "m:h")) != EOF)
+  {
+    switch(opt)
+    {
+      case 'm' : // Maximum number of data bytes printed per event
+      {
+        max = (size_t)atoi(optarg);
+      }
+      break;
+
+      case 'h' :
+      default:
+      {
+        fprintf(stderr,
+                "Usage: %s [-m max] [file...]\n"
+                "\n"
+                "  -m max : Maximum number of bytes printed per data event (0 for all, default)\n"
+                "\n"
+                "The standard input is read if no file is passed\n"
+                ,
+                av[0]);
+        return 1;
+      }
+    } // End switch
+  } // End while
+
+  if (optind >= ac)
+  {
+    return precdump_file(stdin, max);
+  }
+
+  rc = 0;
+  for (i = optind; (0 == rc) && (i < ac); i ++)
+  {
+    f = fopen(av[i], "r");
+    if (!f)
+    {
+      fprintf(stderr, "%s: '%m' (%d)\n", av[i], errno);
+      return 1;
+    }
+
+    rc = precdump_file(f, max);
+
+    fclose(f);
+  } // End for
+
+  return rc;
+
+} // main
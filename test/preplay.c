@@ -0,0 +1,609 @@
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// File        : preplay.c
+// Description : Stand-in of a controlled program replaying an execution
+//               recorded by a PDIP object: the recorded output is displayed
+//               with the original (or scaled) timing and the recorded inputs
+//               and signals are awaited before going on
+//
+// License     :
+//
+//  Copyright (C) 2007-2018 Rachid Koucha <rachid dot koucha at gmail dot com>
+//
+//  This program is free and destined to help people using PDIP/ISYS/RSYS
+//  libraries
+//
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/wait.h>
+
+#include "../pdip.h"
+
+
+
+// Recorded event
+typedef struct
+{
+  pdip_rec_event_t  ev;
+  unsigned char    *data;
+} preplay_event_t;
+
+
+// Events of the replayed execution
+static preplay_event_t *preplay_events;
+static unsigned int     preplay_nb_events;
+
+// Input received but not consumed yet
+static unsigned char    preplay_in[4096];
+static size_t           preplay_in_len;
+
+// Settings of the terminal
+static struct termios   preplay_tio;
+static int              preplay_tio_saved;
+
+
+
+// ----------------------------------------------------------------------------
+// Name   : preplay_pad
+// Usage  : Skip the zeros left by a crash at the end of a mapped recording
+//          (PDIP_REC_PAD). 'ev' contains the first bytes of the padding and
+//          receives the beginning of the following session, if any
+// Return : 1, if a session follows
+//          0, if end of file
+//          -1, if error
+// ----------------------------------------------------------------------------
+static int preplay_pad(
+                       FILE             *f,
+                       pdip_rec_event_t *ev
+                      )
+{
+unsigned char *p = (unsigned char *)ev;
+size_t         i;
+int            c;
+
+  // The following session may begin in the bytes already read
+  for (i = 0; (i < sizeof(*ev)) && !(p[i]); i ++)
+  {
+  } // End for
+
+  if (i < sizeof(*ev))
+  {
+    memmove(p, p + i, sizeof(*ev) - i);
+    i = sizeof(*ev) - i;
+  }
+  else
+  {
+    while (0 == (c = getc(f)))
+    {
+    } // End while
+
+    if (EOF == c)
+    {
+      return 0;
+    }
+
+    p[0] = (unsigned char)c;
+    i = 1;
+  }
+
+  if ((1 != fread(p + i, sizeof(*ev) - i, 1, f)) ||
+      memcmp(p, PDIP_REC_MAGIC, sizeof(PDIP_REC_MAGIC)))
+  {
+    fprintf(stderr, "Bad padding\n");
+    return -1;
+  }
+
+  return 1;
+} // preplay_pad
+
+
+// ----------------------------------------------------------------------------
+// Name   : preplay_load
+// Usage  : Load the events of the 'exec_num'th execution (counted from 1)
+//          recorded into a file
+// Return : 0, if OK
+//          -1, if error
+// ----------------------------------------------------------------------------
+static int preplay_load(
+                        FILE         *f,
+                        unsigned int  exec_num
+                       )
+{
+union
+{
+  pdip_rec_hdr_t   hdr;
+  pdip_rec_event_t ev;
+}                 u;
+unsigned char    *data;
+unsigned int      nb_exec = 0;
+preplay_event_t  *p;
+int               rc;
+
+  while (1 == fread(&(u.ev), sizeof(u.ev), 1, f))
+  {
+    // Zeros left by a crash at the end of the session: the execution ends
+    if (PDIP_REC_PAD == u.ev.type)
+    {
+      if (nb_exec == exec_num)
+      {
+        break;
+      }
+
+      rc = preplay_pad(f, &(u.ev));
+      if (rc < 0)
+      {
+        return -1;
+      }
+
+      if (0 == rc)
+      {
+        break;
+      }
+    }
+
+    // Header of a new session (the magic can't begin an event)
+    if (!memcmp(u.hdr.magic, PDIP_REC_MAGIC, sizeof(u.hdr.magic)))
+    {
+      if ((1 != fread((char *)&(u.hdr) + sizeof(u.ev), sizeof(u.hdr) - sizeof(u.ev), 1, f)) ||
+          (PDIP_REC_VERSION != u.hdr.version))
+      {
+        fprintf(stderr, "Bad session header\n");
+        return -1;
+      }
+
+      // The execution ends with the session
+      if (nb_exec == exec_num)
+      {
+        break;
+      }
+
+      continue;
+    }
+
+    if (PDIP_REC_EXEC == u.ev.type)
+    {
+      nb_exec ++;
+      if (nb_exec > exec_num)
+      {
+        break;
+      }
+    }
+
+    data = (unsigned char *)0;
+    if (u.ev.len)
+    {
+      data = (unsigned char *)malloc(u.ev.len);
+      if (!data)
+      {
+        fprintf(stderr, "malloc(%u): '%m' (%d)\n", u.ev.len, errno);
+        return -1;
+      }
+
+      if (1 != fread(data, u.ev.len, 1, f))
+      {
+        fprintf(stderr, "Truncated event\n");
+        free(data);
+        return -1;
+      }
+    }
+
+    if (nb_exec != exec_num)
+    {
+      free(data);
+      continue;
+    }
+
+    p = (preplay_event_t *)realloc(preplay_events, (preplay_nb_events + 1) * sizeof(preplay_event_t));
+    if (!p)
+    {
+      fprintf(stderr, "realloc(): '%m' (%d)\n", errno);
+      free(data);
+      return -1;
+    }
+
+    preplay_events = p;
+    preplay_events[preplay_nb_events].ev   = u.ev;
+    preplay_events[preplay_nb_events].data = data;
+    preplay_nb_events ++;
+  } // End while
+
+  if (!preplay_nb_events)
+  {
+    fprintf(stderr, "Execution #%u not found\n", exec_num);
+    return -1;
+  }
+
+  return 0;
+} // preplay_load
+
+
+// ----------------------------------------------------------------------------
+// Name   : preplay_restore
+// Usage  : Restore the settings of the terminal
+// ----------------------------------------------------------------------------
+static void preplay_restore(void)
+{
+  if (preplay_tio_saved)
+  {
+    (void)tcsetattr(0, TCSANOW, &preplay_tio);
+    preplay_tio_saved = 0;
+  }
+} // preplay_restore
+
+
+// ----------------------------------------------------------------------------
+// Name   : preplay_raw
+// Usage  : Set the terminal in raw mode as the recorded output already
+//          contains the echo and the processing of the original terminal.
+//          The data sent before this call are echoed by the terminal: the
+//          driving program is expected to wait for the first output (e.g. a
+//          prompt) as with the original program
+// ----------------------------------------------------------------------------
+static void preplay_raw(void)
+{
+struct termios tio;
+
+  if (0 != tcgetattr(0, &preplay_tio))
+  {
+    // Not a terminal
+    return;
+  }
+
+  preplay_tio_saved = 1;
+
+  tio = preplay_tio;
+  cfmakeraw(&tio);
+  (void)tcsetattr(0, TCSANOW, &tio);
+
+  atexit(preplay_restore);
+} // preplay_raw
+
+
+// ----------------------------------------------------------------------------
+// Name   : preplay_wait
+// Usage  : Wait until the date of an event. The dates are relative to the
+//          last input: the time spent by the driving program to send it is
+//          not replayed
+// ----------------------------------------------------------------------------
+static void preplay_wait(
+                         const struct timespec *ref,
+                         uint64_t               ref_ts,
+                         uint64_t               ts,
+                         double                 scale
+                        )
+{
+struct timespec date;
+uint64_t        delay;
+
+  if ((scale <= 0) || (ts <= ref_ts))
+  {
+    return;
+  }
+
+  delay = (uint64_t)((double)(ts - ref_ts) * scale);
+
+  date.tv_sec  = ref->tv_sec + (time_t)(delay / 1000000000);
+  date.tv_nsec = ref->tv_nsec + (long)(delay % 1000000000);
+  if (date.tv_nsec >= 1000000000)
+  {
+    date.tv_sec += 1;
+    date.tv_nsec -= 1000000000;
+  }
+
+  while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &date, (struct timespec *)0))
+  {
+  } // End while
+} // preplay_wait
+
+
+// ----------------------------------------------------------------------------
+// Name   : preplay_output
+// Usage  : Display recorded output
+// Return : 0, if OK
+//          -1, if error
+// ----------------------------------------------------------------------------
+static int preplay_output(
+                          const unsigned char *data,
+                          size_t               len
+                         )
+{
+ssize_t rc;
+
+  while (len)
+  {
+    rc = write(1, data, len);
+    if (rc < 0)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+
+      return -1;
+    }
+
+    data += rc;
+    len -= (size_t)rc;
+  } // End while
+
+  return 0;
+} // preplay_output
+
+
+// ----------------------------------------------------------------------------
+// Name   : preplay_input
+// Usage  : Wait for recorded input
+// Return : 0, if the input is received
+//          1, if unexpected data are received
+//          -1, if error or end of input
+// ----------------------------------------------------------------------------
+static int preplay_input(
+                         const unsigned char *data,
+                         size_t               len
+                        )
+{
+size_t  l;
+ssize_t rc;
+
+  while (len)
+  {
+    if (!preplay_in_len)
+    {
+      rc = read(0, preplay_in, sizeof(preplay_in));
+      if (rc <= 0)
+      {
+        if ((rc < 0) && (EINTR == errno))
+        {
+          continue;
+        }
+
+        return -1;
+      }
+
+      preplay_in_len = (size_t)rc;
+    }
+
+    l = (preplay_in_len < len ? preplay_in_len : len);
+    if (memcmp(preplay_in, data, l))
+    {
+      return 1;
+    }
+
+    memmove(preplay_in, preplay_in + l, preplay_in_len - l);
+    preplay_in_len -= l;
+    data += l;
+    len -= l;
+  } // End while
+
+  return 0;
+} // preplay_input
+
+
+// ----------------------------------------------------------------------------
+// Name   : preplay_int
+// Usage  : Get the integer stored in the data of an event
+// Return : The integer
+// ----------------------------------------------------------------------------
+static int32_t preplay_int(const preplay_event_t *ev)
+{
+int32_t val = 0;
+
+  if (ev->ev.len >= sizeof(val))
+  {
+    memcpy(&val, ev->data, sizeof(val));
+  }
+
+  return val;
+} // preplay_int
+
+
+// ----------------------------------------------------------------------------
+// Name   : preplay_exit
+// Usage  : Terminate as the recorded program
+// ----------------------------------------------------------------------------
+static void preplay_exit(int status)
+{
+sigset_t set;
+int      sig;
+
+  if (WIFSIGNALED(status))
+  {
+    sig = WTERMSIG(status);
+
+    preplay_restore();
+
+    signal(sig, SIG_DFL);
+    sigemptyset(&set);
+    sigaddset(&set, sig);
+    (void)sigprocmask(SIG_UNBLOCK, &set, (sigset_t *)0);
+    (void)raise(sig);
+
+    // The signal does not terminate the process
+    _exit(128 + sig);
+  }
+
+  exit(WIFEXITED(status) ? WEXITSTATUS(status) : 0);
+} // preplay_exit
+
+
+static void preplay_help(const char *prog)
+{
+  fprintf(stderr,
+          "Usage: %s [-s scale] [-n num] file\n"
+          "\n"
+          "  -s scale : Multiplier of the recorded delays (1 by default, 0 for no delay)\n"
+          "  -n num   : Number of the replayed execution in the file (1 by default)\n"
+          "\n"
+          "The recorded output is displayed on the standard output. The recorded\n"
+          "input is awaited on the standard input: the program exits with status 2\n"
+          "if it receives unexpected data. The recorded signals are awaited before\n"
+          "going on. The program ends with the recorded status\n"
+          ,
+          prog);
+} // preplay_help
+
+
+int main(int ac, char *av[])
+{
+int               opt;
+double            scale;
+unsigned int      exec_num;
+FILE             *f;
+sigset_t          set, wset;
+preplay_event_t  *ev;
+struct timespec   ref;
+uint64_t          ref_ts;
+unsigned int      i;
+int               sig;
+int               rc;
+
+  scale = 1;
+  exec_num = 1;
+
+  while ((opt = getopt(ac, av, "s:n:h")) != EOF)
+  {
+    switch(opt)
+    {
+      case 's' : // Scale of the delays
+      {
+        scale = atof(optarg);
+      }
+      break;
+
+      case 'n' : // Number of the execution
+      {
+        exec_num = (unsigned int)atoi(optarg);
+      }
+      break;
+
+      case 'h' :
+      default:
+      {
+        preplay_help(av[0]);
+        return 1;
+      }
+    } // End switch
+  } // End while
+
+  if ((optind != (ac - 1)) || (0 == exec_num))
+  {
+    preplay_help(av[0]);
+    return 1;
+  }
+
+  f = fopen(av[optind], "r");
+  if (!f)
+  {
+    fprintf(stderr, "%s: '%m' (%d)\n", av[optind], errno);
+    return 1;
+  }
+
+  rc = preplay_load(f, exec_num);
+  fclose(f);
+  if (0 != rc)
+  {
+    return 1;
+  }
+
+  // The recorded signals are blocked to be awaited when they are expected
+  sigemptyset(&set);
+  for (i = 0; i < preplay_nb_events; i ++)
+  {
+    if (PDIP_REC_SIGNAL == preplay_events[i].ev.type)
+    {
+      sig = preplay_int(&(preplay_events[i]));
+      if ((sig > 0) && (sig != SIGKILL) && (sig != SIGSTOP))
+      {
+        sigaddset(&set, sig);
+      }
+    }
+  } // End for
+  (void)sigprocmask(SIG_BLOCK, &set, (sigset_t *)0);
+
+  preplay_raw();
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ref);
+  ref_ts = preplay_events[0].ev.ts;
+
+  for (i = 0; i < preplay_nb_events; i ++)
+  {
+    ev = &(preplay_events[i]);
+
+    switch(ev->ev.type)
+    {
+      case PDIP_REC_RECV :
+      {
+        preplay_wait(&ref, ref_ts, ev->ev.ts, scale);
+        if (0 != preplay_output(ev->data, ev->ev.len))
+        {
+          return 1;
+        }
+      }
+      break;
+
+      case PDIP_REC_SEND :
+      {
+        rc = preplay_input(ev->data, ev->ev.len);
+        if (rc != 0)
+        {
+          preplay_restore();
+          fprintf(stderr, "%s\n", (rc > 0 ? "Unexpected input" : "End of input"));
+          exit(2);
+        }
+
+        // The following delays are relative to the reception of the input
+        (void)clock_gettime(CLOCK_MONOTONIC, &ref);
+        ref_ts = ev->ev.ts;
+      }
+      break;
+
+      case PDIP_REC_SIGNAL :
+      {
+        sig = preplay_int(ev);
+        if (sigismember(&set, sig) > 0)
+        {
+          sigemptyset(&wset);
+          sigaddset(&wset, sig);
+          while ((sigwaitinfo(&wset, (siginfo_t *)0) < 0) && (EINTR == errno))
+          {
+          } // End while
+        }
+        else if (SIGKILL == sig)
+        {
+          // Not catchable: the process ends upon reception
+          pause();
+        }
+
+        (void)clock_gettime(CLOCK_MONOTONIC, &ref);
+        ref_ts = ev->ev.ts;
+      }
+      break;
+
+      case PDIP_REC_EXIT :
+      {
+        preplay_wait(&ref, ref_ts, ev->ev.ts, scale);
+        preplay_exit(preplay_int(ev));
+      }
+      break;
+
+      default :
+      {
+        // EXEC or unknown events
+      }
+      break;
+    } // End switch
+  } // End for
+
+  // Recording interrupted before the end of the program
+  return 0;
+
+} // main
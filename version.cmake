@@ -1,8 +1,8 @@
 # Version number
 
-SET(PDIP_MAJOR  2)
-SET(PDIP_MINOR  4)
-SET(PDIP_PATCH  5)
+SET(PDIP_MAJOR  3)
+SET(PDIP_MINOR  0)
+SET(PDIP_PATCH  0)
 SET(PDIP_VERSION ${PDIP_MAJOR}.${PDIP_MINOR}.${PDIP_PATCH})
 
 